@@ -17,3 +17,24 @@ FILE *cpymo_backend_write_save(const char * gamedir, const char * name)
 	return fopen(path, "wb");
 }
 
+FILE *cpymo_backend_append_save(const char * gamedir, const char * name)
+{
+	char *path = (char *)alloca(strlen(gamedir) + strlen(name) + 8);
+	sprintf(path, "%s/save/%s", gamedir, name);
+	return fopen(path, "ab");
+}
+
+error_t cpymo_backend_move_save(const char *gamedir, const char *from_name, const char *to_name)
+{
+	char *from = (char *)alloca(strlen(gamedir) + strlen(from_name) + 8);
+	char *to = (char *)alloca(strlen(gamedir) + strlen(to_name) + 8);
+	sprintf(from, "%s/save/%s", gamedir, from_name);
+	sprintf(to, "%s/save/%s", gamedir, to_name);
+
+	// The SD card can not rename over an existing file.
+	remove(to);
+	if (rename(from, to) != 0) return CPYMO_ERR_UNKNOWN;
+
+	return CPYMO_ERR_SUCC;
+}
+
@@ -1,9 +1,14 @@
 #ifndef INCLUDE_CPYMO_BACKEND_SAVE
 #define INCLUDE_CPYMO_BACKEND_SAVE
 
+#include "../../cpymo/cpymo_error.h"
 #include <stdio.h>
 
 FILE *cpymo_backend_read_save(const char *gamedir, const char *name);
 FILE *cpymo_backend_write_save(const char *gamedir, const char *name);
+FILE *cpymo_backend_append_save(const char *gamedir, const char *name);
+
+// Renames save from_name to to_name, replacing to_name if it exists.
+error_t cpymo_backend_move_save(const char *gamedir, const char *from_name, const char *to_name);
 
 #endif
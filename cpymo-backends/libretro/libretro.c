@@ -167,6 +167,28 @@ FILE *cpymo_backend_write_save(const char *gamedir, const char * name)
     return fopen(path, "wb");
 }
 
+FILE *cpymo_backend_append_save(const char *gamedir, const char * name)
+{
+    char *path = (char *)alloca(strlen(name) + 8);
+    sprintf(path, "save/%s", name);
+    return fopen(path, "ab");
+}
+
+error_t cpymo_backend_move_save(const char *gamedir, const char *from_name, const char *to_name)
+{
+    char *from = (char *)alloca(strlen(from_name) + 8);
+    char *to = (char *)alloca(strlen(to_name) + 8);
+    sprintf(from, "save/%s", from_name);
+    sprintf(to, "save/%s", to_name);
+
+    #ifdef _WIN32
+    remove(to);
+    #endif
+
+    if (rename(from, to) != 0) return CPYMO_ERR_UNKNOWN;
+    return CPYMO_ERR_SUCC;
+}
+
 static void fallback_log(enum retro_log_level level, const char *fmt, ...)
 {
     (void)level;
@@ -270,6 +292,15 @@ void retro_init(void)
     };
     environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &pixfmt);
     environ_cb(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &frametime);
+
+    // States restart from the last say like saves do, and may grow with the game.
+    // Waits and tweens are not serialized, so run-ahead would restart
+    // the current line every frame; INCOMPLETE keeps frontends from using it.
+    // TODO: run-ahead needs the wait callbacks, tweens, textbox progress,
+    // audio positions and open UIs in the state before INCOMPLETE can go.
+    uint64_t quirks =
+        RETRO_SERIALIZATION_QUIRK_INCOMPLETE | RETRO_SERIALIZATION_QUIRK_CORE_VARIABLE_SIZE;
+    environ_cb(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks);
 }
 
 
@@ -445,17 +476,23 @@ void retro_run(void)
 
 size_t retro_serialize_size(void)
 {
-    return 0;
+    return cpymo_rollback_state_size(&engine);
 }
 
 bool retro_serialize(void *data, size_t size)
 {
-    return false;
+    error_t err = cpymo_rollback_save_state(&engine, data, size);
+    if (err != CPYMO_ERR_SUCC)
+        log_cb(RETRO_LOG_ERROR, "cpymo_rollback_save_state: %s\n", cpymo_error_message(err));
+    return err == CPYMO_ERR_SUCC;
 }
 
 bool retro_unserialize(const void *data, size_t size)
 {
-    return false;
+    error_t err = cpymo_rollback_load_state(&engine, data, size);
+    if (err != CPYMO_ERR_SUCC)
+        log_cb(RETRO_LOG_ERROR, "cpymo_rollback_load_state: %s\n", cpymo_error_message(err));
+    return err == CPYMO_ERR_SUCC;
 }
 
 void retro_cheat_reset(void) {}
@@ -375,6 +375,7 @@ void cpymo_backend_masktrans_draw(cpymo_backend_masktrans m, float t, bool is_fa
 #ifdef ENABLE_SDL_IMAGE
 #include <cpymo_package.h>
 #include <cpymo_assetloader.h>
+#include <cpymo_utils.h>
 
 error_t cpymo_assetloader_load_icon_pixels(
 	void **px, int *w, int *h, const char *gamedir)
@@ -413,17 +414,25 @@ static error_t cpymo_assetloader_load_image_surface(
 	cpymo_str name,
 	const char *asset_type,
 	const char *asset_ext,
-	bool use_pkg,
-	const cpymo_package *pkg,
 	const cpymo_assetloader *loader)
 {
+	// Through the vfs, so patch packages apply.
+	cpymo_vfs_file f;
+	error_t err = cpymo_vfs_find(&f, &loader->vfs, asset_type, name, asset_ext);
+	CPYMO_THROW(err);
+
 	SDL_Surface *sur;
-	if (use_pkg) {
-		cpymo_package_stream_reader r;
-		error_t err = cpymo_package_stream_reader_find_create(&r, pkg, name);
-		CPYMO_THROW(err);
+	if (f.package) {
+		cpymo_package_stream_reader r = 
+			cpymo_package_stream_reader_create(f.package, &f.index);
+
+		SDL_RWops *rwops;
+		if (r.mapped) rwops = SDL_RWFromConstMem(r.mapped, (int)r.file_length);
+		else {
+			cpymo_utils_fseek64(r.stream, (int64_t)r.file_offset, SEEK_SET);
+			rwops = SDL_RWFromFP(r.stream, 0);
+		}
 
-		SDL_RWops *rwops = SDL_RWFromFP(r.stream, 0);
 		if (rwops == NULL) {
 			cpymo_package_stream_reader_close(&r);
 			return CPYMO_ERR_OUT_OF_MEM;
@@ -432,34 +441,9 @@ static error_t cpymo_assetloader_load_image_surface(
 		sur = IMG_Load_RW(rwops, 0);
 		SDL_RWclose(rwops);
 		cpymo_package_stream_reader_close(&r);
-		
-		/*char *buf;
-		size_t len;
-		error_t err = cpymo_package_read_file(&buf, &len, pkg, name);
-		CPYMO_THROW(err);
-
-		SDL_RWops *rwops = SDL_RWFromConstMem(buf, (int)len);
-		if (rwops == NULL) {
-			free(buf);
-			return CPYMO_ERR_OUT_OF_MEM;
-		}
-
-		sur = IMG_Load_RW(rwops, 0);
-		SDL_RWclose(rwops);
-		free(buf);*/
 	}
 	else {
-		char *path;
-		error_t err = cpymo_assetloader_get_fs_path(
-			&path,
-			name,
-			asset_type,
-			asset_ext,
-			loader);
-		CPYMO_THROW(err);
-
-		sur = IMG_Load(path);
-		free(path);
+		sur = IMG_Load(f.path);
 	}
 
 	if (sur == NULL) return CPYMO_ERR_OUT_OF_MEM;
@@ -481,7 +465,7 @@ static error_t cpymo_assetloader_load_image_with_mask_ex(
 {
 	SDL_Surface *sur;
 	error_t err = cpymo_assetloader_load_image_surface(
-		&sur, name, asset_type, asset_ext, use_pkg, pkg, loader);
+		&sur, name, asset_type, asset_ext, loader);
 	CPYMO_THROW(err);
 
 	if (sur == NULL) return CPYMO_ERR_OUT_OF_MEM;
@@ -494,8 +478,7 @@ static error_t cpymo_assetloader_load_image_with_mask_ex(
 
 			SDL_Surface *mask;
 			error_t errmask = cpymo_assetloader_load_image_surface(
-				&mask, cpymo_str_pure(mask_name), asset_type, mask_ext, 
-				use_pkg, pkg, loader);
+				&mask, cpymo_str_pure(mask_name), asset_type, mask_ext, loader);
 			free(mask_name);
 
 			if (errmask == CPYMO_ERR_SUCC) {
@@ -579,19 +562,11 @@ error_t cpymo_assetloader_load_system_masktrans(
 	cpymo_backend_masktrans *out, cpymo_str name, 
 	const cpymo_assetloader *loader)
 { 
-	char *filename;
-	error_t err = cpymo_assetloader_get_fs_path(
-		&filename,
-		name,
-		"system",
-		"png",
-		loader);		
+	SDL_Surface *mask;
+	error_t err = cpymo_assetloader_load_image_surface(
+		&mask, name, "system", "png", loader);
 	CPYMO_THROW(err);
 
-	SDL_Surface *mask = IMG_Load(filename);
-	free(filename);
-	if (mask == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
-
 	Uint8 *mask_surface = (Uint8 *)malloc(
 		engine.gameconfig.imagesize_w * engine.gameconfig.imagesize_h);
 	if (mask_surface == NULL) {
@@ -220,6 +220,7 @@ bool cpymo_backend_image_album_ui_writable() { return true; }
 #ifdef ENABLE_SDL2_IMAGE
 #include "../../cpymo/cpymo_package.h"
 #include "../../cpymo/cpymo_assetloader.h"
+#include "../../cpymo/cpymo_utils.h"
 #include <SDL2/SDL_image.h>
 
 error_t cpymo_assetloader_load_icon_pixels(
@@ -247,51 +248,45 @@ error_t cpymo_assetloader_load_icon(
 	return CPYMO_ERR_SUCC;
 }
 
-static SDL_Surface *cpymo_package_sdl2_load_surface(
-	const cpymo_package *package, cpymo_str filename)
+// Through the vfs, so patch packages apply.
+static SDL_Surface *cpymo_assetloader_sdl2_load_surface(
+	const cpymo_assetloader *loader,
+	const char *asset_type, cpymo_str name, const char *asset_ext)
 {
-	cpymo_package_index index;
-	error_t err = cpymo_package_find(&index, package, filename);
+	cpymo_vfs_file f;
+	error_t err = cpymo_vfs_find(&f, &loader->vfs, asset_type, name, asset_ext);
 	if (err != CPYMO_ERR_SUCC) return NULL;
 
+	if (f.package == NULL) return IMG_Load(f.path);
+
 	cpymo_package_stream_reader r = cpymo_package_stream_reader_create(
-		package, &index);
-	fseek(r.stream, r.file_offset, SEEK_SET);
+		f.package, &f.index);
 
-	SDL_RWops *rw = SDL_RWFromFP(r.stream, false);
-	if (rw == NULL) return NULL;
+	SDL_RWops *rw;
+	if (r.mapped) rw = SDL_RWFromConstMem(r.mapped, (int)r.file_length);
+	else {
+		cpymo_utils_fseek64(r.stream, (int64_t)r.file_offset, SEEK_SET);
+		rw = SDL_RWFromFP(r.stream, false);
+	}
 
-	return IMG_Load_RW(rw, true);
+	SDL_Surface *sur = rw ? IMG_Load_RW(rw, true) : NULL;
+	cpymo_package_stream_reader_close(&r);
+	return sur;
 }
 
 static void cpymo_assetloader_sdl2_attach_mask(
 	SDL_Surface **img,
-	const cpymo_package *pkg, bool use_pkg,
 	const cpymo_assetloader *loader,
 	const char *asset_type,
 	cpymo_str asset_name,
 	const char *mask_ext)
 {
-	SDL_Surface *mask = NULL;
 	char *name = alloca(asset_name.len + 8);
 	cpymo_str_copy(name, asset_name.len + 8, asset_name);
 	strcat(name, "_mask");
 
-	if (use_pkg) {
-		mask = cpymo_package_sdl2_load_surface(
-			pkg, cpymo_str_pure(name));
-	}
-	else {
-		char *path = NULL;
-		error_t err = cpymo_assetloader_get_fs_path(
-			&path, cpymo_str_pure(name),
-			asset_type, mask_ext, loader);
-		
-		if (err != CPYMO_ERR_SUCC) return;
-
-		mask = IMG_Load(path);
-		free(path);
-	}
+	SDL_Surface *mask = cpymo_assetloader_sdl2_load_surface(
+		loader, asset_type, cpymo_str_pure(name), mask_ext);
 
 	if (mask == NULL) return;
 	if (mask->w != (*img)->w || mask->h != (*img)->h) {
@@ -349,30 +344,15 @@ error_t cpymo_assetloader_load_image_with_mask(
 	const cpymo_assetloader *loader,
 	bool load_mask)
 {
-	SDL_Surface *sur = NULL;
-	if (use_pkg) {
-		sur = cpymo_package_sdl2_load_surface(pkg, name);
-	}
-	else {
-		char *path = NULL;
-		error_t err = cpymo_assetloader_get_fs_path(
-			&path,
-			name,
-			asset_type,
-			asset_ext,
-			loader);
-		CPYMO_THROW(err);
-
-		sur = IMG_Load(path);
-		free(path);
-	}
+	SDL_Surface *sur = cpymo_assetloader_sdl2_load_surface(
+		loader, asset_type, name, asset_ext);
 
 	if (sur == NULL) 
 		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 
 	if (load_mask && cpymo_gameconfig_is_symbian(loader->game_config)) 
 		cpymo_assetloader_sdl2_attach_mask(
-			&sur, pkg, use_pkg, loader, asset_type, name, mask_ext);
+			&sur, loader, asset_type, name, mask_ext);
 
 	SDL_Texture *t = SDL_CreateTextureFromSurface(renderer, sur);
 	int sw = sur->w, sh = sur->h;
@@ -406,16 +386,9 @@ error_t cpymo_assetloader_load_system_masktrans(
 	cpymo_backend_masktrans *out, cpymo_str name, 
 	const cpymo_assetloader *loader)
 { 
-	char *path = NULL;
-	error_t err = cpymo_assetloader_get_fs_path(
-		&path, name, "system", "png", loader);
-	CPYMO_THROW(err);
-
-	SDL_Surface *sur = IMG_Load(path);
-	if (sur == NULL) {
-		free(path);
-		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
-	}
+	SDL_Surface *sur = cpymo_assetloader_sdl2_load_surface(
+		loader, "system", name, "png");
+	if (sur == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 
 	SDL_Surface *sur2 = 
 		SDL_ConvertSurfaceFormat(sur, SDL_PIXELFORMAT_RGBA8888, 0);
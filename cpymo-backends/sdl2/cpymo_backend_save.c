@@ -8,6 +8,10 @@
 #include <malloc.h>
 #endif
 
+#if defined(_WIN32) && !defined(__UWP__)
+#include <windows.h>
+#endif
+
 FILE *cpymo_backend_read_save(const char * gamedir, const char * name)
 {
 	char *path = (char *)alloca(strlen(gamedir) + strlen(name) + 8);
@@ -22,3 +26,31 @@ FILE *cpymo_backend_write_save(const char * gamedir, const char * name)
 	return fopen(path, "wb");
 }
 
+FILE *cpymo_backend_append_save(const char * gamedir, const char * name)
+{
+	char *path = (char *)alloca(strlen(gamedir) + strlen(name) + 8);
+	sprintf(path, "%s/save/%s", gamedir, name);
+	return fopen(path, "ab");
+}
+
+error_t cpymo_backend_move_save(const char *gamedir, const char *from_name, const char *to_name)
+{
+	char *from = (char *)alloca(strlen(gamedir) + strlen(from_name) + 8);
+	char *to = (char *)alloca(strlen(gamedir) + strlen(to_name) + 8);
+	sprintf(from, "%s/save/%s", gamedir, from_name);
+	sprintf(to, "%s/save/%s", gamedir, to_name);
+
+#if defined(_WIN32) && !defined(__UWP__)
+	if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return CPYMO_ERR_UNKNOWN;
+#else
+	#ifdef _WIN32
+	remove(to);
+	#endif
+
+	if (rename(from, to) != 0) return CPYMO_ERR_UNKNOWN;
+#endif
+
+	return CPYMO_ERR_SUCC;
+}
+
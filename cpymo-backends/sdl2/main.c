@@ -228,6 +228,11 @@ static void save_last_selected_game_dir(const char *gamedir)
 }
 #endif
 
+static double clock_sec(void)
+{
+	return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
 #ifdef USE_GAME_SELECTOR
 #include "../../cpymo/cpymo_game_selector.h"
 
@@ -529,6 +534,8 @@ START:
 		return -1;
 	}
 
+	engine.interpreter_budget.clock = &clock_sec;
+
 	SDL_SetHint(SDL_HINT_ORIENTATIONS, "LandscapeLeft LandscapeRight");
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
 	SDL_SetHint(SDL_HINT_VIDEO_ALLOW_SCREENSAVER, "0");
@@ -0,0 +1,131 @@
+﻿#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "../text/cpymo_backend_headless.c"
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Runs engine code against a generated game in a temporary directory,
+// prints every failed check and returns 1 if any check failed.
+
+cpymo_engine engine;
+
+static int failed = 0;
+
+#define CHECK(X) \
+	if (!(X)) { \
+		printf("[Fail] %s:%d: %s\n", __FILE__, __LINE__, #X); \
+		failed = 1; \
+	}
+
+static void write_file(const char *dir, const char *name, const char *content)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) return;
+	fputs(content, f);
+	fclose(f);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static bool create_game(char *dir, const char *start_script)
+{
+	if (mkdtemp(dir) == NULL) return false;
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/script", dir);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/save", dir);
+	mkdir(path, 0755);
+
+	write_file(dir, "gameconfig.txt",
+		"gametitle,Test\n"
+		"engineversion,1.2\n"
+		"scripttype,pymo\n"
+		"imagesize,800,600\n"
+		"startscript,start\n");
+	write_file(dir, "script/start.txt", start_script);
+	return true;
+}
+
+static void remove_game(const char *dir)
+{
+	nftw(dir, &remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+// Every call moves one millisecond forward.
+static double test_clock_now = 0;
+static double test_clock(void)
+{
+	test_clock_now += 0.001;
+	return test_clock_now;
+}
+
+static void test_interpreter_time_budget(void)
+{
+	char dir[] = "/tmp/cpymo-test-XXXXXX";
+	if (!create_game(dir,
+		"#label loop\n"
+		"#set a,1\n"
+		"#add a,1\n"
+		"#goto loop\n")) {
+		CHECK(!"create_game");
+		return;
+	}
+
+	error_t err = cpymo_engine_init(&engine, dir);
+	CHECK(err == CPYMO_ERR_SUCC);
+	if (err != CPYMO_ERR_SUCC) {
+		remove_game(dir);
+		return;
+	}
+
+	engine.interpreter_budget.instructions = 1000000;
+	engine.interpreter_budget.time_sec = 0.004;
+	engine.interpreter_budget.clock = &test_clock;
+
+	// Run the bootloader until the loop is reached.
+	for (int i = 0; i < 1000 && err == CPYMO_ERR_SUCC; ++i) {
+		if (strcmp(engine.interpreter->script->script_name, "start") == 0) break;
+		bool redraw = false;
+		err = cpymo_engine_update(&engine, 1.0f, &redraw);
+	}
+	CHECK(!cpymo_wait_is_wating(&engine.wait));
+	CHECK(err == CPYMO_ERR_SUCC);
+	CHECK(strcmp(engine.interpreter->script->script_name, "start") == 0);
+
+	// set, add and goto never wait, only the deadline ends the step.
+	memset(&engine.interpreter_stats, 0, sizeof(engine.interpreter_stats));
+	err = cpymo_interpreter_execute_step(engine.interpreter, &engine);
+	CHECK(err == CPYMO_ERR_SUCC);
+	CHECK(engine.interpreter_stats.max_instructions_per_step > 0);
+	CHECK(engine.interpreter_stats.max_instructions_per_step < 1000);
+
+	// Without a clock only the instruction budget ends the step.
+	engine.interpreter_budget.instructions = 5000;
+	engine.interpreter_budget.clock = NULL;
+	memset(&engine.interpreter_stats, 0, sizeof(engine.interpreter_stats));
+	err = cpymo_interpreter_execute_step(engine.interpreter, &engine);
+	CHECK(err == CPYMO_ERR_SUCC);
+	CHECK(engine.interpreter_stats.max_instructions_per_step == 5000);
+
+	cpymo_engine_free(&engine);
+	remove_game(dir);
+}
+
+#define STB_DS_IMPLEMENTATION
+#include "../../stb/stb_ds.h"
+
+int main(void)
+{
+	test_interpreter_time_budget();
+
+	if (failed == 0) puts("[Info] All tests passed.");
+	return failed;
+}
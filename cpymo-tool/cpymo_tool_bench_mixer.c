@@ -0,0 +1,191 @@
+﻿#include "cpymo_tool_prelude.h"
+#include "../cpymo/cpymo_error.h"
+#include "../cpymo/cpymo_audio_mix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+// Compares cpymo_audio_mix against the mixer it replaced,
+// which converted each sample to double and clamped after every channel.
+
+#define BENCH_SAMPLES (48000 * 2)
+#define BENCH_CHANNELS 3
+
+static const float bench_volumes[BENCH_CHANNELS] = { 1.0f, 0.8f, 0.5f };
+
+static void cpymo_tool_bench_mixer_old_mix(
+	void *dst_, const void *src_, size_t len,
+	cpymo_backend_audio_format fmt, float volume)
+{
+#define MIX_SIGNED(TYPE, TYPE_MAX_VAL) { \
+	TYPE *dst = (TYPE *)dst_; \
+	const TYPE *src = (TYPE *)src_; \
+	len /= sizeof(TYPE); \
+	\
+	for (size_t i = 0; i < len; ++i) { \
+		double src_sample = (float)src[i] / (float)TYPE_MAX_VAL; \
+		double dst_sample = (float)dst[i] / (float)TYPE_MAX_VAL; \
+		src_sample *= volume * 1.0f; \
+		dst_sample += src_sample; \
+		\
+		if (dst_sample > 1) dst_sample = 1; \
+		if (dst_sample < -1) dst_sample = -1; \
+		\
+		dst[i] = (TYPE)(dst_sample * TYPE_MAX_VAL); \
+	}\
+}
+
+	switch (fmt) {
+	case cpymo_backend_audio_s16: MIX_SIGNED(int16_t, INT16_MAX); break;
+	case cpymo_backend_audio_s32: MIX_SIGNED(int32_t, INT32_MAX); break;
+	case cpymo_backend_audio_f32: MIX_SIGNED(float, 1.0f); break;
+	}
+
+#undef MIX_SIGNED
+}
+
+static void cpymo_tool_bench_mixer_old(
+	void *dst, void **channels, size_t len, cpymo_backend_audio_format fmt)
+{
+	memset(dst, 0, len);
+	for (size_t c = 0; c < BENCH_CHANNELS; ++c)
+		cpymo_tool_bench_mixer_old_mix(dst, channels[c], len, fmt, bench_volumes[c]);
+}
+
+static void cpymo_tool_bench_mixer_new(
+	void *dst, void **channels, size_t len, cpymo_backend_audio_format fmt,
+	int32_t *gains)
+{
+	const size_t sample_size = cpymo_audio_mix_sample_size(fmt);
+	cpymo_audio_mix_acc acc;
+
+	for (size_t done = 0; done < len / sample_size; done += CPYMO_AUDIO_MIX_BLOCK) {
+		size_t block = len / sample_size - done;
+		if (block > CPYMO_AUDIO_MIX_BLOCK) block = CPYMO_AUDIO_MIX_BLOCK;
+
+		cpymo_audio_mix_clear(&acc, block);
+		for (size_t c = 0; c < BENCH_CHANNELS; ++c)
+			cpymo_audio_mix_add(
+				&acc, 0, (uint8_t *)channels[c] + done * sample_size, block, fmt,
+				gains + c, cpymo_audio_mix_gain(bench_volumes[c]));
+
+		cpymo_audio_mix_pack((uint8_t *)dst + done * sample_size, &acc, block, fmt);
+	}
+}
+
+static void cpymo_tool_bench_mixer_fill(void *buf, size_t samples, cpymo_backend_audio_format fmt)
+{
+	uint32_t seed = 0x12345678u;
+	for (size_t i = 0; i < samples; ++i) {
+		seed = seed * 1664525u + 1013904223u;
+		float v = (float)(int32_t)seed / 2147483648.0f * 0.6f;
+
+		switch (fmt) {
+		case cpymo_backend_audio_s16: ((int16_t *)buf)[i] = (int16_t)(v * INT16_MAX); break;
+		case cpymo_backend_audio_s32: ((int32_t *)buf)[i] = (int32_t)(v * 2147483520.0f); break;
+		case cpymo_backend_audio_f32: ((float *)buf)[i] = v; break;
+		}
+	}
+}
+
+static double cpymo_tool_bench_mixer_sample(const void *buf, size_t i, cpymo_backend_audio_format fmt)
+{
+	switch (fmt) {
+	case cpymo_backend_audio_s16: return ((const int16_t *)buf)[i] / (double)INT16_MAX;
+	case cpymo_backend_audio_s32: return ((const int32_t *)buf)[i] / (double)INT32_MAX;
+	case cpymo_backend_audio_f32: return ((const float *)buf)[i];
+	}
+	return 0;
+}
+
+static double cpymo_tool_bench_mixer_max_diff(
+	const void *a, const void *b, size_t samples, cpymo_backend_audio_format fmt)
+{
+	double max_diff = 0;
+	for (size_t i = 0; i < samples; ++i) {
+		double d = fabs(
+			cpymo_tool_bench_mixer_sample(a, i, fmt) - cpymo_tool_bench_mixer_sample(b, i, fmt));
+		if (d > max_diff) max_diff = d;
+	}
+	return max_diff;
+}
+
+int cpymo_tool_invoke_bench_mixer(int argc, const char **argv)
+{
+	extern int help(void);
+	extern int process_err(error_t);
+
+	cpymo_backend_audio_format fmt = cpymo_backend_audio_s16;
+	const char *fmt_name = "s16";
+	int iterations = 100;
+
+	for (int i = 2; i < argc; ++i) {
+		if (!strcmp(argv[i], "s16") || !strcmp(argv[i], "s32") || !strcmp(argv[i], "f32")) {
+			fmt_name = argv[i];
+			if (!strcmp(fmt_name, "s16")) fmt = cpymo_backend_audio_s16;
+			else if (!strcmp(fmt_name, "s32")) fmt = cpymo_backend_audio_s32;
+			else fmt = cpymo_backend_audio_f32;
+		}
+		else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			if (iterations <= 0) iterations = 1;
+		}
+		else {
+			printf("[Error] Unknown arg \'%s\'.\n", argv[i]);
+			help();
+			return -1;
+		}
+	}
+
+	const size_t len = BENCH_SAMPLES * cpymo_audio_mix_sample_size(fmt);
+
+	void *channels[BENCH_CHANNELS] = { NULL };
+	void *dst_old = malloc(len), *dst_new = malloc(len);
+	bool out_of_mem = dst_old == NULL || dst_new == NULL;
+	for (size_t c = 0; c < BENCH_CHANNELS; ++c) {
+		channels[c] = malloc(len);
+		if (channels[c] == NULL) out_of_mem = true;
+		else cpymo_tool_bench_mixer_fill(channels[c], BENCH_SAMPLES, fmt);
+	}
+
+	int ret = 0;
+	if (out_of_mem) {
+		ret = process_err(CPYMO_ERR_OUT_OF_MEM);
+		goto CLEAN;
+	}
+
+	printf("Mixing %d channels of %d %s samples, %d times.\n",
+		BENCH_CHANNELS, BENCH_SAMPLES, fmt_name, iterations);
+
+	clock_t begin = clock();
+	for (int i = 0; i < iterations; ++i)
+		cpymo_tool_bench_mixer_old(dst_old, channels, len, fmt);
+	double old_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+	int32_t gains[BENCH_CHANNELS] = { 0 };
+	begin = clock();
+	for (int i = 0; i < iterations; ++i)
+		cpymo_tool_bench_mixer_new(dst_new, channels, len, fmt, gains);
+	double new_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+	const double samples = (double)BENCH_SAMPLES * iterations;
+	if (old_time <= 0) old_time = 1.0 / CLOCKS_PER_SEC;
+	if (new_time <= 0) new_time = 1.0 / CLOCKS_PER_SEC;
+
+	printf("old: %.2f Msamples/s\n", samples / old_time / 1e6);
+	printf("new: %.2f Msamples/s\n", samples / new_time / 1e6);
+	printf("speed up: %.2fx\n", old_time / new_time);
+	printf("max difference: %g of full scale\n",
+		cpymo_tool_bench_mixer_max_diff(dst_old, dst_new, BENCH_SAMPLES, fmt));
+
+CLEAN:
+	for (size_t c = 0; c < BENCH_CHANNELS; ++c)
+		free(channels[c]);
+	free(dst_old);
+	free(dst_new);
+	return ret;
+}
@@ -0,0 +1,145 @@
+﻿#include "cpymo_tool_prelude.h"
+#include "cpymo_tool_package.h"
+#include "../cpymo/cpymo_error.h"
+#include "../cpymo/cpymo_package.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Compares cpymo_package_find against the linear scan it replaced,
+// on a package with a large index.
+
+#define BENCH_NAME_FORMAT "asset%06u"
+#define BENCH_LOOKUP_FORMAT "ASSET%06u"
+
+static error_t cpymo_tool_bench_package_find_linear(
+	cpymo_package_index *out_index, const cpymo_package *package, cpymo_str filename)
+{
+	for (uint32_t i = 0; i < package->file_count; ++i) {
+		if (cpymo_str_equals_str_ignore_case(filename, package->files[i].file_name)) {
+			*out_index = package->files[i];
+			return CPYMO_ERR_SUCC;
+		}
+	}
+
+	return CPYMO_ERR_NOT_FOUND;
+}
+
+static error_t cpymo_tool_bench_package_create(const char *path, uint32_t entries)
+{
+	cpymo_tool_package_packer packer;
+	error_t err = cpymo_tool_package_packer_open(&packer, path, entries);
+	CPYMO_THROW(err);
+
+	char name[32];
+	char data = 0;
+	for (uint32_t i = 0; i < entries; ++i) {
+		snprintf(name, sizeof(name), BENCH_NAME_FORMAT, i);
+		err = cpymo_tool_package_packer_add_data(&packer, cpymo_str_pure(name), &data, 1);
+		if (err != CPYMO_ERR_SUCC) break;
+	}
+
+	cpymo_tool_package_packer_close(&packer);
+	return err;
+}
+
+// Every 4th lookup misses.
+static uint32_t cpymo_tool_bench_package_key(uint32_t *seed, uint32_t entries)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	uint32_t key = (*seed >> 8) % entries;
+	return (*seed & 3) == 0 ? key + entries : key;
+}
+
+int cpymo_tool_invoke_bench_package(int argc, const char **argv)
+{
+	extern int help(void);
+	extern int process_err(error_t);
+
+	const char *path = "cpymo-tool-bench-package.pak";
+	uint32_t entries = 50000;
+	int lookups = 10000;
+
+	for (int i = 2; i < argc; ++i) {
+		if (!strcmp(argv[i], "--entries") && i + 1 < argc) {
+			int n = atoi(argv[++i]);
+			entries = n <= 0 ? 1 : (uint32_t)n;
+		}
+		else if (!strcmp(argv[i], "--lookups") && i + 1 < argc) {
+			lookups = atoi(argv[++i]);
+			if (lookups <= 0) lookups = 1;
+		}
+		else if (!strcmp(argv[i], "--pak") && i + 1 < argc) {
+			path = argv[++i];
+		}
+		else {
+			printf("[Error] Unknown arg \'%s\'.\n", argv[i]);
+			help();
+			return -1;
+		}
+	}
+
+	error_t err = cpymo_tool_bench_package_create(path, entries);
+	if (err != CPYMO_ERR_SUCC) {
+		remove(path);
+		return process_err(err);
+	}
+
+	cpymo_package pkg;
+	clock_t begin = clock();
+	err = cpymo_package_open(&pkg, path);
+	double open_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+	if (err != CPYMO_ERR_SUCC) {
+		remove(path);
+		return process_err(err);
+	}
+
+	printf("Looking up %d names in a package of %u files.\n", lookups, (unsigned)entries);
+
+	char name[32];
+	cpymo_package_index index;
+
+	uint32_t seed = 0x12345678u;
+	size_t linear_found = 0;
+	begin = clock();
+	for (int i = 0; i < lookups; ++i) {
+		snprintf(name, sizeof(name), BENCH_LOOKUP_FORMAT,
+			cpymo_tool_bench_package_key(&seed, entries));
+		if (cpymo_tool_bench_package_find_linear(&index, &pkg, cpymo_str_pure(name)) 
+			== CPYMO_ERR_SUCC)
+			linear_found++;
+	}
+	double linear_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+	seed = 0x12345678u;
+	size_t hashed_found = 0, mismatches = 0;
+	begin = clock();
+	for (int i = 0; i < lookups; ++i) {
+		snprintf(name, sizeof(name), BENCH_LOOKUP_FORMAT,
+			cpymo_tool_bench_package_key(&seed, entries));
+		if (cpymo_package_find(&index, &pkg, cpymo_str_pure(name)) == CPYMO_ERR_SUCC) {
+			hashed_found++;
+			if (!cpymo_str_equals_str_ignore_case(cpymo_str_pure(name), index.file_name))
+				mismatches++;
+		}
+	}
+	double hashed_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+	cpymo_package_close(&pkg);
+	remove(path);
+
+	if (linear_time <= 0) linear_time = 1.0 / CLOCKS_PER_SEC;
+	if (hashed_time <= 0) hashed_time = 1.0 / CLOCKS_PER_SEC;
+
+	printf("open with index: %.2f ms\n", open_time * 1e3);
+	printf("linear scan: %.2f us/lookup\n", linear_time / lookups * 1e6);
+	printf("hashed: %.3f us/lookup\n", hashed_time / lookups * 1e6);
+	printf("speed up: %.2fx\n", linear_time / hashed_time);
+	printf("found: %u linear, %u hashed, %u mismatched\n", 
+		(unsigned)linear_found, (unsigned)hashed_found, (unsigned)mismatches);
+
+	return linear_found == hashed_found && mismatches == 0 ? 0 : -1;
+}
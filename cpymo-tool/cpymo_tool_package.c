@@ -7,6 +7,9 @@
 #include "../cpymo/cpymo_package.h"
 #include "../cpymo/cpymo_utils.h"
 #include "../endianness.h/endianness.h"
+#include "../stb/stb_ds.h"
+
+#define CPYMO_TOOL_PACKAGE_V2_ALIGNMENT 4096
 
 static error_t cpymo_tool_unpack(const char *pak_path, const char *extension, const char *out_path) {
 	cpymo_package pkg;
@@ -20,7 +23,11 @@ static error_t cpymo_tool_unpack(const char *pak_path, const char *extension, co
 			max_length = pkg.files[i].file_length;
 
 	char *buf = malloc(max_length);
-	if (buf == NULL) {
+	char *out_file_path = malloc(
+		strlen(out_path) + 1 + CPYMO_PACKAGE_V2_MAX_NAME_LENGTH + strlen(extension) + 1);
+	if (buf == NULL || out_file_path == NULL) {
+		free(buf);
+		free(out_file_path);
 		cpymo_package_close(&pkg);
 		return CPYMO_ERR_OUT_OF_MEM;
 	}
@@ -28,18 +35,14 @@ static error_t cpymo_tool_unpack(const char *pak_path, const char *extension, co
 	for (uint32_t i = 0; i < pkg.file_count; ++i) {
 		const cpymo_package_index *file_index = &pkg.files[i];
 
-		char filename[32] = { '\0' };
-		for (size_t i = 0; i < 32; ++i) {
+		char filename[CPYMO_PACKAGE_V2_MAX_NAME_LENGTH + 1] = { '\0' };
+		for (size_t i = 0; i < sizeof(filename) - 1; ++i) {
 			const char c = file_index->file_name[i];
-			if (c == '\0') {
-				filename[i] = '\0';
-				break;
-			}
-
+			if (c == '\0') break;
 			filename[i] = tolower(c);
 		}
 
-		char out_file_path[256] = { '\0' };
+		out_file_path[0] = '\0';
 		strcat(out_file_path, out_path);
 		strcat(out_file_path, "/");
 		strcat(out_file_path, filename);
@@ -68,6 +71,7 @@ static error_t cpymo_tool_unpack(const char *pak_path, const char *extension, co
 	}
 
 	free(buf);
+	free(out_file_path);
 	cpymo_package_close(&pkg);
 
 	return CPYMO_ERR_SUCC;
@@ -78,9 +82,12 @@ error_t cpymo_tool_package_packer_open(
     const char *path,
     size_t max_files_count)
 {
+	packer->version = 1;
+	packer->v2_index = NULL;
+	packer->v2_names = NULL;
 	packer->current_file_count = 0;
 	packer->data_section_start_offset =
-		(long)(sizeof(uint32_t) + max_files_count * sizeof(cpymo_package_index));
+		sizeof(uint32_t) + (uint64_t)max_files_count * CPYMO_PACKAGE_V1_INDEX_SIZE;
 	packer->index_section_start_offset = sizeof(uint32_t);
 	packer->max_file_count = max_files_count;
 
@@ -88,7 +95,7 @@ error_t cpymo_tool_package_packer_open(
 	if (packer->stream == NULL)
 		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 
-	for (long i = 0; i < packer->data_section_start_offset; ++i) {
+	for (uint64_t i = 0; i < packer->data_section_start_offset; ++i) {
 		if (fputc(0, packer->stream) == EOF) {
 			fclose(packer->stream);
 			return CPYMO_ERR_BAD_FILE_FORMAT;
@@ -98,16 +105,209 @@ error_t cpymo_tool_package_packer_open(
 	return CPYMO_ERR_SUCC;
 }
 
+error_t cpymo_tool_package_packer_open_v2(
+    cpymo_tool_package_packer *packer,
+    const char *path)
+{
+	packer->version = 2;
+	packer->v2_index = NULL;
+	packer->v2_names = NULL;
+	packer->current_file_count = 0;
+	packer->max_file_count = UINT32_MAX;
+	packer->index_section_start_offset = 0;
+	packer->data_section_start_offset = CPYMO_PACKAGE_V2_HEADER_SIZE;
+
+	packer->stream = fopen(path, "wb");
+	if (packer->stream == NULL)
+		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	// Header is written when closing.
+	for (uint64_t i = 0; i < packer->data_section_start_offset; ++i) {
+		if (fputc(0, packer->stream) == EOF) {
+			fclose(packer->stream);
+			return CPYMO_ERR_BAD_FILE_FORMAT;
+		}
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+static void cpymo_tool_package_put_le16(uint8_t *p, uint16_t x)
+{
+	x = end_htole16(x);
+	memcpy(p, &x, sizeof(x));
+}
+
+static void cpymo_tool_package_put_le32(uint8_t *p, uint32_t x)
+{
+	x = end_htole32(x);
+	memcpy(p, &x, sizeof(x));
+}
+
+static void cpymo_tool_package_put_le64(uint8_t *p, uint64_t x)
+{
+	x = end_htole64(x);
+	memcpy(p, &x, sizeof(x));
+}
+
+static uint8_t *cpymo_tool_package_lz4_put_length(uint8_t *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+// Greedy LZ4 block compressor, dst must hold lz4_bound(len) bytes.
+#define CPYMO_TOOL_PACKAGE_LZ4_BOUND(LEN) ((LEN) + (LEN) / 255 + 16)
+static size_t cpymo_tool_package_lz4_compress(
+	const uint8_t *src, size_t len, uint8_t *dst)
+{
+	enum { HASH_BITS = 14 };
+	static int64_t table[1 << HASH_BITS];
+	for (size_t i = 0; i < (1 << HASH_BITS); ++i) table[i] = -1;
+
+	uint8_t *op = dst;
+	size_t anchor = 0, i = 0;
+
+	// The last match must start 12 bytes before the end,
+	// and the last 5 bytes are always literals.
+	const size_t match_start_limit = len > 12 ? len - 12 : 0;
+	const size_t match_end_limit = len > 5 ? len - 5 : 0;
+
+	while (i < match_start_limit) {
+		uint32_t seq;
+		memcpy(&seq, src + i, sizeof(seq));
+		const uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+		const int64_t ref = table[h];
+		table[h] = (int64_t)i;
+
+		uint32_t ref_seq;
+		if (ref < 0 || i - (size_t)ref > 65535 ||
+			(memcpy(&ref_seq, src + ref, sizeof(ref_seq)), ref_seq != seq)) {
+			i++;
+			continue;
+		}
+
+		size_t match = 4;
+		while (i + match < match_end_limit && src[ref + match] == src[i + match])
+			match++;
+
+		const size_t literals = i - anchor;
+		uint8_t *token = op++;
+		*token = (uint8_t)((literals >= 15 ? 15 : literals) << 4);
+		if (literals >= 15) op = cpymo_tool_package_lz4_put_length(op, literals - 15);
+		memcpy(op, src + anchor, literals);
+		op += literals;
+
+		const size_t offset = i - (size_t)ref;
+		*op++ = (uint8_t)(offset & 0xFF);
+		*op++ = (uint8_t)(offset >> 8);
+
+		*token |= (uint8_t)(match - 4 >= 15 ? 15 : match - 4);
+		if (match - 4 >= 15) op = cpymo_tool_package_lz4_put_length(op, match - 4 - 15);
+
+		i += match;
+		anchor = i;
+	}
+
+	const size_t literals = len - anchor;
+	*op++ = (uint8_t)((literals >= 15 ? 15 : literals) << 4);
+	if (literals >= 15) op = cpymo_tool_package_lz4_put_length(op, literals - 15);
+	memcpy(op, src + anchor, literals);
+	op += literals;
+
+	return (size_t)(op - dst);
+}
+
+static error_t cpymo_tool_package_packer_add_data_v2(
+    cpymo_tool_package_packer *packer,
+    cpymo_str name,
+    void *data,
+    size_t len,
+    bool compress)
+{
+	if (packer->current_file_count >= packer->max_file_count)
+		return CPYMO_ERR_NO_MORE_CONTENT;
+	if (len > UINT32_MAX || name.len > CPYMO_PACKAGE_V2_MAX_NAME_LENGTH)
+		return CPYMO_ERR_INVALID_ARG;
+
+	const int64_t tell = cpymo_utils_ftell64(packer->stream);
+	if (tell < 0) return CPYMO_ERR_UNKNOWN;
+
+	uint64_t offset = (uint64_t)tell;
+	while (offset % CPYMO_TOOL_PACKAGE_V2_ALIGNMENT) {
+		if (fputc(0, packer->stream) == EOF) return CPYMO_ERR_UNKNOWN;
+		offset++;
+	}
+
+	uint8_t compression = CPYMO_PACKAGE_COMPRESSION_NONE;
+	const void *stored = data;
+	size_t stored_len = len;
+	uint8_t *compressed = NULL;
+
+	if (compress && len) {
+		compressed = (uint8_t *)malloc(CPYMO_TOOL_PACKAGE_LZ4_BOUND(len));
+		if (compressed == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+		size_t compressed_len =
+			cpymo_tool_package_lz4_compress((const uint8_t *)data, len, compressed);
+
+		// Not worth decompressing if it saves less than 1/16.
+		if (compressed_len < len - len / 16) {
+			compression = CPYMO_PACKAGE_COMPRESSION_LZ4;
+			stored = compressed;
+			stored_len = compressed_len;
+		}
+	}
+
+	size_t written = stored_len ? fwrite(stored, stored_len, 1, packer->stream) : 1;
+	free(compressed);
+	if (written != 1) return CPYMO_ERR_UNKNOWN;
+
+	const size_t name_offset = arrlenu(packer->v2_names);
+	if (name_offset + name.len + 1 > UINT32_MAX) return CPYMO_ERR_OUT_OF_MEM;
+	arrsetlen(packer->v2_names, name_offset + name.len + 1);
+	memcpy(packer->v2_names + name_offset, name.begin, name.len);
+	packer->v2_names[name_offset + name.len] = '\0';
+
+	uint8_t record[CPYMO_PACKAGE_V2_INDEX_SIZE] = { 0 };
+	cpymo_tool_package_put_le64(record, offset);
+	cpymo_tool_package_put_le32(record + 8, (uint32_t)stored_len);
+	cpymo_tool_package_put_le32(record + 12, (uint32_t)len);
+	cpymo_tool_package_put_le32(record + 16, cpymo_package_crc32(0, data, len));
+	cpymo_tool_package_put_le32(record + 20, (uint32_t)name_offset);
+	cpymo_tool_package_put_le16(record + 24, (uint16_t)name.len);
+	record[26] = compression;
+
+	const size_t index_size = arrlenu(packer->v2_index);
+	arrsetlen(packer->v2_index, index_size + sizeof(record));
+	memcpy(packer->v2_index + index_size, record, sizeof(record));
+
+	packer->current_file_count++;
+	return CPYMO_ERR_SUCC;
+}
+
 error_t cpymo_tool_package_packer_add_data(
     cpymo_tool_package_packer *packer,
     cpymo_str name,
     void *data,
     size_t len)
 {
+	if (packer->version == 2)
+		return cpymo_tool_package_packer_add_data_v2(packer, name, data, len, false);
+
 	if (packer->current_file_count >= packer->max_file_count)
 		return CPYMO_ERR_NO_MORE_CONTENT;
 
-	if (fseek(packer->stream, packer->index_section_start_offset, SEEK_SET))
+	// Version 1 offsets are 32 bit.
+	if (packer->data_section_start_offset + len > UINT32_MAX)
+		return CPYMO_ERR_UNSUPPORTED;
+
+	if (cpymo_utils_fseek64(packer->stream, (int64_t)packer->index_section_start_offset, SEEK_SET))
 		return CPYMO_ERR_UNKNOWN;
 
 	char filename[32] = { '\0' };
@@ -116,24 +316,25 @@ error_t cpymo_tool_package_packer_add_data(
 	if (written != 1) return CPYMO_ERR_UNKNOWN;
 
 	uint32_t index[2] = {
-		end_htole32(packer->data_section_start_offset),
+		end_htole32((uint32_t)packer->data_section_start_offset),
 		end_htole32((uint32_t)len)
 	};
 
 	written = fwrite(index, sizeof(index), 1, packer->stream);
 	if (written != 1) return CPYMO_ERR_UNKNOWN;
-	long new_index_offset = ftell(packer->stream);
+	int64_t new_index_offset = cpymo_utils_ftell64(packer->stream);
 
-	if (fseek(packer->stream, packer->data_section_start_offset, SEEK_SET))
+	if (cpymo_utils_fseek64(packer->stream, (int64_t)packer->data_section_start_offset, SEEK_SET))
 		return CPYMO_ERR_UNKNOWN;
 
 	written = fwrite(data, len, 1, packer->stream);
 	if (written != 1) return CPYMO_ERR_UNKNOWN;
-	long new_data_offset = ftell(packer->stream);
+	int64_t new_data_offset = cpymo_utils_ftell64(packer->stream);
+	if (new_index_offset < 0 || new_data_offset < 0) return CPYMO_ERR_UNKNOWN;
 
 	packer->current_file_count++;
-	packer->data_section_start_offset = new_data_offset;
-	packer->index_section_start_offset = new_index_offset;
+	packer->data_section_start_offset = (uint64_t)new_data_offset;
+	packer->index_section_start_offset = (uint64_t)new_index_offset;
 	return CPYMO_ERR_SUCC;
 }
 
@@ -148,11 +349,11 @@ error_t cpymo_tool_package_packer_add_file(
 	if (file > filename) filename = file;
 	const char *ext_start = strrchr(filename, '.');
 
-	char filename_index[32] = { '\0' };
+	char filename_index[CPYMO_PACKAGE_V2_MAX_NAME_LENGTH + 1] = { '\0' };
+	const size_t max_name_len = packer->version == 2 ? sizeof(filename_index) - 1 : 31;
 
-	size_t j = 0;
 	bool finished = false;
-	for (size_t j = 0; j < 31; ++j) {
+	for (size_t j = 0; j < max_name_len; ++j) {
 		if (filename + j == ext_start || filename[j] == '\0') {
 			finished = true;
 			break;
@@ -169,15 +370,61 @@ error_t cpymo_tool_package_packer_add_file(
 	error_t err = cpymo_utils_loadfile(file, &data, &len);
 	CPYMO_THROW(err);
 
-	err = cpymo_tool_package_packer_add_data(
-		packer, cpymo_str_pure(filename_index), data, len);
+	// Scripts and raw images compress well and are always read as a whole.
+	if (packer->version == 2) {
+		bool compress = ext_start &&
+			(cpymo_str_equals_str_ignore_case(cpymo_str_pure(ext_start), ".txt") ||
+			cpymo_str_equals_str_ignore_case(cpymo_str_pure(ext_start), ".bmp"));
+
+		err = cpymo_tool_package_packer_add_data_v2(
+			packer, cpymo_str_pure(filename_index), data, len, compress);
+	}
+	else {
+		err = cpymo_tool_package_packer_add_data(
+			packer, cpymo_str_pure(filename_index), data, len);
+	}
+
 	free(data);
 	return err;
 }
 
+static void cpymo_tool_package_packer_close_v2(
+    cpymo_tool_package_packer *packer)
+{
+	const int64_t tell = cpymo_utils_ftell64(packer->stream);
+	if (tell < 0) abort();
+	const uint64_t index_offset = (uint64_t)tell;
+
+	const size_t index_size = arrlenu(packer->v2_index);
+	const size_t names_size = arrlenu(packer->v2_names);
+	if (index_size && fwrite(packer->v2_index, index_size, 1, packer->stream) != 1)
+		abort();
+	if (names_size && fwrite(packer->v2_names, names_size, 1, packer->stream) != 1)
+		abort();
+
+	uint8_t header[CPYMO_PACKAGE_V2_HEADER_SIZE];
+	memcpy(header, CPYMO_PACKAGE_V2_MAGIC, 4);
+	cpymo_tool_package_put_le32(header + 4, (uint32_t)packer->current_file_count);
+	cpymo_tool_package_put_le64(header + 8, index_offset);
+	cpymo_tool_package_put_le32(header + 16, CPYMO_TOOL_PACKAGE_V2_ALIGNMENT);
+	cpymo_tool_package_put_le32(header + 20, (uint32_t)names_size);
+
+	if (fseek(packer->stream, 0, SEEK_SET)) abort();
+	if (fwrite(header, sizeof(header), 1, packer->stream) != 1) abort();
+	if (fclose(packer->stream)) abort();
+
+	arrfree(packer->v2_index);
+	arrfree(packer->v2_names);
+}
+
 void cpymo_tool_package_packer_close(
     cpymo_tool_package_packer *packer)
 {
+	if (packer->version == 2) {
+		cpymo_tool_package_packer_close_v2(packer);
+		return;
+	}
+
 	uint32_t filecount_le32 = end_htole32((uint32_t)packer->current_file_count);
 	if (fseek(packer->stream, 0, SEEK_SET)) abort();
 	if (fwrite(&filecount_le32, sizeof(filecount_le32), 1, packer->stream) != 1)
@@ -185,10 +432,12 @@ void cpymo_tool_package_packer_close(
 	if (fclose(packer->stream)) abort();
 }
 
-static error_t cpymo_tool_pack(const char *out_pack_path, const char **files_to_pack, uint32_t file_count)
+static error_t cpymo_tool_pack(const char *out_pack_path, const char **files_to_pack, uint32_t file_count, int version)
 {
 	cpymo_tool_package_packer p;
-	error_t err = cpymo_tool_package_packer_open(&p, out_pack_path, file_count);
+	error_t err = version == 2 ?
+		cpymo_tool_package_packer_open_v2(&p, out_pack_path) :
+		cpymo_tool_package_packer_open(&p, out_pack_path, file_count);
 	CPYMO_THROW(err);
 
 	for (uint32_t i = 0; i < file_count; ++i) {
@@ -252,13 +501,20 @@ extern int process_err(error_t);
 
 int cpymo_tool_invoke_pack(int argc, const char ** argv)
 {
+	int version = 1;
+	if (argc >= 3 && strcmp(argv[2], "--v2") == 0) {
+		version = 2;
+		argv++;
+		argc--;
+	}
+
 	if (argc == 5) {
 		if (strcmp(argv[3], "--file-list") == 0) {
 			char **files = NULL;
 			size_t filecount;
 			error_t err = cpymo_tool_get_file_list(&files, &filecount, argv[4]);
 			if (err == CPYMO_ERR_SUCC) {
-				err = cpymo_tool_pack(argv[2], (const char **)files, (uint32_t)filecount);
+				err = cpymo_tool_pack(argv[2], (const char **)files, (uint32_t)filecount, version);
 
 				for (size_t i = 0; i < filecount; ++i)
 					if (files[i]) free(files[i]);
@@ -274,7 +530,7 @@ int cpymo_tool_invoke_pack(int argc, const char ** argv)
 	NORMAL_PACK: {
 		const char *out_pak = argv[2];
 		const char **files_to_pack = argv + 3;
-		return process_err(cpymo_tool_pack(out_pak, files_to_pack, (uint32_t)argc - 3));
+		return process_err(cpymo_tool_pack(out_pak, files_to_pack, (uint32_t)argc - 3, version));
 		}
 	}
 	else return help();
@@ -2,12 +2,18 @@
 #define INCLUDE_CPYMO_TOOL_PACKAGE
 
 #include <stdio.h>
+#include <stdint.h>
 #include "../cpymo/cpymo_str.h"
 
 typedef struct {
+    int version;
     size_t max_file_count, current_file_count;
-    long index_section_start_offset, data_section_start_offset;
+    uint64_t index_section_start_offset, data_section_start_offset;
     FILE *stream;
+
+    // Version 2 only, index and name pool are written when closing.
+    uint8_t *v2_index;
+    char *v2_names;
 } cpymo_tool_package_packer;
 
 error_t cpymo_tool_package_packer_open(
@@ -15,6 +21,10 @@ error_t cpymo_tool_package_packer_open(
     const char *path,
     size_t max_files_count);
 
+error_t cpymo_tool_package_packer_open_v2(
+    cpymo_tool_package_packer *packer,
+    const char *path);
+
 error_t cpymo_tool_package_packer_add_data(
     cpymo_tool_package_packer *packer,
     cpymo_str name,
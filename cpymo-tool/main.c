@@ -10,6 +10,9 @@
 #include "../cpymo/cpymo_assetloader.c"
 #include "../cpymo/cpymo_album.c"
 #include "../cpymo/cpymo_str.c"
+#include "../cpymo/cpymo_vfs.c"
+#include "../cpymo/cpymo_image_cache.c"
+#include "../cpymo/cpymo_audio_mix.c"
 
 #include <stdio.h>
 #include <math.h>
@@ -44,6 +47,8 @@ extern int cpymo_tool_invoke_pack(int argc, const char **argv);
 extern int cpymo_tool_invoke_unpack(int argc, const char **argv);
 extern int cpymo_tool_invoke_resize_image(int argc, const char **argv);
 extern int cpymo_tool_invoke_pack_spritesheet(int argc, const char **argv);
+extern int cpymo_tool_invoke_bench_mixer(int argc, const char **argv);
+extern int cpymo_tool_invoke_bench_package(int argc, const char **argv);
 
 int help(void) {
 	printf("cpymo-tool\n");
@@ -52,8 +57,9 @@ int help(void) {
 	printf("Unpack a PyMO package:\n");
 	printf("    cpymo-tool unpack <pak-file> <extension-with \".\"> <output-dir>\n");
 	printf("Pack a PyMO package:\n");
-	printf("    cpymo-tool pack <out-pak-file> <files-to-pack...>\n");
-	printf("    cpymo-tool pack <out-pak-file> --file-list <file-list.txt>\n");
+	printf("    cpymo-tool pack [--v2] <out-pak-file> <files-to-pack...>\n");
+	printf("    cpymo-tool pack [--v2] <out-pak-file> --file-list <file-list.txt>\n");
+	printf("    (--v2 writes a CPyMO v2 package, which PyMO can not read.)\n");
 	printf("Resize image:\n");
 	printf(
 		"    cpymo-tool resize-image \n"
@@ -71,6 +77,10 @@ int help(void) {
 	printf("    cpymo-tool strip <gamedir> <output-gamedir> [--pack]\n");
 	printf("Convert pymo game:\n");
 	printf("    cpymo-tool convert <s60v3/s60v5/pymo/3ds/psp/wii> <gamedir> <output-gamedir> [--pack]\n");
+	printf("Benchmark the audio mixer:\n");
+	printf("    cpymo-tool bench-mixer [s16/s32/f32] [--iterations <n>]\n");
+	printf("Benchmark package file lookup:\n");
+	printf("    cpymo-tool bench-package [--entries <n>] [--lookups <n>] [--pak <temp-pak-file>]\n");
 	printf("\n");
 	return 0;
 }
@@ -106,6 +116,10 @@ int main(int argc, const char **argv) {
 			ret = cpymo_tool_invoke_strip(argc, argv);
 		else if (strcmp(argv[1], "convert") == 0)
 			ret = cpymo_tool_invoke_convert(argc, argv);
+		else if (strcmp(argv[1], "bench-mixer") == 0)
+			ret = cpymo_tool_invoke_bench_mixer(argc, argv);
+		else if (strcmp(argv[1], "bench-package") == 0)
+			ret = cpymo_tool_invoke_bench_package(argc, argv);
 		else ret = help();
 	}
 
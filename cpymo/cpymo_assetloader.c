@@ -1,6 +1,8 @@
 ﻿#include "cpymo_prelude.h"
 #include "cpymo_assetloader.h"
 #include "cpymo_utils.h"
+#include "cpymo_async_loader.h"
+#include "cpymo_image_cache.h"
 #include <stdlib.h>
 #include <string.h>
 #include <memory.h>
@@ -16,10 +18,14 @@ error_t cpymo_assetloader_init(cpymo_assetloader * out, const cpymo_gameconfig *
 	out->gamedir = chbuf;
 
 	out->game_config = config;
+	out->async_loader = NULL;
+	out->image_cache = NULL;
+	out->script_cache = NULL;
 
 	if (chbuf == NULL) return CPYMO_ERR_OUT_OF_MEM;
 
 	strcpy(chbuf, gamedir);
+	cpymo_vfs_init(&out->vfs, NULL);
 
 	out->use_pkg_bg = false;
 	out->use_pkg_chara = false;
@@ -74,6 +80,32 @@ error_t cpymo_assetloader_init(cpymo_assetloader * out, const cpymo_gameconfig *
 		return CPYMO_ERR_OUT_OF_MEM;
 	}
 	out->gamedir = shrunk_gamedir;
+	out->vfs.gamedir = shrunk_gamedir;
+
+	static const char *asset_types[] = 
+		{ "bg", "chara", "se", "voice", "bgm", "system", "script", "video" };
+
+	// patches first, so they override the game packages and directories.
+	for (size_t i = 0; i < CPYMO_ARR_COUNT(asset_types); ++i) {
+		err = cpymo_vfs_mount_patch(&out->vfs, asset_types[i]);
+		if (err != CPYMO_ERR_SUCC) {
+			cpymo_assetloader_free(out);
+			return err;
+		}
+	}
+
+	if (out->use_pkg_bg) cpymo_vfs_mount_package(&out->vfs, "bg", &out->pkg_bg);
+	if (out->use_pkg_chara) cpymo_vfs_mount_package(&out->vfs, "chara", &out->pkg_chara);
+	if (out->use_pkg_se) cpymo_vfs_mount_package(&out->vfs, "se", &out->pkg_se);
+	if (out->use_pkg_voice) cpymo_vfs_mount_package(&out->vfs, "voice", &out->pkg_voice);
+
+	for (size_t i = 0; i < CPYMO_ARR_COUNT(asset_types); ++i) {
+		err = cpymo_vfs_mount_directory(&out->vfs, asset_types[i]);
+		if (err != CPYMO_ERR_SUCC && err != CPYMO_ERR_UNSUPPORTED) {
+			cpymo_assetloader_free(out);
+			return err;
+		}
+	}
 	
 	return CPYMO_ERR_SUCC;
 }
@@ -85,6 +117,7 @@ void cpymo_assetloader_free(cpymo_assetloader * loader)
 		if (loader->use_pkg_chara) cpymo_package_close(&loader->pkg_chara);
 		if (loader->use_pkg_se) cpymo_package_close(&loader->pkg_se);
 		if (loader->use_pkg_voice) cpymo_package_close(&loader->pkg_voice);
+		cpymo_vfs_free(&loader->vfs);
 		if (loader->gamedir) free((void *)loader->gamedir);
 	}
 }
@@ -119,7 +152,47 @@ error_t cpymo_assetloader_get_fs_path(
 	return CPYMO_ERR_SUCC;
 }
 
-static error_t cpymo_assetloader_load_filesystem_file(
+static error_t cpymo_assetloader_get_vfs_path(
+	char **out_str,
+	cpymo_str asset_name,
+	const char *asset_type,
+	const char *asset_ext,
+	const cpymo_assetloader *l)
+{
+	assert(*out_str == NULL);
+	cpymo_vfs_file f;
+	error_t err = cpymo_vfs_find(&f, &l->vfs, asset_type, asset_name, asset_ext);
+	if (err != CPYMO_ERR_SUCC || f.package)
+		return cpymo_assetloader_get_fs_path(out_str, asset_name, asset_type, asset_ext, l);
+
+	*out_str = cpymo_str_copy_malloc(cpymo_str_pure(f.path));
+	if (*out_str == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_assetloader_load_vfs_file(
+	char **out_buffer, size_t *buf_size, const cpymo_vfs_file *f)
+{
+	if (f->package == NULL)
+		return cpymo_utils_loadfile(f->path, out_buffer, buf_size);
+
+	// malloc(0) may return NULL, which is not out of memory.
+	char *buf = (char *)malloc(f->index.file_length == 0 ? 1 : f->index.file_length);
+	if (buf == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	error_t err = cpymo_package_read_file_from_index(buf, f->package, &f->index);
+	if (err != CPYMO_ERR_SUCC) {
+		free(buf);
+		return err;
+	}
+
+	*out_buffer = buf;
+	*buf_size = f->index.file_length;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_assetloader_load_file(
 	char **out_buffer,
 	size_t *buf_size,
 	const char *asset_type,
@@ -127,20 +200,12 @@ static error_t cpymo_assetloader_load_filesystem_file(
 	const char *asset_ext_name,
 	const cpymo_assetloader *assetloader) 
 {
-	char *path = NULL;
-	error_t err = cpymo_assetloader_get_fs_path(
-		&path, 
-		asset_name, 
-		asset_type, 
-		asset_ext_name, 
-		assetloader);
+	cpymo_vfs_file f;
+	error_t err = cpymo_vfs_find(
+		&f, &assetloader->vfs, asset_type, asset_name, asset_ext_name);
 	CPYMO_THROW(err);
 
-	err = cpymo_utils_loadfile(path, out_buffer, buf_size);
-
-	free(path);
-
-	return err;
+	return cpymo_assetloader_load_vfs_file(out_buffer, buf_size, &f);
 }
 
 #ifndef DISABLE_STB_IMAGE
@@ -167,6 +232,18 @@ static error_t cpymo_assetloader_load_filesystem_image_pixels(
 }
 
 
+error_t cpymo_assetloader_load_vfs_image_pixels(
+	void **pixels, int *w, int *h, int c, const cpymo_vfs_file *f)
+{
+	if (f->package) 
+		return cpymo_package_read_image_from_index(pixels, w, h, c, f->package, &f->index);
+
+	*pixels = stbi_load(f->path, w, h, NULL, c);
+	if (*pixels == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+	
+	return CPYMO_ERR_SUCC;
+}
+
 static error_t cpymo_assetloader_load_image_pixels(
 	void **pixels,
 	int *w,
@@ -175,21 +252,46 @@ static error_t cpymo_assetloader_load_image_pixels(
 	const char *asset_type,
 	cpymo_str asset_name,
 	const char *asset_ext_name,
-	bool using_pkg,
-	const cpymo_package *pkg,
 	const cpymo_assetloader *l)
 {
-	if (using_pkg) 
-		return cpymo_package_read_image(pixels, w, h, c, pkg, asset_name);
-	else return cpymo_assetloader_load_filesystem_image_pixels(
-		pixels,
-		w,
-		h,
-		c,
-		asset_type,
-		asset_name,
-		asset_ext_name,
-		l);
+	const void *cached = l->image_cache ? 
+		cpymo_image_cache_get(l->image_cache, asset_type, asset_name, c, w, h) : NULL;
+	if (cached) {
+		const size_t size = (size_t)*w * (size_t)*h * (size_t)c;
+		*pixels = malloc(size);
+		if (*pixels == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+		memcpy(*pixels, cached, size);
+		return CPYMO_ERR_SUCC;
+	}
+
+	error_t err;
+	if (l->async_loader && cpymo_async_loader_take(
+		l->async_loader, asset_type, asset_name, c, pixels, w, h, &err)) {
+		CPYMO_THROW(err);
+	}
+	else {
+		cpymo_vfs_file f;
+		err = cpymo_vfs_find(&f, &l->vfs, asset_type, asset_name, asset_ext_name);
+		CPYMO_THROW(err);
+
+		err = cpymo_assetloader_load_vfs_image_pixels(pixels, w, h, c, &f);
+		CPYMO_THROW(err);
+	}
+
+	// The cache keeps the decoded pixels and the backend gets a copy.
+	if (l->image_cache) {
+		const size_t size = (size_t)*w * (size_t)*h * (size_t)c;
+		void *copy = malloc(size == 0 ? 1 : size);
+		if (copy && cpymo_image_cache_put(
+			l->image_cache, asset_type, asset_name, c, *pixels, *w, *h)) {
+			memcpy(copy, *pixels, size);
+			*pixels = copy;
+		}
+		else free(copy);
+	}
+
+	return CPYMO_ERR_SUCC;
 }
 
 
@@ -197,7 +299,7 @@ error_t cpymo_assetloader_load_bg_pixels(void ** px, int * w, int * h, cpymo_str
 {
 	return cpymo_assetloader_load_image_pixels(
 		px, w, h, 3, "bg", name,
-		loader->game_config->bgformat, loader->use_pkg_bg, &loader->pkg_bg, loader);
+		loader->game_config->bgformat, loader);
 }
 
 #ifndef CPYMO_TOOL
@@ -237,8 +339,7 @@ static error_t cpymo_assetloader_load_image_with_mask(
 	void *pixels = NULL;
 	error_t err = cpymo_assetloader_load_image_pixels(
 		&pixels, w, h, 4, 
-		asset_type, name, asset_ext,
-		use_pkg, pkg, loader);
+		asset_type, name, asset_ext, loader);
 	CPYMO_THROW(err);
 
 	if (load_mask && cpymo_gameconfig_is_symbian(loader->game_config)) {
@@ -252,8 +353,7 @@ static error_t cpymo_assetloader_load_image_with_mask(
 		int mw, mh;
 		err = cpymo_assetloader_load_image_pixels(
 			&mask, &mw, &mh, 1,
-			asset_type, cpymo_str_pure(filename), mask_ext,
-			use_pkg, pkg, loader);
+			asset_type, cpymo_str_pure(filename), mask_ext, loader);
 		free(filename);
 		if (err == CPYMO_ERR_SUCC) {
 			error_t err = cpymo_backend_image_load_with_mask(img, pixels, mask, *w, *h, mw, mh);
@@ -300,7 +400,7 @@ error_t cpymo_assetloader_load_chara_image(cpymo_backend_image *img, int *w, int
 
 error_t cpymo_assetloader_load_script(char ** out_buffer, size_t * buf_size, const char * script_name, const cpymo_assetloader * loader)
 {
-	error_t err = cpymo_assetloader_load_filesystem_file(
+	error_t err = cpymo_assetloader_load_file(
 		out_buffer, buf_size, "script", cpymo_str_pure(script_name),
 		"txt", loader);
 
@@ -319,7 +419,7 @@ error_t cpymo_assetloader_load_system_masktrans(
 {
 	void *px = NULL;
 	int w, h;
-	error_t err = cpymo_assetloader_load_filesystem_image_pixels(&px, &w, &h, 1, "system", name, "png", loader);
+	error_t err = cpymo_assetloader_load_image_pixels(&px, &w, &h, 1, "system", name, "png", loader);
 	CPYMO_THROW(err);
 
 	err = cpymo_backend_masktrans_create(out, px, w, h);
@@ -335,22 +435,22 @@ error_t cpymo_assetloader_load_system_masktrans(
 
 error_t cpymo_assetloader_get_bgm_path(char ** out_str, cpymo_str bgm_name, const cpymo_assetloader *loader)
 {
-	return cpymo_assetloader_get_fs_path(out_str, bgm_name, "bgm", loader->game_config->bgmformat, loader);
+	return cpymo_assetloader_get_vfs_path(out_str, bgm_name, "bgm", loader->game_config->bgmformat, loader);
 }
 
 error_t cpymo_assetloader_get_vo_path(char **out_str, cpymo_str vo_name, const cpymo_assetloader *l)
 {
-	return cpymo_assetloader_get_fs_path(out_str, vo_name, "voice", l->game_config->voiceformat, l);
+	return cpymo_assetloader_get_vfs_path(out_str, vo_name, "voice", l->game_config->voiceformat, l);
 }
 
 error_t cpymo_assetloader_get_video_path(char ** out_str, cpymo_str movie_name, const cpymo_assetloader * l)
 {
-	return cpymo_assetloader_get_fs_path(out_str, movie_name, "video", "mp4", l);
+	return cpymo_assetloader_get_vfs_path(out_str, movie_name, "video", "mp4", l);
 }
 
 error_t cpymo_assetloader_get_se_path(char **out_str, cpymo_str vo_name, const cpymo_assetloader *l)
 {
-	return cpymo_assetloader_get_fs_path(out_str, vo_name, "se", l->game_config->seformat, l);
+	return cpymo_assetloader_get_vfs_path(out_str, vo_name, "se", l->game_config->seformat, l);
 }
 
 
@@ -2,6 +2,7 @@
 #define INCLUDE_CPYMO_ASSETLOADER
 
 #include "cpymo_package.h"
+#include "cpymo_vfs.h"
 #include "cpymo_gameconfig.h"
 #include "cpymo_parser.h"
 #include <stddef.h>
@@ -11,11 +12,17 @@ typedef struct {
 	cpymo_package pkg_bg, pkg_chara, pkg_se, pkg_voice;
 	const cpymo_gameconfig *game_config;
 	const char *gamedir;
+	cpymo_vfs vfs;
+	struct cpymo_async_loader *async_loader;
+	struct cpymo_image_cache *image_cache;
+	struct cpymo_script_cache *script_cache;
 } cpymo_assetloader;
 
 error_t cpymo_assetloader_init(cpymo_assetloader *out, const cpymo_gameconfig *config, const char *gamedir);
 void cpymo_assetloader_free(cpymo_assetloader *loader);
 
+error_t cpymo_assetloader_load_vfs_file(char **out_buffer, size_t *buf_size, const cpymo_vfs_file *f);
+error_t cpymo_assetloader_load_vfs_image_pixels(void **px, int *w, int *h, int c, const cpymo_vfs_file *f);
 error_t cpymo_assetloader_load_bg_pixels(void **px, int *w, int *h, cpymo_str name, const cpymo_assetloader *l);
 error_t cpymo_assetloader_load_script(char **out_buffer, size_t *buf_size, const char *script_name, const cpymo_assetloader *loader);
 
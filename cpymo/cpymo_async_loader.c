@@ -0,0 +1,481 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_async_loader.h"
+
+#ifdef ENABLE_ASYNC_ASSET_LOADER
+
+#if !defined(ENABLE_PACKAGE_PREAD)
+#error "ENABLE_ASYNC_ASSET_LOADER needs ENABLE_PACKAGE_PREAD to read packages from worker threads."
+#endif
+
+#include "cpymo_engine.h"
+#include "cpymo_vfs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../stb/stb_ds.h"
+
+typedef enum {
+	cpymo_async_loader_job_image,
+	cpymo_async_loader_job_script,
+
+	// Only warms the OS cache, leaves nothing to take.
+	cpymo_async_loader_job_read_ahead
+} cpymo_async_loader_job_kind;
+
+typedef struct cpymo_async_loader_job {
+	cpymo_async_loader_job_kind kind;
+	const char *asset_type;
+	char *name;
+	int channels;
+
+	// Resolved on main thread, the VFS table is not touched by workers.
+	cpymo_vfs_file file;
+
+	// Written by the worker before done is set.
+	void *pixels;
+	int w, h;
+	cpymo_script *script;
+	error_t err;
+
+	// Guarded by lock.
+	bool done;
+	struct cpymo_async_loader_job *next;
+
+	// The interpreter is waiting for this job.
+	bool awaited;
+} cpymo_async_loader_job;
+
+#define CPYMO_ASYNC_LOADER_READ_AHEAD_CHUNK (64 * 1024)
+
+static error_t cpymo_async_loader_read_ahead(const cpymo_vfs_file *file)
+{
+	char *chunk = NULL;
+
+	if (file->package) {
+		// Opening it checks the crc32 of a version 2 file once,
+		// which the audio does not have to do again.
+		cpymo_package_stream_reader r = 
+			cpymo_package_stream_reader_create(file->package, &file->index);
+
+		if (!cpymo_package_advise_willneed(file->package, &file->index)) {
+			chunk = (char *)malloc(CPYMO_ASYNC_LOADER_READ_AHEAD_CHUNK);
+			if (chunk)
+				while (cpymo_package_stream_reader_read(
+					chunk, CPYMO_ASYNC_LOADER_READ_AHEAD_CHUNK, &r));
+		}
+
+		cpymo_package_stream_reader_close(&r);
+		free(chunk);
+		return CPYMO_ERR_SUCC;
+	}
+
+#ifdef POSIX_FADV_WILLNEED
+	int fd = open(file->path, O_RDONLY);
+	if (fd < 0) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	bool advised = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0;
+	close(fd);
+	if (advised) return CPYMO_ERR_SUCC;
+#endif
+
+	FILE *f = fopen(file->path, "rb");
+	if (f == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	chunk = (char *)malloc(CPYMO_ASYNC_LOADER_READ_AHEAD_CHUNK);
+	if (chunk)
+		while (fread(chunk, 1, CPYMO_ASYNC_LOADER_READ_AHEAD_CHUNK, f));
+
+	fclose(f);
+	free(chunk);
+	return CPYMO_ERR_SUCC;
+}
+
+static void *cpymo_async_loader_worker(void *userdata)
+{
+	cpymo_async_loader *l = (cpymo_async_loader *)userdata;
+
+	pthread_mutex_lock(&l->lock);
+	while (true) {
+		while (!l->quit && l->queue_head == NULL)
+			pthread_cond_wait(&l->job_queued, &l->lock);
+
+		if (l->quit) break;
+
+		cpymo_async_loader_job *job = l->queue_head;
+		l->queue_head = job->next;
+		if (l->queue_head == NULL) l->queue_tail = NULL;
+		job->next = NULL;
+
+		pthread_mutex_unlock(&l->lock);
+
+		switch (job->kind) {
+		case cpymo_async_loader_job_image:
+			job->err = cpymo_assetloader_load_vfs_image_pixels(
+				&job->pixels, &job->w, &job->h, job->channels, &job->file);
+			break;
+		case cpymo_async_loader_job_script:
+			job->err = cpymo_script_load_vfs(&job->script, cpymo_str_pure(job->name), &job->file);
+			break;
+		case cpymo_async_loader_job_read_ahead:
+			job->err = cpymo_async_loader_read_ahead(&job->file);
+			break;
+		}
+
+		pthread_mutex_lock(&l->lock);
+		job->done = true;
+		pthread_cond_broadcast(&l->job_done);
+	}
+	pthread_mutex_unlock(&l->lock);
+
+	return NULL;
+}
+
+static void cpymo_async_loader_job_free(cpymo_async_loader_job *job)
+{
+	if (job->pixels) free(job->pixels);
+	if (job->script) cpymo_script_free(job->script);
+	free(job->name);
+	free(job);
+}
+
+void cpymo_async_loader_init(cpymo_async_loader *l)
+{
+	l->jobs = NULL;
+	l->worker_count = 0;
+	l->cache_budget = CPYMO_ASYNC_LOADER_CACHE_BUDGET;
+	l->queue_head = NULL;
+	l->queue_tail = NULL;
+	l->quit = false;
+
+	pthread_mutex_init(&l->lock, NULL);
+	pthread_cond_init(&l->job_queued, NULL);
+	pthread_cond_init(&l->job_done, NULL);
+}
+
+void cpymo_async_loader_free(cpymo_async_loader *l)
+{
+	pthread_mutex_lock(&l->lock);
+	l->quit = true;
+	pthread_cond_broadcast(&l->job_queued);
+	pthread_mutex_unlock(&l->lock);
+
+	for (size_t i = 0; i < l->worker_count; ++i)
+		pthread_join(l->workers[i], NULL);
+	l->worker_count = 0;
+
+	for (size_t i = 0; i < arrlenu(l->jobs); ++i)
+		cpymo_async_loader_job_free(l->jobs[i]);
+	arrfree(l->jobs);
+	l->jobs = NULL;
+
+	pthread_cond_destroy(&l->job_done);
+	pthread_cond_destroy(&l->job_queued);
+	pthread_mutex_destroy(&l->lock);
+}
+
+static size_t cpymo_async_loader_job_size(const cpymo_async_loader_job *job)
+{
+	return job->pixels ? (size_t)job->w * (size_t)job->h * (size_t)job->channels : 0;
+}
+
+// Drops the oldest decoded images nobody is waiting for,
+// until at most max_bytes and max_jobs are left, returns bytes left.
+// Finished read-ahead jobs are always dropped.
+static size_t cpymo_async_loader_evict(
+	cpymo_async_loader *l, size_t max_bytes, size_t max_jobs)
+{
+	size_t used = 0;
+
+	pthread_mutex_lock(&l->lock);
+	for (size_t i = 0; i < arrlenu(l->jobs); ++i)
+		if (l->jobs[i]->done) 
+			used += cpymo_async_loader_job_size(l->jobs[i]);
+
+	for (size_t i = 0; i < arrlenu(l->jobs); ) {
+		const bool over = used > max_bytes || arrlenu(l->jobs) > max_jobs;
+
+		cpymo_async_loader_job *job = l->jobs[i];
+		if (job->done && !job->awaited
+			&& (over || job->kind == cpymo_async_loader_job_read_ahead)) {
+			used -= cpymo_async_loader_job_size(job);
+			cpymo_async_loader_job_free(job);
+			arrdel(l->jobs, i);
+		}
+		else i++;
+	}
+	pthread_mutex_unlock(&l->lock);
+
+	return used;
+}
+
+void cpymo_async_loader_trim_memory(cpymo_async_loader *l)
+{
+	cpymo_async_loader_evict(l, 0, 0);
+}
+
+static ptrdiff_t cpymo_async_loader_find(
+	const cpymo_async_loader *l, const char *asset_type, cpymo_str name, int channels)
+{
+	for (size_t i = 0; i < arrlenu(l->jobs); ++i) {
+		const cpymo_async_loader_job *job = l->jobs[i];
+		if (job->channels == channels
+			&& strcmp(job->asset_type, asset_type) == 0
+			&& cpymo_str_equals_str(name, job->name))
+			return (ptrdiff_t)i;
+	}
+
+	return -1;
+}
+
+static bool cpymo_async_loader_start_workers(cpymo_async_loader *l)
+{
+	while (l->worker_count < CPYMO_ASYNC_LOADER_THREADS) {
+		if (pthread_create(
+			&l->workers[l->worker_count], NULL, 
+			&cpymo_async_loader_worker, l) != 0)
+			break;
+		l->worker_count++;
+	}
+
+	return l->worker_count > 0;
+}
+
+static bool cpymo_async_loader_request(
+	cpymo_engine *e,
+	cpymo_async_loader_job_kind kind,
+	const char *asset_type,
+	cpymo_str name,
+	const char *asset_ext,
+	int channels,
+	bool prefetch)
+{
+	cpymo_async_loader *l = &e->async_loader;
+
+	if (kind == cpymo_async_loader_job_image &&
+		cpymo_image_cache_contains(&e->image_cache, asset_type, name, channels))
+		return false;
+
+	ptrdiff_t i = cpymo_async_loader_find(l, asset_type, name, channels);
+	if (i >= 0) {
+		if (prefetch) return false;
+
+		cpymo_async_loader_job *job = l->jobs[i];
+		pthread_mutex_lock(&l->lock);
+		bool done = job->done;
+		pthread_mutex_unlock(&l->lock);
+
+		job->awaited = !done;
+		return !done;
+	}
+
+	size_t used = cpymo_async_loader_evict(
+		l, l->cache_budget, CPYMO_ASYNC_LOADER_MAX_JOBS - 1);
+	if (arrlenu(l->jobs) >= CPYMO_ASYNC_LOADER_MAX_JOBS) return false;
+	if (prefetch && used >= l->cache_budget) return false;
+
+	if (l->worker_count == 0)
+		if (!cpymo_async_loader_start_workers(l)) return false;
+
+	cpymo_async_loader_job *job = 
+		(cpymo_async_loader_job *)malloc(sizeof(cpymo_async_loader_job));
+	if (job == NULL) return false;
+
+	// Let the synchronous path report missing files.
+	if (cpymo_vfs_find(&job->file, &e->assetloader.vfs, asset_type, name, asset_ext) 
+		!= CPYMO_ERR_SUCC) {
+		free(job);
+		return false;
+	}
+
+	job->name = cpymo_str_copy_malloc(name);
+	if (job->name == NULL) {
+		free(job);
+		return false;
+	}
+
+	job->kind = kind;
+	job->asset_type = asset_type;
+	job->channels = channels;
+	job->pixels = NULL;
+	job->w = 0;
+	job->h = 0;
+	job->script = NULL;
+	job->err = CPYMO_ERR_UNKNOWN;
+	job->done = false;
+	job->next = NULL;
+	job->awaited = !prefetch;
+
+	arrput(l->jobs, job);
+
+	pthread_mutex_lock(&l->lock);
+	if (l->queue_tail) l->queue_tail->next = job;
+	else l->queue_head = job;
+	l->queue_tail = job;
+	pthread_cond_signal(&l->job_queued);
+	pthread_mutex_unlock(&l->lock);
+
+	return true;
+}
+
+static bool cpymo_async_loader_request_with_mask(
+	cpymo_engine *e,
+	const char *asset_type,
+	cpymo_str name,
+	const char *asset_ext,
+	const char *mask_ext,
+	bool load_mask,
+	bool prefetch)
+{
+	bool pending = cpymo_async_loader_request(
+		e, cpymo_async_loader_job_image, asset_type, name, asset_ext, 4, prefetch);
+
+	if (load_mask && cpymo_gameconfig_is_symbian(&e->gameconfig)) {
+		char mask_name[128];
+		if (name.len + 6 <= sizeof(mask_name)) {
+			cpymo_str_copy(mask_name, sizeof(mask_name), name);
+			strcat(mask_name, "_mask");
+			pending |= cpymo_async_loader_request(
+				e, cpymo_async_loader_job_image, asset_type, cpymo_str_pure(mask_name), mask_ext, 1, prefetch);
+		}
+	}
+
+	return pending;
+}
+
+bool cpymo_async_loader_request_bg(cpymo_engine *e, cpymo_str name)
+{
+	return cpymo_async_loader_request(
+		e, cpymo_async_loader_job_image, "bg", name, e->gameconfig.bgformat, 3, false);
+}
+
+bool cpymo_async_loader_request_chara(cpymo_engine *e, cpymo_str name)
+{
+	return cpymo_async_loader_request_with_mask(
+		e, "chara", name, 
+		e->gameconfig.charaformat, e->gameconfig.charamaskformat, true, false);
+}
+
+bool cpymo_async_loader_request_system_image(
+	cpymo_engine *e, cpymo_str name, bool load_mask)
+{
+	return cpymo_async_loader_request_with_mask(
+		e, "system", name, "png", "png", load_mask, false);
+}
+
+void cpymo_async_loader_prefetch_bg(cpymo_engine *e, cpymo_str name)
+{
+	cpymo_async_loader_request(
+		e, cpymo_async_loader_job_image, "bg", name, e->gameconfig.bgformat, 3, true);
+}
+
+void cpymo_async_loader_prefetch_chara(cpymo_engine *e, cpymo_str name)
+{
+	cpymo_async_loader_request_with_mask(
+		e, "chara", name, 
+		e->gameconfig.charaformat, e->gameconfig.charamaskformat, true, true);
+}
+
+void cpymo_async_loader_prefetch_system_image(cpymo_engine *e, cpymo_str name)
+{
+	cpymo_async_loader_request_with_mask(
+		e, "system", name, "png", "png", true, true);
+}
+
+void cpymo_async_loader_prefetch_file(
+	cpymo_engine *e, const char *asset_type, cpymo_str name, const char *asset_ext)
+{
+	cpymo_async_loader_request(
+		e, cpymo_async_loader_job_read_ahead, asset_type, name, asset_ext, 0, true);
+}
+
+void cpymo_async_loader_prefetch_script(cpymo_engine *e, cpymo_str name)
+{
+	if (cpymo_script_cache_find(&e->script_cache, name)) return;
+	cpymo_async_loader_request(
+		e, cpymo_async_loader_job_script, "script", name, "txt", 0, true);
+}
+
+static bool cpymo_async_loader_wait_for_jobs(cpymo_engine *e, float _)
+{
+	cpymo_async_loader *l = &e->async_loader;
+	bool all_done = true;
+
+	pthread_mutex_lock(&l->lock);
+	for (size_t i = 0; i < arrlenu(l->jobs); ++i) {
+		if (l->jobs[i]->awaited && !l->jobs[i]->done) {
+			all_done = false;
+			break;
+		}
+	}
+
+	// The command executes again next step and takes them,
+	// from now on they can be evicted like prefetched images.
+	if (all_done)
+		for (size_t i = 0; i < arrlenu(l->jobs); ++i)
+			l->jobs[i]->awaited = false;
+	pthread_mutex_unlock(&l->lock);
+
+	return all_done;
+}
+
+void cpymo_async_loader_wait(cpymo_engine *e)
+{
+	cpymo_wait_register(&e->wait, &cpymo_async_loader_wait_for_jobs);
+}
+
+// Removes the job from jobs once it is done, NULL if it was not requested.
+static cpymo_async_loader_job *cpymo_async_loader_take_job(
+	cpymo_async_loader *l, const char *asset_type, cpymo_str name, int channels)
+{
+	ptrdiff_t i = cpymo_async_loader_find(l, asset_type, name, channels);
+	if (i < 0) return NULL;
+
+	cpymo_async_loader_job *job = l->jobs[i];
+
+	pthread_mutex_lock(&l->lock);
+	while (!job->done) pthread_cond_wait(&l->job_done, &l->lock);
+	pthread_mutex_unlock(&l->lock);
+
+	arrdel(l->jobs, (size_t)i);
+	return job;
+}
+
+bool cpymo_async_loader_take(
+	cpymo_async_loader *l,
+	const char *asset_type, cpymo_str name, int channels,
+	void **pixels, int *w, int *h, error_t *err)
+{
+	cpymo_async_loader_job *job = 
+		cpymo_async_loader_take_job(l, asset_type, name, channels);
+	if (job == NULL) return false;
+
+	*pixels = job->pixels;
+	*w = job->w;
+	*h = job->h;
+	*err = job->err;
+
+	job->pixels = NULL;
+	cpymo_async_loader_job_free(job);
+
+	return true;
+}
+
+bool cpymo_async_loader_take_script(
+	cpymo_async_loader *l, cpymo_str name, cpymo_script **script, error_t *err)
+{
+	cpymo_async_loader_job *job = cpymo_async_loader_take_job(l, "script", name, 0);
+	if (job == NULL) return false;
+
+	*script = job->script;
+	*err = job->err;
+
+	job->script = NULL;
+	cpymo_async_loader_job_free(job);
+
+	return true;
+}
+
+#endif
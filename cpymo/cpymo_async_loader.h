@@ -0,0 +1,150 @@
+#ifndef INCLUDE_CPYMO_ASYNC_LOADER
+#define INCLUDE_CPYMO_ASYNC_LOADER
+
+#include "cpymo_error.h"
+#include "cpymo_str.h"
+#include "cpymo_script.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Decodes bg, chara and system images and compiles scripts on worker threads.
+// The interpreter requests the images a command needs, parks on engine->wait
+// until they are decoded, then executes the command again,
+// and the asset loader takes the decoded pixels instead of decoding them.
+// cpymo_backend_image_load is still called on the main thread.
+//
+// Threads are used with ENABLE_ASYNC_ASSET_LOADER only.
+// Otherwise, requests return false and images are decoded synchronously.
+// stb_leakcheck is not thread safe, so LEAKCHECK builds never use threads.
+
+#if defined(ENABLE_ASYNC_ASSET_LOADER) && \
+	(defined(DISABLE_STB_IMAGE) || defined(LEAKCHECK) || defined(CPYMO_TOOL))
+#undef ENABLE_ASYNC_ASSET_LOADER
+#endif
+
+struct cpymo_engine;
+
+#ifdef ENABLE_ASYNC_ASSET_LOADER
+
+#include <pthread.h>
+
+#ifndef CPYMO_ASYNC_LOADER_THREADS
+#define CPYMO_ASYNC_LOADER_THREADS 2
+#endif
+
+#ifndef CPYMO_ASYNC_LOADER_MAX_JOBS
+#define CPYMO_ASYNC_LOADER_MAX_JOBS 32
+#endif
+
+#ifndef CPYMO_ASYNC_LOADER_CACHE_BUDGET
+#define CPYMO_ASYNC_LOADER_CACHE_BUDGET (16 * 1024 * 1024)
+#endif
+
+struct cpymo_async_loader_job;
+
+typedef struct cpymo_async_loader {
+	// Only touched by main thread.
+	struct cpymo_async_loader_job **jobs;
+	size_t worker_count;
+
+	// Bytes of decoded pixels kept for prefetched images.
+	size_t cache_budget;
+
+	// Guarded by lock.
+	struct cpymo_async_loader_job *queue_head, *queue_tail;
+	bool quit;
+
+	pthread_mutex_t lock;
+	pthread_cond_t job_queued, job_done;
+	pthread_t workers[CPYMO_ASYNC_LOADER_THREADS];
+} cpymo_async_loader;
+
+void cpymo_async_loader_init(cpymo_async_loader *l);
+void cpymo_async_loader_free(cpymo_async_loader *l);
+void cpymo_async_loader_trim_memory(cpymo_async_loader *l);
+
+// Returns true if the image is not decoded yet,
+// then call cpymo_async_loader_wait and execute the command again.
+bool cpymo_async_loader_request_bg(struct cpymo_engine *e, cpymo_str name);
+bool cpymo_async_loader_request_chara(struct cpymo_engine *e, cpymo_str name);
+bool cpymo_async_loader_request_system_image(
+	struct cpymo_engine *e, cpymo_str name, bool load_mask);
+
+void cpymo_async_loader_wait(struct cpymo_engine *e);
+
+// Decodes an image before the script needs it, nobody waits for it,
+// skipped when the cache budget is used up.
+void cpymo_async_loader_prefetch_bg(struct cpymo_engine *e, cpymo_str name);
+void cpymo_async_loader_prefetch_chara(struct cpymo_engine *e, cpymo_str name);
+void cpymo_async_loader_prefetch_system_image(struct cpymo_engine *e, cpymo_str name);
+
+// Reads a file ahead on a worker thread, used for audio.
+// Hints the OS where it can, otherwise reads the file through once.
+void cpymo_async_loader_prefetch_file(
+	struct cpymo_engine *e, const char *asset_type, cpymo_str name, const char *asset_ext);
+
+// Loads and compiles a script before #change or #call reaches it,
+// skipped if the script cache already has it.
+void cpymo_async_loader_prefetch_script(struct cpymo_engine *e, cpymo_str name);
+
+static inline void cpymo_async_loader_set_cache_budget(cpymo_async_loader *l, size_t bytes)
+{ l->cache_budget = bytes; }
+
+// Takes the pixels of a requested image, waits if it is still decoding.
+// Returns false if this image was not requested.
+bool cpymo_async_loader_take(
+	cpymo_async_loader *l,
+	const char *asset_type, cpymo_str name, int channels,
+	void **pixels, int *w, int *h, error_t *err);
+
+// Takes a prefetched script, waits if it is still loading.
+// Returns false if this script was not prefetched.
+bool cpymo_async_loader_take_script(
+	cpymo_async_loader *l, cpymo_str name, cpymo_script **script, error_t *err);
+
+#else
+
+typedef struct cpymo_async_loader {
+	char unused;
+} cpymo_async_loader;
+
+static inline void cpymo_async_loader_init(cpymo_async_loader *l) {}
+static inline void cpymo_async_loader_free(cpymo_async_loader *l) {}
+static inline void cpymo_async_loader_trim_memory(cpymo_async_loader *l) {}
+
+static inline bool cpymo_async_loader_request_bg(struct cpymo_engine *e, cpymo_str name)
+{ return false; }
+
+static inline bool cpymo_async_loader_request_chara(struct cpymo_engine *e, cpymo_str name)
+{ return false; }
+
+static inline bool cpymo_async_loader_request_system_image(
+	struct cpymo_engine *e, cpymo_str name, bool load_mask)
+{ return false; }
+
+static inline void cpymo_async_loader_wait(struct cpymo_engine *e) {}
+
+static inline void cpymo_async_loader_prefetch_bg(struct cpymo_engine *e, cpymo_str name) {}
+static inline void cpymo_async_loader_prefetch_chara(struct cpymo_engine *e, cpymo_str name) {}
+static inline void cpymo_async_loader_prefetch_system_image(struct cpymo_engine *e, cpymo_str name) {}
+
+static inline void cpymo_async_loader_prefetch_file(
+	struct cpymo_engine *e, const char *asset_type, cpymo_str name, const char *asset_ext) {}
+
+static inline void cpymo_async_loader_prefetch_script(struct cpymo_engine *e, cpymo_str name) {}
+
+static inline void cpymo_async_loader_set_cache_budget(cpymo_async_loader *l, size_t bytes) {}
+
+static inline bool cpymo_async_loader_take(
+	cpymo_async_loader *l,
+	const char *asset_type, cpymo_str name, int channels,
+	void **pixels, int *w, int *h, error_t *err)
+{ return false; }
+
+static inline bool cpymo_async_loader_take_script(
+	cpymo_async_loader *l, cpymo_str name, cpymo_script **script, error_t *err)
+{ return false; }
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef INCLUDE_CPYMO_ATOMIC
+#define INCLUDE_CPYMO_ATOMIC
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Atomics shared by the engine, the audio callback and the decoder thread.
+// C11 atomics, or std::atomic where CPyMO is built as C++.
+// Loads acquire and stores release.
+
+#ifdef __cplusplus
+#include <atomic>
+
+typedef std::atomic<size_t> cpymo_atomic_size;
+typedef std::atomic<bool> cpymo_atomic_bool;
+
+#define cpymo_atomic_init(p, v) std::atomic_init((p), (v))
+#define cpymo_atomic_load(p) (p)->load(std::memory_order_acquire)
+#define cpymo_atomic_load_relaxed(p) (p)->load(std::memory_order_relaxed)
+#define cpymo_atomic_store(p, v) (p)->store((v), std::memory_order_release)
+#elif defined(_MSC_VER)
+// MSVC only has <stdatomic.h> in C since Visual Studio 2022 17.5.
+#include <intrin.h>
+
+typedef volatile size_t cpymo_atomic_size;
+typedef volatile size_t cpymo_atomic_bool;
+
+#if defined(_M_ARM64)
+#define CPYMO_ATOMIC_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#elif defined(_M_ARM)
+#define CPYMO_ATOMIC_FENCE() __dmb(_ARM_BARRIER_ISH)
+#else
+#define CPYMO_ATOMIC_FENCE() _ReadWriteBarrier()
+#endif
+
+static inline size_t cpymo_atomic_load_msvc(const volatile size_t *p)
+{
+	size_t v = *p;
+	CPYMO_ATOMIC_FENCE();
+	return v;
+}
+
+static inline void cpymo_atomic_store_msvc(volatile size_t *p, size_t v)
+{
+	CPYMO_ATOMIC_FENCE();
+	*p = v;
+}
+
+#define cpymo_atomic_init(p, v) (*(p) = (size_t)(v))
+#define cpymo_atomic_load(p) cpymo_atomic_load_msvc(p)
+#define cpymo_atomic_load_relaxed(p) (*(p))
+#define cpymo_atomic_store(p, v) cpymo_atomic_store_msvc((p), (size_t)(v))
+#else
+#include <stdatomic.h>
+
+typedef atomic_size_t cpymo_atomic_size;
+typedef atomic_bool cpymo_atomic_bool;
+
+#define cpymo_atomic_init(p, v) atomic_init((p), (v))
+#define cpymo_atomic_load(p) atomic_load_explicit((p), memory_order_acquire)
+#define cpymo_atomic_load_relaxed(p) atomic_load_explicit((p), memory_order_relaxed)
+#define cpymo_atomic_store(p, v) atomic_store_explicit((p), (v), memory_order_release)
+#endif
+
+#endif
@@ -1,8 +1,15 @@
 ﻿#include "cpymo_prelude.h"
 #include "cpymo_audio.h"
+#include "cpymo_audio_mix.h"
 #include <assert.h>
+#include <string.h>
 #include "../cpymo-backends/include/cpymo_backend_audio.h"
 #include "cpymo_engine.h"
+#include "../stb/stb_ds.h"
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+#include <time.h>
+#endif
 
 #ifdef __CXX
 #undef av_err2str
@@ -10,41 +17,27 @@
 #endif
 
 #ifndef DISABLE_FFMPEG_AUDIO
-static inline void cpymo_audio_channel_init(cpymo_audio_channel *c)
-{
-	c->enabled = false;
-	c->loop = false;
-	c->format_context = NULL;
-	c->codec_context = NULL;
-	c->swr_context = NULL;
-	c->converted_frame_current_offset = 0;
-	c->io_context = NULL;
-}
-
-static void cpymo_audio_channel_reset_unsafe(cpymo_audio_channel *c)
+static void cpymo_audio_voice_free(cpymo_audio_voice *v)
 {
-	if (c->swr_context) swr_free(&c->swr_context);
-	if (c->codec_context) avcodec_free_context(&c->codec_context);
-	if (c->format_context) avformat_close_input(&c->format_context);
-	if (c->io_context) {
-		void *buf = c->io_context->buffer;
-		avio_context_free(&c->io_context);
+	if (v->swr_context) swr_free(&v->swr_context);
+	if (v->codec_context) avcodec_free_context(&v->codec_context);
+	if (v->format_context) avformat_close_input(&v->format_context);
+	if (v->io_context) {
+		void *buf = v->io_context->buffer;
+		avio_context_free(&v->io_context);
 		if (buf) av_free(buf);
-		cpymo_package_stream_reader_close(&c->package_reader);
+		cpymo_package_stream_reader_close(&v->package_reader);
 	}
 
-	cpymo_audio_channel_init(c);
-}
+	if (v->packet) av_packet_free(&v->packet);
+	if (v->frame) av_frame_free(&v->frame);
+	free(v->converted_buf);
 
-static void cpymo_audio_channel_reset(cpymo_audio_channel *c)
-{
-	if (c->enabled) {
-		cpymo_backend_audio_lock();
-		c->enabled = false;
-		cpymo_backend_audio_unlock();
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_ring_free(&v->ring);
+#endif
 
-		cpymo_audio_channel_reset_unsafe(c);
-	}
+	free(v);
 }
 
 static enum AVSampleFormat cpymo_audio_fmt2ffmpeg(
@@ -59,8 +52,8 @@ static enum AVSampleFormat cpymo_audio_fmt2ffmpeg(
 	return (enum AVSampleFormat)-1;
 }
 
-static error_t cpymo_audio_channel_grow_convert_buffer(
-	cpymo_audio_channel *c, 
+static error_t cpymo_audio_voice_grow_convert_buffer(
+	cpymo_audio_voice *v, 
 	size_t samples,
 	const cpymo_backend_audio_info *info)
 {
@@ -71,31 +64,30 @@ static error_t cpymo_audio_channel_grow_convert_buffer(
 		cpymo_audio_fmt2ffmpeg(info->format),
 		1);
 
-	if (size > c->converted_buf_all_size) {
-		uint8_t *converted_buf = (uint8_t *)realloc(c->converted_buf, size);
+	if (size > v->converted_buf_all_size) {
+		uint8_t *converted_buf = (uint8_t *)realloc(v->converted_buf, size);
 		if (converted_buf == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
 			return CPYMO_ERR_OUT_OF_MEM;
 		}
 
-		c->converted_buf = converted_buf;
-		c->converted_buf_all_size = size;
+		v->converted_buf = converted_buf;
+		v->converted_buf_all_size = size;
 	}
 
 	return CPYMO_ERR_SUCC;
 }
 
-static error_t cpymo_audio_channel_flush_converter(cpymo_audio_channel *c)
+static error_t cpymo_audio_voice_flush_converter(cpymo_audio_voice *v)
 {
 	const cpymo_backend_audio_info *info = cpymo_backend_audio_get_info();
 
 	const size_t flush_buffer_samples = 512;
-	error_t err = cpymo_audio_channel_grow_convert_buffer(c, flush_buffer_samples, info);
+	error_t err = cpymo_audio_voice_grow_convert_buffer(v, flush_buffer_samples, info);
 	CPYMO_THROW(err);
 
 	int samples = swr_convert(
-		c->swr_context,
-		&c->converted_buf,
+		v->swr_context,
+		&v->converted_buf,
 		(int)flush_buffer_samples,
 		NULL,
 		0);
@@ -106,37 +98,37 @@ static error_t cpymo_audio_channel_flush_converter(cpymo_audio_channel *c)
 		return CPYMO_ERR_UNKNOWN;
 	}
 
-	c->converted_buf_size = av_samples_get_buffer_size(
+	v->converted_buf_size = av_samples_get_buffer_size(
 		NULL,
 		(int)info->channels,
 		samples,
 		cpymo_audio_fmt2ffmpeg(info->format),
 		1);
 
-	c->converted_frame_current_offset = 0;
+	v->converted_frame_current_offset = 0;
 	return CPYMO_ERR_SUCC;
 }
 
-static error_t cpymo_audio_channel_convert_current_frame(cpymo_audio_channel *c)
+static error_t cpymo_audio_voice_convert_current_frame(cpymo_audio_voice *v)
 {
 	const cpymo_backend_audio_info *info = cpymo_backend_audio_get_info();
 
-	assert(c->frame->nb_samples != 0);
+	assert(v->frame->nb_samples != 0);
 	
-	error_t err = cpymo_audio_channel_grow_convert_buffer(
-		c, (size_t)c->frame->nb_samples, info);
+	error_t err = cpymo_audio_voice_grow_convert_buffer(
+		v, (size_t)v->frame->nb_samples, info);
 	CPYMO_THROW(err);
 
 	int samples = swr_convert(
-		c->swr_context,
-		&c->converted_buf,
-		c->frame->nb_samples,
-		(const uint8_t **)c->frame->data,
-		c->frame->nb_samples);
+		v->swr_context,
+		&v->converted_buf,
+		v->frame->nb_samples,
+		(const uint8_t **)v->frame->data,
+		v->frame->nb_samples);
 
 	if (samples == 0) {
-		memset(c->converted_buf, 0, c->converted_buf_all_size);
-		c->converted_buf_size = 0;
+		memset(v->converted_buf, 0, v->converted_buf_all_size);
+		v->converted_buf_size = 0;
 		return CPYMO_ERR_SUCC;
 	}
 	else if (samples < 0) {
@@ -145,43 +137,43 @@ static error_t cpymo_audio_channel_convert_current_frame(cpymo_audio_channel *c)
 		return CPYMO_ERR_UNKNOWN;
 	}
 
-	c->converted_buf_size = av_samples_get_buffer_size(
+	v->converted_buf_size = av_samples_get_buffer_size(
 		NULL,
 		(int)info->channels,
 		samples,
 		cpymo_audio_fmt2ffmpeg(info->format),
 		1);
 
-	c->converted_frame_current_offset = 0;
+	v->converted_frame_current_offset = 0;
 	return CPYMO_ERR_SUCC;
 }
 
-static void cpymo_audio_channel_seek_to_head(cpymo_audio_channel *c)
+static void cpymo_audio_voice_seek_to_head(cpymo_audio_voice *v)
 {
-	av_seek_frame(c->format_context, c->stream_id, 0, AVSEEK_FLAG_FRAME | AVSEEK_FLAG_ANY);
+	av_seek_frame(v->format_context, v->stream_id, 0, AVSEEK_FLAG_FRAME | AVSEEK_FLAG_ANY);
 }
 
-static error_t cpymo_audio_channel_next_frame(cpymo_audio_channel *c)
+static error_t cpymo_audio_voice_next_frame(cpymo_audio_voice *v)
 { RETRY: {
-	int result = avcodec_receive_frame(c->codec_context, c->frame);
+	int result = avcodec_receive_frame(v->codec_context, v->frame);
 
 	if (result == 0) {
 		// One frame received
-		error_t err = cpymo_audio_channel_convert_current_frame(c);
-		av_frame_unref(c->frame);
+		error_t err = cpymo_audio_voice_convert_current_frame(v);
+		av_frame_unref(v->frame);
 		return err;
 	}
 	else if (result == AVERROR(EAGAIN)) {
 		// No frame received, send more packet to codec.
-		result = av_read_frame(c->format_context, c->packet);
+		result = av_read_frame(v->format_context, v->packet);
 		if (result == 0) {
-			if (c->packet->stream_index != c->stream_id) {
-				av_packet_unref(c->packet);
+			if (v->packet->stream_index != v->stream_id) {
+				av_packet_unref(v->packet);
 				goto RETRY;
 			}
 
-			result = avcodec_send_packet(c->codec_context, c->packet);
-			av_packet_unref(c->packet);
+			result = avcodec_send_packet(v->codec_context, v->packet);
+			av_packet_unref(v->packet);
 			if (result != 0) {
 				printf("[Error] avcodec_send_packet: %s.\n", av_err2str(result));
 				return CPYMO_ERR_UNKNOWN;
@@ -189,11 +181,11 @@ static error_t cpymo_audio_channel_next_frame(cpymo_audio_channel *c)
 			goto RETRY;
 		}
 		else if (result == AVERROR_EOF) {
-			if (c->loop) {
-				cpymo_audio_channel_seek_to_head(c);
+			if (v->loop) {
+				cpymo_audio_voice_seek_to_head(v);
 			}
 			else {
-				result = avcodec_send_packet(c->codec_context, NULL);
+				result = avcodec_send_packet(v->codec_context, NULL);
 				if (result != 0) {
 					printf("[Error] avcodec_send_packet: %s.\n", av_err2str(result));
 					return CPYMO_ERR_UNKNOWN;
@@ -209,7 +201,7 @@ static error_t cpymo_audio_channel_next_frame(cpymo_audio_channel *c)
 	else if (result == AVERROR_EOF) {
 		// No frame received, and no more packet send to codec.
 		// Flush Swr buffer.
-		return cpymo_audio_channel_flush_converter(c);
+		return cpymo_audio_voice_flush_converter(v);
 	}
 	else {
 		printf("[Error] av_receive_frame: %s.\n", av_err2str(result));
@@ -217,71 +209,369 @@ static error_t cpymo_audio_channel_next_frame(cpymo_audio_channel *c)
 	}
 }}
 
-static void cpymo_audio_mix_samples(
-	void *dst_, 
-	const void *src_,
-	size_t len, 
-	cpymo_backend_audio_format fmt,
-	float volume)
+// Audio thread: hands the voice playing on cid back to the engine.
+static void cpymo_audio_release(cpymo_audio_system *s, size_t cid)
 {
+	cpymo_audio_voice *v = s->playing[cid];
+	if (v == NULL) return;
 
-#define MIX_SIGNED(TYPE, TYPE_MAX_VAL) { \
-	TYPE *dst = (TYPE *)dst_; \
-	const TYPE *src = (TYPE *)src_; \
-	len /= sizeof(TYPE); \
-	\
-	for (size_t i = 0; i < len; ++i) { \
-		double src_sample = (float)src[i] / (float)TYPE_MAX_VAL; \
-		double dst_sample = (float)dst[i] / (float)TYPE_MAX_VAL; \
-		src_sample *= volume * 1.0f; \
-		dst_sample += src_sample; \
-		\
-		if (dst_sample > 1) dst_sample = 1; \
-		if (dst_sample < -1) dst_sample = -1; \
-		\
-		dst[i] = (TYPE)(dst_sample * TYPE_MAX_VAL); \
-	}\
+	// There is room for every live voice, see cpymo_audio_play_file.
+	size_t written = cpymo_audio_ring_write(&s->released, &v, sizeof(v));
+	assert(written == sizeof(v));
+	(void)written;
+
+	s->playing[cid] = NULL;
 }
 
-	switch (fmt) {
-	case cpymo_backend_audio_s16: MIX_SIGNED(int16_t, INT16_MAX); break;
-	case cpymo_backend_audio_s32: MIX_SIGNED(int32_t, INT32_MAX); break;
-	case cpymo_backend_audio_f32: MIX_SIGNED(float, 1.0f); break;
+static void cpymo_audio_apply_command(cpymo_audio_system *s, const cpymo_audio_command *cmd)
+{
+	switch (cmd->type) {
+	case cpymo_audio_command_play:
+		cpymo_audio_release(s, cmd->cid);
+		s->playing[cmd->cid] = cmd->voice;
+		break;
+	case cpymo_audio_command_stop:
+		cpymo_audio_release(s, cmd->cid);
+		break;
+	case cpymo_audio_command_volume:
+		s->playing_volumes[cmd->cid] = cmd->volume;
+		break;
 	}
 }
 
-static void cpymo_audio_channel_mix_samples(uint8_t *dst, size_t len, cpymo_audio_channel *c)
+static bool cpymo_audio_queue_receive(cpymo_audio_ring *r, cpymo_audio_command *cmd)
 {
-	const cpymo_backend_audio_info *info = cpymo_backend_audio_get_info();
+	size_t size;
+	const void *p = cpymo_audio_ring_peek(r, &size);
+	if (size < sizeof(cpymo_audio_command)) return false;
+
+	memcpy(cmd, p, sizeof(cpymo_audio_command));
+	cpymo_audio_ring_consume(r, sizeof(cpymo_audio_command));
+	return true;
+}
 
-	while (len > 0) {
-		uint8_t *src = c->converted_buf + c->converted_frame_current_offset;
-		size_t src_size = c->converted_buf_size - c->converted_frame_current_offset;
+// Audio thread, before each buffer.
+static void cpymo_audio_receive_commands(cpymo_audio_system *s)
+{
+	cpymo_audio_command cmd;
+	while (cpymo_audio_queue_receive(&s->commands, &cmd))
+		cpymo_audio_apply_command(s, &cmd);
+}
 
-		if (src_size == 0) {
-			error_t err = cpymo_audio_channel_next_frame(c);
-			if (err == CPYMO_ERR_SUCC) 
-				continue;
-			else
-				goto FILL_BLANK_AND_RESET;
+static void cpymo_audio_queue_flush(cpymo_audio_ring *r, cpymo_audio_command **pending)
+{
+	size_t sent = 0;
+	while (sent < arrlenu(*pending) 
+		&& cpymo_audio_ring_writable(r) >= sizeof(cpymo_audio_command)) 
+	{
+		cpymo_audio_ring_write(r, &(*pending)[sent], sizeof(cpymo_audio_command));
+		sent++;
+	}
+
+	if (sent) arrdeln(*pending, 0, sent);
+}
+
+// Engine thread. If the ring is full, commands wait in `pending`
+// and are sent in order with the next ones.
+static void cpymo_audio_queue_send(
+	cpymo_audio_ring *r, cpymo_audio_command **pending, 
+	cpymo_audio_command_type type, size_t cid, cpymo_audio_voice *v, float volume)
+{
+	cpymo_audio_command cmd;
+	cmd.type = type;
+	cmd.cid = cid;
+	cmd.voice = v;
+	cmd.volume = volume;
+
+	cpymo_audio_queue_flush(r, pending);
+
+	if (arrlenu(*pending) == 0 && cpymo_audio_ring_writable(r) >= sizeof(cmd))
+		cpymo_audio_ring_write(r, &cmd, sizeof(cmd));
+	else
+		arrput(*pending, cmd);
+}
+
+static void cpymo_audio_send(
+	cpymo_audio_system *s, cpymo_audio_command_type type, 
+	size_t cid, cpymo_audio_voice *v, float volume)
+{
+	cpymo_audio_queue_send(&s->commands, &s->pending, type, cid, v, volume);
+}
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+// Decodes until the ring is full. Returns false if the stream ended or failed,
+// decode_done is set then. The decoder is closed when the voice is freed.
+static bool cpymo_audio_voice_fill(cpymo_audio_voice *v)
+{
+	while (true) {
+		size_t pending = v->converted_buf_size - v->converted_frame_current_offset;
+
+		if (pending == 0) {
+			if (cpymo_audio_voice_next_frame(v) != CPYMO_ERR_SUCC) {
+				cpymo_atomic_store(&v->decode_done, true);
+				return false;
+			}
+
+			continue;
 		}
-		else {
-			size_t write_size = src_size;
-			if (write_size > len) write_size = len;
 
-			cpymo_audio_mix_samples(dst, src, write_size, info->format, c->volume);
-			c->converted_frame_current_offset += write_size;
-			dst += write_size;
-			len -= write_size;
+		size_t written = cpymo_audio_ring_write(
+			&v->ring, v->converted_buf + v->converted_frame_current_offset, pending);
+		v->converted_frame_current_offset += written;
+
+		if (written < pending) return true;
+	}
+}
+
+// Decoder thread: the voice on cid is not touched again.
+static void cpymo_audio_decoder_drop(cpymo_audio_system *s, size_t cid)
+{
+	cpymo_audio_voice *v = s->decoding[cid];
+	if (v == NULL) return;
+
+	s->decoding[cid] = NULL;
+	cpymo_atomic_store(&v->decoder_released, true);
+}
+
+static void *cpymo_audio_decoder(void *userdata)
+{
+	cpymo_audio_system *s = (cpymo_audio_system *)userdata;
+
+	// Rings hold CPYMO_AUDIO_DECODE_AHEAD_MS, refill them well before they run dry.
+	const long period_ms = CPYMO_AUDIO_DECODE_AHEAD_MS / 4 > 0 ? CPYMO_AUDIO_DECODE_AHEAD_MS / 4 : 1;
+
+	while (true) {
+		cpymo_audio_command cmd;
+		while (cpymo_audio_queue_receive(&s->decoder_commands, &cmd)) {
+			cpymo_audio_decoder_drop(s, cmd.cid);
+			if (cmd.type == cpymo_audio_command_play)
+				s->decoding[cmd.cid] = cmd.voice;
+		}
+
+		for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i) {
+			cpymo_audio_voice *v = s->decoding[i];
+			if (v && !cpymo_audio_voice_fill(v)) cpymo_audio_decoder_drop(s, i);
+		}
+
+		struct timespec t;
+		clock_gettime(CLOCK_REALTIME, &t);
+		long ns = t.tv_nsec + period_ms * 1000000L;
+		t.tv_sec += ns / 1000000000L;
+		t.tv_nsec = ns % 1000000000L;
+
+		pthread_mutex_lock(&s->decoder_lock);
+		if (!s->decoder_woken && !s->decoder_quit)
+			pthread_cond_timedwait(&s->decoder_wake, &s->decoder_lock, &t);
+		s->decoder_woken = false;
+		bool quit = s->decoder_quit;
+		pthread_mutex_unlock(&s->decoder_lock);
+
+		if (quit) break;
+	}
+
+	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i)
+		cpymo_audio_decoder_drop(s, i);
+
+	return NULL;
+}
+
+static void cpymo_audio_decoder_wake(cpymo_audio_system *s)
+{
+	pthread_mutex_lock(&s->decoder_lock);
+	s->decoder_woken = true;
+	pthread_cond_signal(&s->decoder_wake);
+	pthread_mutex_unlock(&s->decoder_lock);
+}
+
+// Engine thread, does nothing if the callback decodes.
+static void cpymo_audio_decoder_send(
+	cpymo_audio_system *s, cpymo_audio_command_type type, size_t cid, cpymo_audio_voice *v)
+{
+	if (!s->decoder_started) return;
+
+	cpymo_audio_queue_send(&s->decoder_commands, &s->decoder_pending, type, cid, v, 0);
+	cpymo_audio_decoder_wake(s);
+}
+
+static void cpymo_audio_decoder_init(cpymo_audio_system *s)
+{
+	s->decoder_started = false;
+	s->decoder_quit = false;
+	s->decoder_woken = false;
+	s->decoder_pending = NULL;
+
+	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i)
+		s->decoding[i] = NULL;
+
+	pthread_mutex_init(&s->decoder_lock, NULL);
+	pthread_cond_init(&s->decoder_wake, NULL);
+
+	if (cpymo_audio_ring_init(
+		&s->decoder_commands, 
+		CPYMO_AUDIO_COMMAND_QUEUE_SIZE * sizeof(cpymo_audio_command)) == CPYMO_ERR_SUCC)
+	{
+		s->decoder_started = 
+			pthread_create(&s->decoder, NULL, &cpymo_audio_decoder, s) == 0;
+	}
+
+	if (!s->decoder_started)
+		printf("[Warning] Can not start audio decoder thread, decoding in the audio callback.\n");
+}
+
+static void cpymo_audio_decoder_free(cpymo_audio_system *s)
+{
+	if (s->decoder_started) {
+		pthread_mutex_lock(&s->decoder_lock);
+		s->decoder_quit = true;
+		pthread_cond_broadcast(&s->decoder_wake);
+		pthread_mutex_unlock(&s->decoder_lock);
+
+		pthread_join(s->decoder, NULL);
+		s->decoder_started = false;
+	}
+
+	cpymo_audio_ring_free(&s->decoder_commands);
+	arrfree(s->decoder_pending);
+
+	pthread_cond_destroy(&s->decoder_wake);
+	pthread_mutex_destroy(&s->decoder_lock);
+}
+#endif
+
+// Engine thread: a voice is freed once the audio thread handed it back
+// and the decoder thread let go of it.
+static bool cpymo_audio_voice_freeable(const cpymo_audio_system *s, cpymo_audio_voice *v)
+{
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	return !s->decoder_started || cpymo_atomic_load(&v->decoder_released);
+#else
+	return true;
+#endif
+}
+
+// Engine thread: frees the voices the audio thread handed back.
+static void cpymo_audio_collect(cpymo_audio_system *s)
+{
+	cpymo_audio_queue_flush(&s->commands, &s->pending);
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	if (s->decoder_started) 
+		cpymo_audio_queue_flush(&s->decoder_commands, &s->decoder_pending);
+#endif
+
+	for (size_t i = 0; i < arrlenu(s->retired);) {
+		if (cpymo_audio_voice_freeable(s, s->retired[i])) {
+			cpymo_audio_voice_free(s->retired[i]);
+			arrdelswap(s->retired, i);
+			s->live_voices--;
+		}
+		else i++;
+	}
+
+	while (true) {
+		size_t size;
+		const void *p = cpymo_audio_ring_peek(&s->released, &size);
+		if (size < sizeof(cpymo_audio_voice *)) break;
+
+		cpymo_audio_voice *v;
+		memcpy(&v, p, sizeof(v));
+		cpymo_audio_ring_consume(&s->released, sizeof(v));
+
+		for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i)
+			if (s->voices[i] == v) s->voices[i] = NULL;
+
+		if (cpymo_audio_voice_freeable(s, v)) {
+			cpymo_audio_voice_free(v);
+			s->live_voices--;
 		}
+		else arrput(s->retired, v);
 	}
+}
+
+static void cpymo_audio_stop(cpymo_audio_system *s, size_t cid)
+{
+	if (!cpymo_atomic_load_relaxed(&s->enabled)) return;
+
+	cpymo_audio_collect(s);
+	if (s->voices[cid] == NULL) return;
+
+	s->voices[cid] = NULL;
+	cpymo_audio_send(s, cpymo_audio_command_stop, cid, NULL, 0);
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_decoder_send(s, cpymo_audio_command_stop, cid, NULL);
+#endif
+}
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+// Returns false once the voice is played to the end.
+static bool cpymo_audio_voice_mix_samples(
+	cpymo_audio_mix_acc *acc, size_t samples,
+	cpymo_backend_audio_format fmt, cpymo_audio_voice *v, float volume,
+	const cpymo_audio_system *s)
+{
+	const size_t sample_size = cpymo_audio_mix_sample_size(fmt);
+	const int32_t target = cpymo_audio_mix_gain(volume);
+	size_t offset = 0;
+
+	while (offset < samples) {
+		// Read before the ring, so the ring is drained if it is set.
+		bool decode_done = cpymo_atomic_load(&v->decode_done);
+
+		size_t src_size;
+		const void *src = cpymo_audio_ring_peek(&v->ring, &src_size);
+		size_t src_samples = src_size / sample_size;
+
+		if (src_samples == 0) {
+			if (decode_done) return false;
+
+			if (!s->decoder_started) {
+				cpymo_audio_voice_fill(v);
+				continue;
+			}
+
+			// Underrun, the rest of the block stays silent.
+			return true;
+		}
+
+		if (src_samples > samples - offset) src_samples = samples - offset;
+
+		cpymo_audio_mix_add(acc, offset, src, src_samples, fmt, &v->mix_gain, target);
+		cpymo_audio_ring_consume(&v->ring, src_samples * sample_size);
+		offset += src_samples;
+	}
+
+	return true;
+}
+#else
+// Returns false once the voice is played to the end.
+static bool cpymo_audio_voice_mix_samples(
+	cpymo_audio_mix_acc *acc, size_t samples,
+	cpymo_backend_audio_format fmt, cpymo_audio_voice *v, float volume,
+	const cpymo_audio_system *s)
+{
+	const size_t sample_size = cpymo_audio_mix_sample_size(fmt);
+	const int32_t target = cpymo_audio_mix_gain(volume);
+	size_t offset = 0;
+
+	while (offset < samples) {
+		const uint8_t *src = v->converted_buf + v->converted_frame_current_offset;
+		size_t src_samples = 
+			(v->converted_buf_size - v->converted_frame_current_offset) / sample_size;
+
+		if (src_samples == 0) {
+			if (cpymo_audio_voice_next_frame(v) != CPYMO_ERR_SUCC) return false;
+			continue;
+		}
 
-	return;
+		if (src_samples > samples - offset) src_samples = samples - offset;
 
-FILL_BLANK_AND_RESET:
-	cpymo_audio_channel_reset_unsafe(c);
-	return;
+		cpymo_audio_mix_add(acc, offset, src, src_samples, fmt, &v->mix_gain, target);
+		v->converted_frame_current_offset += src_samples * sample_size;
+		offset += src_samples;
+	}
+
+	return true;
 }
+#endif
 
 int cpymo_audio_packaged_audio_ffmpeg_read_packet(void *opaque, uint8_t *buf, int buf_size)
 {
@@ -308,62 +598,42 @@ int64_t cpymo_audio_packaged_audio_ffmpeg_seek(void *opaque, int64_t offset, int
 	};
 }
 
-static error_t cpymo_audio_channel_play_file(
-	cpymo_audio_channel *c, 
-	const char * filename, const cpymo_package_stream_reader *package_reader, 
-	bool loop)
+static error_t cpymo_audio_voice_open(
+	cpymo_audio_voice *v,
+	const char *filename, const cpymo_package_stream_reader *package_reader,
+	const cpymo_backend_audio_info *info)
 {
-	const cpymo_backend_audio_info *info = 
-		cpymo_backend_audio_get_info();
-	if (info == NULL) return CPYMO_ERR_SUCC;
-
-	if (filename) { assert(package_reader == NULL); }
-	if (package_reader) { assert(filename == NULL); }
-	assert(!(filename == NULL && package_reader == NULL));
-
-	cpymo_audio_channel_reset(c);
-	// everything safe now.
-
-	assert(c->enabled == false);
-	
-	assert(c->io_context == NULL);
-
-	assert(c->format_context == NULL);
-
 	if (package_reader) {
-		c->package_reader = *package_reader;
+		v->package_reader = *package_reader;
 
 		const size_t avio_buf_size = 1024 * 1024;
 		void *io_buffer = av_malloc(avio_buf_size);
 		if (io_buffer == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
 			return CPYMO_ERR_OUT_OF_MEM;
 		}
 
-		c->io_context = avio_alloc_context(
-			(unsigned char *)io_buffer, (int)avio_buf_size, 0, &c->package_reader,
+		v->io_context = avio_alloc_context(
+			(unsigned char *)io_buffer, (int)avio_buf_size, 0, &v->package_reader,
 			&cpymo_audio_packaged_audio_ffmpeg_read_packet,
 			NULL,
 			&cpymo_audio_packaged_audio_ffmpeg_seek);
 
-		if (c->io_context == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
+		if (v->io_context == NULL) {
 			printf("[Error] avio_alloc_context failed.\n");
 			return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 		}
 
-		c->format_context = avformat_alloc_context();
-		if (c->format_context == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
+		v->format_context = avformat_alloc_context();
+		if (v->format_context == NULL) {
 			return CPYMO_ERR_OUT_OF_MEM;
 		}
 
-		c->format_context->pb = c->io_context;
-		c->format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+		v->format_context->pb = v->io_context;
+		v->format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
 	}
 
 	int result = 
-		avformat_open_input(&c->format_context, filename == NULL ? "" : filename, NULL, NULL);
+		avformat_open_input(&v->format_context, filename == NULL ? "" : filename, NULL, NULL);
 
 	if (filename == NULL) filename = "package stream reader";
 
@@ -372,52 +642,46 @@ static error_t cpymo_audio_channel_play_file(
 			filename,
 			av_err2str(result));
 
-		cpymo_audio_channel_reset_unsafe(c);
 		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 	}
 
-	result = avformat_find_stream_info(c->format_context, NULL);
+	result = avformat_find_stream_info(v->format_context, NULL);
 	if (result != 0) {
-		cpymo_audio_channel_reset_unsafe(c);
 		printf("[Error] Can not get stream info from %s.\n", filename);
 		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
 
 	
-	c->stream_id = av_find_best_stream(
-		c->format_context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+	v->stream_id = av_find_best_stream(
+		v->format_context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
 	if (result != 0) {
-		cpymo_audio_channel_reset_unsafe(c);
 		printf("[Error] Can not find best stream from %s.\n", filename);
 		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
 
-	AVStream *stream = c->format_context->streams[c->stream_id];
+	AVStream *stream = v->format_context->streams[v->stream_id];
 	const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
 	if (codec == NULL) {
-		cpymo_audio_channel_reset_unsafe(c);
 		printf("[Error] Can not find codec.\n");
 		return CPYMO_ERR_NOT_FOUND;
 	}
-	assert(c->codec_context == NULL);
-	c->codec_context = avcodec_alloc_context3(codec);
-	avcodec_parameters_to_context(c->codec_context, stream->codecpar);
-	c->codec_context->pkt_timebase = stream->time_base;
-	if (c->codec_context == NULL) {
-		cpymo_audio_channel_reset_unsafe(c);
+	assert(v->codec_context == NULL);
+	v->codec_context = avcodec_alloc_context3(codec);
+	avcodec_parameters_to_context(v->codec_context, stream->codecpar);
+	v->codec_context->pkt_timebase = stream->time_base;
+	if (v->codec_context == NULL) {
 		return CPYMO_ERR_UNKNOWN;
 	}
 
-	result = avcodec_open2(c->codec_context, codec, NULL);
+	result = avcodec_open2(v->codec_context, codec, NULL);
 	if (result != 0) {
-		c->codec_context = NULL;
-		cpymo_audio_channel_reset_unsafe(c);
+		v->codec_context = NULL;
 		return CPYMO_ERR_UNSUPPORTED;
 	}
 
-	assert(c->swr_context == NULL);
+	assert(v->swr_context == NULL);
 #if LIBAVUTIL_VERSION_MAJOR < 57
-	c->swr_context = swr_alloc_set_opts(
+	v->swr_context = swr_alloc_set_opts(
 		NULL,
 		av_get_default_channel_layout((int)info->channels),
 		cpymo_audio_fmt2ffmpeg(info->format),
@@ -434,7 +698,7 @@ static error_t cpymo_audio_channel_play_file(
 	AVChannelLayout ch_layout;
 	av_channel_layout_default(&ch_layout, info->channels);
 	swr_alloc_set_opts2(
-		&c->swr_context,
+		&v->swr_context,
 		&ch_layout,
 		cpymo_audio_fmt2ffmpeg(info->format),
 		(int)info->freq,
@@ -443,136 +707,313 @@ static error_t cpymo_audio_channel_play_file(
 		stream->codecpar->sample_rate,
 		0, NULL);
 #endif
-	if (c->swr_context == NULL) {
-		cpymo_audio_channel_reset_unsafe(c);
+	if (v->swr_context == NULL) {
 		return CPYMO_ERR_UNKNOWN;
 	}
 
-	result = swr_init(c->swr_context);
+	result = swr_init(v->swr_context);
 	if (result < 0) {
-		cpymo_audio_channel_reset_unsafe(c);
 		return CPYMO_ERR_UNKNOWN;
 	}
 
-	if (c->packet == NULL) {
-		c->packet = av_packet_alloc();
-		if (c->packet == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
-			return CPYMO_ERR_OUT_OF_MEM;
+	v->packet = av_packet_alloc();
+	if (v->packet == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	v->frame = av_frame_alloc();
+	if (v->frame == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_audio_play_file(
+	cpymo_audio_system *s, size_t cid,
+	const char * filename, const cpymo_package_stream_reader *package_reader, 
+	bool loop)
+{
+	const cpymo_backend_audio_info *info = 
+		cpymo_backend_audio_get_info();
+	if (info == NULL || !cpymo_atomic_load_relaxed(&s->enabled)) return CPYMO_ERR_SUCC;
+
+	if (filename) { assert(package_reader == NULL); }
+	if (package_reader) { assert(filename == NULL); }
+	assert(!(filename == NULL && package_reader == NULL));
+
+	cpymo_audio_stop(s, cid);
+
+	// The audio thread hands voices back within a buffer,
+	// so this is only reached while it does not run.
+	if (s->live_voices >= CPYMO_AUDIO_MAX_VOICES) {
+		printf("[Warning] Audio thread is not running, sound skipped.\n");
+		if (package_reader) {
+			cpymo_package_stream_reader r = *package_reader;
+			cpymo_package_stream_reader_close(&r);
 		}
+		return CPYMO_ERR_SUCC;
 	}
 
-	if (c->frame == NULL) {
-		c->frame = av_frame_alloc();
-		if (c->frame == NULL) {
-			cpymo_audio_channel_reset_unsafe(c);
-			return CPYMO_ERR_OUT_OF_MEM;
-		}
+	cpymo_audio_voice *v = (cpymo_audio_voice *)calloc(1, sizeof(cpymo_audio_voice));
+	if (v == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	const size_t frames = info->freq * CPYMO_AUDIO_DECODE_AHEAD_MS / 1000 + 1;
+	error_t err = cpymo_audio_ring_init(
+		&v->ring, frames * info->channels * cpymo_audio_mix_sample_size(info->format));
+	if (err != CPYMO_ERR_SUCC) {
+		free(v);
+		return err;
 	}
 
-	c->loop = loop;
-	c->converted_frame_current_offset = 0;
+	v->ring_lent = 0;
+	cpymo_atomic_init(&v->decode_done, false);
+	cpymo_atomic_init(&v->decoder_released, !s->decoder_started);
 
+	err = cpymo_audio_voice_open(v, filename, package_reader, info);
+#else
+	error_t err = cpymo_audio_voice_open(v, filename, package_reader, info);
+#endif
+
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_audio_voice_free(v);
+		return err;
+	}
+
+	v->loop = loop;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	// The decoder thread decodes ahead as soon as it gets the voice,
+	// the audio thread plays silence until then.
+	if (!s->decoder_started) {
+		cpymo_audio_voice_fill(v);
+		if (cpymo_audio_ring_readable(&v->ring) == 0) {
+			cpymo_audio_voice_free(v);
+			return CPYMO_ERR_SUCC;
+		}
+	}
+#else
 	// read first frame
-	if (cpymo_audio_channel_next_frame(c) != CPYMO_ERR_SUCC) {
-		cpymo_audio_channel_reset_unsafe(c);
+	if (cpymo_audio_voice_next_frame(v) != CPYMO_ERR_SUCC) {
+		cpymo_audio_voice_free(v);
 		return CPYMO_ERR_SUCC;
 	}
+#endif
 
-	cpymo_backend_audio_lock();
-	c->enabled = true;
-	cpymo_backend_audio_unlock();
+	s->live_voices++;
+	s->voices[cid] = v;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_decoder_send(s, cpymo_audio_command_play, cid, v);
+#endif
+	cpymo_audio_send(s, cpymo_audio_command_play, cid, v, 0);
 	return CPYMO_ERR_SUCC;
 }
 
 void cpymo_audio_init(cpymo_audio_system *s)
 {
-	s->enabled = cpymo_backend_audio_get_info() != NULL;
+	cpymo_atomic_store(&s->enabled, false);
 
 	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i) {
-		cpymo_audio_channel_init(s->channels + i);
-		s->channels[i].packet = NULL;
-		s->channels[i].frame = NULL;
-		s->channels[i].converted_buf = NULL;
-		s->channels[i].converted_buf_all_size = 0;
-		s->channels[i].volume = 0;
+		s->voices[i] = NULL;
+		s->volumes[i] = 0;
+		s->playing[i] = NULL;
+		s->playing_volumes[i] = 0;
 	}
 
+	s->live_voices = 0;
+	s->pending = NULL;
+	s->retired = NULL;
+	s->commands.buf = NULL;
+	s->released.buf = NULL;
+
 	s->bgm_name = NULL;
 	s->se_name = NULL;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	s->decoder_started = false;
+#endif
+
+	if (cpymo_backend_audio_get_info() == NULL) return;
+
+	if (cpymo_audio_ring_init(
+			&s->commands, 
+			CPYMO_AUDIO_COMMAND_QUEUE_SIZE * sizeof(cpymo_audio_command)) != CPYMO_ERR_SUCC
+		|| cpymo_audio_ring_init(
+			&s->released, 
+			CPYMO_AUDIO_MAX_VOICES * sizeof(cpymo_audio_voice *)) != CPYMO_ERR_SUCC) 
+	{
+		printf("[Warning] Can not allocate audio queues, audio disabled.\n");
+		cpymo_audio_ring_free(&s->commands);
+		cpymo_audio_ring_free(&s->released);
+		return;
+	}
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_decoder_init(s);
+#endif
+
+	// The audio callback may already be running,
+	// it sees the queues set up once it sees enabled.
+	cpymo_atomic_store(&s->enabled, true);
 }
 
 void cpymo_audio_free(cpymo_audio_system *s)
 {
-	if (s->enabled == false) return;
+	if (cpymo_atomic_load_relaxed(&s->enabled) == false) return;
+
+	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i)
+		s->voices[i] = NULL;
 
+	// The only time the audio thread is waited for: take every voice back.
 	cpymo_backend_audio_lock();
 
-	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i) {
-		s->channels[i].enabled = false;
-		cpymo_audio_channel_reset_unsafe(s->channels + i);
+	cpymo_audio_receive_commands(s);
+	for (size_t i = 0; i < arrlenu(s->pending); ++i)
+		cpymo_audio_apply_command(s, &s->pending[i]);
+	arrfree(s->pending);
 
-		if (s->channels[i].packet) av_packet_free(&s->channels[i].packet);
-		if (s->channels[i].frame) av_frame_free(&s->channels[i].frame);
-		if (s->channels[i].converted_buf) free(s->channels[i].converted_buf);
-	}
+	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i)
+		cpymo_audio_release(s, i);
 
+	cpymo_atomic_store(&s->enabled, false);
 	cpymo_backend_audio_unlock();
 
-	s->enabled = false;
+	// With the decoder thread stopped, every voice can be freed.
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_decoder_free(s);
+#endif
+
+	cpymo_audio_collect(s);
+	assert(s->live_voices == 0);
+	arrfree(s->retired);
+
+	cpymo_audio_ring_free(&s->commands);
+	cpymo_audio_ring_free(&s->released);
 
 	if (s->bgm_name) free(s->bgm_name);
 	if (s->se_name) free(s->se_name);
 }
 
+#ifdef ENABLE_AUDIO_DECODER_THREAD
 bool cpymo_audio_channel_get_samples(void **samples, size_t *len, size_t cid, cpymo_audio_system *s)
-{ RETRY: {
-	if (!s->enabled) return false;
+{
+	if (!cpymo_atomic_load(&s->enabled)) return false;
+
+	// The samples handed out last time are copied by now.
+	cpymo_audio_voice *v = s->playing[cid];
+	if (v) {
+		cpymo_audio_ring_consume(&v->ring, v->ring_lent);
+		v->ring_lent = 0;
+	}
 
-	cpymo_audio_channel *c = &s->channels[cid];
-	if (!c->enabled) return false;
+	cpymo_audio_receive_commands(s);
 
-	size_t writeable_size = c->converted_buf_size - c->converted_frame_current_offset;
+	v = s->playing[cid];
+	if (v == NULL) return false;
 
-	if (writeable_size == 0) {
-		error_t err = cpymo_audio_channel_next_frame(c);
-		if (err == CPYMO_ERR_SUCC) goto RETRY;
-		else {
-			cpymo_audio_channel_reset_unsafe(c);
+	while (true) {
+		bool decode_done = cpymo_atomic_load(&v->decode_done);
+
+		size_t readable;
+		const void *src = cpymo_audio_ring_peek(&v->ring, &readable);
+
+		if (readable > 0) {
+			*samples = (void *)src;
+
+			if (readable > *len) readable = *len;
+			*len = readable;
+			v->ring_lent = readable;
+
+			return true;
+		}
+
+		if (decode_done) {
+			cpymo_audio_release(s, cid);
+		}
+		else if (!s->decoder_started) {
+			cpymo_audio_voice_fill(v);
+			continue;
+		}
+
+		return false;
+	}
+}
+#else
+bool cpymo_audio_channel_get_samples(void **samples, size_t *len, size_t cid, cpymo_audio_system *s)
+{
+	if (!cpymo_atomic_load(&s->enabled)) return false;
+
+	cpymo_audio_receive_commands(s);
+
+	cpymo_audio_voice *v = s->playing[cid];
+	if (v == NULL) return false;
+
+	size_t writeable_size = v->converted_buf_size - v->converted_frame_current_offset;
+
+	while (writeable_size == 0) {
+		if (cpymo_audio_voice_next_frame(v) != CPYMO_ERR_SUCC) {
+			cpymo_audio_release(s, cid);
 			return false;
 		}
+
+		writeable_size = v->converted_buf_size - v->converted_frame_current_offset;
 	}
 
-	*samples = c->converted_buf + c->converted_frame_current_offset;
+	*samples = v->converted_buf + v->converted_frame_current_offset;
 
 	if (writeable_size > *len) writeable_size = *len;
 	*len = writeable_size;
-	c->converted_frame_current_offset += writeable_size;
+	v->converted_frame_current_offset += writeable_size;
 
 	return true;
-} }
+}
+#endif
 
 void cpymo_audio_copy_mixed_samples(void * dst, size_t len, cpymo_audio_system *s)
 {
-	if (s->enabled == false) return;
+	if (cpymo_atomic_load(&s->enabled) == false) {
+		memset(dst, 0, len);
+		return;
+	}
 
-	memset(dst, 0, len);
+	cpymo_audio_receive_commands(s);
 
-	for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i) {
-		if (s->channels[i].enabled) {
-			cpymo_audio_channel_mix_samples((uint8_t *)dst, len, s->channels + i);
+	const cpymo_backend_audio_info *info = cpymo_backend_audio_get_info();
+	const cpymo_backend_audio_format fmt = info->format;
+	const size_t sample_size = cpymo_audio_mix_sample_size(fmt);
+	size_t samples = len / sample_size;
+	uint8_t *out = (uint8_t *)dst;
+
+	memset(out + samples * sample_size, 0, len % sample_size);
+
+	// Whole frames per block, so a voice that runs dry
+	// keeps its speakers when it continues in the next block.
+	const size_t max_block = CPYMO_AUDIO_MIX_BLOCK - CPYMO_AUDIO_MIX_BLOCK % info->channels;
+
+	cpymo_audio_mix_acc acc;
+	while (samples > 0) {
+		size_t block = samples < max_block ? samples : max_block;
+		cpymo_audio_mix_clear(&acc, block);
+
+		for (size_t i = 0; i < CPYMO_AUDIO_MAX_CHANNELS; ++i) {
+			cpymo_audio_voice *v = s->playing[i];
+			if (v && !cpymo_audio_voice_mix_samples(
+				&acc, block, fmt, v, s->playing_volumes[i], s))
+				cpymo_audio_release(s, i);
 		}
+
+		cpymo_audio_mix_pack(out, &acc, block, fmt);
+		out += block * sample_size;
+		samples -= block;
 	}
 }
 
 bool cpymo_audio_enabled(cpymo_engine * e)
 {
-	return e->audio.enabled;
+	return cpymo_atomic_load_relaxed(&e->audio.enabled);
 }
 
 bool cpymo_audio_wait_se(struct cpymo_engine *e, float d)
 {
-	if (e->audio.channels[CPYMO_AUDIO_CHANNEL_SE].loop) {
+	if (cpymo_audio_channel_is_looping(CPYMO_AUDIO_CHANNEL_SE, &e->audio)) {
 		printf("[Error] Can not wait a looping SE.\n");
 		return true;
 	}
@@ -581,7 +1022,7 @@ bool cpymo_audio_wait_se(struct cpymo_engine *e, float d)
 		return true;
 	}
 
-	return !e->audio.channels[CPYMO_AUDIO_CHANNEL_SE].enabled;
+	return !cpymo_audio_channel_is_playing(CPYMO_AUDIO_CHANNEL_SE, &e->audio);
 }
 
 static error_t cpymo_audio_high_level_play_file_on_filesystem(
@@ -595,8 +1036,8 @@ static error_t cpymo_audio_high_level_play_file_on_filesystem(
 		error_t err = cpymo_package_stream_reader_from_file(&r, path);
 		CPYMO_THROW(err);
 		
-		err = cpymo_audio_channel_play_file(
-			&e->audio.channels[channel],
+		err = cpymo_audio_play_file(
+			&e->audio, (size_t)channel,
 			NULL,
 			&r,
 			loop);
@@ -608,8 +1049,8 @@ static error_t cpymo_audio_high_level_play_file_on_filesystem(
 
 		return CPYMO_ERR_SUCC;
 	#else
-		return cpymo_audio_channel_play_file(
-			&e->audio.channels[channel],
+		return cpymo_audio_play_file(
+			&e->audio, (size_t)channel,
 			path,
 			NULL,
 			loop);
@@ -619,20 +1060,23 @@ static error_t cpymo_audio_high_level_play_file_on_filesystem(
 static error_t cpymo_audio_high_level_play(
 	cpymo_engine *e,
 	cpymo_str filename,
-	error_t(*get_path)(char **, cpymo_str, const cpymo_assetloader *),
-	const cpymo_package *package,
+	const char *asset_type,
+	const char *asset_ext,
 	int channel,
 	bool loop)
 {
-	if (e->audio.enabled) {
-		if (package) {
-			cpymo_package_stream_reader r;
-			error_t err = cpymo_package_stream_reader_find_create(
-				&r, package, filename);
-			CPYMO_THROW(err);
+	if (cpymo_atomic_load_relaxed(&e->audio.enabled)) {
+		cpymo_vfs_file f;
+		error_t err = cpymo_vfs_find(
+			&f, &e->assetloader.vfs, asset_type, filename, asset_ext);
+		CPYMO_THROW(err);
 
-			err = cpymo_audio_channel_play_file(
-				&e->audio.channels[channel],
+		if (f.package) {
+			cpymo_package_stream_reader r = 
+				cpymo_package_stream_reader_create(f.package, &f.index);
+
+			err = cpymo_audio_play_file(
+				&e->audio, (size_t)channel,
 				NULL,
 				&r,
 				loop);
@@ -642,14 +1086,8 @@ static error_t cpymo_audio_high_level_play(
 			}
 		}
 		else {
-			char *path = NULL;
-			error_t err = get_path(&path, filename, &e->assetloader);
-			CPYMO_THROW(err);
-
-			err = cpymo_audio_high_level_play_file_on_filesystem(
-				e, path, channel, loop);
-			free(path);
-			return err;
+			return cpymo_audio_high_level_play_file_on_filesystem(
+				e, f.path, channel, loop);
 		}
 	}
 
@@ -658,12 +1096,14 @@ static error_t cpymo_audio_high_level_play(
 
 float cpymo_audio_get_channel_volume(size_t cid, const cpymo_audio_system *s)
 {
-	return s->channels[cid].volume;
+	return s->volumes[cid];
 }
 
 void cpymo_audio_set_channel_volume(size_t cid, cpymo_audio_system *s, float vol)
 {
-	s->channels[cid].volume = vol;
+	s->volumes[cid] = vol;
+	if (cpymo_atomic_load_relaxed(&s->enabled))
+		cpymo_audio_send(s, cpymo_audio_command_volume, cid, NULL, vol);
 }
 
 error_t cpymo_audio_bgm_play(cpymo_engine *e, cpymo_str bgmname, bool loop)
@@ -682,8 +1122,8 @@ error_t cpymo_audio_bgm_play(cpymo_engine *e, cpymo_str bgmname, bool loop)
 	}
 
 	return cpymo_audio_high_level_play(
-		e, bgmname, &cpymo_assetloader_get_bgm_path, 
-		NULL, CPYMO_AUDIO_CHANNEL_BGM, loop);
+		e, bgmname, "bgm", e->gameconfig.bgmformat,
+		CPYMO_AUDIO_CHANNEL_BGM, loop);
 }
 
 void cpymo_audio_bgm_stop(cpymo_engine * engine)
@@ -693,10 +1133,7 @@ void cpymo_audio_bgm_stop(cpymo_engine * engine)
 		engine->audio.bgm_name = NULL;
 	}
 
-	if (engine->audio.enabled) {
-		cpymo_audio_channel_reset(
-			&engine->audio.channels[CPYMO_AUDIO_CHANNEL_BGM]);
-	}
+	cpymo_audio_stop(&engine->audio, CPYMO_AUDIO_CHANNEL_BGM);
 }
 
 error_t cpymo_audio_se_play(cpymo_engine * e, cpymo_str sename, bool loop)
@@ -715,8 +1152,7 @@ error_t cpymo_audio_se_play(cpymo_engine * e, cpymo_str sename, bool loop)
 	}
 
 	return cpymo_audio_high_level_play(
-		e, sename, &cpymo_assetloader_get_se_path,
-		e->assetloader.use_pkg_se ? &e->assetloader.pkg_se : NULL,
+		e, sename, "se", e->gameconfig.seformat,
 		CPYMO_AUDIO_CHANNEL_SE, loop);
 }
 
@@ -727,23 +1163,19 @@ void cpymo_audio_se_stop(cpymo_engine *e)
 		e->audio.se_name = NULL;
 	}
 
-	if (e->audio.enabled) {
-		cpymo_audio_channel_reset(
-			&e->audio.channels[CPYMO_AUDIO_CHANNEL_SE]);
-	}
+	cpymo_audio_stop(&e->audio, CPYMO_AUDIO_CHANNEL_SE);
 }
 
 error_t cpymo_audio_vo_play(cpymo_engine * e, cpymo_str voname)
 {
 	return cpymo_audio_high_level_play(
-		e, voname, &cpymo_assetloader_get_vo_path,
-		e->assetloader.use_pkg_voice ? &e->assetloader.pkg_voice : NULL,
+		e, voname, "voice", e->gameconfig.voiceformat,
 		CPYMO_AUDIO_CHANNEL_VO, false);
 }
 
 void cpymo_audio_vo_stop(cpymo_engine * e)
 {
-	cpymo_audio_channel_reset(e->audio.channels + CPYMO_AUDIO_CHANNEL_VO);
+	cpymo_audio_stop(&e->audio, CPYMO_AUDIO_CHANNEL_VO);
 }
 
 error_t cpymo_audio_play_video(cpymo_engine * e, const char * path)
@@ -763,10 +1195,15 @@ const char * cpymo_audio_get_se_name(cpymo_engine * e)
 }
 
 bool cpymo_audio_channel_is_playing(size_t cid, cpymo_audio_system *s)
-{ return s->channels[cid].enabled; }
+{
+	if (!cpymo_atomic_load_relaxed(&s->enabled)) return false;
+
+	cpymo_audio_collect(s);
+	return s->voices[cid] != NULL;
+}
 
 bool cpymo_audio_channel_is_looping(size_t cid, cpymo_audio_system *s)
-{ return s->channels[cid].loop; }
+{ return cpymo_audio_channel_is_playing(cid, s) && s->voices[cid]->loop; }
 
 #endif
 
@@ -6,6 +6,7 @@
 
 #include "cpymo_package.h"
 #include "cpymo_error.h"
+#include "cpymo_audio_ring.h"
 
 #define CPYMO_AUDIO_MAX_CHANNELS 3
 #define CPYMO_AUDIO_CHANNEL_BGM 0
@@ -26,6 +27,32 @@ typedef struct {
 
 #if (!defined DISABLE_FFMPEG_AUDIO)
 
+// With ENABLE_AUDIO_DECODER_THREAD, a decoder thread keeps
+// CPYMO_AUDIO_DECODE_AHEAD_MS of decoded samples in each voice's ring
+// and the audio callback only mixes what is in the rings.
+// Otherwise, or if the thread can not be started, the callback decodes.
+#if defined(ENABLE_AUDIO_DECODER_THREAD) && defined(__EMSCRIPTEN__)
+#undef ENABLE_AUDIO_DECODER_THREAD
+#endif
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+#include <pthread.h>
+
+#ifndef CPYMO_AUDIO_DECODE_AHEAD_MS
+#define CPYMO_AUDIO_DECODE_AHEAD_MS 200
+#endif
+#endif
+
+// Voices the audio thread has not handed back yet,
+// more plays are skipped until it does.
+#ifndef CPYMO_AUDIO_MAX_VOICES
+#define CPYMO_AUDIO_MAX_VOICES 32
+#endif
+
+#ifndef CPYMO_AUDIO_COMMAND_QUEUE_SIZE
+#define CPYMO_AUDIO_COMMAND_QUEUE_SIZE 64
+#endif
+
 #ifdef __CXX
 extern "C" {
 #endif
@@ -38,10 +65,15 @@ extern "C" {
 }
 #endif
 
+// One played file. The engine opens a voice for each play and sends it
+// to the audio thread, which hands it back once it is stopped or played
+// to the end. Only the engine thread opens and frees voices,
+// so the audio thread never waits for FFmpeg teardown.
 typedef struct {
-	bool enabled, loop;
+	bool loop;
 
-	float volume;
+	// Q15 gain ramping towards the channel volume, see cpymo_audio_mix.h.
+	int32_t mix_gain;
 	
 	AVFormatContext *format_context;
 	AVCodecContext *codec_context;
@@ -58,11 +90,76 @@ typedef struct {
 	cpymo_package_stream_reader package_reader;
 
 	int stream_id;
-} cpymo_audio_channel;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	cpymo_audio_ring ring;
+
+	// Bytes handed out by cpymo_audio_channel_get_samples,
+	// consumed on its next call.
+	size_t ring_lent;
+
+	// Set by the decoder after the last samples are in the ring.
+	cpymo_atomic_bool decode_done;
+
+	// Set by the decoder thread once it does not touch the voice any more.
+	cpymo_atomic_bool decoder_released;
+#endif
+} cpymo_audio_voice;
+
+typedef enum {
+	cpymo_audio_command_play,
+	cpymo_audio_command_stop,
+	cpymo_audio_command_volume,
+} cpymo_audio_command_type;
+
+typedef struct {
+	cpymo_audio_command_type type;
+	size_t cid;
+	cpymo_audio_voice *voice;
+	float volume;
+} cpymo_audio_command;
 
 typedef struct {
-	bool enabled;
-	cpymo_audio_channel channels[CPYMO_AUDIO_MAX_CHANNELS];
+	// Only written by the engine thread, read by the audio callback.
+	cpymo_atomic_bool enabled;
+
+	// Engine thread. voices[] is what the engine played last on each channel,
+	// NULL once it is stopped or known to have ended.
+	cpymo_audio_voice *voices[CPYMO_AUDIO_MAX_CHANNELS];
+	float volumes[CPYMO_AUDIO_MAX_CHANNELS];
+	size_t live_voices;
+
+	// stb_ds array of commands that did not fit into the queue yet.
+	cpymo_audio_command *pending;
+
+	// stb_ds array of voices handed back by the audio thread
+	// that the decoder thread still has to let go of.
+	cpymo_audio_voice **retired;
+
+	// Audio thread.
+	cpymo_audio_voice *playing[CPYMO_AUDIO_MAX_CHANNELS];
+	float playing_volumes[CPYMO_AUDIO_MAX_CHANNELS];
+
+	// Commands from the engine, drained by the audio thread before each buffer,
+	// and voices the audio thread is done with, freed by the engine.
+	cpymo_audio_ring commands, released;
+
+#ifdef ENABLE_AUDIO_DECODER_THREAD
+	bool decoder_started;
+
+	// Play and stop commands for the decoder thread, like `commands`.
+	cpymo_audio_ring decoder_commands;
+	cpymo_audio_command *decoder_pending;
+
+	// Decoder thread.
+	cpymo_audio_voice *decoding[CPYMO_AUDIO_MAX_CHANNELS];
+
+	// Only guards decoder_woken and decoder_quit, never held while decoding.
+	pthread_mutex_t decoder_lock;
+	pthread_cond_t decoder_wake;
+	bool decoder_woken, decoder_quit;
+	pthread_t decoder;
+#endif
 
 	char *bgm_name, *se_name;
 } cpymo_audio_system;
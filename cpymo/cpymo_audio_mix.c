@@ -0,0 +1,238 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_audio_mix.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPYMO_AUDIO_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define CPYMO_AUDIO_MIX_NEON
+#include <arm_neon.h>
+#endif
+
+size_t cpymo_audio_mix_sample_size(cpymo_backend_audio_format fmt)
+{
+	switch (fmt) {
+	case cpymo_backend_audio_s16: return sizeof(int16_t);
+	case cpymo_backend_audio_s32: return sizeof(int32_t);
+	case cpymo_backend_audio_f32: return sizeof(float);
+	}
+
+	assert(false);
+	return sizeof(float);
+}
+
+int32_t cpymo_audio_mix_gain(float volume)
+{
+	if (!(volume > 0)) return 0;
+	if (volume >= 1) return CPYMO_AUDIO_MIX_UNITY;
+	return (int32_t)(volume * CPYMO_AUDIO_MIX_UNITY + 0.5f);
+}
+
+void cpymo_audio_mix_clear(cpymo_audio_mix_acc *acc, size_t samples)
+{
+	assert(samples <= CPYMO_AUDIO_MIX_BLOCK);
+	memset(acc->i, 0, samples * sizeof(acc->i[0]));
+}
+
+static inline int32_t cpymo_audio_mix_ramp(int32_t gain, int32_t target)
+{
+	if (gain < target)
+		return target - gain > CPYMO_AUDIO_MIX_RAMP_STEP ? gain + CPYMO_AUDIO_MIX_RAMP_STEP : target;
+	else
+		return gain - target > CPYMO_AUDIO_MIX_RAMP_STEP ? gain - CPYMO_AUDIO_MIX_RAMP_STEP : target;
+}
+
+static void cpymo_audio_mix_add_s16(
+	int32_t *acc, const int16_t *src, size_t n, int32_t *p_gain, int32_t target)
+{
+	int32_t gain = *p_gain;
+	size_t i = 0;
+
+	for (; i < n && gain != target; ++i) {
+		gain = cpymo_audio_mix_ramp(gain, target);
+		acc[i] += (src[i] * gain) >> 15;
+	}
+
+	*p_gain = gain;
+	if (gain == 0) return;
+
+#if defined CPYMO_AUDIO_MIX_SSE2
+	if (gain == CPYMO_AUDIO_MIX_UNITY) {
+		for (; i + 8 <= n; i += 8) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+			__m128i *a = (__m128i *)(acc + i);
+			_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), lo));
+			_mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), hi));
+		}
+	}
+	else {
+		const __m128i g = _mm_set1_epi16((int16_t)gain);
+		for (; i + 8 <= n; i += 8) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i pl = _mm_mullo_epi16(s, g), ph = _mm_mulhi_epi16(s, g);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(pl, ph), 15);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(pl, ph), 15);
+			__m128i *a = (__m128i *)(acc + i);
+			_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), lo));
+			_mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), hi));
+		}
+	}
+#elif defined CPYMO_AUDIO_MIX_NEON
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t s = vld1q_s16(src + i);
+		int32x4_t lo, hi;
+		if (gain == CPYMO_AUDIO_MIX_UNITY) {
+			lo = vmovl_s16(vget_low_s16(s));
+			hi = vmovl_s16(vget_high_s16(s));
+		}
+		else {
+			lo = vshrq_n_s32(vmull_n_s16(vget_low_s16(s), (int16_t)gain), 15);
+			hi = vshrq_n_s32(vmull_n_s16(vget_high_s16(s), (int16_t)gain), 15);
+		}
+		vst1q_s32(acc + i, vaddq_s32(vld1q_s32(acc + i), lo));
+		vst1q_s32(acc + i + 4, vaddq_s32(vld1q_s32(acc + i + 4), hi));
+	}
+#endif
+
+	for (; i < n; ++i)
+		acc[i] += (src[i] * gain) >> 15;
+}
+
+static void cpymo_audio_mix_add_f32(
+	float *acc, const float *src, size_t n, int32_t *p_gain, int32_t target)
+{
+	const float unit = 1.0f / CPYMO_AUDIO_MIX_UNITY;
+	int32_t gain = *p_gain;
+	size_t i = 0;
+
+	for (; i < n && gain != target; ++i) {
+		gain = cpymo_audio_mix_ramp(gain, target);
+		acc[i] += src[i] * ((float)gain * unit);
+	}
+
+	*p_gain = gain;
+	if (gain == 0) return;
+
+	const float g = (float)gain * unit;
+
+#if defined CPYMO_AUDIO_MIX_SSE2
+	const __m128 gv = _mm_set1_ps(g);
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(acc + i, _mm_add_ps(
+			_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), gv)));
+#elif defined CPYMO_AUDIO_MIX_NEON
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), vld1q_f32(src + i), g));
+#endif
+
+	for (; i < n; ++i)
+		acc[i] += src[i] * g;
+}
+
+static void cpymo_audio_mix_add_s32(
+	float *acc, const int32_t *src, size_t n, int32_t *p_gain, int32_t target)
+{
+	const float unit = 1.0f / CPYMO_AUDIO_MIX_UNITY / 2147483648.0f;
+	int32_t gain = *p_gain;
+
+	for (size_t i = 0; i < n; ++i) {
+		if (gain != target) gain = cpymo_audio_mix_ramp(gain, target);
+		acc[i] += (float)src[i] * ((float)gain * unit);
+	}
+
+	*p_gain = gain;
+}
+
+void cpymo_audio_mix_add(
+	cpymo_audio_mix_acc *acc, size_t offset,
+	const void *src, size_t samples,
+	cpymo_backend_audio_format fmt,
+	int32_t *gain, int32_t target)
+{
+	assert(offset + samples <= CPYMO_AUDIO_MIX_BLOCK);
+
+	switch (fmt) {
+	case cpymo_backend_audio_s16:
+		cpymo_audio_mix_add_s16(acc->i + offset, (const int16_t *)src, samples, gain, target);
+		break;
+	case cpymo_backend_audio_s32:
+		cpymo_audio_mix_add_s32(acc->f + offset, (const int32_t *)src, samples, gain, target);
+		break;
+	case cpymo_backend_audio_f32:
+		cpymo_audio_mix_add_f32(acc->f + offset, (const float *)src, samples, gain, target);
+		break;
+	}
+}
+
+static void cpymo_audio_mix_pack_s16(int16_t *dst, const int32_t *acc, size_t n)
+{
+	size_t i = 0;
+
+#if defined CPYMO_AUDIO_MIX_SSE2
+	for (; i + 8 <= n; i += 8) {
+		const __m128i *a = (const __m128i *)(acc + i);
+		_mm_storeu_si128((__m128i *)(dst + i),
+			_mm_packs_epi32(_mm_loadu_si128(a), _mm_loadu_si128(a + 1)));
+	}
+#elif defined CPYMO_AUDIO_MIX_NEON
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(dst + i, vcombine_s16(
+			vqmovn_s32(vld1q_s32(acc + i)), vqmovn_s32(vld1q_s32(acc + i + 4))));
+#endif
+
+	for (; i < n; ++i) {
+		int32_t v = acc[i];
+		if (v > INT16_MAX) v = INT16_MAX;
+		if (v < INT16_MIN) v = INT16_MIN;
+		dst[i] = (int16_t)v;
+	}
+}
+
+static void cpymo_audio_mix_pack_f32(float *dst, const float *acc, size_t n)
+{
+	size_t i = 0;
+
+#if defined CPYMO_AUDIO_MIX_SSE2
+	const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), lo), hi));
+#elif defined CPYMO_AUDIO_MIX_NEON
+	const float32x4_t lo = vdupq_n_f32(-1.0f), hi = vdupq_n_f32(1.0f);
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vld1q_f32(acc + i), lo), hi));
+#endif
+
+	for (; i < n; ++i) {
+		float v = acc[i];
+		if (v > 1.0f) v = 1.0f;
+		if (v < -1.0f) v = -1.0f;
+		dst[i] = v;
+	}
+}
+
+static void cpymo_audio_mix_pack_s32(int32_t *dst, const float *acc, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		double v = acc[i];
+		if (v > 1.0) v = 1.0;
+		if (v < -1.0) v = -1.0;
+		dst[i] = (int32_t)(v * INT32_MAX);
+	}
+}
+
+void cpymo_audio_mix_pack(
+	void *dst, const cpymo_audio_mix_acc *acc, size_t samples,
+	cpymo_backend_audio_format fmt)
+{
+	assert(samples <= CPYMO_AUDIO_MIX_BLOCK);
+
+	switch (fmt) {
+	case cpymo_backend_audio_s16: cpymo_audio_mix_pack_s16((int16_t *)dst, acc->i, samples); break;
+	case cpymo_backend_audio_s32: cpymo_audio_mix_pack_s32((int32_t *)dst, acc->f, samples); break;
+	case cpymo_backend_audio_f32: cpymo_audio_mix_pack_f32((float *)dst, acc->f, samples); break;
+	}
+}
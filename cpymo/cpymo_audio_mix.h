@@ -0,0 +1,49 @@
+#ifndef INCLUDE_CPYMO_AUDIO_MIX
+#define INCLUDE_CPYMO_AUDIO_MIX
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../cpymo-backends/include/cpymo_backend_audio.h"
+
+// Mixes all channels into one accumulator block, which is saturated
+// into the output only once per block.
+// s16 is accumulated in int32 with Q15 gains, s32 and f32 in float.
+
+#define CPYMO_AUDIO_MIX_UNITY (1 << 15)
+
+// Samples of one accumulator block, not frames.
+#ifndef CPYMO_AUDIO_MIX_BLOCK
+#define CPYMO_AUDIO_MIX_BLOCK 512
+#endif
+
+// Gain change per sample while a channel moves to a new volume,
+// unity is reached in 512 samples, about 6ms of 44100Hz stereo.
+#ifndef CPYMO_AUDIO_MIX_RAMP_STEP
+#define CPYMO_AUDIO_MIX_RAMP_STEP 64
+#endif
+
+typedef union {
+	int32_t i[CPYMO_AUDIO_MIX_BLOCK];
+	float f[CPYMO_AUDIO_MIX_BLOCK];
+} cpymo_audio_mix_acc;
+
+size_t cpymo_audio_mix_sample_size(cpymo_backend_audio_format fmt);
+
+// Volume is clamped to [0, 1].
+int32_t cpymo_audio_mix_gain(float volume);
+
+void cpymo_audio_mix_clear(cpymo_audio_mix_acc *acc, size_t samples);
+
+// Adds `samples` samples of `src` to acc starting at `offset`,
+// moving *gain towards `target` by CPYMO_AUDIO_MIX_RAMP_STEP per sample.
+void cpymo_audio_mix_add(
+	cpymo_audio_mix_acc *acc, size_t offset,
+	const void *src, size_t samples,
+	cpymo_backend_audio_format fmt,
+	int32_t *gain, int32_t target);
+
+void cpymo_audio_mix_pack(
+	void *dst, const cpymo_audio_mix_acc *acc, size_t samples,
+	cpymo_backend_audio_format fmt);
+
+#endif
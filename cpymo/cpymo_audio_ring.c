@@ -0,0 +1,88 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_audio_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+error_t cpymo_audio_ring_init(cpymo_audio_ring *r, size_t capacity)
+{
+	r->buf = (uint8_t *)malloc(capacity);
+	if (r->buf == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	r->capacity = capacity;
+	cpymo_atomic_init(&r->head, (size_t)0);
+	cpymo_atomic_init(&r->tail, (size_t)0);
+	return CPYMO_ERR_SUCC;
+}
+
+void cpymo_audio_ring_free(cpymo_audio_ring *r)
+{
+	free(r->buf);
+	r->buf = NULL;
+}
+
+static inline size_t cpymo_audio_ring_distance(const cpymo_audio_ring *r, size_t head, size_t tail)
+{
+	return head >= tail ? head - tail : head + 2 * r->capacity - tail;
+}
+
+static inline size_t cpymo_audio_ring_advance(const cpymo_audio_ring *r, size_t pos, size_t n)
+{
+	pos += n;
+	return pos >= 2 * r->capacity ? pos - 2 * r->capacity : pos;
+}
+
+static inline size_t cpymo_audio_ring_index(const cpymo_audio_ring *r, size_t pos)
+{
+	return pos >= r->capacity ? pos - r->capacity : pos;
+}
+
+size_t cpymo_audio_ring_readable(cpymo_audio_ring *r)
+{
+	size_t tail = cpymo_atomic_load_relaxed(&r->tail);
+	size_t head = cpymo_atomic_load(&r->head);
+	return cpymo_audio_ring_distance(r, head, tail);
+}
+
+size_t cpymo_audio_ring_writable(cpymo_audio_ring *r)
+{
+	size_t head = cpymo_atomic_load_relaxed(&r->head);
+	size_t tail = cpymo_atomic_load(&r->tail);
+	return r->capacity - cpymo_audio_ring_distance(r, head, tail);
+}
+
+size_t cpymo_audio_ring_write(cpymo_audio_ring *r, const void *data, size_t size)
+{
+	size_t writable = cpymo_audio_ring_writable(r);
+	if (size > writable) size = writable;
+	if (size == 0) return 0;
+
+	size_t head = cpymo_atomic_load_relaxed(&r->head);
+	size_t index = cpymo_audio_ring_index(r, head);
+	size_t first = r->capacity - index;
+	if (first > size) first = size;
+
+	memcpy(r->buf + index, data, first);
+	memcpy(r->buf, (const uint8_t *)data + first, size - first);
+
+	cpymo_atomic_store(&r->head, cpymo_audio_ring_advance(r, head, size));
+	return size;
+}
+
+const void *cpymo_audio_ring_peek(cpymo_audio_ring *r, size_t *size)
+{
+	size_t tail = cpymo_atomic_load_relaxed(&r->tail);
+	size_t head = cpymo_atomic_load(&r->head);
+
+	size_t index = cpymo_audio_ring_index(r, tail);
+	size_t readable = cpymo_audio_ring_distance(r, head, tail);
+	if (readable > r->capacity - index) readable = r->capacity - index;
+
+	*size = readable;
+	return r->buf + index;
+}
+
+void cpymo_audio_ring_consume(cpymo_audio_ring *r, size_t size)
+{
+	size_t tail = cpymo_atomic_load_relaxed(&r->tail);
+	cpymo_atomic_store(&r->tail, cpymo_audio_ring_advance(r, tail, size));
+}
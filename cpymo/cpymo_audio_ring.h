@@ -0,0 +1,36 @@
+#ifndef INCLUDE_CPYMO_AUDIO_RING
+#define INCLUDE_CPYMO_AUDIO_RING
+
+#include "cpymo_error.h"
+#include "cpymo_atomic.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free byte ring with one writer thread and one reader thread.
+// head and tail run over [0, 2 * capacity), so a full ring
+// is told apart from an empty one without a spare byte
+// and the capacity does not need to be a power of two.
+// Records never wrap if the capacity is a multiple of their size.
+
+typedef struct {
+	uint8_t *buf;
+	size_t capacity;
+
+	// head is only written by the writer, tail only by the reader.
+	cpymo_atomic_size head, tail;
+} cpymo_audio_ring;
+
+error_t cpymo_audio_ring_init(cpymo_audio_ring *r, size_t capacity);
+void cpymo_audio_ring_free(cpymo_audio_ring *r);
+
+size_t cpymo_audio_ring_readable(cpymo_audio_ring *r);
+
+// Writer side, write returns the bytes written.
+size_t cpymo_audio_ring_writable(cpymo_audio_ring *r);
+size_t cpymo_audio_ring_write(cpymo_audio_ring *r, const void *data, size_t size);
+
+// Reader side, returns the readable bytes that are contiguous after the tail.
+const void *cpymo_audio_ring_peek(cpymo_audio_ring *r, size_t *size);
+void cpymo_audio_ring_consume(cpymo_audio_ring *r, size_t size);
+
+#endif
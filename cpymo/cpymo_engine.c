@@ -98,6 +98,8 @@ error_t cpymo_engine_init(cpymo_engine *out, const char *gamedir)
 	}
 
 	cpymo_interpreter_init(out->interpreter, boot_script, true, NULL);
+	memset(&out->interpreter_stats, 0, sizeof(out->interpreter_stats));
+	cpymo_interpreter_budget_init(&out->interpreter_budget);
 
 	// create title
 	out->title = (char *)malloc(1);
@@ -110,6 +112,22 @@ error_t cpymo_engine_init(cpymo_engine *out, const char *gamedir)
 	}
 	out->title[0] = '\0';
 
+	// init image cache
+	cpymo_image_cache_init(
+		&out->image_cache, (size_t)out->gameconfig.imagecache * 1024);
+	out->assetloader.image_cache = &out->image_cache;
+
+	// init script cache
+	cpymo_script_cache_init(&out->script_cache);
+	out->assetloader.script_cache = &out->script_cache;
+
+	// init async loader
+	cpymo_async_loader_init(&out->async_loader);
+	cpymo_async_loader_set_cache_budget(
+		&out->async_loader, (size_t)out->gameconfig.prefetchcache * 1024);
+	out->assetloader.async_loader = &out->async_loader;
+	cpymo_prefetch_init(&out->prefetch);
+
 	// init wait
 	cpymo_wait_reset(&out->wait);
 
@@ -152,15 +170,27 @@ error_t cpymo_engine_init(cpymo_engine *out, const char *gamedir)
 	// init backlog
 	err = cpymo_backlog_init(&out->backlog);
 	if (err != CPYMO_ERR_SUCC) {
+		cpymo_prefetch_free(&out->prefetch);
+		cpymo_async_loader_free(&out->async_loader);
+		cpymo_image_cache_free(&out->image_cache);
 		free(out->title);
 		cpymo_interpreter_free(out->interpreter);
 		free(out->interpreter);
+		cpymo_script_cache_free(&out->script_cache);
 		cpymo_vars_free(&out->vars);
 		cpymo_assetloader_free(&out->assetloader);
 		return err;
 	}
 
+	// init save writer
+	cpymo_save_writer_init(&out->save_writer, out->assetloader.gamedir);
+	cpymo_save_index_init(&out->save_index);
+
+	// init rollback
+	cpymo_rollback_init(&out->rollback);
+
 	// states
+	out->fast_forward = NULL;
 	out->skipping = false;
 	out->redraw = true;
 	out->ignore_next_mouse_button_flag = false;
@@ -183,11 +213,18 @@ error_t cpymo_engine_init(cpymo_engine *out, const char *gamedir)
 	}
 
 	// load global save data
+	cpymo_save_global_journal_init(&out->global_journal);
 	err = cpymo_save_global_load(out);
 	if (err != CPYMO_ERR_SUCC && err != CPYMO_ERR_CAN_NOT_OPEN_FILE) {
 		printf("[Error] Global save data broken! %s\n", cpymo_error_message(err));
 	}
 
+	// load save index
+	err = cpymo_save_index_load(out);
+	if (err != CPYMO_ERR_SUCC) {
+		printf("[Warning] Can not load save index: %s\n", cpymo_error_message(err));
+	}
+
 	out->input = out->prev_input = cpymo_input_snapshot();
 	out->ignore_next_mouse_button_flag = out->input.mouse_button;
 
@@ -216,7 +253,7 @@ void cpymo_engine_free(cpymo_engine *engine)
 	while (engine->ui) cpymo_ui_exit(engine);
 
 	if (engine->assetloader.gamedir) {
-		error_t err = cpymo_save_global_save(engine);
+		error_t err = cpymo_save_global_flush(engine);
 		if (err != CPYMO_ERR_SUCC)
 			printf("[Error] Can not save global savedata. %s\n", cpymo_error_message(err));
 
@@ -224,6 +261,10 @@ void cpymo_engine_free(cpymo_engine *engine)
 		if (err != CPYMO_ERR_SUCC)
 			printf("[Error] Can not save config. %s\n", cpymo_error_message(err));
 	}
+
+	cpymo_save_writer_free(&engine->save_writer);
+	cpymo_save_index_free(&engine->save_index);
+	cpymo_rollback_free(&engine->rollback);
 	
 	cpymo_hash_flags_free(&engine->flags);
 	cpymo_text_free(&engine->text);
@@ -240,6 +281,13 @@ void cpymo_engine_free(cpymo_engine *engine)
 		free(engine->interpreter);
 	}
 	cpymo_vars_free(&engine->vars);
+	cpymo_prefetch_free(&engine->prefetch);
+	cpymo_async_loader_free(&engine->async_loader);
+	cpymo_interpreter_print_stats(&engine->interpreter_stats);
+	cpymo_script_cache_print_stats(&engine->script_cache);
+	cpymo_script_cache_free(&engine->script_cache);
+	cpymo_image_cache_print_stats(&engine->image_cache);
+	cpymo_image_cache_free(&engine->image_cache);
 	cpymo_assetloader_free(&engine->assetloader);
 	if (engine->title) free(engine->title);
 	cpymo_audio_free(&engine->audio);
@@ -309,6 +357,8 @@ error_t cpymo_engine_update(cpymo_engine *engine, float delta_time_sec, bool * r
 	if (engine->input.hide_window != engine->prev_input.hide_window)
 		cpymo_engine_request_redraw(engine);
 
+	cpymo_save_global_update(engine, delta_time_sec);
+
 #ifdef ENABLE_TEXT_EXTRACT
 	if (!engine->input.copy && !engine->input.append_copy)
 		engine->text_extract_copy_latched = false;
@@ -355,6 +405,8 @@ error_t cpymo_engine_update(cpymo_engine *engine, float delta_time_sec, bool * r
 
 			CPYMO_THROW(err);
 		}
+
+		cpymo_prefetch_update(engine);
 	}
 
 	*redraw |= engine->redraw; engine->redraw = false;
@@ -398,6 +450,10 @@ void cpymo_engine_trim_memory(cpymo_engine *e)
 
 	cpymo_anime_off(&e->anime);
 
+	cpymo_async_loader_trim_memory(&e->async_loader);
+	cpymo_image_cache_clear(&e->image_cache);
+	cpymo_script_cache_clear(&e->script_cache);
+
 	cpymo_audio_se_stop(e);
 	cpymo_audio_vo_stop(e);
 
@@ -3,6 +3,10 @@
 
 #include "../cpymo-backends/include/cpymo_backend_input.h"
 #include "cpymo_assetloader.h"
+#include "cpymo_async_loader.h"
+#include "cpymo_image_cache.h"
+#include "cpymo_script_cache.h"
+#include "cpymo_prefetch.h"
 #include "cpymo_gameconfig.h"
 #include "cpymo_error.h"
 #include "cpymo_interpreter.h"
@@ -19,15 +23,29 @@
 #include "cpymo_say.h"
 #include "cpymo_text.h"
 #include "cpymo_hash_flags.h"
+#include "cpymo_save_global.h"
+#include "cpymo_save_writer.h"
+#include "cpymo_save.h"
+#include "cpymo_rollback.h"
 #include "cpymo_ui.h"
 #include "cpymo_audio.h"
 #include "cpymo_backlog.h"
+#include "cpymo_fast_forward.h"
 
 struct cpymo_engine {
 	cpymo_gameconfig gameconfig;
 	cpymo_assetloader assetloader;
+	cpymo_image_cache image_cache;
+	cpymo_script_cache script_cache;
+	cpymo_async_loader async_loader;
+	cpymo_prefetch prefetch;
 	cpymo_vars vars;
 	cpymo_interpreter *interpreter;
+	cpymo_interpreter_stats interpreter_stats;
+
+	// Backends may change it after cpymo_engine_init,
+	// the game selector keeps it when it starts a game.
+	cpymo_interpreter_budget interpreter_budget;
 	cpymo_input prev_input, input;
 	cpymo_wait wait;
 	cpymo_flash flash;
@@ -41,10 +59,17 @@ struct cpymo_engine {
 	cpymo_say say;
 	cpymo_text text;
 	cpymo_hash_flags flags;
+	cpymo_save_global_journal global_journal;
+	cpymo_save_writer save_writer;
+	cpymo_save_index save_index;
+	cpymo_rollback rollback;
 	struct cpymo_ui *ui;
 	cpymo_audio_system audio;
 	cpymo_backlog backlog;
 
+	// Set while cpymo_engine_fast_forward runs.
+	cpymo_fast_forward *fast_forward;
+
 	bool skipping;
 	char *title;
 
@@ -0,0 +1,262 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_fast_forward.h"
+#include "cpymo_engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../stb/stb_ds.h"
+
+static error_t cpymo_fast_forward_set_str(char **out, cpymo_str str)
+{
+	char *s = cpymo_str_copy_malloc(str);
+	if (s == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	free(*out);
+	*out = s;
+	return CPYMO_ERR_SUCC;
+}
+
+static void cpymo_fast_forward_free(cpymo_fast_forward *ff)
+{
+	free(ff->target_script);
+	free(ff->bg);
+	free(ff->msgbox);
+	free(ff->namebox);
+	free(ff->bgm);
+
+	cpymo_fast_forward_chara_kill_all(ff);
+	arrfree(ff->charas);
+}
+
+static error_t cpymo_fast_forward_init(
+	cpymo_fast_forward *ff, cpymo_engine *e, cpymo_str script_name, size_t line)
+{
+	memset(ff, 0, sizeof(*ff));
+	ff->target_line = line;
+
+	error_t err = cpymo_fast_forward_set_str(&ff->target_script, script_name);
+	CPYMO_THROW(err);
+
+	// Charas are recreated from this record if any of them changes.
+	for (struct cpymo_chara *c = e->charas.chara; c; c = c->next) {
+		if (!c->alive) continue;
+
+		err = cpymo_fast_forward_chara(
+			ff, cpymo_str_pure(c->chara_name), c->chara_id, c->layer, 0,
+			c->pos_x.end_value, c->pos_y.end_value);
+		if (err != CPYMO_ERR_SUCC) {
+			cpymo_fast_forward_free(ff);
+			return err;
+		}
+	}
+
+	ff->charas_changed = false;
+	return CPYMO_ERR_SUCC;
+}
+
+// Ends what the engine waits for as if the player skipped it.
+static error_t cpymo_fast_forward_finish_wait(cpymo_engine *e)
+{
+	for (int i = 0; i < 64 && cpymo_wait_is_wating(&e->wait); ++i) {
+		cpymo_wait_over_callback cb = e->wait.callback;
+		cpymo_wait_reset(&e->wait);
+
+		if (cb) {
+			error_t err = cb(e);
+			CPYMO_THROW(err);
+		}
+	}
+
+	cpymo_wait_reset(&e->wait);
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_fast_forward_materialize(cpymo_fast_forward *ff, cpymo_engine *e)
+{
+	error_t err = CPYMO_ERR_SUCC;
+
+	if (ff->textbox_changed) {
+		err = cpymo_say_load_msgbox_and_namebox_image(
+			&e->say,
+			cpymo_str_pure(ff->msgbox),
+			cpymo_str_pure(ff->namebox),
+			&e->assetloader);
+		CPYMO_THROW(err);
+	}
+
+	if (ff->bg_changed) {
+		err = cpymo_bg_command(
+			e, &e->bg, cpymo_str_pure(ff->bg), cpymo_str_pure("BG_NOFADE"),
+			ff->bg_x, ff->bg_y, 0);
+		CPYMO_THROW(err);
+	}
+
+	if (ff->charas_changed) {
+		cpymo_charas_free(&e->charas);
+		cpymo_charas_init(&e->charas);
+
+		for (size_t i = 0; i < arrlenu(ff->charas); ++i) {
+			const cpymo_fast_forward_chara_info *c = &ff->charas[i];
+			struct cpymo_chara *ch = NULL;
+			err = cpymo_charas_new_chara(
+				e, &ch, cpymo_str_pure(c->name), c->id, c->layer,
+				c->coord_mode, c->x, c->y, 1.0f, 0);
+			CPYMO_THROW(err);
+		}
+	}
+
+	if (ff->bgm_changed) {
+		if (ff->bgm) err = cpymo_audio_bgm_play(e, cpymo_str_pure(ff->bgm), ff->bgm_loop);
+		else cpymo_audio_bgm_stop(e);
+		CPYMO_THROW(err);
+	}
+
+	cpymo_engine_request_redraw(e);
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_engine_fast_forward(cpymo_engine *e, cpymo_str script_name, size_t line)
+{
+	if (e->fast_forward || e->ui || e->select_img.selections)
+		return CPYMO_ERR_INVALID_ARG;
+
+	error_t err = cpymo_fast_forward_finish_wait(e);
+	CPYMO_THROW(err);
+
+	cpymo_fast_forward ff;
+	err = cpymo_fast_forward_init(&ff, e, script_name, line);
+	CPYMO_THROW(err);
+
+	e->fast_forward = &ff;
+
+	while (e->interpreter && !cpymo_fast_forward_should_stop(&ff, e->interpreter)) {
+		err = cpymo_interpreter_execute_step(e->interpreter, e);
+		if (err != CPYMO_ERR_SUCC) break;
+
+		err = cpymo_fast_forward_finish_wait(e);
+		if (err != CPYMO_ERR_SUCC) break;
+
+		if (e->ui || e->select_img.selections) break;
+	}
+
+	e->fast_forward = NULL;
+
+	error_t materialize_err = cpymo_fast_forward_materialize(&ff, e);
+	cpymo_fast_forward_free(&ff);
+
+	if (err == CPYMO_ERR_SUCC) err = materialize_err;
+	return err;
+}
+
+bool cpymo_fast_forward_should_stop(
+	const cpymo_fast_forward *ff, const cpymo_interpreter *interpreter)
+{
+	if (ff->interrupted) return true;
+
+	return interpreter->script_parser.cur_line == ff->target_line
+		&& strcmp(interpreter->script->script_name, ff->target_script) == 0;
+}
+
+error_t cpymo_fast_forward_bg(cpymo_fast_forward *ff, cpymo_str name, float x, float y)
+{
+	error_t err = cpymo_fast_forward_set_str(&ff->bg, name);
+	CPYMO_THROW(err);
+
+	ff->bg_x = x;
+	ff->bg_y = y;
+	ff->bg_changed = true;
+	return CPYMO_ERR_SUCC;
+}
+
+static cpymo_fast_forward_chara_info *cpymo_fast_forward_find_chara(cpymo_fast_forward *ff, int id)
+{
+	for (size_t i = 0; i < arrlenu(ff->charas); ++i)
+		if (ff->charas[i].id == id)
+			return &ff->charas[i];
+	return NULL;
+}
+
+error_t cpymo_fast_forward_chara(
+	cpymo_fast_forward *ff, cpymo_str name,
+	int id, int layer, int coord_mode, float x, float y)
+{
+	if (cpymo_str_equals_str(name, "NULL")) {
+		cpymo_fast_forward_chara_kill(ff, id);
+		return CPYMO_ERR_SUCC;
+	}
+
+	cpymo_fast_forward_chara_info c;
+	c.id = id;
+	c.layer = layer;
+	c.coord_mode = coord_mode;
+	c.x = x;
+	c.y = y;
+	c.name = cpymo_str_copy_malloc(name);
+	if (c.name == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	cpymo_fast_forward_chara_info *prev = cpymo_fast_forward_find_chara(ff, id);
+	if (prev) {
+		free(prev->name);
+		*prev = c;
+	}
+	else arrput(ff->charas, c);
+
+	ff->charas_changed = true;
+	return CPYMO_ERR_SUCC;
+}
+
+void cpymo_fast_forward_chara_pos(
+	cpymo_fast_forward *ff, int id, int coord_mode, float x, float y)
+{
+	cpymo_fast_forward_chara_info *c = cpymo_fast_forward_find_chara(ff, id);
+	if (c == NULL) return;
+
+	c->coord_mode = coord_mode;
+	c->x = x;
+	c->y = y;
+	ff->charas_changed = true;
+}
+
+void cpymo_fast_forward_chara_kill(cpymo_fast_forward *ff, int id)
+{
+	cpymo_fast_forward_chara_info *c = cpymo_fast_forward_find_chara(ff, id);
+	if (c == NULL) return;
+
+	free(c->name);
+	arrdel(ff->charas, (size_t)(c - ff->charas));
+	ff->charas_changed = true;
+}
+
+void cpymo_fast_forward_chara_kill_all(cpymo_fast_forward *ff)
+{
+	for (size_t i = 0; i < arrlenu(ff->charas); ++i)
+		free(ff->charas[i].name);
+
+	if (ff->charas) arrsetlen(ff->charas, 0);
+	ff->charas_changed = true;
+}
+
+error_t cpymo_fast_forward_textbox(cpymo_fast_forward *ff, cpymo_str msgbox, cpymo_str namebox)
+{
+	error_t err = cpymo_fast_forward_set_str(&ff->msgbox, msgbox);
+	CPYMO_THROW(err);
+
+	err = cpymo_fast_forward_set_str(&ff->namebox, namebox);
+	CPYMO_THROW(err);
+
+	ff->textbox_changed = true;
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_fast_forward_bgm(cpymo_fast_forward *ff, cpymo_str name, bool loop)
+{
+	ff->bgm_changed = true;
+	ff->bgm_loop = loop;
+
+	if (name.len == 0) {
+		free(ff->bgm);
+		ff->bgm = NULL;
+		return CPYMO_ERR_SUCC;
+	}
+
+	return cpymo_fast_forward_set_str(&ff->bgm, name);
+}
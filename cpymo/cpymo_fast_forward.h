@@ -0,0 +1,69 @@
+#ifndef INCLUDE_CPYMO_FAST_FORWARD
+#define INCLUDE_CPYMO_FAST_FORWARD
+
+#include "cpymo_error.h"
+#include "cpymo_str.h"
+
+// Fast forward runs the script without drawing, creating text,
+// decoding images or playing audio. Variables, flags and jumps run as usual,
+// bg, chara, textbox and bgm commands only update this record,
+// the rest of the visual and audio commands are skipped.
+// The recorded bg, charas, textbox and bgm are loaded once at the target.
+
+struct cpymo_engine;
+struct cpymo_interpreter;
+
+typedef struct {
+	int id, layer, coord_mode;
+	float x, y;
+	char *name;
+} cpymo_fast_forward_chara_info;
+
+typedef struct {
+	char *target_script;
+	size_t target_line;
+
+	// Set when a command that needs the player is reached.
+	bool interrupted;
+
+	char *bg;
+	float bg_x, bg_y;
+	bool bg_changed;
+
+	cpymo_fast_forward_chara_info *charas;
+	bool charas_changed;
+
+	char *msgbox, *namebox;
+	bool textbox_changed;
+
+	char *bgm;
+	bool bgm_loop, bgm_changed;
+} cpymo_fast_forward;
+
+// Runs the script until the running interpreter is about to run
+// line `line` of `script_name`. It stops earlier before a command that needs
+// the player (sel, select_*, load, album, music, config)
+// and returns CPYMO_ERR_NO_MORE_CONTENT if the script ends first.
+error_t cpymo_engine_fast_forward(
+	struct cpymo_engine *e, cpymo_str script_name, size_t line);
+
+bool cpymo_fast_forward_should_stop(
+	const cpymo_fast_forward *ff, const struct cpymo_interpreter *interpreter);
+
+error_t cpymo_fast_forward_bg(cpymo_fast_forward *ff, cpymo_str name, float x, float y);
+
+// A chara named NULL is removed like the chara command does.
+error_t cpymo_fast_forward_chara(
+	cpymo_fast_forward *ff, cpymo_str name,
+	int id, int layer, int coord_mode, float x, float y);
+void cpymo_fast_forward_chara_pos(
+	cpymo_fast_forward *ff, int id, int coord_mode, float x, float y);
+void cpymo_fast_forward_chara_kill(cpymo_fast_forward *ff, int id);
+void cpymo_fast_forward_chara_kill_all(cpymo_fast_forward *ff);
+
+error_t cpymo_fast_forward_textbox(cpymo_fast_forward *ff, cpymo_str msgbox, cpymo_str namebox);
+
+// An empty name stops the bgm.
+error_t cpymo_fast_forward_bgm(cpymo_fast_forward *ff, cpymo_str name, bool loop);
+
+#endif
@@ -75,12 +75,14 @@ static error_t cpymo_game_selector_ok(cpymo_engine *e, void *selected)
 	}
 
 	cpymo_game_selector_callback after = sel->after_init;
+	cpymo_interpreter_budget budget = e->interpreter_budget;
 
 	cpymo_engine_free(e);
 	error_t err = cpymo_engine_init(e, gamedir);
 	free(gamedir);
 
 	CPYMO_THROW(err);
+	e->interpreter_budget = budget;
 
 	if (after) {
 		err = after(e, e->assetloader.gamedir);
@@ -393,9 +395,20 @@ error_t cpymo_engine_init_with_game_selector(
 	e->assetloader.use_pkg_voice = false;
 	e->assetloader.game_config = &e->gameconfig;
 	e->assetloader.gamedir = NULL;
+	cpymo_vfs_init(&e->assetloader.vfs, NULL);
+	e->assetloader.async_loader = NULL;
+	e->assetloader.image_cache = NULL;
+	cpymo_image_cache_init(&e->image_cache, 0);
+	e->assetloader.script_cache = NULL;
+	cpymo_script_cache_init(&e->script_cache);
+	cpymo_async_loader_init(&e->async_loader);
+	cpymo_prefetch_init(&e->prefetch);
 	
 	cpymo_vars_init(&e->vars);
 	e->interpreter = NULL;
+	e->fast_forward = NULL;
+	memset(&e->interpreter_stats, 0, sizeof(e->interpreter_stats));
+	cpymo_interpreter_budget_init(&e->interpreter_budget);
 	e->title = NULL;
 
 	cpymo_wait_reset(&e->wait);
@@ -410,6 +423,10 @@ error_t cpymo_engine_init_with_game_selector(
 	cpymo_say_init(&e->say);
 	cpymo_text_init(&e->text);
 	cpymo_hash_flags_init(&e->flags);
+	cpymo_save_global_journal_init(&e->global_journal);
+	cpymo_save_writer_init(&e->save_writer, NULL);
+	cpymo_save_index_init(&e->save_index);
+	cpymo_rollback_init(&e->rollback);
 	e->ui = NULL;
 	cpymo_backlog_init(&e->backlog);
 	e->skipping = false;
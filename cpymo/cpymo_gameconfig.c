@@ -9,6 +9,18 @@
 const cpymo_pymo_version cpymo_pymo_version_current = 
 	{ 1, 2 };
 
+#ifndef CPYMO_GAMECONFIG_DEFAULT_PREFETCH_LINES
+#define CPYMO_GAMECONFIG_DEFAULT_PREFETCH_LINES 64
+#endif
+
+#ifndef CPYMO_GAMECONFIG_DEFAULT_PREFETCH_CACHE
+#define CPYMO_GAMECONFIG_DEFAULT_PREFETCH_CACHE (16 * 1024)
+#endif
+
+#ifndef CPYMO_GAMECONFIG_DEFAULT_IMAGE_CACHE
+#define CPYMO_GAMECONFIG_DEFAULT_IMAGE_CACHE (8 * 1024)
+#endif
+
 static void cpymo_dispatch_gameconfig(cpymo_gameconfig *o, cpymo_str key, cpymo_parser *parser) 
 {
 	size_t magic_key_len;
@@ -119,6 +131,24 @@ static void cpymo_dispatch_gameconfig(cpymo_gameconfig *o, cpymo_str key, cpymo_
 		return;
 	}
 
+	D("prefetchlines") {
+		o->prefetchlines = (uint16_t)cpymo_utils_clamp(cpymo_str_atoi(
+			cpymo_parser_curline_pop_commacell(parser)), 0, 1024);
+		return;
+	}
+
+	D("prefetchcache") {
+		int kb = cpymo_str_atoi(cpymo_parser_curline_pop_commacell(parser));
+		o->prefetchcache = kb > 0 ? (uint32_t)kb : 0;
+		return;
+	}
+
+	D("imagecache") {
+		int kb = cpymo_str_atoi(cpymo_parser_curline_pop_commacell(parser));
+		o->imagecache = kb > 0 ? (uint32_t)kb : 0;
+		return;
+	}
+
 	D("startscript") {
 		cpymo_str cpymo_str = cpymo_parser_curline_pop_commacell(parser);
 		SETUP(startscript, cpymo_str);
@@ -220,6 +250,9 @@ error_t cpymo_gameconfig_parse(cpymo_gameconfig *out_config, const char *stream,
 	strcpy(out_config->bgmformat, "mp3");
 	strcpy(out_config->voiceformat, "mp3");
 	strcpy(out_config->seformat, "mp3");
+	out_config->prefetchlines = CPYMO_GAMECONFIG_DEFAULT_PREFETCH_LINES;
+	out_config->prefetchcache = CPYMO_GAMECONFIG_DEFAULT_PREFETCH_CACHE;
+	out_config->imagecache = CPYMO_GAMECONFIG_DEFAULT_IMAGE_CACHE;
 
 	/*** Default Config End ***/
 
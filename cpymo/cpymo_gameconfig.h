@@ -51,6 +51,11 @@ typedef struct {
 	unsigned namealign : 2;	// 0 - middle, 1 - left, 2 - right
 
 	cpymo_pymo_version engineversion;
+
+	// CPyMO only, ignored by PyMO.
+	uint16_t prefetchlines;		// script lines scanned ahead for assets, 0 to disable
+	uint32_t prefetchcache;		// KiB of decoded images kept for prefetch
+	uint32_t imagecache;		// KiB of recently shown images kept decoded
 } cpymo_gameconfig;
 error_t cpymo_gameconfig_parse(cpymo_gameconfig *out_config, const char *stream, size_t len);
 error_t cpymo_gameconfig_parse_from_file(cpymo_gameconfig *out_config, const char *path);
@@ -1,63 +1,189 @@
 ﻿#include "cpymo_prelude.h"
 #include "cpymo_hash_flags.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "../stb/stb_ds.h"
 
-typedef struct {
-	cpymo_hash_flag key;
-} cpymo_hash_flags_internal;
+#define CPYMO_HASH_FLAGS_MIN_CAPACITY 64
+
+// Flags are hashes already, but the low bits of cpymo_str_hash are weak,
+// the top bits of the Fibonacci hash pick the slot.
+static inline uint64_t cpymo_hash_flags_mix(cpymo_hash_flag f)
+{
+	return f * 0x9E3779B97F4A7C15ull;
+}
+
+static inline size_t cpymo_hash_flags_home(const cpymo_hash_flags *fs, cpymo_hash_flag f)
+{
+	return (size_t)(cpymo_hash_flags_mix(f) >> fs->shift);
+}
 
 void cpymo_hash_flags_init(cpymo_hash_flags *f)
 {
-	f->flags = NULL;
-	f->dirty = false;
+	f->slots = NULL;
+	f->capacity = 0;
+	f->count = 0;
+	f->shift = 64;
+	f->has_zero = false;
+	f->unsaved = NULL;
+	f->unsaved_deletion = false;
 }
 
 void cpymo_hash_flags_free(cpymo_hash_flags *f)
 {
-	cpymo_hash_flags_internal *flags = (cpymo_hash_flags_internal *)f->flags;
-	if (flags) hmfree(flags);
+	if (f->slots) free(f->slots);
+	f->slots = NULL;
+	arrfree(f->unsaved);
+}
+
+static void cpymo_hash_flags_insert(cpymo_hash_flags *fs, cpymo_hash_flag f)
+{
+	const size_t mask = fs->capacity - 1;
+	size_t i = cpymo_hash_flags_home(fs, f);
+	while (fs->slots[i]) {
+		if (fs->slots[i] == f) return;
+		i = (i + 1) & mask;
+	}
+
+	fs->slots[i] = f;
+	fs->count++;
+}
+
+// Keeps the load factor at most 3/4 with `count` flags.
+static error_t cpymo_hash_flags_reserve(cpymo_hash_flags *fs, size_t count)
+{
+	size_t capacity = fs->capacity ? fs->capacity : CPYMO_HASH_FLAGS_MIN_CAPACITY;
+	while (count > capacity / 4 * 3) capacity *= 2;
+
+	if (capacity == fs->capacity) return CPYMO_ERR_SUCC;
+
+	unsigned shift = 64;
+	for (size_t c = capacity; c > 1; c >>= 1) shift--;
+
+	cpymo_hash_flag *slots = (cpymo_hash_flag *)calloc(capacity, sizeof(cpymo_hash_flag));
+	if (slots == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	cpymo_hash_flag *old_slots = fs->slots;
+	size_t old_capacity = fs->capacity;
+
+	fs->slots = slots;
+	fs->capacity = capacity;
+	fs->shift = shift;
+	fs->count = 0;
+
+	for (size_t i = 0; i < old_capacity; ++i)
+		if (old_slots[i]) cpymo_hash_flags_insert(fs, old_slots[i]);
+
+	if (old_slots) free(old_slots);
+	return CPYMO_ERR_SUCC;
 }
 
 error_t cpymo_hash_flags_add(cpymo_hash_flags *fs, cpymo_hash_flag f)
 {
 	if (cpymo_hash_flags_check(fs, f)) return CPYMO_ERR_SUCC;
 
-	cpymo_hash_flags_internal *flags = (cpymo_hash_flags_internal *)fs->flags;
-	cpymo_hash_flags_internal kv;
-	kv.key = f;
-	hmputs(flags, kv);
-	fs->flags = (void *)flags;
-	fs->dirty = true;
+	if (f == 0) fs->has_zero = true;
+	else {
+		error_t err = cpymo_hash_flags_reserve(fs, fs->count + 1);
+		CPYMO_THROW(err);
+
+		cpymo_hash_flags_insert(fs, f);
+	}
+
+	arrput(fs->unsaved, f);
 	return CPYMO_ERR_SUCC;
 }
 
 void cpymo_hash_flags_del(cpymo_hash_flags *fs, cpymo_hash_flag f)
 {
-	cpymo_hash_flags_internal *flags = (cpymo_hash_flags_internal *)fs->flags;
-	if (hmdel(flags, f))
-		fs->dirty = true;
+	if (f == 0) {
+		if (fs->has_zero) fs->unsaved_deletion = true;
+		fs->has_zero = false;
+		return;
+	}
+
+	if (fs->capacity == 0) return;
+
+	const size_t mask = fs->capacity - 1;
+	size_t i = cpymo_hash_flags_home(fs, f);
+	while (fs->slots[i] != f) {
+		if (fs->slots[i] == 0) return;
+		i = (i + 1) & mask;
+	}
+
+	// Shift the rest of the cluster back, so no tombstone is needed.
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		if (fs->slots[j] == 0) break;
+
+		size_t home = cpymo_hash_flags_home(fs, fs->slots[j]);
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			fs->slots[i] = fs->slots[j];
+			i = j;
+		}
+	}
+
+	fs->slots[i] = 0;
+	fs->count--;
+	fs->unsaved_deletion = true;
+}
+
+bool cpymo_hash_flags_check(const cpymo_hash_flags *fs, cpymo_hash_flag f)
+{
+	if (f == 0) return fs->has_zero;
+	if (fs->capacity == 0) return false;
+
+	const size_t mask = fs->capacity - 1;
+	size_t i = cpymo_hash_flags_home(fs, f);
+	while (fs->slots[i]) {
+		if (fs->slots[i] == f) return true;
+		i = (i + 1) & mask;
+	}
+
+	return false;
+}
+
+size_t cpymo_hash_flags_count(const cpymo_hash_flags *fs)
+{
+	return fs->count + (fs->has_zero ? 1 : 0);
 }
 
-bool cpymo_hash_flags_check(cpymo_hash_flags *fs, cpymo_hash_flag f)
+static int cpymo_hash_flags_compare(const void *a, const void *b)
 {
-	cpymo_hash_flags_internal *flags = (cpymo_hash_flags_internal *)fs->flags;
-	cpymo_hash_flags_internal *ret = hmgetp_null(flags, f);
-	fs->flags = (void *)flags;
-	return ret != NULL;
+	uint64_t x = cpymo_hash_flags_mix(*(const cpymo_hash_flag *)a);
+	uint64_t y = cpymo_hash_flags_mix(*(const cpymo_hash_flag *)b);
+	return x < y ? -1 : (x > y ? 1 : 0);
 }
 
-size_t cpymo_hash_flags_count(cpymo_hash_flags *fs)
+error_t cpymo_hash_flags_add_many(cpymo_hash_flags *fs, cpymo_hash_flag *flags, size_t count)
 {
-	cpymo_hash_flags_internal *f = (cpymo_hash_flags_internal *)fs->flags;
-	size_t len = hmlenu(f);
-	fs->flags = (void *)f;
-	return len;
+	error_t err = cpymo_hash_flags_reserve(fs, fs->count + count);
+	CPYMO_THROW(err);
+
+	// In mixed order the home slots only go up,
+	// so the inserts walk the table once.
+	qsort(flags, count, sizeof(flags[0]), &cpymo_hash_flags_compare);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (flags[i] == 0) fs->has_zero = true;
+		else cpymo_hash_flags_insert(fs, flags[i]);
+	}
+
+	return CPYMO_ERR_SUCC;
 }
 
-uint64_t cpymo_hash_flags_get(cpymo_hash_flags *fs, size_t index)
+void cpymo_hash_flags_copy_to(const cpymo_hash_flags *fs, cpymo_hash_flag *out)
 {
-	cpymo_hash_flags_internal *f = (cpymo_hash_flags_internal *)fs->flags;
-	return f[index].key;
-}
\ No newline at end of file
+	if (fs->has_zero) *out++ = 0;
+
+	for (size_t i = 0; i < fs->capacity; ++i)
+		if (fs->slots[i]) *out++ = fs->slots[i];
+}
+
+void cpymo_hash_flags_clear_unsaved(cpymo_hash_flags *fs)
+{
+	if (fs->unsaved) arrsetlen(fs->unsaved, 0);
+	fs->unsaved_deletion = false;
+}
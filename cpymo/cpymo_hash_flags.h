@@ -8,9 +8,18 @@
 
 typedef uint64_t cpymo_hash_flag;
 
+// A flat open addressing set with linear probing,
+// 0 marks an empty slot so flag 0 is kept in has_zero.
 typedef struct {
-	void *flags;
-	bool dirty;
+	cpymo_hash_flag *slots;
+	size_t capacity, count;
+	unsigned shift;
+	bool has_zero;
+
+	// Flags added since cpymo_hash_flags_clear_unsaved,
+	// unsaved_deletion is set if any flag was deleted since then.
+	cpymo_hash_flag *unsaved;
+	bool unsaved_deletion;
 } cpymo_hash_flags;
 
 void cpymo_hash_flags_init(cpymo_hash_flags *);
@@ -18,9 +27,17 @@ void cpymo_hash_flags_free(cpymo_hash_flags *);
 
 error_t cpymo_hash_flags_add(cpymo_hash_flags *, cpymo_hash_flag);
 void cpymo_hash_flags_del(cpymo_hash_flags *, cpymo_hash_flag);
-bool cpymo_hash_flags_check(cpymo_hash_flags *, cpymo_hash_flag);
+bool cpymo_hash_flags_check(const cpymo_hash_flags *, cpymo_hash_flag);
+
+size_t cpymo_hash_flags_count(const cpymo_hash_flags *);
+
+// Adds saved flags with one reservation, they are not marked unsaved.
+// Sorts them in place first so they are inserted in table order.
+error_t cpymo_hash_flags_add_many(cpymo_hash_flags *, cpymo_hash_flag *flags, size_t count);
+
+// Copies cpymo_hash_flags_count flags to out in table order.
+void cpymo_hash_flags_copy_to(const cpymo_hash_flags *, cpymo_hash_flag *out);
 
-size_t cpymo_hash_flags_count(cpymo_hash_flags *);
-uint64_t cpymo_hash_flags_get(cpymo_hash_flags *, size_t index);
+void cpymo_hash_flags_clear_unsaved(cpymo_hash_flags *);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,207 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_image_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <assert.h>
+#include "../stb/stb_ds.h"
+
+typedef struct cpymo_image_cache_node {
+	char *key;
+	void *pixels;
+	int w, h;
+	size_t size;
+	struct cpymo_image_cache_node *prev, *next;
+} cpymo_image_cache_node;
+
+typedef struct {
+	char *key;
+	cpymo_image_cache_node *value;
+} cpymo_image_cache_entry;
+
+#define CPYMO_IMAGE_CACHE_MAX_KEY 256
+
+static bool cpymo_image_cache_make_key(
+	char *key, const char *asset_type, cpymo_str name, int channels)
+{
+	size_t len = 0;
+
+#define PUT(CH) { \
+		if (len >= CPYMO_IMAGE_CACHE_MAX_KEY - 1) return false; \
+		key[len++] = (char)tolower((unsigned char)(CH)); \
+	}
+
+	for (const char *p = asset_type; *p; ++p) PUT(*p);
+	PUT('/');
+	for (size_t i = 0; i < name.len; ++i) PUT(name.begin[i]);
+	PUT(':');
+	PUT('0' + channels);
+
+#undef PUT
+
+	key[len] = '\0';
+	return true;
+}
+
+static cpymo_image_cache_node *cpymo_image_cache_find(
+	const cpymo_image_cache *c, const char *key)
+{
+	// stb_ds allocates a header when looking up in an empty map.
+	if (c->entries == NULL) return NULL;
+
+	cpymo_image_cache_entry *entries = (cpymo_image_cache_entry *)c->entries;
+	cpymo_image_cache_entry *e = shgetp_null(entries, key);
+	return e ? e->value : NULL;
+}
+
+static void cpymo_image_cache_unlink(cpymo_image_cache *c, cpymo_image_cache_node *n)
+{
+	if (n->prev) n->prev->next = n->next;
+	else c->head = n->next;
+
+	if (n->next) n->next->prev = n->prev;
+	else c->tail = n->prev;
+
+	n->prev = NULL;
+	n->next = NULL;
+}
+
+static void cpymo_image_cache_link_head(cpymo_image_cache *c, cpymo_image_cache_node *n)
+{
+	n->prev = NULL;
+	n->next = c->head;
+	if (c->head) c->head->prev = n;
+	c->head = n;
+	if (c->tail == NULL) c->tail = n;
+}
+
+static void cpymo_image_cache_remove(cpymo_image_cache *c, cpymo_image_cache_node *n)
+{
+	cpymo_image_cache_entry *entries = (cpymo_image_cache_entry *)c->entries;
+	shdel(entries, n->key);
+	c->entries = (void *)entries;
+
+	cpymo_image_cache_unlink(c, n);
+	c->used -= n->size;
+
+	free(n->pixels);
+	free(n->key);
+	free(n);
+}
+
+static void cpymo_image_cache_evict(cpymo_image_cache *c, size_t max_bytes)
+{
+	while (c->tail && c->used > max_bytes)
+		cpymo_image_cache_remove(c, c->tail);
+}
+
+void cpymo_image_cache_init(cpymo_image_cache *c, size_t budget)
+{
+	c->entries = NULL;
+	c->head = NULL;
+	c->tail = NULL;
+	c->used = 0;
+	c->budget = budget;
+	c->hits = 0;
+	c->misses = 0;
+}
+
+void cpymo_image_cache_free(cpymo_image_cache *c)
+{
+	cpymo_image_cache_clear(c);
+
+	cpymo_image_cache_entry *entries = (cpymo_image_cache_entry *)c->entries;
+	shfree(entries);
+	c->entries = NULL;
+}
+
+void cpymo_image_cache_clear(cpymo_image_cache *c)
+{
+	cpymo_image_cache_evict(c, 0);
+	assert(c->used == 0);
+}
+
+bool cpymo_image_cache_contains(
+	const cpymo_image_cache *c, 
+	const char *asset_type, cpymo_str name, int channels)
+{
+	char key[CPYMO_IMAGE_CACHE_MAX_KEY];
+	if (!cpymo_image_cache_make_key(key, asset_type, name, channels)) return false;
+	return cpymo_image_cache_find(c, key) != NULL;
+}
+
+const void *cpymo_image_cache_get(
+	cpymo_image_cache *c,
+	const char *asset_type, cpymo_str name, int channels,
+	int *w, int *h)
+{
+	char key[CPYMO_IMAGE_CACHE_MAX_KEY];
+	cpymo_image_cache_node *n = NULL;
+	if (cpymo_image_cache_make_key(key, asset_type, name, channels))
+		n = cpymo_image_cache_find(c, key);
+
+	if (n == NULL) {
+		c->misses++;
+		return NULL;
+	}
+
+	*w = n->w;
+	*h = n->h;
+
+	cpymo_image_cache_unlink(c, n);
+	cpymo_image_cache_link_head(c, n);
+	c->hits++;
+
+	return n->pixels;
+}
+
+bool cpymo_image_cache_put(
+	cpymo_image_cache *c,
+	const char *asset_type, cpymo_str name, int channels,
+	void *pixels, int w, int h)
+{
+	size_t size = (size_t)w * (size_t)h * (size_t)channels;
+	if (size == 0 || size > c->budget) return false;
+
+	char key[CPYMO_IMAGE_CACHE_MAX_KEY];
+	if (!cpymo_image_cache_make_key(key, asset_type, name, channels)) return false;
+
+	cpymo_image_cache_node *old = cpymo_image_cache_find(c, key);
+	if (old) cpymo_image_cache_remove(c, old);
+
+	cpymo_image_cache_evict(c, c->budget - size);
+
+	cpymo_image_cache_node *n = 
+		(cpymo_image_cache_node *)malloc(sizeof(cpymo_image_cache_node));
+	if (n == NULL) return false;
+
+	n->key = cpymo_str_copy_malloc(cpymo_str_pure(key));
+	if (n->key == NULL) {
+		free(n);
+		return false;
+	}
+
+	n->pixels = pixels;
+	n->w = w;
+	n->h = h;
+	n->size = size;
+
+	cpymo_image_cache_entry *entries = (cpymo_image_cache_entry *)c->entries;
+	shput(entries, n->key, n);
+	c->entries = (void *)entries;
+
+	cpymo_image_cache_link_head(c, n);
+	c->used += size;
+	return true;
+}
+
+void cpymo_image_cache_print_stats(const cpymo_image_cache *c)
+{
+	uint32_t total = c->hits + c->misses;
+	if (total == 0) return;
+
+	printf("[Info] Image cache: %u hits, %u misses, %u%% hit rate.\n",
+		(unsigned)c->hits, (unsigned)c->misses, 
+		(unsigned)((uint64_t)c->hits * 100 / total));
+}
@@ -0,0 +1,53 @@
+#ifndef INCLUDE_CPYMO_IMAGE_CACHE
+#define INCLUDE_CPYMO_IMAGE_CACHE
+
+#include "cpymo_str.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Keeps decoded pixels of recently loaded bg, chara and system images,
+// keyed by (asset type, name, channels) and bounded by a byte budget,
+// the least recently used images are dropped first.
+// Backend images own their pixels, so the asset loader copies
+// the cached pixels on a hit instead of decoding the file again.
+
+struct cpymo_image_cache_node;
+
+typedef struct cpymo_image_cache {
+	void *entries;
+
+	// Most recently used at head.
+	struct cpymo_image_cache_node *head, *tail;
+
+	size_t used, budget;
+	uint32_t hits, misses;
+} cpymo_image_cache;
+
+void cpymo_image_cache_init(cpymo_image_cache *c, size_t budget);
+void cpymo_image_cache_free(cpymo_image_cache *c);
+
+// Drops all images, used when the system is low on memory.
+void cpymo_image_cache_clear(cpymo_image_cache *c);
+
+bool cpymo_image_cache_contains(
+	const cpymo_image_cache *c, 
+	const char *asset_type, cpymo_str name, int channels);
+
+// Returns the cached pixels, owned by the cache and valid until
+// it is changed, NULL if not cached.
+const void *cpymo_image_cache_get(
+	cpymo_image_cache *c,
+	const char *asset_type, cpymo_str name, int channels,
+	int *w, int *h);
+
+// Takes the malloc'd pixels without copying them.
+// Returns false if they are not cached, then they still belong to the caller.
+bool cpymo_image_cache_put(
+	cpymo_image_cache *c,
+	const char *asset_type, cpymo_str name, int channels,
+	void *pixels, int w, int h);
+
+void cpymo_image_cache_print_stats(const cpymo_image_cache *c);
+
+#endif
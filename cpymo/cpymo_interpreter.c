@@ -11,7 +11,6 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <setjmp.h>
 #include <assert.h>
 #include <ctype.h>
 
@@ -25,6 +24,8 @@ void cpymo_interpreter_init(
 {
 	out->script = script;
 	out->own_script = own_script;
+	out->script_cache = NULL;
+	out->var_slots = NULL;
 	cpymo_parser_init(
 		&out->script_parser, 
 		out->script->script_content, 
@@ -41,37 +42,52 @@ error_t cpymo_interpreter_init_script(
 	cpymo_interpreter *caller)
 {	
 	out->script = NULL;
-	out->own_script = true;
+	out->own_script = false;
+	out->script_cache = NULL;
+	out->var_slots = NULL;
 
-	cpymo_interpreter *find_script = caller;
-	while (find_script) {
-		if (cpymo_str_equals_str(script_name, find_script->script->script_name)) {
-			out->script = find_script->script;
-			out->own_script = false;
-			break;
-		}
-		find_script = find_script->caller;
-	}
-
-	if (out->script == NULL) {
-		error_t err = cpymo_script_load(&out->script, script_name, loader);
-		if (err != CPYMO_ERR_SUCC) {
-			out->own_script = false;
-			return err;
-		}
-	}
+	cpymo_script *script = NULL;
+	cpymo_script_cache *cache = loader->script_cache;
+	error_t err = cache
+		? cpymo_script_cache_acquire(cache, &script, script_name, loader)
+		: cpymo_script_load(&script, script_name, loader);
+	CPYMO_THROW(err);
 
-	cpymo_interpreter_init(out, out->script, out->own_script, caller);
+	cpymo_interpreter_init(out, script, true, caller);
+	out->script_cache = cache;
 
 	return CPYMO_ERR_SUCC;
 }
 
+static void cpymo_interpreter_release_script(cpymo_interpreter *interpreter)
+{
+	free(interpreter->var_slots);
+	interpreter->var_slots = NULL;
+
+	if (!interpreter->own_script) return;
+
+	if (interpreter->script_cache)
+		cpymo_script_cache_release(interpreter->script_cache, interpreter->script);
+	else cpymo_script_free(interpreter->script);
+}
+
 error_t cpymo_interpreter_goto_line(cpymo_interpreter * interpreter, uint64_t line)
 {
-	cpymo_parser_reset(&interpreter->script_parser);
-	while (line != interpreter->script_parser.cur_line)
-		if (!cpymo_parser_next_line(&interpreter->script_parser))
-			return CPYMO_ERR_NO_MORE_CONTENT;
+	// Seek with the line records instead of parsing every line before it,
+	// a line past the end leaves the parser at the end of the script.
+	const cpymo_script *s = interpreter->script;
+	cpymo_parser *p = &interpreter->script_parser;
+	cpymo_parser_reset(p);
+
+	const size_t seek = line < s->line_count ? (size_t)line : s->line_count - 1;
+	p->cur_line = seek;
+	p->cur_pos = s->lines[seek].offset;
+
+	if (seek != line) {
+		while (cpymo_parser_next_line(p));
+		return CPYMO_ERR_NO_MORE_CONTENT;
+	}
+
 	return CPYMO_ERR_SUCC;
 }
 
@@ -82,96 +98,220 @@ void cpymo_interpreter_free(cpymo_interpreter * interpreter)
 		cpymo_interpreter *to_free = caller;
 		caller = caller->caller;
 
-		if (to_free->own_script)
-			cpymo_script_free(to_free->script);
+		cpymo_interpreter_release_script(to_free);
 		free(to_free);
 	}
 
-	if (interpreter->own_script)
-		cpymo_script_free(interpreter->script);
+	cpymo_interpreter_release_script(interpreter);
+}
+
+static cpymo_var_slot cpymo_interpreter_var_slot(
+	cpymo_engine *engine, cpymo_interpreter *interpreter, const cpymo_script_arg *arg)
+{
+	const cpymo_script *s = interpreter->script;
+	if (interpreter->var_slots == NULL) {
+		interpreter->var_slots = 
+			(cpymo_var_slot *)calloc(s->var_count, sizeof(cpymo_var_slot));
+
+		// Out of memory, intern it every time.
+		if (interpreter->var_slots == NULL) 
+			return cpymo_vars_intern(&engine->vars, cpymo_script_arg_str(s, arg));
+	}
+
+	// Interned once per cell, later runs use the cached slot.
+	cpymo_var_slot *slot = &interpreter->var_slots[arg->var];
+	if (*slot == CPYMO_VAR_SLOT_NONE)
+		*slot = cpymo_vars_intern(&engine->vars, cpymo_script_arg_str(s, arg));
+
+	return *slot;
+}
+
+static cpymo_val cpymo_interpreter_eval_arg(
+	cpymo_engine *engine, cpymo_interpreter *interpreter, const cpymo_script_arg *arg)
+{
+	const bool interned = 
+		interpreter->var_slots && interpreter->var_slots[arg->var] != CPYMO_VAR_SLOT_NONE;
+	if (!interned && cpymo_vars_is_constant(cpymo_script_arg_str(interpreter->script, arg)))
+		return arg->ival;
+
+	return cpymo_vars_get_slot(&engine->vars, cpymo_interpreter_var_slot(engine, interpreter, arg));
+}
+
+static const cpymo_script_line *cpymo_interpreter_current_line(const cpymo_interpreter *interpreter)
+{
+	const cpymo_parser *p = &interpreter->script_parser;
+	if (p->cur_pos >= p->stream.len || p->cur_line >= interpreter->script->line_count)
+		return NULL;
+
+	return &interpreter->script->lines[p->cur_line];
+}
+
+static bool cpymo_interpreter_next_line(cpymo_interpreter *interpreter)
+{
+	cpymo_parser *p = &interpreter->script_parser;
+	const cpymo_script *s = interpreter->script;
+
+	// The parser is already at the beginning of a line or at the last line.
+	if (p->is_line_end || p->cur_line + 1 >= s->line_count)
+		return cpymo_parser_next_line(p);
+
+	p->cur_line++;
+	p->cur_pos = s->lines[p->cur_line].offset;
+	return true;
 }
 
 error_t cpymo_interpreter_goto_label(cpymo_interpreter * interpreter, cpymo_str label)
 {
-	bool retring = false;
-	uint64_t cur_line_num = interpreter->script_parser.cur_line;
+	cpymo_parser *p = &interpreter->script_parser;
+	const cpymo_script *s = interpreter->script;
+
+	size_t line;
+	if (!cpymo_script_find_label(s, label, p->cur_line, &line)) {
+		char label_name[32];
+		cpymo_str_copy(label_name, sizeof(label_name), label);
+		printf("[Error] Can not find label %s in script %s.\n", 
+			label_name, s->script_name);
+		cpymo_interpreter_next_line(interpreter);
+		return CPYMO_ERR_SUCC;
+	}
+
+	p->cur_line = line;
+	p->cur_pos = s->lines[line].offset;
+	p->is_line_end = false;
+	cpymo_interpreter_next_line(interpreter);
+	return CPYMO_ERR_SUCC;
+}
 
-RETRY:
-	while (1) {
-		cpymo_str command = 
-			cpymo_parser_curline_pop_command(&interpreter->script_parser);
+typedef struct {
+	const cpymo_script *script;
+	const cpymo_script_line *line;
+	size_t next;
+} cpymo_interpreter_args;
 
-		if (cpymo_str_equals_str(command, "label")) {
-			cpymo_str cur_label = 
-				cpymo_parser_curline_pop_commacell(&interpreter->script_parser);
+static const cpymo_script_arg *cpymo_interpreter_pop_arg(cpymo_interpreter_args *a)
+{
+	return cpymo_script_get_arg(a->script, a->line, a->next++);
+}
 
-			if (cpymo_str_equals(cur_label, label)) {
-				cpymo_parser_next_line(&interpreter->script_parser);
-				return CPYMO_ERR_SUCC;
-			}
-		}
-		else {
-			if (!cpymo_parser_next_line(&interpreter->script_parser)) {
-				if (retring) {
-					char label_name[32];
-					cpymo_str_copy(label_name, sizeof(label_name), label);
-					printf("[Error] Can not find label %s in script %s.\n", 
-						label_name, interpreter->script->script_name);
-					return cpymo_interpreter_goto_line(interpreter, cur_line_num);
-				}
-				else {
-					cpymo_parser_reset(&interpreter->script_parser);
-					retring = true;
-					goto RETRY;
-				}
-			}
-		}
+// The line the text parser was on after popping these arguments,
+// it consumed the line break with the last one.
+// Selection hashes saved in global save data include it.
+static unsigned cpymo_interpreter_args_line(
+	const cpymo_interpreter_args *a, const cpymo_interpreter *interpreter)
+{
+	const cpymo_script *s = a->script;
+	size_t line = interpreter->script_parser.cur_line;
+
+	if (a->next >= a->line->argc) {
+		if (line + 1 < s->line_count 
+			|| (s->script_content_len && s->script_content[s->script_content_len - 1] == '\n'))
+			line++;
 	}
+
+	return (unsigned)line;
 }
 
-static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *interpreter, cpymo_engine *engine, jmp_buf cont);
+typedef enum {
+	// The command is done, the interpreter moves to the next line.
+	cpymo_interpreter_cont_done,
+
+	// The command moved the interpreter itself or changed engine->interpreter.
+	cpymo_interpreter_cont_jumped,
+
+	// The command runs again in the next step.
+	cpymo_interpreter_cont_retry,
+} cpymo_interpreter_cont;
 
-#define EXEC_CONTVAL_OK 1
-#define EXEC_CONTVAL_INTERPRETER_UPDATED 2
+static error_t cpymo_interpreter_dispatch(const cpymo_script_line *line, cpymo_interpreter *interpreter, cpymo_engine *engine, cpymo_interpreter_cont *cont);
 
 error_t cpymo_interpreter_execute_step(cpymo_interpreter * interpreter, cpymo_engine *engine)
 {
-	jmp_buf cont;
-
-	switch (setjmp(cont)) {
-	case 0: break;
-	case EXEC_CONTVAL_OK: break;
-	case EXEC_CONTVAL_INTERPRETER_UPDATED: interpreter = engine->interpreter; break;
-	default: return CPYMO_ERR_INVALID_ARG;
-	}
-
-	cpymo_str command =
-		cpymo_parser_curline_pop_command(&interpreter->script_parser);
-
-	error_t err = cpymo_interpreter_dispatch(command, interpreter, engine, cont);
-	switch (err) {
-	case CPYMO_ERR_NOT_FOUND:
-	case CPYMO_ERR_CAN_NOT_OPEN_FILE:
-	case CPYMO_ERR_BAD_FILE_FORMAT:
-	case CPYMO_ERR_UNSUPPORTED:
-	case CPYMO_ERR_INVALID_ARG:
-	case CPYMO_ERR_UNKNOWN:
-		printf("[Error] In script \'%s\'(%d): %s\n",
-			interpreter->script->script_name,
-			(int)interpreter->script_parser.cur_line,
-			cpymo_error_message(err));
-		break;
-	default: return err;
-	};
+	error_t err = CPYMO_ERR_SUCC;
+	uint32_t instructions = 0;
+
+	const cpymo_interpreter_budget *budget = &engine->interpreter_budget;
+	const uint32_t max_instructions = budget->instructions ? budget->instructions : 1;
+	const bool timed = budget->clock && budget->time_sec > 0;
+	const double deadline = timed ? budget->clock() + budget->time_sec : 0;
+
+	while (instructions < max_instructions) {
+		interpreter = engine->interpreter;
+		if (interpreter == NULL) {
+			err = CPYMO_ERR_NO_MORE_CONTENT;
+			break;
+		}
 
-	if (!cpymo_parser_next_line(&interpreter->script_parser)) {
-		if (interpreter->no_more_content)
-			return CPYMO_ERR_NO_MORE_CONTENT;
-		else
-			interpreter->no_more_content = true;
+		if (engine->fast_forward 
+			&& cpymo_fast_forward_should_stop(engine->fast_forward, interpreter))
+			break;
+
+		cpymo_parser line_begin = interpreter->script_parser;
+		cpymo_interpreter_cont cont = cpymo_interpreter_cont_done;
+
+		err = cpymo_interpreter_dispatch(
+			cpymo_interpreter_current_line(interpreter), interpreter, engine, &cont);
+		instructions++;
+
+		if (cont == cpymo_interpreter_cont_retry) {
+			interpreter->script_parser = line_begin;
+			break;
+		}
+
+		// Jumped commands already moved the interpreter.
+		if (err != CPYMO_ERR_SUCC || cont != cpymo_interpreter_cont_jumped) {
+			switch (err) {
+			case CPYMO_ERR_SUCC:
+				break;
+			case CPYMO_ERR_NOT_FOUND:
+			case CPYMO_ERR_CAN_NOT_OPEN_FILE:
+			case CPYMO_ERR_BAD_FILE_FORMAT:
+			case CPYMO_ERR_UNSUPPORTED:
+			case CPYMO_ERR_INVALID_ARG:
+			case CPYMO_ERR_UNKNOWN:
+				printf("[Error] In script \'%s\'(%d): %s\n",
+					interpreter->script->script_name,
+					(int)interpreter->script_parser.cur_line,
+					cpymo_error_message(err));
+				err = CPYMO_ERR_SUCC;
+				break;
+			default: goto END;
+			};
+
+			if (!cpymo_interpreter_next_line(interpreter)) {
+				if (interpreter->no_more_content)
+					err = CPYMO_ERR_NO_MORE_CONTENT;
+				else
+					interpreter->no_more_content = true;
+				break;
+			}
+		}
+
+		// Commands that wait or open a UI end the step,
+		// the engine has to update them before the next command runs.
+		if (cpymo_wait_is_wating(&engine->wait) || cpymo_ui_enabled(engine))
+			break;
+
+		// Reading the clock costs more than most commands.
+		if (timed && instructions % 32 == 0 && budget->clock() >= deadline)
+			break;
 	}
 
-	return CPYMO_ERR_SUCC;
+END:
+	engine->interpreter_stats.instructions += instructions;
+	engine->interpreter_stats.steps++;
+	if (instructions > engine->interpreter_stats.max_instructions_per_step)
+		engine->interpreter_stats.max_instructions_per_step = instructions;
+
+	return err;
+}
+
+void cpymo_interpreter_print_stats(const cpymo_interpreter_stats *stats)
+{
+	if (stats->steps == 0) return;
+
+	printf("[Info] Interpreter: %u instructions per step on average, %u at most.\n",
+		(unsigned)(stats->instructions / stats->steps),
+		(unsigned)stats->max_instructions_per_step);
 }
 
 void cpymo_interpreter_checkpoint(cpymo_interpreter * interpreter)
@@ -179,12 +319,16 @@ void cpymo_interpreter_checkpoint(cpymo_interpreter * interpreter)
 	interpreter->checkpoint.cur_line = interpreter->script_parser.cur_line;
 }
 
-#define D(CMD) \
-	else if (cpymo_str_equals_str(command, CMD))
-
 #define POP_ARG(X) \
-	cpymo_str X = cpymo_parser_curline_pop_commacell(&interpreter->script_parser); \
-	cpymo_str_trim(&X)
+	const cpymo_script_arg *X##_arg = cpymo_interpreter_pop_arg(&args); \
+	cpymo_str X = cpymo_script_arg_str(args.script, X##_arg); \
+	(void)X##_arg, (void)X
+
+#define ARG_INT(X) (X##_arg->ival)
+#define ARG_VAR(X) cpymo_interpreter_var_slot(engine, interpreter, X##_arg)
+#define ARG_EVAL(X) cpymo_interpreter_eval_arg(engine, interpreter, X##_arg)
+#define ARG_COLOR(X) (X##_arg->color)
+#define ARG_LINE() cpymo_interpreter_args_line(&args, interpreter)
 
 #define IS_EMPTY(X) \
 	cpymo_str_equals_str(X, "")
@@ -196,25 +340,313 @@ void cpymo_interpreter_checkpoint(cpymo_interpreter * interpreter)
 	float OUT_X = cpymo_str_atof(IN_X) / 100.0f * engine->gameconfig.imagesize_w; \
 	float OUT_Y = cpymo_str_atof(IN_Y) / 100.0f * engine->gameconfig.imagesize_h;
 
-#define CONT_WITH_CURRENT_CONTEXT { longjmp(cont, EXEC_CONTVAL_OK); return CPYMO_ERR_UNKNOWN; }
+#define CONT_WITH_CURRENT_CONTEXT { \
+	*cont = cpymo_interpreter_cont_jumped; \
+	return CPYMO_ERR_SUCC; }
+
+#define AWAIT_ASSETS_AND_RETRY { \
+	cpymo_async_loader_wait(engine); \
+	*cont = cpymo_interpreter_cont_retry; \
+	return CPYMO_ERR_SUCC; }
 
 #define CONT_NEXTLINE { \
-	if (cpymo_parser_next_line(&interpreter->script_parser))	\
-		{ longjmp(cont, EXEC_CONTVAL_OK); return CPYMO_ERR_UNKNOWN; }	\
+	if (cpymo_interpreter_next_line(interpreter)) CONT_WITH_CURRENT_CONTEXT \
 	else return CPYMO_ERR_NO_MORE_CONTENT; }
 
-static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *interpreter, cpymo_engine *engine, jmp_buf cont)
+static error_t cpymo_interpreter_test_condition(
+	const cpymo_script_condition *condition, cpymo_interpreter *interpreter, cpymo_engine *engine, bool *pass)
+{
+	const cpymo_script *s = interpreter->script;
+	*pass = false;
+
+	if (condition->cmp == cpymo_script_cmp_bad) {
+		printf( 
+			"[Error] Bad if expression \"%.*s\" in script %s(%u).\n", 
+			(int)condition->len,
+			s->script_content + condition->begin,
+			s->script_name,
+			(unsigned)interpreter->script_parser.cur_line);
+		return CPYMO_ERR_INVALID_ARG;
+	}
+
+	const cpymo_val lv = condition->left_is_constant ? 
+		condition->left.ival : 
+		cpymo_vars_get_slot(&engine->vars, 
+			cpymo_interpreter_var_slot(engine, interpreter, &condition->left));
+
+	cpymo_val rv;
+	if (condition->right_is_constant) {
+		rv = condition->right.ival;
+	}
+	else {
+		// Unknown variable, the sub command is skipped.
+		const cpymo_val *var = cpymo_vars_access_slot(&engine->vars, 
+			cpymo_interpreter_var_slot(engine, interpreter, &condition->right));
+		if (var == NULL) return CPYMO_ERR_SUCC;
+		else {
+			rv = *var;
+		}
+	}
+
+	switch (condition->cmp) {
+	case cpymo_script_cmp_eq: *pass = lv == rv; break;
+	case cpymo_script_cmp_ne: *pass = lv != rv; break;
+	case cpymo_script_cmp_gt: *pass = lv > rv; break;
+	case cpymo_script_cmp_ge: *pass = lv >= rv; break;
+	case cpymo_script_cmp_lt: *pass = lv < rv; break;
+	case cpymo_script_cmp_le: *pass = lv <= rv; break;
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+// Commands that draw, show text or play audio while fast forwarding,
+// see cpymo_fast_forward.h. The rest run as usual with *handled set to false.
+static error_t cpymo_interpreter_dispatch_fast_forward(const cpymo_script_line *line, cpymo_interpreter *interpreter, cpymo_engine *engine, cpymo_interpreter_cont *cont, bool *handled)
+{
+	error_t err;
+	cpymo_fast_forward *ff = engine->fast_forward;
+
+	cpymo_interpreter_args args;
+	args.script = interpreter->script;
+	args.line = line;
+	args.next = 0;
+
+	*handled = true;
+
+	switch (line->op) {
+	case cpymo_script_op_say:
+	case cpymo_script_op_text:
+	case cpymo_script_op_text_off:
+	case cpymo_script_op_waitkey:
+	case cpymo_script_op_title_dsp:
+	case cpymo_script_op_flash:
+	case cpymo_script_op_quake:
+	case cpymo_script_op_fade_out:
+	case cpymo_script_op_fade_in:
+	case cpymo_script_op_movie:
+	case cpymo_script_op_chara_quake:
+	case cpymo_script_op_chara_down:
+	case cpymo_script_op_chara_up:
+	case cpymo_script_op_chara_anime:
+	case cpymo_script_op_scroll:
+	case cpymo_script_op_anime_on:
+	case cpymo_script_op_anime_off:
+	case cpymo_script_op_wait:
+	case cpymo_script_op_wait_se:
+	case cpymo_script_op_se:
+	case cpymo_script_op_se_stop:
+	case cpymo_script_op_vo:
+	case cpymo_script_op_date:
+		CONT_NEXTLINE;
+
+	case cpymo_script_op_sel:
+	case cpymo_script_op_select_text:
+	case cpymo_script_op_select_var:
+	case cpymo_script_op_select_img:
+	case cpymo_script_op_select_imgs:
+	case cpymo_script_op_load:
+	case cpymo_script_op_album:
+	case cpymo_script_op_music:
+	case cpymo_script_op_config:
+		// Needs the player, fast forward stops before it.
+		ff->interrupted = true;
+		*cont = cpymo_interpreter_cont_retry;
+		return CPYMO_ERR_SUCC;
+
+	case cpymo_script_op_bg: {
+		POP_ARG(bg_name); ENSURE(bg_name);
+		POP_ARG(transition);
+		POP_ARG(time_str);
+		POP_ARG(x_str);
+		POP_ARG(y_str);
+
+		cpymo_album_cg_unlock(engine, bg_name);
+
+		err = cpymo_fast_forward_bg(
+			ff, bg_name, 
+			IS_EMPTY(x_str) ? 0.0f : (float)ARG_INT(x_str),
+			IS_EMPTY(y_str) ? 0.0f : (float)ARG_INT(y_str));
+		CPYMO_THROW(err);
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_chara: {
+		while (true) {
+			POP_ARG(chara_id_or_time_str);
+			POP_ARG(filename);
+			POP_ARG(pos_x_str);
+			POP_ARG(layer_str);
+
+			if (IS_EMPTY(filename) && IS_EMPTY(pos_x_str) && IS_EMPTY(layer_str))
+				break;
+
+			ENSURE(filename);
+			ENSURE(pos_x_str);
+			ENSURE(layer_str);
+
+			err = cpymo_fast_forward_chara(
+				ff, filename, ARG_INT(chara_id_or_time_str), ARG_INT(layer_str), 5,
+				(float)ARG_INT(pos_x_str) / 100.0f * (float)engine->gameconfig.imagesize_w, 0);
+			CPYMO_THROW(err);
+		}
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_chara_y: {
+		POP_ARG(coord_mode_str); ENSURE(coord_mode_str);
+		int coord_mode = ARG_INT(coord_mode_str);
+
+		while (true) {
+			POP_ARG(chara_id_or_time_str);
+			POP_ARG(filename);
+			POP_ARG(pos_x_str);
+			POP_ARG(pos_y_str);
+			POP_ARG(layer_str);
+
+			if (IS_EMPTY(filename) && IS_EMPTY(pos_x_str) && IS_EMPTY(pos_y_str) && IS_EMPTY(layer_str))
+				break;
+
+			ENSURE(filename);
+			ENSURE(pos_x_str);
+			ENSURE(pos_y_str);
+			ENSURE(layer_str);
+
+			POS(pos_x, pos_y, pos_x_str, pos_y_str);
+			err = cpymo_fast_forward_chara(
+				ff, filename, ARG_INT(chara_id_or_time_str), ARG_INT(layer_str), 
+				coord_mode, pos_x, pos_y);
+			CPYMO_THROW(err);
+		}
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_chara_cls: {
+		POP_ARG(id_str); ENSURE(id_str);
+
+		if (cpymo_str_equals_str(id_str, "a"))
+			cpymo_fast_forward_chara_kill_all(ff);
+		else cpymo_fast_forward_chara_kill(ff, ARG_INT(id_str));
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_chara_pos: {
+		POP_ARG(id_str); ENSURE(id_str);
+		POP_ARG(x_str); ENSURE(x_str);
+		POP_ARG(y_str); ENSURE(y_str);
+		POP_ARG(coord_mode_str);
+
+		POS(x, y, x_str, y_str);
+		int coord_mode = IS_EMPTY(coord_mode_str) ? 5 : ARG_INT(coord_mode_str);
+
+		cpymo_fast_forward_chara_pos(ff, ARG_INT(id_str), coord_mode, x, y);
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_chara_scroll: {
+		POP_ARG(coord_mode_str); ENSURE(coord_mode_str);
+		POP_ARG(chara_id_str); ENSURE(chara_id_str);
+		POP_ARG(filename_or_endx); ENSURE(filename_or_endx);
+		POP_ARG(startx_str_or_endy); ENSURE(startx_str_or_endy);
+		POP_ARG(starty_str_or_time); ENSURE(starty_str_or_time);
+		POP_ARG(endx_str);
+
+		int coord_mode = ARG_INT(coord_mode_str);
+		int chara_id = ARG_INT(chara_id_str);
+
+		// Only where the chara ends up matters.
+		if (!IS_EMPTY(endx_str)) {
+			POP_ARG(endy_str); ENSURE(endy_str);
+			POP_ARG(begin_alpha_str); ENSURE(begin_alpha_str);
+			POP_ARG(layer_str); ENSURE(layer_str);
+
+			POS(endx, endy, endx_str, endy_str);
+			err = cpymo_fast_forward_chara(
+				ff, filename_or_endx, chara_id, ARG_INT(layer_str), coord_mode, endx, endy);
+			CPYMO_THROW(err);
+		}
+		else {
+			POS(endx, endy, filename_or_endx, startx_str_or_endy);
+			cpymo_fast_forward_chara_pos(ff, chara_id, coord_mode, endx, endy);
+		}
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_textbox: {
+		POP_ARG(msg); ENSURE(msg);
+		POP_ARG(name); ENSURE(name);
+
+		err = cpymo_fast_forward_textbox(ff, msg, name);
+		CPYMO_THROW(err);
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_bgm: {
+		POP_ARG(filename); ENSURE(filename);
+		POP_ARG(isloop_s);
+
+		err = cpymo_fast_forward_bgm(ff, filename, !cpymo_str_equals_str(isloop_s, "0"));
+		CPYMO_THROW(err);
+
+		CONT_NEXTLINE;
+	}
+
+	case cpymo_script_op_bgm_stop: {
+		err = cpymo_fast_forward_bgm(ff, cpymo_str_pure(""), false);
+		CPYMO_THROW(err);
+
+		CONT_NEXTLINE;
+	}
+
+	default:
+		*handled = false;
+		return CPYMO_ERR_SUCC;
+	}
+}
+
+static error_t cpymo_interpreter_dispatch(const cpymo_script_line *line, cpymo_interpreter *interpreter, cpymo_engine *engine, cpymo_interpreter_cont *cont)
 {
 	error_t err;
 
-	if (IS_EMPTY(command)) {
+	if (line == NULL) {
 		CONT_NEXTLINE;
 	}
 
+	cpymo_interpreter_args args;
+	args.script = interpreter->script;
+	args.line = line;
+	args.next = 0;
+
+	for (size_t i = 0; i < line->conditions; ++i) {
+		bool pass;
+		err = cpymo_interpreter_test_condition(
+			cpymo_script_get_condition(args.script, line, i), interpreter, engine, &pass);
+		CPYMO_THROW(err);
+
+		if (!pass) CONT_NEXTLINE;
+	}
+
+	if (engine->fast_forward) {
+		bool handled;
+		err = cpymo_interpreter_dispatch_fast_forward(line, interpreter, engine, cont, &handled);
+		if (handled) return err;
+	}
+
+	switch (line->op) {
+	case cpymo_script_op_none:
+		CONT_NEXTLINE;
+
 	/*** I. Text ***/
-	D("say") {
+	case cpymo_script_op_say: {
 		cpymo_fade_reset(&engine->fade);
 		cpymo_interpreter_checkpoint(interpreter);
+		cpymo_rollback_record(engine);
 
 		POP_ARG(name_or_text);
 		POP_ARG(text);
@@ -239,7 +671,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return cpymo_say_start(engine, name_or_text, text);
 	}
 
-	D("text") {
+	case cpymo_script_op_text: {
 		POP_ARG(content); ENSURE(content);
 		POP_ARG(x1_str); ENSURE(x1_str);
 		POP_ARG(y1_str); ENSURE(y1_str);
@@ -248,13 +680,13 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		POP_ARG(y2_str); ENSURE(y2_str);
 		POS(x2, y2, x2_str, y2_str);
 		POP_ARG(col_str); ENSURE(col_str);
-		cpymo_color col = cpymo_str_as_color(col_str);
+		cpymo_color col = ARG_COLOR(col_str);
 		POP_ARG(fontsize_str); ENSURE(fontsize_str);
 		float fontsize = 
 			cpymo_str_atof(fontsize_str) * 
 			engine->gameconfig.imagesize_h / 240.0f * 1.2f;
 		POP_ARG(show_immediately_str);
-		bool show_immediately = cpymo_str_atoi(show_immediately_str) != 0;
+		bool show_immediately = ARG_INT(show_immediately_str) != 0;
 
 		cpymo_engine_extract_text(engine, content);
 		cpymo_engine_extract_text_submit(engine);
@@ -262,19 +694,19 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return cpymo_text_new(engine, x1, y1, x2, y2, col, fontsize, content, show_immediately);
 	}
 
-	D("text_off") {
+	case cpymo_script_op_text_off: {
 		cpymo_engine_request_redraw(engine);
 		cpymo_text_clear(&engine->text);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("waitkey") {
+	case cpymo_script_op_waitkey: {
 		cpymo_engine_request_redraw(engine);
 		cpymo_wait_for_seconds(&engine->wait, 5.0f);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("title") {
+	case cpymo_script_op_title: {
 		POP_ARG(title);
 
 		char *buf = cpymo_str_copy_malloc_trim_memory(engine, title);
@@ -286,7 +718,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		CONT_NEXTLINE;
 	}
 
-	D("title_dsp") {
+	case cpymo_script_op_title_dsp: {
 		if (strlen(engine->title) <= 0)
 			CONT_NEXTLINE;
 
@@ -303,7 +735,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 	}
 
 	/*** II. Video ***/
-	D("chara") {
+	case cpymo_script_op_chara: {
 		int chara_ids[CHARA_BUF_SIZE];
 		int layers[CHARA_BUF_SIZE];
 		float pos_x_s[CHARA_BUF_SIZE];
@@ -317,7 +749,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			POP_ARG(pos_x_str);
 			POP_ARG(layer_str);
 
-			int chara_id_or_time = cpymo_str_atoi(chara_id_or_time_str);
+			int chara_id_or_time = ARG_INT(chara_id_or_time_str);
 			
 			if (IS_EMPTY(filename) && IS_EMPTY(pos_x_str) && IS_EMPTY(layer_str)) {
 				time = (float)chara_id_or_time / 1000.0f;
@@ -335,14 +767,21 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			} 
 			else {
 				chara_ids[command_buffer_size] = chara_id;
-				layers[command_buffer_size] = cpymo_str_atoi(layer_str);
+				layers[command_buffer_size] = ARG_INT(layer_str);
 				pos_x_s[command_buffer_size] =
-					(float)cpymo_str_atoi(pos_x_str) / 100.0f * (float)engine->gameconfig.imagesize_w;
+					(float)ARG_INT(pos_x_str) / 100.0f * (float)engine->gameconfig.imagesize_w;
 				filenames[command_buffer_size] = filename;
 				command_buffer_size++;
 			}
 		}
 
+		bool loading = false;
+		for (size_t i = 0; i < command_buffer_size; ++i)
+			if (!cpymo_str_equals_str(filenames[i], "NULL"))
+				loading |= cpymo_async_loader_request_chara(engine, filenames[i]);
+
+		if (loading) AWAIT_ASSETS_AND_RETRY;
+
 		for (size_t i = 0; i < command_buffer_size; ++i) {
 			if (cpymo_str_equals_str(filenames[i], "NULL")) {
 				cpymo_charas_kill(engine, chara_ids[i], time);
@@ -369,36 +808,39 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("chara_cls") {
+	case cpymo_script_op_chara_cls: {
 		POP_ARG(id_str); ENSURE(id_str);
 		POP_ARG(time_str);
 
-		float time = IS_EMPTY(time_str) ? 0.3f : (float)cpymo_str_atoi(time_str) / 1000.0f;
+		float time = IS_EMPTY(time_str) ? 0.3f : (float)ARG_INT(time_str) / 1000.0f;
 		if (cpymo_str_equals_str(id_str, "a"))
 			cpymo_charas_kill_all(engine, time);
-		else cpymo_charas_kill(engine, cpymo_str_atoi(id_str), time);
+		else cpymo_charas_kill(engine, ARG_INT(id_str), time);
 
 		cpymo_charas_wait(engine);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("chara_pos") {
+	case cpymo_script_op_chara_pos: {
 		POP_ARG(id_str); ENSURE(id_str);
 		POP_ARG(x_str); ENSURE(x_str);
 		POP_ARG(y_str); ENSURE(y_str);
 		POP_ARG(coord_mode_str);
 
-		int id = cpymo_str_atoi(id_str);
+		int id = ARG_INT(id_str);
 		POS(x, y, x_str, y_str);
 
-		int coord_mode = IS_EMPTY(coord_mode_str) ? 5 : cpymo_str_atoi(coord_mode_str);
+		int coord_mode = IS_EMPTY(coord_mode_str) ? 5 : ARG_INT(coord_mode_str);
 
 		cpymo_charas_pos(engine, id, coord_mode, x, y);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("bg") {
+	case cpymo_script_op_bg: {
 		POP_ARG(bg_name); ENSURE(bg_name);
+		if (cpymo_async_loader_request_bg(engine, bg_name)) 
+			AWAIT_ASSETS_AND_RETRY;
+
 		POP_ARG(transition);
 		POP_ARG(time_str);
 		POP_ARG(x_str);
@@ -414,12 +856,12 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		else if (cpymo_str_equals_str(time_str, "BG_SLOW")) time = 0.5f;
 		else if (cpymo_str_equals_str(time_str, "BG_VERYSLOW")) time = 1.0f;
 		else if (!IS_EMPTY(time_str))
-			time = (float)cpymo_str_atoi(time_str) / 1000.0f;
+			time = (float)ARG_INT(time_str) / 1000.0f;
 		else time = 0.3f;
 		
 
-		if (IS_EMPTY(x_str)) x = 0.0f; else x = (float)cpymo_str_atoi(x_str);
-		if (IS_EMPTY(y_str)) y = 0.0f; else y = (float)cpymo_str_atoi(y_str);
+		if (IS_EMPTY(x_str)) x = 0.0f; else x = (float)ARG_INT(x_str);
+		if (IS_EMPTY(y_str)) y = 0.0f; else y = (float)ARG_INT(y_str);
 
 		if (IS_EMPTY(transition)) {
 			transition.begin = "BG_ALPHA";
@@ -439,19 +881,19 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return err;
 	}
 
-	D("flash") {
+	case cpymo_script_op_flash: {
 		POP_ARG(col_str); ENSURE(col_str);
 		POP_ARG(time_str); ENSURE(time_str);
 
-		cpymo_color col = cpymo_str_as_color(col_str);
-		float time = cpymo_str_atoi(time_str) / 1000.0f;
+		cpymo_color col = ARG_COLOR(col_str);
+		float time = ARG_INT(time_str) / 1000.0f;
 
 		cpymo_flash_start(engine, col, time);
 
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("quake") {
+	case cpymo_script_op_quake: {
 		static float offsets[] = { -1, -2, 4, 3, 6, -4, 5, 3, 2, -1, 0, 0 };
 		cpymo_charas_play_anime(
 			engine, 0.06f, 1, offsets,
@@ -461,25 +903,25 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("fade_out") {
+	case cpymo_script_op_fade_out: {
 		POP_ARG(col_str); ENSURE(col_str);
 		POP_ARG(time_str); ENSURE(time_str);
 
-		cpymo_color col = cpymo_str_as_color(col_str);
-		float time = cpymo_str_atoi(time_str) / 1000.0f;
+		cpymo_color col = ARG_COLOR(col_str);
+		float time = ARG_INT(time_str) / 1000.0f;
 
 		cpymo_fade_start_fadeout(engine, time, col);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("fade_in") {
+	case cpymo_script_op_fade_in: {
 		POP_ARG(time_str); ENSURE(time_str);
-		float time = cpymo_str_atoi(time_str) / 1000.0f;
+		float time = ARG_INT(time_str) / 1000.0f;
 		cpymo_fade_start_fadein(engine, time);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("movie") {
+	case cpymo_script_op_movie: {
 		POP_ARG(movie_name);
 
 		if (engine->gameconfig.playvideo) {
@@ -494,7 +936,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		}
 	}
 
-	D("textbox") {
+	case cpymo_script_op_textbox: {
 		POP_ARG(msg); ENSURE(msg);
 		POP_ARG(name); ENSURE(name);
 
@@ -507,7 +949,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 	}
 
 	#define CHARA_QUAKE(NAME, ...) \
-		D(NAME) { \
+		case cpymo_script_op_##NAME: { \
 			static float offsets[] = { __VA_ARGS__}; \
 			cpymo_charas_play_anime( \
 				engine, 0.1f, 1, \
@@ -519,23 +961,23 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 				POP_ARG(id); \
 				if (IS_EMPTY(id)) break; \
 				\
-				cpymo_charas_set_play_anime(&engine->charas, cpymo_str_atoi(id)); \
+				cpymo_charas_set_play_anime(&engine->charas, ARG_INT(id)); \
 			} \
 			\
 			return CPYMO_ERR_SUCC; \
 		}
 
-	CHARA_QUAKE("chara_quake", -10, 3, 10, 3, -6, 2, 5, 2, -4, 1, 3, 0, -1, 0, 0, 0)
-	CHARA_QUAKE("chara_down", 0, 7, 0, 16, 0, 12, 0, 16, 0, 7, 0, 0)
-	CHARA_QUAKE("chara_up", 0, -16, 0, 0, 0, -6, 0, 0)
+	CHARA_QUAKE(chara_quake, -10, 3, 10, 3, -6, 2, 5, 2, -4, 1, 3, 0, -1, 0, 0, 0)
+	CHARA_QUAKE(chara_down, 0, 7, 0, 16, 0, 12, 0, 16, 0, 7, 0, 0)
+	CHARA_QUAKE(chara_up, 0, -16, 0, 0, 0, -6, 0, 0)
 	#undef CHARA_QUAKE
 
-	D("chara_anime") {
+	case cpymo_script_op_chara_anime: {
 		POP_ARG(id_str); ENSURE(id_str);
 		POP_ARG(peroid_str); ENSURE(peroid_str);
 		POP_ARG(loop_str); ENSURE(loop_str);
 
-		int loops = cpymo_str_atoi(loop_str);
+		int loops = ARG_INT(loop_str);
 
 		float *buffer = (float *)malloc(64 * sizeof(float));
 		if (buffer == NULL) return CPYMO_ERR_OUT_OF_MEM;
@@ -548,8 +990,8 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			POP_ARG(y_str); 
 			if (IS_EMPTY(y_str)) break;
 
-			float x = (float)cpymo_str_atoi(x_str);
-			float y = (float)cpymo_str_atoi(y_str);
+			float x = (float)ARG_INT(x_str);
+			float y = (float)ARG_INT(y_str);
 			buffer[offsets * 2] = x;
 			buffer[offsets * 2 + 1] = y;
 			offsets++;
@@ -558,13 +1000,13 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		if (offsets > 0 || loops <= 0) {
 			cpymo_charas_play_anime(
 				engine,
-				(float)cpymo_str_atoi(peroid_str) / 1000.0f,
+				(float)ARG_INT(peroid_str) / 1000.0f,
 				loops,
 				buffer,
 				offsets,
 				true);
 
-			cpymo_charas_set_play_anime(&engine->charas, cpymo_str_atoi(id_str));
+			cpymo_charas_set_play_anime(&engine->charas, ARG_INT(id_str));
 
 			return CPYMO_ERR_SUCC;
 		}
@@ -578,7 +1020,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		}
 	}
 
-	D("scroll") {
+	case cpymo_script_op_scroll: {
 		POP_ARG(filename); ENSURE(filename);
 		POP_ARG(sx_str); ENSURE(sx_str);
 		POP_ARG(sy_str); ENSURE(sy_str);
@@ -588,16 +1030,16 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 		cpymo_album_cg_unlock(engine, filename);
 
-		float sx = (float)cpymo_str_atoi(sx_str);
-		float sy = (float)cpymo_str_atoi(sy_str);
-		float ex = (float)cpymo_str_atoi(ex_str);
-		float ey = (float)cpymo_str_atoi(ey_str);
-		float time = (float)cpymo_str_atoi(time_str) / 1000.0f;
+		float sx = (float)ARG_INT(sx_str);
+		float sy = (float)ARG_INT(sy_str);
+		float ex = (float)ARG_INT(ex_str);
+		float ey = (float)ARG_INT(ey_str);
+		float time = (float)ARG_INT(time_str) / 1000.0f;
 
 		return cpymo_scroll_start(engine, filename, sx, sy, ex, ey, time);
 	}
 
-	D("chara_y") {
+	case cpymo_script_op_chara_y: {
 		int chara_ids[CHARA_BUF_SIZE];
 		int layers[CHARA_BUF_SIZE];
 		float pos_x_s[CHARA_BUF_SIZE];
@@ -606,7 +1048,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		size_t command_buffer_size = 0;
 
 		POP_ARG(coord_mode_str); ENSURE(coord_mode_str);
-		int coord_mode = cpymo_str_atoi(coord_mode_str);
+		int coord_mode = ARG_INT(coord_mode_str);
 
 		float time = 0.3f;
 		while (true) {
@@ -616,7 +1058,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			POP_ARG(pos_y_str);
 			POP_ARG(layer_str);
 
-			int chara_id_or_time = cpymo_str_atoi(chara_id_or_time_str);
+			int chara_id_or_time = ARG_INT(chara_id_or_time_str);
 
 			if (IS_EMPTY(filename) && IS_EMPTY(pos_x_str) && IS_EMPTY(pos_y_str) && IS_EMPTY(layer_str)) {
 				time = (float)chara_id_or_time / 1000.0f;
@@ -635,7 +1077,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			}
 			else {
 				chara_ids[command_buffer_size] = chara_id;
-				layers[command_buffer_size] = cpymo_str_atoi(layer_str);
+				layers[command_buffer_size] = ARG_INT(layer_str);
 				POS(pos_x, pos_y, pos_x_str, pos_y_str);
 				pos_x_s[command_buffer_size] = pos_x;
 				pos_y_s[command_buffer_size] = pos_y;
@@ -670,7 +1112,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("chara_scroll") {
+	case cpymo_script_op_chara_scroll: {
 		POP_ARG(coord_mode_str); ENSURE(coord_mode_str);
 		POP_ARG(chara_id_str); ENSURE(chara_id_str);
 		POP_ARG(filename_or_endx); ENSURE(filename_or_endx);
@@ -678,8 +1120,8 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		POP_ARG(starty_str_or_time); ENSURE(starty_str_or_time);
 		POP_ARG(endx_str);
 
-		int coord_mode = cpymo_str_atoi(coord_mode_str);
-		int chara_id = cpymo_str_atoi(chara_id_str);
+		int coord_mode = ARG_INT(coord_mode_str);
+		int chara_id = ARG_INT(chara_id_str);
 
 		if (!IS_EMPTY(endx_str)) {
 
@@ -690,9 +1132,9 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 			POS(startx, starty, startx_str_or_endy, starty_str_or_time);
 			POS(endx, endy, endx_str, endy_str);
-			int layer = cpymo_str_atoi(layer_str);
-			float begin_alpha = 1.0f - (float)cpymo_str_atoi(begin_alpha_str) / 255.0f;
-			float time = (float)cpymo_str_atoi(time_str) / 1000.0f;
+			int layer = ARG_INT(layer_str);
+			float begin_alpha = 1.0f - (float)ARG_INT(begin_alpha_str) / 255.0f;
+			float time = (float)ARG_INT(time_str) / 1000.0f;
 
 			struct cpymo_chara *c = NULL;
 			err = cpymo_charas_new_chara(
@@ -715,7 +1157,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		}
 		else {
 			POS(endx, endy, filename_or_endx, startx_str_or_endy);
-			float time = (float)cpymo_str_atoi(starty_str_or_time) / 1000.0f;
+			float time = (float)ARG_INT(starty_str_or_time) / 1000.0f;
 
 			struct cpymo_chara *c = NULL;
 			err = cpymo_charas_find(
@@ -740,7 +1182,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("anime_on") {
+	case cpymo_script_op_anime_on: {
 #ifdef LOW_FRAME_RATE
 		CONT_NEXTLINE;
 #endif
@@ -751,10 +1193,13 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		POP_ARG(interval_str); ENSURE(interval_str);
 		POP_ARG(is_loop_s); ENSURE(is_loop_s);
 
-		int frames = cpymo_str_atoi(frames_str);
+		if (cpymo_async_loader_request_system_image(engine, filename, true))
+			AWAIT_ASSETS_AND_RETRY;
+
+		int frames = ARG_INT(frames_str);
 		
-		float interval = cpymo_str_atoi(interval_str) / 1000.0f;
-		bool is_loop = cpymo_str_atoi(is_loop_s) != 0;
+		float interval = ARG_INT(interval_str) / 1000.0f;
+		bool is_loop = ARG_INT(is_loop_s) != 0;
 
 		POS(x, y, x_str, y_str);
 
@@ -769,7 +1214,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		CONT_NEXTLINE;
 	}
 	
-	D("anime_off") {
+	case cpymo_script_op_anime_off: {
 #ifdef LOW_FRAME_RATE
 		CONT_NEXTLINE;
 #endif
@@ -778,45 +1223,42 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 	}
 
 	/*** III. Variables, Selection, Jump ***/
-	D("set") {
+	case cpymo_script_op_set: {
 		POP_ARG(name); ENSURE(name);
 		POP_ARG(value_str); ENSURE(value_str);
 
-		err = cpymo_vars_set(
-			&engine->vars, name, 
-			cpymo_vars_eval(&engine->vars, value_str));
+		err = cpymo_vars_set_slot(
+			&engine->vars, ARG_VAR(name), ARG_EVAL(value_str));
 		CPYMO_THROW(err);
 			
 		CONT_NEXTLINE;
 	}
 
-	D("add") {
+	case cpymo_script_op_add: {
 		POP_ARG(name); ENSURE(name);
 		POP_ARG(value); ENSURE(value);
 
-		err = cpymo_vars_add(&engine->vars, name, 
-			cpymo_vars_eval(&engine->vars, value));
+		err = cpymo_vars_add_slot(&engine->vars, ARG_VAR(name), ARG_EVAL(value));
 		CPYMO_THROW(err);
 
 		CONT_NEXTLINE;
 	}
 
-	D("sub") {
+	case cpymo_script_op_sub: {
 		POP_ARG(name); ENSURE(name);
 		POP_ARG(value); ENSURE(value);
 
-		err = cpymo_vars_add(&engine->vars, name, 
-			-cpymo_vars_eval(&engine->vars, value));
+		err = cpymo_vars_add_slot(&engine->vars, ARG_VAR(name), -ARG_EVAL(value));
 		CPYMO_THROW(err);
 
 		CONT_NEXTLINE;
 	}
 
-	D("label") {
+	case cpymo_script_op_label: {
 		CONT_NEXTLINE;
 	}
 
-	D("goto") {
+	case cpymo_script_op_goto: {
 		POP_ARG(label);
 		ENSURE(label);
 		err = cpymo_interpreter_goto_label(interpreter, label);
@@ -825,140 +1267,31 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		CONT_WITH_CURRENT_CONTEXT;
 	}
 
-	D("change") {
+	case cpymo_script_op_change: {
 		POP_ARG(script_name);
 		ENSURE(script_name);
 
-		bool own_script = interpreter->own_script;
-		interpreter->own_script = false;
-		cpymo_script *script = interpreter->script;
-		cpymo_interpreter *caller = interpreter->caller;
-		interpreter->caller = NULL;
-		cpymo_interpreter_free(interpreter);
+		// The old script is released after the new one is acquired,
+		// script_name points into it.
+		cpymo_interpreter prev = *interpreter;
 		err = cpymo_interpreter_init_script(
-			interpreter, script_name, &engine->assetloader, caller);
-		if (own_script) cpymo_script_free(script);
-		CPYMO_THROW(err);
-
-		CONT_WITH_CURRENT_CONTEXT;
-	}
-
-	D("if") {
-		POP_ARG(condition); ENSURE(condition);
-
-		cpymo_parser parser;
-		cpymo_parser_init(&parser, condition.begin, condition.len);
-
-		cpymo_str left;
-		left.begin = condition.begin;
-		left.len = 0;
-
-		while (left.len < condition.len) {
-			char ch = left.begin[left.len];
-			if (ch == '>' || ch == '<' || ch == '=' || ch == '!') 
-				break;
-			left.len++;
-		}
-
-		if (left.len >= condition.len) goto BAD_EXPRESSION;
-
-		cpymo_str op;
-		op.begin = left.begin + left.len;
-		op.len = 1;
-
-		if (op.begin[0] == '!') {
-			op.len++;
-			if (op.len + left.len >= condition.len) goto BAD_EXPRESSION;
-			if (op.begin[1] != '=') goto BAD_EXPRESSION;
-		}
-
-		if ((op.begin[0] == '>' || op.begin[0] == '<')) {
-			if (op.len + 1 + left.len < condition.len) {
-				if (op.begin[1] == '=')
-					op.len++;
-			}
-		}
-
-		if ((op.begin[0] == '<')) {
-			if (op.len + 1 + left.len < condition.len) {
-				if (op.begin[1] == '>')
-					op.len++;
-			}
-		}
-
-		cpymo_str right;
-		right.begin = op.begin + op.len;
-		right.len = condition.len - op.len - left.len;
-
-		cpymo_str_trim(&left);
-		cpymo_str_trim(&op);
-		cpymo_str_trim(&right);
-
-		if (IS_EMPTY(left) || IS_EMPTY(right) || IS_EMPTY(op)) 
-			goto BAD_EXPRESSION;
-
-		const int lv = cpymo_vars_eval(&engine->vars, left);
-
-		int rv;
-		if (cpymo_vars_is_constant(right)) {
-			rv = cpymo_str_atoi(right);
-		}
-		else {
-			const cpymo_val *var = cpymo_vars_access(&engine->vars, right);
-			if (var == NULL) { CONT_NEXTLINE; }
-			else {
-				rv = *var;
-			}
+			interpreter, script_name, &engine->assetloader, prev.caller);
+		if (err != CPYMO_ERR_SUCC) {
+			*interpreter = prev;
+			return err;
 		}
 
-		bool run_sub_command;
-		if (cpymo_str_equals_str(op, "="))
-			run_sub_command = lv == rv;
-		else if (cpymo_str_equals_str(op, "!=") || cpymo_str_equals_str(op, "<>"))
-			run_sub_command = lv != rv;
-		else if (cpymo_str_equals_str(op, ">"))
-			run_sub_command = lv > rv;
-		else if (cpymo_str_equals_str(op, ">="))
-			run_sub_command = lv >= rv;
-		else if (cpymo_str_equals_str(op, "<"))
-			run_sub_command = lv < rv;
-		else if (cpymo_str_equals_str(op, "<="))
-			run_sub_command = lv <= rv;
-		else goto BAD_EXPRESSION;
-
-		if (run_sub_command) {
-			while (!interpreter->script_parser.is_line_end) {
-				// Skip blanks
-				char ch = cpymo_parser_curline_peek(&interpreter->script_parser);
-				if (ch == ' ' || ch == '\t')
-					cpymo_parser_curline_readchar(&interpreter->script_parser);
-				else break;
-			}
-
-			cpymo_str sub_command =
-				cpymo_parser_curline_readuntil_or(&interpreter->script_parser, ' ', '\t');
+		prev.caller = NULL;
+		cpymo_interpreter_free(&prev);
 
-			cpymo_str_trim(&sub_command);
-			return cpymo_interpreter_dispatch(sub_command, interpreter, engine, cont);
-		}
-		
-
-		CONT_NEXTLINE;
-
-		BAD_EXPRESSION: {
-			char *condition_str = cpymo_str_copy_malloc(condition);
-			if (condition_str == NULL) return CPYMO_ERR_OUT_OF_MEM;
-			printf( 
-				"[Error] Bad if expression \"%s\" in script %s(%u).\n", 
-				condition_str,
-				interpreter->script->script_name,
-				(unsigned)interpreter->script_parser.cur_line);
-			free(condition_str);
-			return CPYMO_ERR_INVALID_ARG;
-		}
+		CONT_WITH_CURRENT_CONTEXT;
 	}
 
-	D("call") {
+	case cpymo_script_op_if:
+		// Conditions are tested above, only an empty condition gets here.
+		return CPYMO_ERR_INVALID_ARG;
+
+	case cpymo_script_op_call: {
 		POP_ARG(script_name);
 		ENSURE(script_name);
 
@@ -976,13 +1309,15 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 		assert(engine->interpreter == interpreter);
 
+		// Returns to the line after #call.
+		cpymo_interpreter_next_line(interpreter);
+
 		engine->interpreter = callee;
 
-		longjmp(cont, EXEC_CONTVAL_INTERPRETER_UPDATED);
-		return CPYMO_ERR_UNKNOWN;
+		CONT_WITH_CURRENT_CONTEXT;
 	}
 
-	D("ret") {
+	case cpymo_script_op_ret: {
 		if (interpreter->caller == NULL) return CPYMO_ERR_NO_MORE_CONTENT;
 
 		assert(engine->interpreter == interpreter);
@@ -990,19 +1325,17 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		// cpymo_interpreter *caller = interpreter->caller;
 
 		engine->interpreter = interpreter->caller;
-		if (interpreter->own_script)
-			cpymo_script_free(interpreter->script);
+		cpymo_interpreter_release_script(interpreter);
 		free(interpreter);
 
-		longjmp(cont, EXEC_CONTVAL_INTERPRETER_UPDATED);
-		return CPYMO_ERR_UNKNOWN;
+		CONT_WITH_CURRENT_CONTEXT;
 	}
 
-	D("sel") {
+	case cpymo_script_op_sel: {
 		cpymo_interpreter_checkpoint(interpreter);
 
 		POP_ARG(choices_str); ENSURE(choices_str);
-		int choices = cpymo_str_atoi(choices_str);
+		int choices = ARG_INT(choices_str);
 
 		POP_ARG(hint_pic);
 
@@ -1067,11 +1400,11 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("select_text") { 
+	case cpymo_script_op_select_text: { 
 		cpymo_interpreter_checkpoint(interpreter);
 
 		POP_ARG(choices_str); ENSURE(choices_str); 
-		const int choices = cpymo_str_atoi(choices_str); 
+		const int choices = ARG_INT(choices_str); 
 		error_t err = cpymo_select_img_configuare_begin(
 			&engine->select_img, (size_t)choices, cpymo_str_pure(""),
 			&engine->assetloader, &engine->gameconfig); 
@@ -1087,7 +1420,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			cpymo_str_hash_append_cstr(&hash, "/");
 
 			char buf[32];
-			sprintf(buf, "%u", (unsigned)interpreter->script_parser.cur_line);
+			sprintf(buf, "%u", ARG_LINE());
 			cpymo_str_hash_append_cstr(&hash, buf);
 			cpymo_str_hash_append_cstr(&hash, "/");
 			sprintf(buf, "%d", i);
@@ -1115,18 +1448,18 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		
 		cpymo_select_img_configuare_end_select_text( 
 			&engine->select_img, &engine->wait, engine, x1, y1, x2, y2,  
-			cpymo_str_as_color(col), 
-			cpymo_str_atoi(init_pos),
+			ARG_COLOR(col), 
+			ARG_INT(init_pos),
 			false); 
 		
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("select_var") {
+	case cpymo_script_op_select_var: {
 		cpymo_interpreter_checkpoint(interpreter);
 
 		POP_ARG(choices_str); ENSURE(choices_str);
-		const int choices = cpymo_str_atoi(choices_str);
+		const int choices = ARG_INT(choices_str);
 		error_t err = cpymo_select_img_configuare_begin(
 			&engine->select_img, (size_t)choices, cpymo_str_pure(""),
 			&engine->assetloader, &engine->gameconfig);
@@ -1143,7 +1476,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 				&hash, interpreter->script->script_name);
 			cpymo_str_hash_append_cstr(&hash, "/");
 			char buf[32];
-			sprintf(buf, "%u", (unsigned)interpreter->script_parser.cur_line);
+			sprintf(buf, "%u", ARG_LINE());
 			cpymo_str_hash_append_cstr(&hash, buf);
 			cpymo_str_hash_append_cstr(&hash, "/");
 			sprintf(buf, "%d", i);
@@ -1153,7 +1486,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 			err = cpymo_select_img_configuare_select_text(
 				&engine->select_img, &engine->assetloader, &engine->gameconfig, &engine->flags,
-				text, cpymo_vars_eval(&engine->vars, expr) != 0, cpymo_select_img_selection_nohint, hash,
+				text, ARG_EVAL(expr) != 0, cpymo_select_img_selection_nohint, hash,
 				cpymo_gameconfig_font_size(&engine->gameconfig));
 			CPYMO_THROW(err);
 		}
@@ -1169,20 +1502,23 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 		cpymo_select_img_configuare_end_select_text(
 			&engine->select_img, &engine->wait, engine, x1, y1, x2, y2,
-			cpymo_str_as_color(col),
-			cpymo_str_atoi(init_pos),
+			ARG_COLOR(col),
+			ARG_INT(init_pos),
 			false);
 
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("select_img") {
+	case cpymo_script_op_select_img: {
 		cpymo_interpreter_checkpoint(interpreter);
 
 		POP_ARG(choices_str); ENSURE(choices_str);
 		POP_ARG(filename); ENSURE(filename);
 
-		size_t choices = (size_t)cpymo_str_atoi(choices_str);
+		if (cpymo_async_loader_request_system_image(engine, filename, true))
+			AWAIT_ASSETS_AND_RETRY;
+
+		size_t choices = (size_t)ARG_INT(choices_str);
 		if (choices) {
 			error_t err = cpymo_select_img_configuare_begin(
 				&engine->select_img, choices, filename, 
@@ -1193,7 +1529,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 				POP_ARG(x_str); ENSURE(x_str);
 				POP_ARG(y_str); ENSURE(y_str);
 				POP_ARG(v_str); ENSURE(v_str);
-				const bool enabled = cpymo_vars_eval(&engine->vars, v_str) != 0;
+				const bool enabled = ARG_EVAL(v_str) != 0;
 				POS(x, y, x_str, y_str);
 
 				uint64_t hash;
@@ -1203,7 +1539,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 					&hash, interpreter->script->script_name);
 				cpymo_str_hash_append_cstr(&hash, "/");
 				char buf[32];
-				sprintf(buf, "%u", (unsigned)interpreter->script_parser.cur_line);
+				sprintf(buf, "%u", ARG_LINE());
 				cpymo_str_hash_append_cstr(&hash, buf);
 				cpymo_str_hash_append_cstr(&hash, "/");
 				sprintf(buf, "%d", (int)i);
@@ -1215,7 +1551,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			}
 
 			POP_ARG(init_position);
-			int init_position_i = cpymo_str_atoi(init_position);
+			int init_position_i = ARG_INT(init_position);
 
 			cpymo_select_img_configuare_end(&engine->select_img, &engine->wait, engine, init_position_i);
 		}
@@ -1224,12 +1560,28 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("select_imgs") {
+	case cpymo_script_op_select_imgs: {
 		cpymo_interpreter_checkpoint(interpreter);
 
 		POP_ARG(choices_str); ENSURE(choices_str);
 
-		size_t choices = (size_t)cpymo_str_atoi(choices_str);
+		size_t choices = (size_t)ARG_INT(choices_str);
+
+		{
+			cpymo_interpreter_args scan = args;
+			bool loading = false;
+			for (size_t i = 0; i < choices; ++i) {
+				cpymo_str filename = cpymo_script_arg_str(
+					scan.script, cpymo_interpreter_pop_arg(&scan));
+				if (IS_EMPTY(filename)) break;
+
+				loading |= cpymo_async_loader_request_system_image(engine, filename, true);
+				scan.next += 3;
+			}
+
+			if (loading) AWAIT_ASSETS_AND_RETRY;
+		}
+
 		if (choices) {
 			error_t err = cpymo_select_img_configuare_begin(
 				&engine->select_img, choices, cpymo_str_pure(""),
@@ -1241,7 +1593,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 				POP_ARG(x_str); ENSURE(x_str);
 				POP_ARG(y_str); ENSURE(y_str);
 				POP_ARG(v_str); ENSURE(v_str);
-				const bool enabled = cpymo_vars_eval(&engine->vars, v_str);
+				const bool enabled = ARG_EVAL(v_str) != 0;
 				POS(x, y, x_str, y_str);
 
 				uint64_t hash;
@@ -1251,7 +1603,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 				cpymo_str_hash_append_cstr(&hash, "/");
 				
 				char buf[32];
-				sprintf(buf, "%u", (unsigned)interpreter->script_parser.cur_line);
+				sprintf(buf, "%u", ARG_LINE());
 				cpymo_str_hash_append_cstr(&hash, buf);
 				cpymo_str_hash_append_cstr(&hash, "/");
 				sprintf(buf, "%d", (int)i);
@@ -1264,7 +1616,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			}
 
 			POP_ARG(init_position);
-			int init_position_i = cpymo_str_atoi(init_position);
+			int init_position_i = ARG_INT(init_position);
 
 			cpymo_select_img_configuare_end(&engine->select_img, &engine->wait, engine, init_position_i);
 		}
@@ -1273,17 +1625,17 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return CPYMO_ERR_SUCC;
 	}
 	
-	D("wait") {
+	case cpymo_script_op_wait: {
 		POP_ARG(wait_ms_str);
 		ENSURE(wait_ms_str);
 
 		cpymo_engine_request_redraw(engine);
-		float wait_sec = (float)cpymo_str_atoi(wait_ms_str) / 1000.0f;
+		float wait_sec = (float)ARG_INT(wait_ms_str) / 1000.0f;
 		cpymo_wait_for_seconds(&engine->wait, wait_sec);
 		return CPYMO_ERR_SUCC;
 	}
 
-	D("wait_se") {
+	case cpymo_script_op_wait_se: {
 		if (cpymo_audio_enabled(engine)) {
 			cpymo_wait_register(&engine->wait, &cpymo_audio_wait_se);
 			return CPYMO_ERR_SUCC;
@@ -1293,13 +1645,13 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		}
 	}
 
-	D("rand") {
+	case cpymo_script_op_rand: {
 		POP_ARG(var_name); ENSURE(var_name);
 		POP_ARG(min_val_str); ENSURE(min_val_str);
 		POP_ARG(max_val_str); ENSURE(max_val_str);
 
-		int min_val = cpymo_str_atoi(min_val_str);
-		int max_val = cpymo_str_atoi(max_val_str);
+		int min_val = ARG_INT(min_val_str);
+		int max_val = ARG_INT(max_val_str);
 
 		if (max_val - min_val <= 0) {
 			printf(
@@ -1310,14 +1662,14 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 			return CPYMO_ERR_INVALID_ARG;
 		}
 
-		err = cpymo_vars_set(&engine->vars, var_name, min_val + rand() % (max_val - min_val + 1));
+		err = cpymo_vars_set_slot(&engine->vars, ARG_VAR(var_name), min_val + rand() % (max_val - min_val + 1));
 		CPYMO_THROW(err);
 
 		CONT_NEXTLINE;
 	}
 
 	/*** IV. Audio ***/
-	D("bgm") {
+	case cpymo_script_op_bgm: {
 		POP_ARG(filename); ENSURE(filename);
 		POP_ARG(isloop_s);
 
@@ -1335,12 +1687,12 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		CONT_NEXTLINE;
 	}
 
-	D("bgm_stop") {
+	case cpymo_script_op_bgm_stop: {
 		cpymo_audio_bgm_stop(engine);
 		CONT_NEXTLINE;
 	}
 
-	D("se") {
+	case cpymo_script_op_se: {
 		POP_ARG(filename); ENSURE(filename);
 		POP_ARG(isloop_s);
 
@@ -1361,12 +1713,12 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		CONT_NEXTLINE;
 	}
 
-	D("se_stop") {
+	case cpymo_script_op_se_stop: {
 		cpymo_audio_se_stop(engine);
 		CONT_NEXTLINE;
 	}
 
-	D("vo") {
+	case cpymo_script_op_vo: {
 		POP_ARG(filename); ENSURE(filename);
 
 		if (!cpymo_engine_skipping(engine)) {
@@ -1388,32 +1740,28 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 	}
 
 	/*** V. System ***/
-	D("load") {
+	case cpymo_script_op_load: {
 		POP_ARG(save_id_x);
 
 		if (IS_EMPTY(save_id_x)) {
 			return cpymo_save_ui_enter(engine, true);
 		}
 		else {
-			unsigned short save_id = (unsigned short)cpymo_str_atoi(save_id_x);
-			FILE *file = cpymo_save_open_read(engine, save_id);
-			if (file) {
-				error_t err = cpymo_save_load_savedata(engine, file);
-				if (err != CPYMO_ERR_SUCC) {
-					printf("[Error] Bad save data file: %s\n", cpymo_error_message(err));
-					return CPYMO_ERR_NO_MORE_CONTENT;
-				}
-
-				longjmp(cont, EXEC_CONTVAL_INTERPRETER_UPDATED);
-				return CPYMO_ERR_UNKNOWN;
-			}
-			else {
+			unsigned short save_id = (unsigned short)ARG_INT(save_id_x);
+			error_t err = cpymo_save_load(engine, save_id);
+			if (err == CPYMO_ERR_CAN_NOT_OPEN_FILE) {
 				CONT_NEXTLINE;
 			}
+			else if (err != CPYMO_ERR_SUCC) {
+				printf("[Error] Bad save data file: %s\n", cpymo_error_message(err));
+				return CPYMO_ERR_NO_MORE_CONTENT;
+			}
+
+			CONT_WITH_CURRENT_CONTEXT;
 		}
 	}
 
-	D("album") {
+	case cpymo_script_op_album: {
 		POP_ARG(list_name);
 
 		cpymo_str ui_name;
@@ -1429,11 +1777,11 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return cpymo_album_enter(engine, list_name, ui_name, 0);
 	}
 
-	D("music") {
+	case cpymo_script_op_music: {
 		return cpymo_music_box_enter(engine);
 	}
 
-	D("date") {
+	case cpymo_script_op_date: {
 		int fmonth = cpymo_vars_get(&engine->vars, cpymo_str_pure("FMONTH"));
 		int fdate = cpymo_vars_get(&engine->vars, cpymo_str_pure("FDATE"));
 		char *str = NULL;
@@ -1451,7 +1799,7 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		POS(x, y, x_str, y_str);
 
 		cpymo_color col =
-			cpymo_str_as_color(col_str);
+			ARG_COLOR(col_str);
 
 		err = cpymo_floating_hint_start(
 			engine,
@@ -1463,11 +1811,13 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 		return err;
 	}
 
-	D("config") {
+	case cpymo_script_op_config: {
 		return cpymo_config_ui_enter(engine);
 	}
 	
-	else {
+	default: {
+		POP_ARG(command);
+
 		char buf[32];
 		cpymo_str_copy(buf, 32, command);
 
@@ -1479,4 +1829,5 @@ static error_t cpymo_interpreter_dispatch(cpymo_str command, cpymo_interpreter *
 
 		CONT_NEXTLINE;
 	}
+	}
 }
@@ -5,6 +5,8 @@
 #include "cpymo_error.h"
 #include "cpymo_assetloader.h"
 #include "cpymo_script.h"
+#include "cpymo_script_cache.h"
+#include "cpymo_vars.h"
 
 struct cpymo_engine;
 
@@ -12,8 +14,16 @@ struct cpymo_interpreter {
 	cpymo_script *script;
 	bool own_script;
 
+	// If set, the owned script is released to this cache instead of freed.
+	cpymo_script_cache *script_cache;
+
 	cpymo_parser script_parser;
 
+	// Slots of cells used as variable names, by cpymo_script_arg.var,
+	// interned on first use. Kept here and not in the script,
+	// which is shared through the script cache.
+	cpymo_var_slot *var_slots;
+
 	bool no_more_content;
 
 	struct cpymo_interpreter *caller;
@@ -25,6 +35,42 @@ struct cpymo_interpreter {
 
 typedef struct cpymo_interpreter cpymo_interpreter;
 
+// cpymo_interpreter_execute_step runs commands until one of them waits,
+// opens a UI, or the engine's interpreter_budget is used up.
+// These are the defaults of cpymo_interpreter_budget_init.
+#ifndef CPYMO_INTERPRETER_INSTRUCTION_BUDGET
+#define CPYMO_INTERPRETER_INSTRUCTION_BUDGET 1024
+#endif
+
+#ifndef CPYMO_INTERPRETER_TIME_BUDGET_SEC
+#define CPYMO_INTERPRETER_TIME_BUDGET_SEC 0.004
+#endif
+
+// Returns seconds since any fixed point.
+typedef double (*cpymo_interpreter_clock)(void);
+
+typedef struct {
+	// Commands per step, at least one command runs.
+	uint32_t instructions;
+
+	// Time per step, only capped if the backend sets clock
+	// and time_sec is greater than 0.
+	double time_sec;
+	cpymo_interpreter_clock clock;
+} cpymo_interpreter_budget;
+
+static inline void cpymo_interpreter_budget_init(cpymo_interpreter_budget *b)
+{
+	b->instructions = CPYMO_INTERPRETER_INSTRUCTION_BUDGET;
+	b->time_sec = CPYMO_INTERPRETER_TIME_BUDGET_SEC;
+	b->clock = NULL;
+}
+
+typedef struct {
+	uint64_t instructions, steps;
+	uint32_t max_instructions_per_step;
+} cpymo_interpreter_stats;
+
 void cpymo_interpreter_init(
 	cpymo_interpreter *out, 
 	cpymo_script *script, 
@@ -42,6 +88,8 @@ void cpymo_interpreter_free(cpymo_interpreter *interpreter);
 error_t cpymo_interpreter_goto_label(cpymo_interpreter *interpreter, cpymo_str label);
 error_t cpymo_interpreter_execute_step(cpymo_interpreter *interpreter, struct cpymo_engine *engine);
 
+void cpymo_interpreter_print_stats(const cpymo_interpreter_stats *stats);
+
 void cpymo_interpreter_checkpoint(cpymo_interpreter *interpreter);
 
 error_t cpymo_interpreter_goto_line(cpymo_interpreter *interpreter, uint64_t line);
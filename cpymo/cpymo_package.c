@@ -6,87 +6,295 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <stdint.h>
+#include <ctype.h>
 #include "../endianness.h/endianness.h"
 #include "../stb/stb_image.h"
 #include <assert.h>
 
-error_t cpymo_package_open(cpymo_package *out_package, const char * path)
+#ifdef ENABLE_PACKAGE_PREAD
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#endif
+
+// Reads at an absolute offset without depending on the position of stream,
+// so every reader can keep its own position. With ENABLE_PACKAGE_PREAD
+// this is also safe to call from several threads on the same stream.
+static size_t cpymo_package_read_at(FILE *stream, uint64_t offset, void *dst, size_t size)
 {
-	if (out_package == NULL || path == NULL) return CPYMO_ERR_INVALID_ARG;
-#ifdef DEBUG
-	out_package->has_stream_reader = false;
+#ifdef ENABLE_PACKAGE_PREAD
+	size_t total = 0;
+	const int fd = fileno(stream);
+	while (total < size) {
+		ssize_t n = pread(fd, (char *)dst + total, size - total, (off_t)(offset + total));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		total += (size_t)n;
+	}
+
+	return total;
+#else
+	if (offset > (uint64_t)INT64_MAX || cpymo_utils_fseek64(stream, (int64_t)offset, SEEK_SET) != 0)
+		return 0;
+
+	return fread(dst, 1, size, stream);
 #endif
-	out_package->stream = NULL;
-	out_package->files = NULL;
-	out_package->file_count = 0;
-	out_package->stream = fopen(path, "rb");
-	if (out_package->stream == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+}
 
-	size_t count = 
-		fread(
-			&out_package->file_count, 
-			sizeof(out_package->file_count), 
-			1, 
-			out_package->stream);
+#ifdef ENABLE_PACKAGE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-	out_package->file_count = end_le32toh(out_package->file_count);
+static void cpymo_package_map(cpymo_package *pkg)
+{
+	struct stat st;
+	int fd = fileno(pkg->stream);
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) return;
+	if ((uintmax_t)st.st_size > (uintmax_t)SIZE_MAX) return;
 
-	if (count != 1) {
-		fclose(out_package->stream);
-		out_package->stream = NULL;
-		return CPYMO_ERR_BAD_FILE_FORMAT;
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) return;
+
+	pkg->mapped = (const char *)p;
+	pkg->mapped_size = (size_t)st.st_size;
+}
+
+static void cpymo_package_unmap(cpymo_package *pkg)
+{
+	if (pkg->mapped) munmap((void *)pkg->mapped, pkg->mapped_size);
+}
+#endif
+
+static uint32_t cpymo_package_name_hash(cpymo_str name)
+{
+	uint64_t hash;
+	cpymo_str_hash_init(&hash);
+	for (size_t i = 0; i < name.len; ++i)
+		cpymo_str_hash_step(&hash, (char)tolower((unsigned char)name.begin[i]));
+
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static error_t cpymo_package_build_name_table(cpymo_package *pkg)
+{
+	uint32_t cap = 16;
+	while ((uint64_t)cap < (uint64_t)pkg->file_count * 2) {
+		if (cap > UINT32_MAX / 2) return CPYMO_ERR_OUT_OF_MEM;
+		cap *= 2;
 	}
 
-	if ((uint64_t)out_package->file_count * sizeof(cpymo_package_index) > SIZE_MAX) {
-		fclose(out_package->stream);
-		out_package->stream = NULL;
-		return CPYMO_ERR_OUT_OF_MEM;
+	pkg->name_table = (uint32_t *)calloc(cap, sizeof(uint32_t));
+	if (pkg->name_table == NULL) return CPYMO_ERR_OUT_OF_MEM;
+	pkg->name_table_mask = cap - 1;
+
+	for (uint32_t i = 0; i < pkg->file_count; ++i) {
+		cpymo_str name = cpymo_str_pure(pkg->files[i].file_name);
+
+		uint32_t slot = cpymo_package_name_hash(name) & pkg->name_table_mask;
+		while (pkg->name_table[slot]) {
+			// Keep the first one, the same as linear scanning.
+			if (cpymo_str_equals_str_ignore_case(
+				name, pkg->files[pkg->name_table[slot] - 1].file_name))
+				break;
+
+			slot = (slot + 1) & pkg->name_table_mask;
+		}
+
+		if (pkg->name_table[slot] == 0)
+			pkg->name_table[slot] = i + 1;
 	}
 
-	out_package->files = (cpymo_package_index *)malloc(
-		out_package->file_count == 0 ? 1 :
-		sizeof(cpymo_package_index) * out_package->file_count);
+	return CPYMO_ERR_SUCC;
+}
+
+static uint16_t cpymo_package_le16(const uint8_t *p)
+{
+	uint16_t x;
+	memcpy(&x, p, sizeof(x));
+	return end_le16toh(x);
+}
+
+static uint32_t cpymo_package_le32(const uint8_t *p)
+{
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return end_le32toh(x);
+}
+
+static uint64_t cpymo_package_le64(const uint8_t *p)
+{
+	uint64_t x;
+	memcpy(&x, p, sizeof(x));
+	return end_le64toh(x);
+}
 
-	if (out_package->files == NULL) {
-		fclose(out_package->stream);
-		out_package->stream = NULL;
+static error_t cpymo_package_open_v1(cpymo_package *pkg, uint32_t file_count)
+{
+	const size_t record_size = CPYMO_PACKAGE_V1_INDEX_SIZE;
+	if ((uint64_t)file_count * record_size > SIZE_MAX ||
+		(uint64_t)file_count * sizeof(cpymo_package_index) > SIZE_MAX)
 		return CPYMO_ERR_OUT_OF_MEM;
+
+	// Names are used in place inside the raw index records.
+	pkg->names = (char *)malloc(file_count == 0 ? 1 : file_count * record_size);
+	pkg->files = (cpymo_package_index *)malloc(
+		file_count == 0 ? 1 : sizeof(cpymo_package_index) * file_count);
+	if (pkg->names == NULL || pkg->files == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	if (fread(pkg->names, record_size, file_count, pkg->stream) != file_count)
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	for (uint32_t i = 0; i < file_count; ++i) {
+		char *record = pkg->names + i * record_size;
+		cpymo_package_index *file = &pkg->files[i];
+		record[31] = '\0';
+		file->file_name = record;
+		file->file_offset = cpymo_package_le32((const uint8_t *)record + 32);
+		file->file_length = cpymo_package_le32((const uint8_t *)record + 36);
+		file->stored_length = file->file_length;
+		file->crc32 = 0;
+		file->compression = CPYMO_PACKAGE_COMPRESSION_NONE;
+		file->id = i;
 	}
-	
-	count =
-		fread(
-			out_package->files,
-			sizeof(cpymo_package_index),
-			out_package->file_count,
-			out_package->stream);
-
-	if (count != out_package->file_count) {
-		cpymo_package_close(out_package);
+
+	pkg->version = 1;
+	pkg->file_count = file_count;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_package_open_v2(cpymo_package *pkg)
+{
+	uint8_t header[CPYMO_PACKAGE_V2_HEADER_SIZE - 4];
+	if (fread(header, sizeof(header), 1, pkg->stream) != 1)
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	const uint32_t file_count = cpymo_package_le32(header);
+	const uint64_t index_offset = cpymo_package_le64(header + 4);
+	const uint32_t name_pool_size = cpymo_package_le32(header + 16);
+
+	if ((uint64_t)file_count * CPYMO_PACKAGE_V2_INDEX_SIZE > SIZE_MAX ||
+		(uint64_t)file_count * sizeof(cpymo_package_index) > SIZE_MAX ||
+		(uint64_t)name_pool_size + 1 > SIZE_MAX)
+		return CPYMO_ERR_OUT_OF_MEM;
+
+	const size_t index_size = (size_t)file_count * CPYMO_PACKAGE_V2_INDEX_SIZE;
+	pkg->files = (cpymo_package_index *)malloc(
+		file_count == 0 ? 1 : sizeof(cpymo_package_index) * file_count);
+	pkg->names = (char *)malloc((size_t)name_pool_size + 1);
+	if (pkg->files == NULL || pkg->names == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	uint8_t *index = (uint8_t *)malloc(index_size == 0 ? 1 : index_size);
+	if (index == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	if (cpymo_package_read_at(pkg->stream, index_offset, index, index_size) != index_size ||
+		cpymo_package_read_at(pkg->stream, index_offset + index_size, pkg->names, name_pool_size) != name_pool_size) {
+		free(index);
 		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
 
-	for (uint32_t i = 0; i < out_package->file_count; ++i) {
-		cpymo_package_index *file = &out_package->files[i];
-		file->file_length = end_le32toh(file->file_length);
-		file->file_offset = end_le32toh(file->file_offset);
+	pkg->names[name_pool_size] = '\0';
+
+	for (uint32_t i = 0; i < file_count; ++i) {
+		const uint8_t *record = index + (size_t)i * CPYMO_PACKAGE_V2_INDEX_SIZE;
+		cpymo_package_index *file = &pkg->files[i];
+		file->file_offset = cpymo_package_le64(record);
+		file->stored_length = cpymo_package_le32(record + 8);
+		file->file_length = cpymo_package_le32(record + 12);
+		file->crc32 = cpymo_package_le32(record + 16);
+		const uint32_t name_offset = cpymo_package_le32(record + 20);
+		const uint16_t name_length = cpymo_package_le16(record + 24);
+		file->compression = record[26];
+		file->id = i;
+
+		if (name_length > CPYMO_PACKAGE_V2_MAX_NAME_LENGTH ||
+			(uint64_t)name_offset + name_length >= name_pool_size ||
+			pkg->names[name_offset + name_length] != '\0' ||
+			file->compression > CPYMO_PACKAGE_COMPRESSION_LZ4 ||
+			(file->compression == CPYMO_PACKAGE_COMPRESSION_NONE &&
+				file->stored_length != file->file_length)) {
+			free(index);
+			return CPYMO_ERR_BAD_FILE_FORMAT;
+		}
+
+		file->file_name = pkg->names + name_offset;
+	}
+
+	free(index);
+
+	pkg->crc_state = (uint8_t *)calloc(file_count == 0 ? 1 : file_count, sizeof(uint8_t));
+	if (pkg->crc_state == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	pkg->version = 2;
+	pkg->file_count = file_count;
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_package_open(cpymo_package *out_package, const char * path)
+{
+	if (out_package == NULL || path == NULL) return CPYMO_ERR_INVALID_ARG;
+	out_package->version = 0;
+	out_package->stream = NULL;
+	out_package->files = NULL;
+	out_package->names = NULL;
+	out_package->file_count = 0;
+	out_package->name_table = NULL;
+	out_package->name_table_mask = 0;
+	out_package->mapped = NULL;
+	out_package->mapped_size = 0;
+	out_package->crc_state = NULL;
+	out_package->stream = fopen(path, "rb");
+	if (out_package->stream == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	// Version 1 starts with the file count, which can never be the magic.
+	uint8_t magic[4];
+	error_t err = CPYMO_ERR_BAD_FILE_FORMAT;
+	if (fread(magic, sizeof(magic), 1, out_package->stream) == 1) {
+		if (memcmp(magic, CPYMO_PACKAGE_V2_MAGIC, sizeof(magic)) == 0)
+			err = cpymo_package_open_v2(out_package);
+		else
+			err = cpymo_package_open_v1(out_package, cpymo_package_le32(magic));
+	}
+
+	if (err == CPYMO_ERR_SUCC)
+		err = cpymo_package_build_name_table(out_package);
+
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_package_close(out_package);
+		return err;
 	}
 
+#ifdef ENABLE_PACKAGE_MMAP
+	cpymo_package_map(out_package);
+#endif
+
 	return CPYMO_ERR_SUCC;
 }
 
 void cpymo_package_close(cpymo_package * package)
 {
 	if (package == NULL) return;
+#ifdef ENABLE_PACKAGE_MMAP
+	cpymo_package_unmap(package);
+#endif
 	free(package->files);
+	free(package->names);
+	free(package->name_table);
+	free(package->crc_state);
 	if (package->stream) fclose(package->stream);
 	package->files = NULL;
+	package->names = NULL;
+	package->name_table = NULL;
+	package->crc_state = NULL;
+	package->mapped = NULL;
+	package->mapped_size = 0;
 	package->stream = NULL;
 	package->file_count = 0;
 }
 
 error_t cpymo_package_find(cpymo_package_index * out_index, const cpymo_package * package, cpymo_str filename)
 {
-	if (filename.len > 31) {
+	if (package->version == 1 && filename.len > 31) {
 		filename.len = 31;
 		printf("[Warning] File name \"");
 		for (size_t i = 0; i < filename.len; ++i)
@@ -94,29 +302,232 @@ error_t cpymo_package_find(cpymo_package_index * out_index, const cpymo_package
 		puts("\" is too long!");
 	}
 
-	for (uint32_t i = 0; i < package->file_count; ++i) {
-		if (cpymo_str_equals_str_ignore_case(filename, package->files[i].file_name)) {
-			*out_index = package->files[i];
+	if (package->name_table == NULL) return CPYMO_ERR_NOT_FOUND;
+
+	uint32_t slot = cpymo_package_name_hash(filename) & package->name_table_mask;
+	while (package->name_table[slot]) {
+		const cpymo_package_index *file = &package->files[package->name_table[slot] - 1];
+		if (cpymo_str_equals_str_ignore_case(filename, file->file_name)) {
+			*out_index = *file;
 			return CPYMO_ERR_SUCC;
 		}
+
+		slot = (slot + 1) & package->name_table_mask;
 	}
 
 	return CPYMO_ERR_NOT_FOUND;
 }
 
+enum {
+	cpymo_package_crc_unchecked = 0,
+	cpymo_package_crc_good,
+	cpymo_package_crc_bad
+};
+
+// Threads checking the same file at once store the same result.
+static uint8_t *cpymo_package_crc_state(const cpymo_package *package, const cpymo_package_index *index)
+{
+	if (package->version < 2 || package->crc_state == NULL) return NULL;
+	if (index->id >= package->file_count) return NULL;
+	return &package->crc_state[index->id];
+}
+
+static bool cpymo_package_check_crc(
+	const cpymo_package *package, const cpymo_package_index *index, const void *data)
+{
+	uint8_t *state = cpymo_package_crc_state(package, index);
+	if (state == NULL) return package->version < 2;
+
+	if (*state == cpymo_package_crc_unchecked) {
+		*state = cpymo_package_crc32(0, data, index->file_length) == index->crc32 ?
+			cpymo_package_crc_good : cpymo_package_crc_bad;
+	}
+
+	return *state == cpymo_package_crc_good;
+}
+
+// For uncompressed files that are neither mapped nor read in one piece.
+static bool cpymo_package_check_crc_streamed(
+	const cpymo_package *package, const cpymo_package_index *index)
+{
+	uint8_t *state = cpymo_package_crc_state(package, index);
+	if (state == NULL) return package->version < 2;
+	if (*state != cpymo_package_crc_unchecked) return *state == cpymo_package_crc_good;
+
+	const size_t chunk_size = 64 * 1024;
+	char *chunk = (char *)malloc(chunk_size);
+	if (chunk == NULL) return false;
+
+	uint32_t crc = 0;
+	size_t checked = 0;
+	while (checked < index->file_length) {
+		size_t size = index->file_length - checked;
+		if (size > chunk_size) size = chunk_size;
+
+		if (cpymo_package_read_at(package->stream, index->file_offset + checked, chunk, size) != size)
+			break;
+
+		crc = cpymo_package_crc32(crc, chunk, size);
+		checked += size;
+	}
+
+	free(chunk);
+
+	// A short read may be temporary, only a full read is kept.
+	if (checked < index->file_length) return false;
+
+	*state = crc == index->crc32 ? cpymo_package_crc_good : cpymo_package_crc_bad;
+	return *state == cpymo_package_crc_good;
+}
+
+static const char *cpymo_package_get_mapped_stored_data(const cpymo_package *package, const cpymo_package_index *index)
+{
+	if (package->mapped == NULL) return NULL;
+	if (index->file_offset + index->stored_length > (uint64_t)package->mapped_size)
+		return NULL;
+
+	return package->mapped + index->file_offset;
+}
+
+const void *cpymo_package_get_mapped_file(const cpymo_package *package, const cpymo_package_index *index)
+{
+	if (index->compression != CPYMO_PACKAGE_COMPRESSION_NONE) return NULL;
+
+	const char *data = cpymo_package_get_mapped_stored_data(package, index);
+	if (data == NULL || !cpymo_package_check_crc(package, index, data)) return NULL;
+	return data;
+}
+
+bool cpymo_package_advise_willneed(const cpymo_package *package, const cpymo_package_index *index)
+{
+#ifdef ENABLE_PACKAGE_MMAP
+	const char *data = cpymo_package_get_mapped_stored_data(package, index);
+	if (data) {
+		const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+		const uintptr_t begin = (uintptr_t)data & ~(page - 1);
+		return madvise((void *)begin, (uintptr_t)data + index->stored_length - begin, MADV_WILLNEED) == 0;
+	}
+#endif
+
+#if defined(ENABLE_PACKAGE_PREAD) && defined(POSIX_FADV_WILLNEED)
+	return posix_fadvise(
+		fileno(package->stream), 
+		(off_t)index->file_offset, (off_t)index->stored_length, 
+		POSIX_FADV_WILLNEED) == 0;
+#else
+	return false;
+#endif
+}
+
+uint32_t cpymo_package_crc32(uint32_t crc, const void *data, size_t len)
+{
+	static const uint32_t table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+		0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+		0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	const uint8_t *p = (const uint8_t *)data;
+	crc = ~crc;
+	for (size_t i = 0; i < len; ++i) {
+		crc ^= p[i];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+	}
+
+	return ~crc;
+}
+
+bool cpymo_package_lz4_decompress(
+	const void *src, size_t src_len, void *dst, size_t dst_len)
+{
+	const uint8_t *ip = (const uint8_t *)src, *const iend = ip + src_len;
+	uint8_t *op = (uint8_t *)dst, *const oend = op + dst_len;
+
+	while (ip < iend) {
+		const uint8_t token = *ip++;
+
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			uint8_t b;
+			do {
+				if (ip >= iend) return false;
+				b = *ip++;
+				literals += b;
+			} while (b == 255);
+		}
+
+		if ((size_t)(iend - ip) < literals || (size_t)(oend - op) < literals)
+			return false;
+		memcpy(op, ip, literals);
+		op += literals;
+		ip += literals;
+
+		// The last sequence has literals only.
+		if (ip >= iend) break;
+
+		if (iend - ip < 2) return false;
+		const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - (uint8_t *)dst)) return false;
+
+		size_t match = token & 0x0F;
+		if (match == 15) {
+			uint8_t b;
+			do {
+				if (ip >= iend) return false;
+				b = *ip++;
+				match += b;
+			} while (b == 255);
+		}
+		match += 4;
+
+		if ((size_t)(oend - op) < match) return false;
+		const uint8_t *m = op - offset;
+		while (match--) *op++ = *m++;
+	}
+
+	return op == oend;
+}
+
 error_t cpymo_package_read_file_from_index(char *out_buffer, const cpymo_package * package, const cpymo_package_index * index)
 {
-	#ifdef DEBUG
-	assert(package->has_stream_reader == false);
-	#endif
-	
-	if ((uintmax_t)index->file_offset > (uintmax_t)LONG_MAX ||
-		fseek(package->stream, (long)index->file_offset, SEEK_SET) != 0)
-		return CPYMO_ERR_BAD_FILE_FORMAT;
-	if (index->file_length == 0) return CPYMO_ERR_SUCC;
-	const size_t count = fread(out_buffer, index->file_length, 1, package->stream);
+	const char *stored = cpymo_package_get_mapped_stored_data(package, index);
 
-	if (count != 1) return CPYMO_ERR_BAD_FILE_FORMAT;
+	if (index->compression == CPYMO_PACKAGE_COMPRESSION_NONE) {
+		if (stored) memcpy(out_buffer, stored, index->file_length);
+		else if (index->file_length) {
+			const size_t count = cpymo_package_read_at(
+				package->stream, index->file_offset, out_buffer, index->file_length);
+
+			if (count != index->file_length) return CPYMO_ERR_BAD_FILE_FORMAT;
+		}
+	}
+	else {
+		char *stored_buf = NULL;
+		if (stored == NULL) {
+			stored_buf = (char *)malloc(index->stored_length == 0 ? 1 : index->stored_length);
+			if (stored_buf == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+			const size_t count = cpymo_package_read_at(
+				package->stream, index->file_offset, stored_buf, index->stored_length);
+			if (count != index->stored_length) {
+				free(stored_buf);
+				return CPYMO_ERR_BAD_FILE_FORMAT;
+			}
+
+			stored = stored_buf;
+		}
+
+		bool succ = cpymo_package_lz4_decompress(
+			stored, index->stored_length, out_buffer, index->file_length);
+		free(stored_buf);
+		if (!succ) return CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
+	if (!cpymo_package_check_crc(package, index, out_buffer))
+		return CPYMO_ERR_BAD_FILE_FORMAT;
 
 	return CPYMO_ERR_SUCC;
 }
@@ -161,7 +572,13 @@ static void cpymo_package_stream_reader_image_skip(void *stream_reader, int n)
 
 #ifndef DISABLE_STB_IMAGE
 error_t cpymo_package_read_image_from_index(void ** pixels, int * w, int * h, int channels, const cpymo_package * pkg, const cpymo_package_index * index)
-{	
+{
+	const stbi_uc *mapped = (const stbi_uc *)cpymo_package_get_mapped_file(pkg, index);
+	if (mapped) {
+		*pixels = stbi_load_from_memory(mapped, (int)index->file_length, w, h, NULL, channels);
+		return *pixels ? CPYMO_ERR_SUCC : CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
 #ifdef STREAMING_LOAD_IMAGE
 	stbi_io_callbacks cbs;
 	cbs.eof = &cpymo_package_stream_read_image_eof;
@@ -229,12 +646,8 @@ error_t cpymo_package_stream_reader_seek(size_t seek, cpymo_package_stream_reade
 		return CPYMO_ERR_OUT_OF_MEM;
 	}
 
-	if (seek > (size_t)LONG_MAX ||
-		r->file_offset > (size_t)LONG_MAX - seek ||
-		fseek(r->stream, (long)(r->file_offset + seek), SEEK_SET) != 0)
-		return CPYMO_ERR_BAD_FILE_FORMAT;
 	r->current = seek;
-	
+
 	return CPYMO_ERR_SUCC;
 }
 
@@ -245,17 +658,23 @@ size_t cpymo_package_stream_reader_read(char *dst_buf, size_t dst_buf_size, cpym
 
 	if (read_size <= 0) return 0;
 
+	if (r->mapped) {
+		memcpy(dst_buf, r->mapped + r->current, read_size);
+		r->current += read_size;
+		return read_size;
+	}
+
+	read_size = cpymo_package_read_at(
+		r->stream, r->file_offset + r->current, dst_buf, read_size);
 	r->current += read_size;
 
-	return fread(dst_buf, read_size, 1, r->stream) * read_size;
+	return read_size;
 }
 
 void cpymo_package_stream_reader_close(cpymo_package_stream_reader * r)
 {
 	if (r->own_stream && r->stream) fclose(r->stream);
-#ifdef DEBUG
-	if (r->package) r->package->has_stream_reader = false;
-#endif
+	free(r->owned_buffer);
 
 #ifdef LEAKCHECK
 	free(r->leak_mark);
@@ -271,17 +690,29 @@ cpymo_package_stream_reader cpymo_package_stream_reader_create(
 	reader.file_length = index->file_length;
 	reader.current = 0;
 	reader.stream = package->stream;
+	reader.mapped = (const char *)cpymo_package_get_mapped_file(package, index);
+	reader.owned_buffer = NULL;
 	reader.own_stream = false;
-#ifdef DEBUG
-	assert(package->has_stream_reader == false);
-	reader.package = (cpymo_package *)package;
-#endif
+
+	if (index->compression == CPYMO_PACKAGE_COMPRESSION_NONE) {
+		if (reader.mapped == NULL && !cpymo_package_check_crc_streamed(package, index))
+			reader.file_length = 0;
+	}
+	else {
+		reader.owned_buffer = (char *)malloc(index->file_length == 0 ? 1 : index->file_length);
+		if (reader.owned_buffer == NULL ||
+			cpymo_package_read_file_from_index(reader.owned_buffer, package, index) != CPYMO_ERR_SUCC) {
+			// Leave an empty reader, reading it gets EOF.
+			reader.file_length = 0;
+		}
+
+		reader.mapped = reader.owned_buffer;
+	}
 
 #ifdef LEAKCHECK
 	reader.leak_mark = malloc(1024);
 	assert(reader.leak_mark);
 #endif
-	cpymo_package_stream_reader_seek(0, &reader);
 	return reader;
 }
 
@@ -302,19 +733,15 @@ error_t cpymo_package_stream_reader_from_file(
 	out->leak_mark = leak_mark;
 #endif
 
-#ifdef DEBUG
-	out->package = NULL;
-#endif
-
-	if (fseek(file, 0, SEEK_END) != 0) {
+	if (cpymo_utils_fseek64(file, 0, SEEK_END) != 0) {
 #ifdef LEAKCHECK
 		free(out->leak_mark);
 #endif
 		fclose(file);
 		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
-	long file_length = ftell(file);
-	if (file_length < 0 || fseek(file, 0, SEEK_SET) != 0) {
+	int64_t file_length = cpymo_utils_ftell64(file);
+	if (file_length < 0 || (uint64_t)file_length > SIZE_MAX || cpymo_utils_fseek64(file, 0, SEEK_SET) != 0) {
 #ifdef LEAKCHECK
 		free(out->leak_mark);
 #endif
@@ -327,6 +754,8 @@ error_t cpymo_package_stream_reader_from_file(
 	out->file_offset = 0;
 	out->own_stream = true;
 	out->stream = file;
+	out->mapped = NULL;
+	out->owned_buffer = NULL;
 
 	return CPYMO_ERR_SUCC;
 }
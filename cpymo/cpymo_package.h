@@ -7,20 +7,69 @@
 #include "cpymo_parser.h"
 #include "cpymo_error.h"
 
+// Package format version 1 (PyMO):
+//   uint32_t file_count;
+//   struct { char file_name[32]; uint32_t file_offset, file_length; } [file_count];
+//   file data...
+//
+// Package format version 2 (CPyMO), all integers are little endian:
+//   char magic[4] = "CPK2";
+//   uint32_t file_count;
+//   uint64_t index_offset;
+//   uint32_t alignment;
+//   uint32_t name_pool_size;
+//   file data, each file starts at a multiple of alignment...
+//   at index_offset:
+//   struct {
+//       uint64_t file_offset;
+//       uint32_t stored_length, file_length, crc32;
+//       uint32_t name_offset;
+//       uint16_t name_length;
+//       uint8_t compression, reserved[5];
+//   } [file_count];
+//   char name_pool[name_pool_size];    // names terminated by '\0'
+// name_length is at most CPYMO_PACKAGE_V2_MAX_NAME_LENGTH.
+
+#define CPYMO_PACKAGE_V1_INDEX_SIZE 40
+
+#define CPYMO_PACKAGE_V2_MAGIC "CPK2"
+#define CPYMO_PACKAGE_V2_HEADER_SIZE 24
+#define CPYMO_PACKAGE_V2_INDEX_SIZE 32
+#define CPYMO_PACKAGE_V2_MAX_NAME_LENGTH 255
+
+#define CPYMO_PACKAGE_COMPRESSION_NONE 0
+#define CPYMO_PACKAGE_COMPRESSION_LZ4 1
+
 typedef struct {
-	char file_name[32];
-	uint32_t file_offset;
-	uint32_t file_length;
+	const char *file_name;
+	uint64_t file_offset;
+	uint32_t file_length;		// Length after decompression.
+	uint32_t stored_length;		// Length in package.
+	uint32_t crc32;
+	uint8_t compression;
+	uint32_t id;				// Position in cpymo_package.files.
 } cpymo_package_index;
 
 typedef struct {
+	uint32_t version;
 	uint32_t file_count;
 	cpymo_package_index *files;
+	char *names;
 	FILE *stream;
 
-#ifdef DEBUG
-	bool has_stream_reader;
-#endif
+	// Open addressing table of (index + 1) into files, 0 means empty slot.
+	// Keys are case folded file names, so lookup is O(1).
+	uint32_t *name_table;
+	uint32_t name_table_mask;
+
+	// Whole package mapped read-only when ENABLE_PACKAGE_MMAP is defined
+	// and mapping succeeded, otherwise NULL and reads go through stream.
+	const char *mapped;
+	size_t mapped_size;
+
+	// Version 2 only, one per file: the crc32 is checked on the first access,
+	// whichever way the file is read, and the result is kept here.
+	uint8_t *crc_state;
 } cpymo_package;
 
 error_t cpymo_package_open(cpymo_package *out_package, const char *path);
@@ -29,6 +78,19 @@ error_t cpymo_package_find(cpymo_package_index *out_index, const cpymo_package *
 error_t cpymo_package_read_file_from_index(char *out_buffer, const cpymo_package *package, const cpymo_package_index *index);
 error_t cpymo_package_read_file(char **out_buffer, size_t *sz, const cpymo_package *package, cpymo_str filename);
 
+// Zero-copy access to a file in a mapped package.
+// Returns NULL if the package is not mapped, the file is compressed
+// or its crc32 does not match, caller should fallback to reading.
+const void *cpymo_package_get_mapped_file(const cpymo_package *package, const cpymo_package_index *index);
+
+// Hints the OS to read this entry ahead.
+// Returns false where unsupported, read the entry instead to warm the cache.
+bool cpymo_package_advise_willneed(const cpymo_package *package, const cpymo_package_index *index);
+
+uint32_t cpymo_package_crc32(uint32_t crc, const void *data, size_t len);
+bool cpymo_package_lz4_decompress(
+	const void *src, size_t src_len, void *dst, size_t dst_len);
+
 error_t cpymo_package_read_image_from_index(
 	void **pixels, int *w, int *h, int channels, 
 	const cpymo_package *pkg, const cpymo_package_index *index);
@@ -37,17 +99,20 @@ error_t cpymo_package_read_image(
 	void **pixels, int *w, int *h, int channels,
 	const cpymo_package *pkg, cpymo_str filename);
 
+// Every reader keeps its own position and reads at absolute offsets,
+// so several readers can stream from one package at the same time.
+// Readers on different threads need ENABLE_PACKAGE_PREAD or a mapped package.
+// Compressed files are decompressed into an owned buffer at creation.
+// A file failing its crc32 check gets an empty reader.
 typedef struct {
-	size_t file_offset;
+	uint64_t file_offset;
 	size_t file_length;
 	size_t current;
 	FILE *stream;
+	const char *mapped;
+	char *owned_buffer;
 	bool own_stream;
 
-#ifdef DEBUG
-	cpymo_package *package;
-#endif
-
 #ifdef LEAKCHECK
 	void *leak_mark;
 #endif
@@ -0,0 +1,148 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_prefetch.h"
+
+#ifdef ENABLE_ASYNC_ASSET_LOADER
+
+#include "cpymo_engine.h"
+#include <string.h>
+
+void cpymo_prefetch_init(cpymo_prefetch *p)
+{
+	p->scanned_script = NULL;
+	p->scan_begin_line = 0;
+	p->rescan_line = 0;
+}
+
+void cpymo_prefetch_free(cpymo_prefetch *p)
+{
+	cpymo_prefetch_init(p);
+}
+
+static inline cpymo_str cpymo_prefetch_arg(
+	const cpymo_script *s, const cpymo_script_line *line, size_t i)
+{
+	return cpymo_script_arg_str(s, cpymo_script_get_arg(s, line, i));
+}
+
+// Returns false to stop scanning, 
+// sets target to the script name of change or call.
+static bool cpymo_prefetch_line(
+	cpymo_engine *e, const cpymo_script *s, const cpymo_script_line *line, cpymo_str *target)
+{
+	#define ARG(I) cpymo_prefetch_arg(s, line, I)
+
+	switch (line->op) {
+	case cpymo_script_op_bg: {
+		cpymo_str name = ARG(0);
+		if (name.len) cpymo_async_loader_prefetch_bg(e, name);
+		break;
+	}
+
+	case cpymo_script_op_chara:
+		// id, filename, position, layer, ..., time
+		for (size_t i = 1; i < line->argc; i += 4) {
+			cpymo_str name = ARG(i);
+			if (name.len == 0) break;
+			if (!cpymo_str_equals_str(name, "NULL"))
+				cpymo_async_loader_prefetch_chara(e, name);
+		}
+		break;
+
+	case cpymo_script_op_select_img:
+	case cpymo_script_op_anime_on: {
+		cpymo_str name = ARG(1);
+		if (name.len) cpymo_async_loader_prefetch_system_image(e, name);
+		break;
+	}
+
+	case cpymo_script_op_select_imgs: {
+		const int choices = cpymo_script_get_arg(s, line, 0)->ival;
+		for (int i = 0; i < choices; ++i) {
+			cpymo_str name = ARG(1 + 4 * (size_t)i);
+			if (name.len == 0) break;
+			cpymo_async_loader_prefetch_system_image(e, name);
+		}
+		break;
+	}
+
+	case cpymo_script_op_bgm: {
+		cpymo_str name = ARG(0);
+		if (name.len) 
+			cpymo_async_loader_prefetch_file(e, "bgm", name, e->gameconfig.bgmformat);
+		break;
+	}
+
+	case cpymo_script_op_se: {
+		cpymo_str name = ARG(0);
+		if (name.len) 
+			cpymo_async_loader_prefetch_file(e, "se", name, e->gameconfig.seformat);
+		break;
+	}
+
+	case cpymo_script_op_vo: {
+		cpymo_str name = ARG(0);
+		if (name.len) 
+			cpymo_async_loader_prefetch_file(e, "voice", name, e->gameconfig.voiceformat);
+		break;
+	}
+
+	case cpymo_script_op_change:
+	case cpymo_script_op_call:
+		*target = ARG(0);
+		break;
+
+	case cpymo_script_op_ret:
+		return false;
+
+	default:
+		break;
+	}
+
+	#undef ARG
+
+	return true;
+}
+
+void cpymo_prefetch_update(cpymo_engine *e)
+{
+	cpymo_prefetch *p = &e->prefetch;
+	const size_t lines = e->gameconfig.prefetchlines;
+	if (e->interpreter == NULL || lines == 0) return;
+
+	const cpymo_interpreter *interpreter = e->interpreter;
+	const size_t cur_line = interpreter->script_parser.cur_line;
+
+	if (p->scanned_script == interpreter->script
+		&& cur_line >= p->scan_begin_line
+		&& cur_line < p->rescan_line)
+		return;
+
+	p->scanned_script = interpreter->script;
+	p->scan_begin_line = cur_line;
+	p->rescan_line = cur_line + (lines + 1) / 2;
+
+	const cpymo_script *s = interpreter->script;
+	size_t line = cur_line;
+	bool followed = false;
+	for (size_t i = 0; i < lines && line < s->line_count; ++i, ++line) {
+		cpymo_str target = { NULL, 0 };
+		if (!cpymo_prefetch_line(e, s, &s->lines[line], &target)) break;
+		if (target.len == 0) continue;
+
+		// Only one level, and only into scripts that are already compiled,
+		// others are compiled by the async loader and scanned next time.
+		if (followed) break;
+		followed = true;
+
+		const cpymo_script *following = cpymo_script_cache_find(&e->script_cache, target);
+		if (following == NULL) {
+			cpymo_async_loader_prefetch_script(e, target);
+			break;
+		}
+
+		s = following;
+		line = (size_t)-1;
+	}
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef INCLUDE_CPYMO_PREFETCH
+#define INCLUDE_CPYMO_PREFETCH
+
+#include "cpymo_async_loader.h"
+#include "cpymo_script.h"
+
+// Scans the script ahead of the interpreter for bg, chara, select_img(s),
+// anime_on, bgm, se and vo, following change and call targets,
+// so images are decoded by cpymo_async_loader and audio is read ahead
+// before the interpreter reaches them.
+// gameconfig.prefetchlines sets how many lines are scanned.
+// Change and call targets are compiled by the async loader
+// and taken by the script cache when the interpreter gets to them.
+
+struct cpymo_engine;
+
+#ifdef ENABLE_ASYNC_ASSET_LOADER
+
+typedef struct {
+	const cpymo_script *scanned_script;
+	size_t scan_begin_line, rescan_line;
+} cpymo_prefetch;
+
+void cpymo_prefetch_init(cpymo_prefetch *p);
+void cpymo_prefetch_free(cpymo_prefetch *p);
+void cpymo_prefetch_update(struct cpymo_engine *e);
+
+#else
+
+typedef struct {
+	char unused;
+} cpymo_prefetch;
+
+static inline void cpymo_prefetch_init(cpymo_prefetch *p) {}
+static inline void cpymo_prefetch_free(cpymo_prefetch *p) {}
+static inline void cpymo_prefetch_update(struct cpymo_engine *e) {}
+
+#endif
+
+#endif
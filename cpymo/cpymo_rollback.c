@@ -0,0 +1,679 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_rollback.h"
+#include "cpymo_engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../stb/stb_ds.h"
+#include "../endianness.h/endianness.h"
+
+static void cpymo_rollback_snapshot_free(cpymo_rollback_snapshot *s)
+{
+	arrfree(s->strings);
+	arrfree(s->frames);
+	arrfree(s->charas);
+	arrfree(s->locals);
+}
+
+void cpymo_rollback_init(cpymo_rollback *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+void cpymo_rollback_free(cpymo_rollback *r)
+{
+	for (size_t i = 0; i < CPYMO_ROLLBACK_SIZE; ++i)
+		cpymo_rollback_snapshot_free(&r->snapshots[i]);
+	cpymo_rollback_snapshot_free(&r->state);
+	cpymo_rollback_init(r);
+}
+
+static cpymo_rollback_name cpymo_rollback_add_name(cpymo_rollback_snapshot *s, const char *name)
+{
+	if (name == NULL || *name == '\0') return 0;
+
+	size_t len = strlen(name) + 1;
+	cpymo_rollback_name offset = (cpymo_rollback_name)arrlenu(s->strings);
+	memcpy(arraddnptr(s->strings, len), name, len);
+	return offset;
+}
+
+static inline const char *cpymo_rollback_name_str(
+	const cpymo_rollback_snapshot *s, cpymo_rollback_name name)
+{ return s->strings + name; }
+
+static inline bool cpymo_rollback_name_is(
+	const cpymo_rollback_snapshot *s, cpymo_rollback_name name, const char *str)
+{ return strcmp(cpymo_rollback_name_str(s, name), str ? str : "") == 0; }
+
+static void cpymo_rollback_take(cpymo_rollback_snapshot *s, cpymo_engine *e)
+{
+	if (s->strings) arrsetlen(s->strings, 0);
+	if (s->frames) arrsetlen(s->frames, 0);
+	if (s->charas) arrsetlen(s->charas, 0);
+	if (s->locals) arrsetlen(s->locals, 0);
+
+	arrput(s->strings, '\0');
+
+	for (cpymo_interpreter *i = e->interpreter; i; i = i->caller) {
+		cpymo_rollback_frame f;
+		f.script_name = cpymo_rollback_add_name(s, i->script->script_name);
+		f.cur_pos = i->script_parser.cur_pos;
+		f.cur_line = i->script_parser.cur_line;
+		f.is_line_end = i->script_parser.is_line_end;
+		f.checkpoint_line = i->checkpoint.cur_line;
+		arrput(s->frames, f);
+	}
+
+	for (size_t i = 0; i < arrlenu(e->vars.locals); ++i) {
+		cpymo_rollback_var v;
+		v.slot = e->vars.locals[i];
+		v.value = cpymo_vars_get_slot(&e->vars, v.slot);
+		arrput(s->locals, v);
+	}
+
+	for (struct cpymo_chara *c = e->charas.chara; c; c = c->next) {
+		if (!c->alive) continue;
+
+		cpymo_rollback_chara ch;
+		ch.name = cpymo_rollback_add_name(s, c->chara_name);
+		ch.id = c->chara_id;
+		ch.layer = c->layer;
+		ch.x = c->pos_x.end_value;
+		ch.y = c->pos_y.end_value;
+		arrput(s->charas, ch);
+	}
+
+	s->title = cpymo_rollback_add_name(s, e->title);
+	s->msgbox = cpymo_rollback_add_name(s, e->say.msgbox_name);
+	s->namebox = cpymo_rollback_add_name(s, e->say.namebox_name);
+	s->bgm = cpymo_rollback_add_name(s, cpymo_audio_get_bgm_name(e));
+	s->se = cpymo_rollback_add_name(s, cpymo_audio_get_se_name(e));
+
+	s->bg = cpymo_rollback_add_name(s, e->bg.current_bg_name);
+	s->bg_x = e->scroll.img ? e->scroll.ex : e->bg.current_bg_x;
+	s->bg_y = e->scroll.img ? e->scroll.ey : e->bg.current_bg_y;
+
+	s->anime = 0;
+	if (e->anime.anime_image && e->anime.is_loop) {
+		s->anime = cpymo_rollback_add_name(s, e->anime.anime_name);
+		s->anime_frames = e->anime.all_frame;
+		s->anime_interval = e->anime.interval;
+		s->anime_x = e->anime.draw_x;
+		s->anime_y = e->anime.draw_y;
+	}
+
+	s->fade = e->fade.state != cpymo_fade_disabled;
+	s->fade_col = e->fade.col;
+}
+
+error_t cpymo_rollback_record(cpymo_engine *e)
+{
+	cpymo_rollback *r = &e->rollback;
+	if (e->interpreter == NULL) return CPYMO_ERR_SUCC;
+
+	size_t slot = r->count ? (r->newest + 1) % CPYMO_ROLLBACK_SIZE : 0;
+	cpymo_rollback_take(&r->snapshots[slot], e);
+
+	r->newest = slot;
+	if (r->count < CPYMO_ROLLBACK_SIZE) r->count++;
+	r->autosaved = false;
+
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_rollback_restore_interpreter(
+	cpymo_interpreter **out, const cpymo_rollback_snapshot *s, cpymo_engine *e)
+{
+	// Frames are stored callee first, callers are created first.
+	cpymo_interpreter *caller = NULL;
+	for (size_t i = arrlenu(s->frames); i > 0; --i) {
+		const cpymo_rollback_frame *f = &s->frames[i - 1];
+
+		cpymo_interpreter *interpreter = (cpymo_interpreter *)malloc(sizeof(cpymo_interpreter));
+		error_t err = interpreter ? 
+			cpymo_interpreter_init_script(
+				interpreter,
+				cpymo_str_pure(cpymo_rollback_name_str(s, f->script_name)),
+				&e->assetloader,
+				caller)
+			: CPYMO_ERR_OUT_OF_MEM;
+
+		if (err != CPYMO_ERR_SUCC) {
+			free(interpreter);
+			if (caller) {
+				cpymo_interpreter_free(caller);
+				free(caller);
+			}
+			return err;
+		}
+
+		interpreter->script_parser.cur_pos = f->cur_pos;
+		interpreter->script_parser.cur_line = f->cur_line;
+		interpreter->script_parser.is_line_end = f->is_line_end;
+		interpreter->checkpoint.cur_line = f->checkpoint_line;
+		caller = interpreter;
+	}
+
+	if (caller == NULL) return CPYMO_ERR_NOT_FOUND;
+
+	cpymo_interpreter_goto_line(caller, (uint64_t)caller->checkpoint.cur_line);
+	*out = caller;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_rollback_restore_bg(const cpymo_rollback_snapshot *s, cpymo_engine *e)
+{
+	const bool keep =
+		e->bg.current_bg
+		&& e->bg.transform_draw == NULL
+		&& e->bg.current_bg_name
+		&& cpymo_rollback_name_is(s, s->bg, e->bg.current_bg_name);
+
+	if (!keep) {
+		if (s->bg == 0) {
+			cpymo_bg_reset(&e->bg);
+			return CPYMO_ERR_SUCC;
+		}
+
+		error_t err = cpymo_bg_command(
+			e, &e->bg,
+			cpymo_str_pure(cpymo_rollback_name_str(s, s->bg)),
+			cpymo_str_pure("BG_NOFADE"),
+			0, 0, 0);
+		CPYMO_THROW(err);
+	}
+
+	e->bg.current_bg_x = s->bg_x;
+	e->bg.current_bg_y = s->bg_y;
+	return CPYMO_ERR_SUCC;
+}
+
+static const cpymo_rollback_chara *cpymo_rollback_find_chara(
+	const cpymo_rollback_snapshot *s, const struct cpymo_chara *c)
+{
+	for (size_t i = 0; i < arrlenu(s->charas); ++i) {
+		const cpymo_rollback_chara *ch = &s->charas[i];
+		if (ch->id == c->chara_id && ch->layer == c->layer 
+			&& cpymo_rollback_name_is(s, ch->name, c->chara_name))
+			return ch;
+	}
+
+	return NULL;
+}
+
+static error_t cpymo_rollback_restore_charas(const cpymo_rollback_snapshot *s, cpymo_engine *e)
+{
+	// Quake and other chara animations are not kept.
+	if (e->charas.anime_pos) {
+		cpymo_charas_free(&e->charas);
+		cpymo_charas_init(&e->charas);
+	}
+
+	for (struct cpymo_chara *c = e->charas.chara; c; c = c->next) {
+		if (!c->alive) continue;
+
+		const cpymo_rollback_chara *ch = cpymo_rollback_find_chara(s, c);
+		if (ch) {
+			cpymo_tween_assign(&c->pos_x, ch->x);
+			cpymo_tween_assign(&c->pos_y, ch->y);
+			cpymo_tween_assign(&c->alpha, 1.0f);
+			c->play_anime = false;
+		}
+		else {
+			c->alive = false;
+			cpymo_tween_assign(&c->alpha, 0);
+		}
+	}
+
+	for (size_t i = 0; i < arrlenu(s->charas); ++i) {
+		const cpymo_rollback_chara *ch = &s->charas[i];
+
+		struct cpymo_chara *c = NULL;
+		if (cpymo_charas_find(&e->charas, &c, ch->id) == CPYMO_ERR_SUCC) continue;
+
+		c = NULL;
+		error_t err = cpymo_charas_new_chara(
+			e, &c, cpymo_str_pure(cpymo_rollback_name_str(s, ch->name)),
+			ch->id, ch->layer, 0, ch->x, ch->y, 1.0f, 0);
+		CPYMO_THROW(err);
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_rollback_restore(const cpymo_rollback_snapshot *s, cpymo_engine *e)
+{
+	// Build the interpreters first, so a missing script leaves the engine as it is.
+	cpymo_interpreter *interpreter = NULL;
+	error_t err = cpymo_rollback_restore_interpreter(&interpreter, s, e);
+	CPYMO_THROW(err);
+
+	while (e->ui) cpymo_ui_exit(e);
+
+	if (e->interpreter) {
+		cpymo_interpreter_free(e->interpreter);
+		free(e->interpreter);
+	}
+	e->interpreter = interpreter;
+
+	cpymo_vars_clear_locals(&e->vars);
+	for (size_t i = 0; i < arrlenu(s->locals); ++i) {
+		err = cpymo_vars_set_slot(&e->vars, s->locals[i].slot, s->locals[i].value);
+		CPYMO_THROW(err);
+	}
+
+	cpymo_wait_reset(&e->wait);
+	cpymo_flash_reset(&e->flash);
+	cpymo_select_img_reset(&e->select_img);
+	cpymo_scroll_reset(&e->scroll);
+	cpymo_text_clear(&e->text);
+	cpymo_say_reset_text(e);
+	cpymo_backlog_free(&e->backlog); cpymo_backlog_init(&e->backlog);
+
+	char *title = cpymo_str_copy_malloc(cpymo_str_pure(cpymo_rollback_name_str(s, s->title)));
+	if (title == NULL) return CPYMO_ERR_OUT_OF_MEM;
+	free(e->title);
+	e->title = title;
+
+	if (!cpymo_rollback_name_is(s, s->msgbox, e->say.msgbox_name) 
+		|| !cpymo_rollback_name_is(s, s->namebox, e->say.namebox_name)) {
+		cpymo_say_load_msgbox_and_namebox_image(
+			&e->say,
+			cpymo_str_pure(cpymo_rollback_name_str(s, s->msgbox)),
+			cpymo_str_pure(cpymo_rollback_name_str(s, s->namebox)),
+			&e->assetloader);
+	}
+
+	cpymo_audio_vo_stop(e);
+
+	if (!cpymo_rollback_name_is(s, s->bgm, cpymo_audio_get_bgm_name(e))) {
+		cpymo_audio_bgm_stop(e);
+		if (s->bgm) cpymo_audio_bgm_play(e, cpymo_str_pure(cpymo_rollback_name_str(s, s->bgm)), true);
+	}
+
+	if (!cpymo_rollback_name_is(s, s->se, cpymo_audio_get_se_name(e))) {
+		cpymo_audio_se_stop(e);
+		if (s->se) cpymo_audio_se_play(e, cpymo_str_pure(cpymo_rollback_name_str(s, s->se)), true);
+	}
+
+	if (s->fade) {
+		e->fade.state = cpymo_fade_keep;
+		e->fade.col = s->fade_col;
+		cpymo_tween_assign(&e->fade.alpha, 1.0f);
+	}
+	else {
+		cpymo_fade_reset(&e->fade);
+	}
+
+	err = cpymo_rollback_restore_bg(s, e);
+	CPYMO_THROW(err);
+
+	err = cpymo_rollback_restore_charas(s, e);
+	CPYMO_THROW(err);
+
+	const bool keep_anime =
+		s->anime && e->anime.anime_image && e->anime.is_loop && e->anime.anime_name
+		&& cpymo_rollback_name_is(s, s->anime, e->anime.anime_name);
+	if (!keep_anime) {
+		cpymo_anime_off(&e->anime);
+		if (s->anime) {
+			err = cpymo_anime_on(
+				e, s->anime_frames,
+				cpymo_str_pure(cpymo_rollback_name_str(s, s->anime)),
+				s->anime_x, s->anime_y, s->anime_interval, true);
+			CPYMO_THROW(err);
+		}
+	}
+
+	cpymo_engine_request_redraw(e);
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_rollback_back(cpymo_engine *e, size_t lines)
+{
+	cpymo_rollback *r = &e->rollback;
+	if (lines >= r->count) return CPYMO_ERR_NOT_FOUND;
+
+	size_t slot = (r->newest + CPYMO_ROLLBACK_SIZE - lines) % CPYMO_ROLLBACK_SIZE;
+	error_t err = cpymo_rollback_restore(&r->snapshots[slot], e);
+	CPYMO_THROW(err);
+
+	// The say at the restored snapshot records it again when it runs.
+	r->count -= lines + 1;
+	r->newest = (slot + CPYMO_ROLLBACK_SIZE - 1) % CPYMO_ROLLBACK_SIZE;
+	r->autosaved = false;
+
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_rollback_quickload(cpymo_engine *e)
+{
+	if (!e->rollback.autosaved) return CPYMO_ERR_NOT_FOUND;
+	return cpymo_rollback_back(e, 0);
+}
+
+// Counts the bytes it would write even when out of space.
+typedef struct {
+	uint8_t *p, *end;
+	size_t size;
+	bool overflow;
+} cpymo_rollback_writer;
+
+static void cpymo_rollback_write(cpymo_rollback_writer *w, const void *data, size_t size)
+{
+	w->size += size;
+
+	if ((size_t)(w->end - w->p) < size) {
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(w->p, data, size);
+	w->p += size;
+}
+
+static inline void cpymo_rollback_write_u32(cpymo_rollback_writer *w, uint32_t x)
+{
+	x = end_htole32(x);
+	cpymo_rollback_write(w, &x, sizeof(x));
+}
+
+static inline void cpymo_rollback_write_f32(cpymo_rollback_writer *w, float x)
+{
+	uint32_t u;
+	memcpy(&u, &x, sizeof(u));
+	cpymo_rollback_write_u32(w, u);
+}
+
+static inline void cpymo_rollback_write_u8(cpymo_rollback_writer *w, uint8_t x)
+{
+	cpymo_rollback_write(w, &x, sizeof(x));
+}
+
+typedef struct {
+	const uint8_t *p, *end;
+	bool bad;
+} cpymo_rollback_reader;
+
+static const uint8_t *cpymo_rollback_read(cpymo_rollback_reader *r, size_t size)
+{
+	if ((size_t)(r->end - r->p) < size) {
+		r->bad = true;
+		return NULL;
+	}
+
+	const uint8_t *data = r->p;
+	r->p += size;
+	return data;
+}
+
+static inline uint32_t cpymo_rollback_read_u32(cpymo_rollback_reader *r)
+{
+	const uint8_t *p = cpymo_rollback_read(r, 4);
+	if (p == NULL) return 0;
+
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return end_le32toh(x);
+}
+
+static inline float cpymo_rollback_read_f32(cpymo_rollback_reader *r)
+{
+	uint32_t u = cpymo_rollback_read_u32(r);
+	float x;
+	memcpy(&x, &u, sizeof(x));
+	return x;
+}
+
+static inline uint8_t cpymo_rollback_read_u8(cpymo_rollback_reader *r)
+{
+	const uint8_t *p = cpymo_rollback_read(r, 1);
+	return p ? *p : 0;
+}
+
+static inline cpymo_rollback_name cpymo_rollback_read_name(
+	cpymo_rollback_reader *r, const cpymo_rollback_snapshot *s)
+{
+	cpymo_rollback_name name = cpymo_rollback_read_u32(r);
+	if (name >= arrlenu(s->strings)) r->bad = true;
+	return r->bad ? 0 : name;
+}
+
+// Variables are written by name, slots are only valid in this process.
+static void cpymo_rollback_write_snapshot(
+	cpymo_rollback_writer *w, const cpymo_rollback_snapshot *s, const cpymo_vars *vars)
+{
+	cpymo_rollback_write_u32(w, (uint32_t)arrlenu(s->strings));
+	cpymo_rollback_write(w, s->strings, arrlenu(s->strings));
+
+	cpymo_rollback_write_u32(w, (uint32_t)arrlenu(s->frames));
+	for (size_t i = 0; i < arrlenu(s->frames); ++i) {
+		const cpymo_rollback_frame *f = &s->frames[i];
+		cpymo_rollback_write_u32(w, f->script_name);
+		cpymo_rollback_write_u32(w, (uint32_t)f->cur_pos);
+		cpymo_rollback_write_u32(w, (uint32_t)f->cur_line);
+		cpymo_rollback_write_u32(w, (uint32_t)f->checkpoint_line);
+		cpymo_rollback_write_u8(w, f->is_line_end);
+	}
+
+	cpymo_rollback_write_u32(w, (uint32_t)arrlenu(s->charas));
+	for (size_t i = 0; i < arrlenu(s->charas); ++i) {
+		const cpymo_rollback_chara *c = &s->charas[i];
+		cpymo_rollback_write_u32(w, c->name);
+		cpymo_rollback_write_u32(w, (uint32_t)c->id);
+		cpymo_rollback_write_u32(w, (uint32_t)c->layer);
+		cpymo_rollback_write_f32(w, c->x);
+		cpymo_rollback_write_f32(w, c->y);
+	}
+
+	cpymo_rollback_write_u32(w, (uint32_t)arrlenu(s->locals));
+	for (size_t i = 0; i < arrlenu(s->locals); ++i) {
+		const char *name = cpymo_vars_slot_name(vars, s->locals[i].slot);
+		size_t len = strlen(name);
+		cpymo_rollback_write_u32(w, (uint32_t)len);
+		cpymo_rollback_write(w, name, len);
+		cpymo_rollback_write_u32(w, (uint32_t)s->locals[i].value);
+	}
+
+	cpymo_rollback_write_u32(w, s->title);
+	cpymo_rollback_write_u32(w, s->msgbox);
+	cpymo_rollback_write_u32(w, s->namebox);
+	cpymo_rollback_write_u32(w, s->bgm);
+	cpymo_rollback_write_u32(w, s->se);
+
+	cpymo_rollback_write_u32(w, s->bg);
+	cpymo_rollback_write_f32(w, s->bg_x);
+	cpymo_rollback_write_f32(w, s->bg_y);
+
+	cpymo_rollback_write_u32(w, s->anime);
+	cpymo_rollback_write_u32(w, (uint32_t)s->anime_frames);
+	cpymo_rollback_write_f32(w, s->anime_interval);
+	cpymo_rollback_write_f32(w, s->anime_x);
+	cpymo_rollback_write_f32(w, s->anime_y);
+
+	cpymo_rollback_write_u8(w, s->fade);
+	cpymo_rollback_write_u8(w, s->fade_col.r);
+	cpymo_rollback_write_u8(w, s->fade_col.g);
+	cpymo_rollback_write_u8(w, s->fade_col.b);
+}
+
+static error_t cpymo_rollback_read_snapshot(
+	cpymo_rollback_reader *r, cpymo_rollback_snapshot *s, cpymo_vars *vars)
+{
+	if (s->strings) arrsetlen(s->strings, 0);
+	if (s->frames) arrsetlen(s->frames, 0);
+	if (s->charas) arrsetlen(s->charas, 0);
+	if (s->locals) arrsetlen(s->locals, 0);
+
+	uint32_t strings_len = cpymo_rollback_read_u32(r);
+	const uint8_t *strings = cpymo_rollback_read(r, strings_len);
+	if (strings == NULL || strings_len == 0 || strings[0] != '\0' || strings[strings_len - 1] != '\0')
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+	memcpy(arraddnptr(s->strings, strings_len), strings, strings_len);
+
+	uint32_t count = cpymo_rollback_read_u32(r);
+	for (uint32_t i = 0; i < count && !r->bad; ++i) {
+		cpymo_rollback_frame f;
+		f.script_name = cpymo_rollback_read_name(r, s);
+		f.cur_pos = cpymo_rollback_read_u32(r);
+		f.cur_line = cpymo_rollback_read_u32(r);
+		f.checkpoint_line = cpymo_rollback_read_u32(r);
+		f.is_line_end = cpymo_rollback_read_u8(r) != 0;
+		arrput(s->frames, f);
+	}
+
+	count = cpymo_rollback_read_u32(r);
+	for (uint32_t i = 0; i < count && !r->bad; ++i) {
+		cpymo_rollback_chara c;
+		c.name = cpymo_rollback_read_name(r, s);
+		c.id = (int)(int32_t)cpymo_rollback_read_u32(r);
+		c.layer = (int)(int32_t)cpymo_rollback_read_u32(r);
+		c.x = cpymo_rollback_read_f32(r);
+		c.y = cpymo_rollback_read_f32(r);
+		arrput(s->charas, c);
+	}
+
+	count = cpymo_rollback_read_u32(r);
+	for (uint32_t i = 0; i < count && !r->bad; ++i) {
+		uint32_t len = cpymo_rollback_read_u32(r);
+		const uint8_t *name = cpymo_rollback_read(r, len);
+		cpymo_val value = (cpymo_val)cpymo_rollback_read_u32(r);
+		if (r->bad) break;
+
+		cpymo_str name_str = { (const char *)name, len };
+		cpymo_rollback_var v;
+		v.slot = cpymo_vars_intern(vars, name_str);
+		v.value = value;
+		if (v.slot == CPYMO_VAR_SLOT_NONE) return CPYMO_ERR_OUT_OF_MEM;
+		arrput(s->locals, v);
+	}
+
+	s->title = cpymo_rollback_read_name(r, s);
+	s->msgbox = cpymo_rollback_read_name(r, s);
+	s->namebox = cpymo_rollback_read_name(r, s);
+	s->bgm = cpymo_rollback_read_name(r, s);
+	s->se = cpymo_rollback_read_name(r, s);
+
+	s->bg = cpymo_rollback_read_name(r, s);
+	s->bg_x = cpymo_rollback_read_f32(r);
+	s->bg_y = cpymo_rollback_read_f32(r);
+
+	s->anime = cpymo_rollback_read_name(r, s);
+	s->anime_frames = (int)(int32_t)cpymo_rollback_read_u32(r);
+	s->anime_interval = cpymo_rollback_read_f32(r);
+	s->anime_x = cpymo_rollback_read_f32(r);
+	s->anime_y = cpymo_rollback_read_f32(r);
+
+	s->fade = cpymo_rollback_read_u8(r) != 0;
+	s->fade_col.r = cpymo_rollback_read_u8(r);
+	s->fade_col.g = cpymo_rollback_read_u8(r);
+	s->fade_col.b = cpymo_rollback_read_u8(r);
+
+	return r->bad ? CPYMO_ERR_BAD_FILE_FORMAT : CPYMO_ERR_SUCC;
+}
+
+#define CPYMO_ROLLBACK_STATE_HEADER_SIZE 12
+#define CPYMO_ROLLBACK_STATE_ALIGN (64 * 1024)
+
+static inline size_t cpymo_rollback_name_size(const char *name)
+{ return name && *name ? strlen(name) + 1 : 0; }
+
+// At least what cpymo_rollback_write_snapshot writes for the current state,
+// counted from the engine without taking a snapshot.
+static size_t cpymo_rollback_state_bound(cpymo_engine *e)
+{
+	size_t strings = 1, frames = 0, charas = 0, locals = 0;
+
+	for (cpymo_interpreter *i = e->interpreter; i; i = i->caller) {
+		strings += cpymo_rollback_name_size(i->script->script_name);
+		frames++;
+	}
+
+	for (struct cpymo_chara *c = e->charas.chara; c; c = c->next) {
+		if (!c->alive) continue;
+		strings += cpymo_rollback_name_size(c->chara_name);
+		charas++;
+	}
+
+	for (size_t i = 0; i < arrlenu(e->vars.locals); ++i)
+		locals += 4 + strlen(cpymo_vars_slot_name(&e->vars, e->vars.locals[i])) + 4;
+
+	strings += cpymo_rollback_name_size(e->title);
+	strings += cpymo_rollback_name_size(e->say.msgbox_name);
+	strings += cpymo_rollback_name_size(e->say.namebox_name);
+	strings += cpymo_rollback_name_size(cpymo_audio_get_bgm_name(e));
+	strings += cpymo_rollback_name_size(cpymo_audio_get_se_name(e));
+	strings += cpymo_rollback_name_size(e->bg.current_bg_name);
+	strings += cpymo_rollback_name_size(e->anime.anime_name);
+
+	// Counts, frames, charas, locals, then names, bg, anime and fade.
+	return 4 + strings + 4 + frames * 17 + 4 + charas * 20 + 4 + locals
+		+ 5 * 4 + 3 * 4 + 5 * 4 + 4;
+}
+
+size_t cpymo_rollback_state_size(cpymo_engine *e)
+{
+	cpymo_rollback *r = &e->rollback;
+
+	size_t size = CPYMO_ROLLBACK_STATE_HEADER_SIZE + cpymo_rollback_state_bound(e);
+	size = (size + CPYMO_ROLLBACK_STATE_ALIGN - 1) / CPYMO_ROLLBACK_STATE_ALIGN * CPYMO_ROLLBACK_STATE_ALIGN;
+	if (size > r->state_size) r->state_size = size;
+	return r->state_size;
+}
+
+error_t cpymo_rollback_save_state(cpymo_engine *e, void *data, size_t size)
+{
+	if (size < CPYMO_ROLLBACK_STATE_HEADER_SIZE) return CPYMO_ERR_INVALID_ARG;
+
+	cpymo_rollback *r = &e->rollback;
+	cpymo_rollback_take(&r->state, e);
+
+	cpymo_rollback_writer w;
+	w.p = (uint8_t *)data + CPYMO_ROLLBACK_STATE_HEADER_SIZE;
+	w.end = (uint8_t *)data + size;
+	w.size = 0;
+	w.overflow = false;
+	cpymo_rollback_write_snapshot(&w, &r->state, &e->vars);
+	if (w.overflow) return CPYMO_ERR_OUT_OF_MEM;
+
+	const size_t payload = w.size;
+	memset(w.p, 0, (size_t)(w.end - w.p));
+
+	w.p = (uint8_t *)data;
+	cpymo_rollback_write(&w, CPYMO_ROLLBACK_STATE_MAGIC, 4);
+	cpymo_rollback_write_u32(&w, CPYMO_ROLLBACK_STATE_VERSION);
+	cpymo_rollback_write_u32(&w, (uint32_t)payload);
+
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_rollback_load_state(cpymo_engine *e, const void *data, size_t size)
+{
+	cpymo_rollback_reader r;
+	r.p = (const uint8_t *)data;
+	r.end = r.p + size;
+	r.bad = false;
+
+	const uint8_t *magic = cpymo_rollback_read(&r, 4);
+	if (magic == NULL || memcmp(magic, CPYMO_ROLLBACK_STATE_MAGIC, 4) != 0)
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	if (cpymo_rollback_read_u32(&r) != CPYMO_ROLLBACK_STATE_VERSION) 
+		return CPYMO_ERR_UNSUPPORTED;
+
+	uint32_t payload = cpymo_rollback_read_u32(&r);
+	if (r.bad || (size_t)(r.end - r.p) < payload) return CPYMO_ERR_BAD_FILE_FORMAT;
+	r.end = r.p + payload;
+
+	cpymo_rollback_snapshot *s = &e->rollback.state;
+	error_t err = cpymo_rollback_read_snapshot(&r, s, &e->vars);
+	CPYMO_THROW(err);
+
+	err = cpymo_rollback_restore(s, e);
+	CPYMO_THROW(err);
+
+	// The newest snapshot is the say that runs again.
+	e->rollback.count = 0;
+	e->rollback.autosaved = false;
+	return CPYMO_ERR_SUCC;
+}
@@ -0,0 +1,107 @@
+#ifndef INCLUDE_CPYMO_ROLLBACK
+#define INCLUDE_CPYMO_ROLLBACK
+
+#include "cpymo_error.h"
+#include "cpymo_vars.h"
+#include "cpymo_color.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// In-memory snapshots of the engine, one per say,
+// restored without touching the disk.
+// Backgrounds, charas, msgbox and bgm that are already loaded
+// are kept if the snapshot names the same ones.
+
+#ifndef CPYMO_ROLLBACK_SIZE
+#define CPYMO_ROLLBACK_SIZE 32
+#endif
+
+struct cpymo_engine;
+
+// Names are offsets into cpymo_rollback_snapshot.strings, 0 is the empty name.
+typedef uint32_t cpymo_rollback_name;
+
+typedef struct {
+	cpymo_rollback_name script_name;
+	size_t cur_pos, cur_line, checkpoint_line;
+	bool is_line_end;
+} cpymo_rollback_frame;
+
+typedef struct {
+	cpymo_rollback_name name;
+	int id, layer;
+	float x, y;
+} cpymo_rollback_chara;
+
+typedef struct {
+	cpymo_var_slot slot;
+	cpymo_val value;
+} cpymo_rollback_var;
+
+typedef struct {
+	// stb_ds arrays, kept when the slot is reused.
+	char *strings;
+	cpymo_rollback_frame *frames;
+	cpymo_rollback_chara *charas;
+	cpymo_rollback_var *locals;
+
+	cpymo_rollback_name title, msgbox, namebox, bgm, se;
+
+	cpymo_rollback_name bg;
+	float bg_x, bg_y;
+
+	cpymo_rollback_name anime;
+	int anime_frames;
+	float anime_interval, anime_x, anime_y;
+
+	bool fade;
+	cpymo_color fade_col;
+} cpymo_rollback_snapshot;
+
+typedef struct {
+	cpymo_rollback_snapshot snapshots[CPYMO_ROLLBACK_SIZE];
+	size_t newest, count;
+
+	// Set if the autosave holds the newest snapshot.
+	bool autosaved;
+
+	// Scratch snapshot of the state functions below, kept to reuse its arrays.
+	cpymo_rollback_snapshot state;
+	size_t state_size;
+} cpymo_rollback;
+
+void cpymo_rollback_init(cpymo_rollback *r);
+void cpymo_rollback_free(cpymo_rollback *r);
+
+error_t cpymo_rollback_record(struct cpymo_engine *e);
+
+static inline void cpymo_rollback_mark_autosaved(cpymo_rollback *r)
+{ r->autosaved = r->count > 0; }
+
+// Number of lines cpymo_rollback_back can go back.
+static inline size_t cpymo_rollback_count(const cpymo_rollback *r)
+{ return r->count ? r->count - 1 : 0; }
+
+// Goes back `lines` says before the current one.
+// Returns CPYMO_ERR_NOT_FOUND if there are not so many snapshots.
+error_t cpymo_rollback_back(struct cpymo_engine *e, size_t lines);
+
+// Restores the autosave from memory,
+// returns CPYMO_ERR_NOT_FOUND if it must be read from the disk.
+error_t cpymo_rollback_quickload(struct cpymo_engine *e);
+
+// Flat, versioned form of a snapshot of the current state, used as savestates.
+// Like a save, restoring it starts again from the last say:
+// waits, tweens, text progress and open menus are not part of it,
+// so states are not frame-exact and can not be used for run-ahead or rewind.
+#define CPYMO_ROLLBACK_STATE_MAGIC "CPST"
+#define CPYMO_ROLLBACK_STATE_VERSION 1
+
+// Counted from the engine without taking a snapshot.
+// Rounded up and never shrinks, so frontends can keep their buffers.
+size_t cpymo_rollback_state_size(struct cpymo_engine *e);
+error_t cpymo_rollback_save_state(struct cpymo_engine *e, void *data, size_t size);
+error_t cpymo_rollback_load_state(struct cpymo_engine *e, const void *data, size_t size);
+
+#endif
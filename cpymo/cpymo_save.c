@@ -1,6 +1,7 @@
 ﻿#include "cpymo_prelude.h"
 #include "cpymo_save.h"
 #include "cpymo_save_global.h"
+#include "cpymo_save_writer.h"
 #include "cpymo_engine.h"
 #include "cpymo_msgbox_ui.h"
 #include "../cpymo-backends/include/cpymo_backend_save.h"
@@ -8,51 +9,90 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
-
-#ifdef __EMSCRIPTEN__
-#include <emscripten.h>
-#endif
+#include <time.h>
 
 static inline void cpymo_save_get_filename(char *dst, unsigned short save_id)
 {
 	sprintf(dst, "save-%02d.csav", save_id);
 }
 
-error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
+typedef struct {
+	uint8_t *data;
+	size_t size, capacity;
+	bool out_of_mem;
+} cpymo_save_buffer;
+
+static void cpymo_save_buffer_append(cpymo_save_buffer *buf, const void *data, size_t size)
 {
-	FILE *save = NULL;
-	const char * const empty = "";
+	if (buf->out_of_mem) return;
+
+	// Keeps room for the trailer added by the save writer.
+	size_t required = buf->size + size + CPYMO_SAVE_WRITER_TRAILER_SIZE;
+	if (required > buf->capacity) {
+		size_t capacity = buf->capacity ? buf->capacity * 2 : 1024;
+		while (capacity < required) capacity *= 2;
+
+		uint8_t *new_data = (uint8_t *)realloc(buf->data, capacity);
+		if (new_data == NULL) {
+			buf->out_of_mem = true;
+			return;
+		}
 
-	{
-		char save_filename[16];
-		cpymo_save_get_filename(save_filename, save_id);
-		save = cpymo_backend_write_save(e->assetloader.gamedir, save_filename);
+		buf->data = new_data;
+		buf->capacity = capacity;
+	}
+
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+}
+
+static void cpymo_save_buffer_append_str(cpymo_save_buffer *buf, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+	if (len > UINT16_MAX) len = UINT16_MAX;
+
+	const uint16_t len_le = end_htole16((uint16_t)len);
+	cpymo_save_buffer_append(buf, &len_le, sizeof(len_le));
+	cpymo_save_buffer_append(buf, str, len);
+}
+
+static error_t cpymo_save_read_all(FILE *file, uint8_t **data, size_t *size)
+{
+	if (fseek(file, 0, SEEK_END) != 0) return CPYMO_ERR_UNKNOWN;
+	long len = ftell(file);
+	if (len < 0 || fseek(file, 0, SEEK_SET) != 0) return CPYMO_ERR_UNKNOWN;
+
+	*data = (uint8_t *)malloc(len > 0 ? (size_t)len : 1);
+	if (*data == NULL) return CPYMO_ERR_OUT_OF_MEM;
 
-		if (save == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+	if (len > 0 && fread(*data, (size_t)len, 1, file) != 1) {
+		free(*data);
+		*data = NULL;
+		return CPYMO_ERR_UNKNOWN;
 	}
 
+	*size = (size_t)len;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_save_index_update(cpymo_engine *e, unsigned short save_id);
+
+error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
+{
+	cpymo_save_buffer save = { NULL, 0, 0, false };
+	const char * const empty = "";
+
 	#define WRITE_STR(STR) \
 		if (STR) \
 		{ \
 			const size_t len = strlen(STR); \
 			const uint16_t len_le = end_htole16((uint16_t)len); \
-			if (fwrite(&len_le, sizeof(len_le), 1, save) != 1) { \
-				fclose(save); \
-				return CPYMO_ERR_UNKNOWN; \
-			} \
-			if (len) { \
-				if (fwrite(STR, len, 1, save) != 1) { \
-					fclose(save); \
-					return CPYMO_ERR_UNKNOWN; \
-				} \
-			} \
+			cpymo_save_buffer_append(&save, &len_le, sizeof(len_le)); \
+			cpymo_save_buffer_append(&save, STR, len); \
 		} \
 		else { \
 			uint16_t zero = end_htole16(0); \
-			if (fwrite(&zero, sizeof(zero), 1, save) != 1) { \
-				fclose(save); \
-				return CPYMO_ERR_UNKNOWN; \
-			} \
+			cpymo_save_buffer_append(&save, &zero, sizeof(zero)); \
 		}
 
 	WRITE_STR(e->title);
@@ -82,10 +122,7 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 			e->fade.col.b
 		};
 
-		if (fwrite(fadeout_state, sizeof(fadeout_state), 1, save) != 1) {
-			fclose(save);
-			return CPYMO_ERR_UNKNOWN;
-		}
+		cpymo_save_buffer_append(&save, fadeout_state, sizeof(fadeout_state));
 	}
 
 	#define PACK32(X) (assert(sizeof(X) == 4), end_htole32(*(uint32_t *)(&X)))
@@ -105,10 +142,7 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 		}
 
 		uint32_t pos[] = { PACK32(bg_x), PACK32(bg_y) };
-		if (fwrite(pos, sizeof(pos), 1, save) != 1) {
-			fclose(save);
-			return CPYMO_ERR_UNKNOWN;
-		}
+		cpymo_save_buffer_append(&save, pos, sizeof(pos));
 	}
 
 	// CHARA
@@ -130,10 +164,7 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 					PACK32(y)
 				};
 
-				if (fwrite(chara_params, sizeof(chara_params), 1, save) != 1) {
-					fclose(save);
-					return CPYMO_ERR_UNKNOWN;
-				}
+				cpymo_save_buffer_append(&save, chara_params, sizeof(chara_params));
 			}
 			chara = chara->next;
 		}
@@ -158,10 +189,7 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 				PACK32(y)
 			};
 
-			if (fwrite(anime_params, sizeof(anime_params), 1, save) != 1) {
-				fclose(save);
-				return CPYMO_ERR_UNKNOWN;
-			}
+			cpymo_save_buffer_append(&save, anime_params, sizeof(anime_params));
 		}
 		else {
 			WRITE_STR(empty);
@@ -170,17 +198,14 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 
 	// LOCAL VARS
 	{
-		size_t sz = cpymo_vars_count(&e->vars.locals);
+		size_t sz = cpymo_vars_count(&e->vars, false);
 		for (size_t i = 0; i < sz; ++i) {
 			cpymo_val val;
 			const char *var_name = 
-				cpymo_vars_get_by_index(e->vars.locals, i, &val);
+				cpymo_vars_get_by_index(&e->vars, false, i, &val);
 			WRITE_STR(var_name);
 			uint32_t val_le = PACK32(val);
-			if (fwrite(&val_le, sizeof(val_le), 1, save) != 1) {
-				fclose(save);
-				return CPYMO_ERR_UNKNOWN;
-			}
+			cpymo_save_buffer_append(&save, &val_le, sizeof(val_le));
 		}
 
 		
@@ -204,10 +229,7 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 				PACK32(checkpoint_line)
 			};
 
-			if (fwrite(interpreter_params, sizeof(interpreter_params), 1, save) != 1) {
-				fclose(save);
-				return CPYMO_ERR_UNKNOWN;
-			}
+			cpymo_save_buffer_append(&save, interpreter_params, sizeof(interpreter_params));
 
 			interpreter = interpreter->caller;
 		}
@@ -219,11 +241,20 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 	#undef PACK32
 	#undef WRITE_STR
 
-	fclose(save);
+	if (save.out_of_mem) {
+		free(save.data);
+		return CPYMO_ERR_OUT_OF_MEM;
+	}
+
+	char save_filename[16];
+	cpymo_save_get_filename(save_filename, save_id);
 
-#ifdef __EMSCRIPTEN__
-	EM_ASM(FS.syncfs(false, function(err) {}););
-#endif
+	error_t err = cpymo_save_writer_write(&e->save_writer, save_filename, save.data, save.size);
+	CPYMO_THROW(err);
+
+	err = cpymo_save_index_update(e, save_id);
+	if (err != CPYMO_ERR_SUCC)
+		printf("[Warning] Can not update save index: %s\n", cpymo_error_message(err));
 
 	return CPYMO_ERR_SUCC;
 }
@@ -231,23 +262,78 @@ error_t cpymo_save_write(cpymo_engine * e, unsigned short save_id)
 #ifndef DISABLE_AUTOSAVE
 void cpymo_save_autosave(cpymo_engine *e)
 {
-	cpymo_save_write(e, 0);
+	if (cpymo_save_write(e, 0) == CPYMO_ERR_SUCC)
+		cpymo_rollback_mark_autosaved(&e->rollback);
 	cpymo_save_global_save(e);
 }
 #endif
 
-FILE * cpymo_save_open_read(struct cpymo_engine *e, unsigned short save_id)
+error_t cpymo_save_load(cpymo_engine *e, unsigned short save_id)
+{
+#ifndef DISABLE_AUTOSAVE
+	// The autosave is usually still in memory.
+	if (save_id == 0 && cpymo_rollback_quickload(e) == CPYMO_ERR_SUCC)
+		return CPYMO_ERR_SUCC;
+#endif
+
+	uint8_t *data = NULL;
+	size_t size = 0;
+	error_t err = cpymo_save_read(e, save_id, &data, &size);
+	CPYMO_THROW(err);
+
+	err = cpymo_save_load_savedata(e, data, size);
+	free(data);
+	return err;
+}
+
+error_t cpymo_save_read(
+	struct cpymo_engine *e, unsigned short save_id, uint8_t **data, size_t *size)
 {
 	char filename[16];
 	cpymo_save_get_filename(filename, save_id);
 
-	return cpymo_backend_read_save(e->assetloader.gamedir, filename);
+	// A save still queued for writing would be read half written.
+	cpymo_save_writer_wait(&e->save_writer);
+
+	FILE *file = cpymo_backend_read_save(e->assetloader.gamedir, filename);
+	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	error_t err = cpymo_save_read_all(file, data, size);
+	fclose(file);
+	CPYMO_THROW(err);
+
+	if (!cpymo_save_writer_verify(*data, *size)) {
+		printf("[Error] %s is corrupted.\n", filename);
+		free(*data);
+		*data = NULL;
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
+	// Saves written before the trailer have none to strip.
+	if (*size >= CPYMO_SAVE_WRITER_TRAILER_SIZE
+		&& memcmp(*data + *size - 4, CPYMO_SAVE_WRITER_MAGIC, 4) == 0)
+		*size -= CPYMO_SAVE_WRITER_TRAILER_SIZE;
+
+	return CPYMO_ERR_SUCC;
+}
+
+typedef struct {
+	const uint8_t *p, *end;
+} cpymo_save_reader;
+
+static bool cpymo_save_read_bytes(void *dst, size_t size, cpymo_save_reader *save)
+{
+	if ((size_t)(save->end - save->p) < size) return false;
+
+	memcpy(dst, save->p, size);
+	save->p += size;
+	return true;
 }
 
-static error_t cpymo_save_read_string(char **str, FILE *save) 
+static error_t cpymo_save_read_string(char **str, cpymo_save_reader *save) 
 {
 	uint16_t len_le;
-	if (fread(&len_le, sizeof(len_le), 1, save) != 1) {
+	if (!cpymo_save_read_bytes(&len_le, sizeof(len_le), save)) {
 		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
 
@@ -259,7 +345,7 @@ static error_t cpymo_save_read_string(char **str, FILE *save)
 	*str = dst;
 
 	if (len) {
-		if (fread(*str, len, 1, save) != 1) {
+		if (!cpymo_save_read_bytes(*str, len, save)) {
 			free(*str);
 			*str = NULL;
 			return CPYMO_ERR_BAD_FILE_FORMAT;
@@ -271,12 +357,14 @@ static error_t cpymo_save_read_string(char **str, FILE *save)
 	return CPYMO_ERR_SUCC;
 }
 
-error_t cpymo_save_load_title(cpymo_save_title *out, FILE *save)
+error_t cpymo_save_load_title(cpymo_save_title *out, const uint8_t *data, size_t size)
 {
 	assert(out->say_name == NULL);
 	assert(out->say_text == NULL);
 	assert(out->title == NULL);
 
+	cpymo_save_reader reader = { data, data + size }, *save = &reader;
+
 	error_t err = cpymo_save_read_string(&out->title, save);
 	CPYMO_THROW(err);
 
@@ -299,8 +387,10 @@ error_t cpymo_save_load_title(cpymo_save_title *out, FILE *save)
 	return CPYMO_ERR_SUCC;
 }
 
-error_t cpymo_save_load_savedata(cpymo_engine *e, FILE *save)
+error_t cpymo_save_load_savedata(cpymo_engine *e, const uint8_t *data, size_t size)
 {
+	cpymo_save_reader reader = { data, data + size }, *save = &reader;
+
 	while (e->ui) cpymo_ui_exit(e);
 	
 	// reset states
@@ -382,7 +472,7 @@ error_t cpymo_save_load_savedata(cpymo_engine *e, FILE *save)
 	// FADEOUT
 	{
 		uint8_t fadeout_state[4];
-		if (fread(fadeout_state, sizeof(fadeout_state), 1, save) != 1) { THROW; }
+		if (!cpymo_save_read_bytes(fadeout_state, sizeof(fadeout_state), save)) { THROW; }
 
 		if (fadeout_state[0]) {
 			cpymo_color col;
@@ -401,7 +491,7 @@ error_t cpymo_save_load_savedata(cpymo_engine *e, FILE *save)
 
 	#define READ_PARAMS(NAME, SIZE) \
 		uint32_t NAME[SIZE]; \
-		if (fread(NAME, sizeof(NAME), 1, save) != 1) { \
+		if (!cpymo_save_read_bytes(NAME, sizeof(NAME), save)) { \
 			THROW; \
 		} \
 		for (size_t iiiii = 0; iiiii < SIZE; ++iiiii) \
@@ -531,3 +621,231 @@ error_t cpymo_save_load_savedata(cpymo_engine *e, FILE *save)
 	return CPYMO_ERR_SUCC;
 }
 
+
+#define CPYMO_SAVE_INDEX_FILE "saves.cidx"
+#define CPYMO_SAVE_INDEX_MAGIC "CIDX"
+#define CPYMO_SAVE_INDEX_VERSION 1
+
+static void cpymo_save_index_slot_clear(cpymo_save_index_slot *slot)
+{
+	free(slot->title.title);
+	free(slot->title.say_name);
+	free(slot->title.say_text);
+	slot->title.title = NULL;
+	slot->title.say_name = NULL;
+	slot->title.say_text = NULL;
+	slot->timestamp = 0;
+	slot->present = false;
+}
+
+void cpymo_save_index_init(cpymo_save_index *index)
+{
+	memset(index, 0, sizeof(*index));
+}
+
+void cpymo_save_index_free(cpymo_save_index *index)
+{
+	for (size_t i = 0; i < CPYMO_MAX_SAVES; ++i)
+		cpymo_save_index_slot_clear(&index->slots[i]);
+	index->loaded = false;
+}
+
+static error_t cpymo_save_index_write(cpymo_engine *e)
+{
+	cpymo_save_buffer buf = { NULL, 0, 0, false };
+	cpymo_save_buffer_append(&buf, CPYMO_SAVE_INDEX_MAGIC, 4);
+
+	uint16_t header[] = {
+		end_htole16(CPYMO_SAVE_INDEX_VERSION),
+		end_htole16(CPYMO_MAX_SAVES)
+	};
+	cpymo_save_buffer_append(&buf, header, sizeof(header));
+
+	for (size_t i = 0; i < CPYMO_MAX_SAVES; ++i) {
+		const cpymo_save_index_slot *slot = &e->save_index.slots[i];
+		uint8_t present = slot->present;
+		cpymo_save_buffer_append(&buf, &present, sizeof(present));
+		if (!present) continue;
+
+		uint64_t timestamp = end_htole64((uint64_t)slot->timestamp);
+		cpymo_save_buffer_append(&buf, &timestamp, sizeof(timestamp));
+		cpymo_save_buffer_append_str(&buf, slot->title.title);
+		cpymo_save_buffer_append_str(&buf, slot->title.say_name);
+		cpymo_save_buffer_append_str(&buf, slot->title.say_text);
+	}
+
+	if (buf.out_of_mem) {
+		free(buf.data);
+		return CPYMO_ERR_OUT_OF_MEM;
+	}
+
+	return cpymo_save_writer_write(&e->save_writer, CPYMO_SAVE_INDEX_FILE, buf.data, buf.size);
+}
+
+static error_t cpymo_save_index_parse_str(char **out, const uint8_t **p, const uint8_t *end)
+{
+	if (end - *p < 2) return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	uint16_t len_le;
+	memcpy(&len_le, *p, sizeof(len_le));
+	size_t len = end_le16toh(len_le);
+	*p += 2;
+
+	if ((size_t)(end - *p) < len) return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	*out = (char *)malloc(len + 1);
+	if (*out == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	memcpy(*out, *p, len);
+	(*out)[len] = '\0';
+	*p += len;
+
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_save_index_parse(cpymo_save_index *index, const uint8_t *data, size_t size)
+{
+	// The index is always written with a trailer.
+	if (size < 8 + CPYMO_SAVE_WRITER_TRAILER_SIZE) return CPYMO_ERR_BAD_FILE_FORMAT;
+	if (memcmp(data + size - 4, CPYMO_SAVE_WRITER_MAGIC, 4) != 0) return CPYMO_ERR_BAD_FILE_FORMAT;
+	if (!cpymo_save_writer_verify(data, size)) return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	const uint8_t *p = data, *end = data + size - CPYMO_SAVE_WRITER_TRAILER_SIZE;
+	if (memcmp(p, CPYMO_SAVE_INDEX_MAGIC, 4) != 0) return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	uint16_t header[2];
+	memcpy(header, p + 4, sizeof(header));
+	p += 8;
+
+	if (end_le16toh(header[0]) != CPYMO_SAVE_INDEX_VERSION) return CPYMO_ERR_BAD_FILE_FORMAT;
+
+	size_t slots = end_le16toh(header[1]);
+	for (size_t i = 0; i < slots; ++i) {
+		if (p >= end) return CPYMO_ERR_BAD_FILE_FORMAT;
+		bool present = *p++ != 0;
+		if (!present) continue;
+
+		uint64_t timestamp;
+		if (end - p < (ptrdiff_t)sizeof(timestamp)) return CPYMO_ERR_BAD_FILE_FORMAT;
+		memcpy(&timestamp, p, sizeof(timestamp));
+		p += sizeof(timestamp);
+
+		cpymo_save_index_slot discard, *slot = i < CPYMO_MAX_SAVES ? &index->slots[i] : &discard;
+		memset(&discard, 0, sizeof(discard));
+		slot->present = true;
+		slot->timestamp = (int64_t)end_le64toh(timestamp);
+
+		error_t err = cpymo_save_index_parse_str(&slot->title.title, &p, end);
+		if (err == CPYMO_ERR_SUCC) err = cpymo_save_index_parse_str(&slot->title.say_name, &p, end);
+		if (err == CPYMO_ERR_SUCC) err = cpymo_save_index_parse_str(&slot->title.say_text, &p, end);
+
+		if (slot == &discard) cpymo_save_index_slot_clear(&discard);
+		CPYMO_THROW(err);
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+// The index is only written once it is loaded,
+// so there is no write of it queued to wait for here.
+static error_t cpymo_save_index_read(cpymo_engine *e)
+{
+	FILE *file = cpymo_backend_read_save(e->assetloader.gamedir, CPYMO_SAVE_INDEX_FILE);
+	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	uint8_t *data = NULL;
+	size_t size = 0;
+	error_t err = cpymo_save_read_all(file, &data, &size);
+	fclose(file);
+	CPYMO_THROW(err);
+
+	err = cpymo_save_index_parse(&e->save_index, data, size);
+	free(data);
+
+	return err;
+}
+
+// Saves written before the index existed are read once to build it.
+static error_t cpymo_save_index_rebuild(cpymo_engine *e)
+{
+	for (unsigned short i = 0; i < CPYMO_MAX_SAVES; ++i) {
+		uint8_t *data = NULL;
+		size_t size = 0;
+		error_t err = cpymo_save_read(e, i, &data, &size);
+		if (err == CPYMO_ERR_OUT_OF_MEM) return err;
+		if (err != CPYMO_ERR_SUCC) continue;
+
+		cpymo_save_index_slot *slot = &e->save_index.slots[i];
+		err = cpymo_save_load_title(&slot->title, data, size);
+		free(data);
+
+		if (err == CPYMO_ERR_OUT_OF_MEM) return err;
+		slot->present = err == CPYMO_ERR_SUCC;
+	}
+
+	return cpymo_save_index_write(e);
+}
+
+error_t cpymo_save_index_load(cpymo_engine *e)
+{
+	if (e->save_index.loaded) return CPYMO_ERR_SUCC;
+
+	error_t err = cpymo_save_index_read(e);
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_save_index_free(&e->save_index);
+		if (err == CPYMO_ERR_OUT_OF_MEM) return err;
+
+		err = cpymo_save_index_rebuild(e);
+		if (err == CPYMO_ERR_OUT_OF_MEM) {
+			cpymo_save_index_free(&e->save_index);
+			return err;
+		}
+		else if (err != CPYMO_ERR_SUCC) {
+			printf("[Warning] Can not write save index: %s\n", cpymo_error_message(err));
+		}
+	}
+
+	e->save_index.loaded = true;
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_save_index_get(cpymo_engine *e, const cpymo_save_index **out)
+{
+	error_t err = cpymo_save_index_load(e);
+	CPYMO_THROW(err);
+
+	*out = &e->save_index;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_save_index_update(cpymo_engine *e, unsigned short save_id)
+{
+	if (save_id >= CPYMO_MAX_SAVES) return CPYMO_ERR_SUCC;
+
+	// Loaded by cpymo_engine_init, only loads here if that ran out of memory.
+	error_t err = cpymo_save_index_load(e);
+	CPYMO_THROW(err);
+
+	const char *say_name = e->say.current_name ? e->say.current_name : "";
+	const char *say_text = e->say.current_text ? e->say.current_text : "";
+	cpymo_save_title title;
+	title.title = cpymo_str_copy_malloc(cpymo_str_pure(e->title ? e->title : ""));
+	title.say_name = cpymo_str_copy_malloc(cpymo_str_pure(say_name));
+	title.say_text = cpymo_str_copy_malloc(cpymo_str_pure(say_text));
+
+	if (title.title == NULL || title.say_name == NULL || title.say_text == NULL) {
+		// Keep the old title of this slot, the save itself is written.
+		free(title.title);
+		free(title.say_name);
+		free(title.say_text);
+		return CPYMO_ERR_OUT_OF_MEM;
+	}
+
+	cpymo_save_index_slot *slot = &e->save_index.slots[save_id];
+	cpymo_save_index_slot_clear(slot);
+	slot->title = title;
+	slot->present = true;
+	slot->timestamp = (int64_t)time(NULL);
+
+	return cpymo_save_index_write(e);
+}
@@ -2,8 +2,14 @@
 #define INCLUDE_CPYMO_SAVE
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "cpymo_error.h"
 
+#ifndef CPYMO_MAX_SAVES
+#define CPYMO_MAX_SAVES 31
+#endif
+
 struct cpymo_engine;
 
 error_t cpymo_save_write(struct cpymo_engine *e, unsigned short save_id);
@@ -14,15 +20,46 @@ void cpymo_save_autosave(struct cpymo_engine *e);
 static inline void cpymo_save_autosave(struct cpymo_engine *e) {}
 #endif
 
-FILE * cpymo_save_open_read(struct cpymo_engine *e, unsigned short save_id);
+// Reads a whole save into a malloc'd buffer and checks its trailer,
+// *size then excludes the trailer.
+// Returns CPYMO_ERR_CAN_NOT_OPEN_FILE if the slot is empty
+// and CPYMO_ERR_BAD_FILE_FORMAT if the save is corrupted.
+error_t cpymo_save_read(
+	struct cpymo_engine *e, unsigned short save_id, uint8_t **data, size_t *size);
 
 typedef struct {
 	char *title;
 	char *say_name, *say_text;
 } cpymo_save_title;
 
-error_t cpymo_save_load_title(cpymo_save_title *out, FILE *save);
+error_t cpymo_save_load_title(cpymo_save_title *out, const uint8_t *data, size_t size);
+
+error_t cpymo_save_load_savedata(struct cpymo_engine *e, const uint8_t *data, size_t size);
+
+// Returns CPYMO_ERR_CAN_NOT_OPEN_FILE if the slot is empty.
+error_t cpymo_save_load(struct cpymo_engine *e, unsigned short save_id);
+
+// Titles of every slot, kept in save/saves.cidx by cpymo_save_write,
+// so the save and load menus read one file instead of every slot.
+typedef struct {
+	bool present;
+	int64_t timestamp;
+	cpymo_save_title title;
+} cpymo_save_index_slot;
+
+typedef struct {
+	cpymo_save_index_slot slots[CPYMO_MAX_SAVES];
+	bool loaded;
+} cpymo_save_index;
+
+void cpymo_save_index_init(cpymo_save_index *index);
+void cpymo_save_index_free(cpymo_save_index *index);
+
+// Reads the index, rebuilding it from the slots if it is missing or broken.
+// Called once by cpymo_engine_init, cpymo_save_write then updates it in memory
+// and queues it on the save writer, so saving never reads or waits for it.
+error_t cpymo_save_index_load(struct cpymo_engine *e);
 
-error_t cpymo_save_load_savedata(struct cpymo_engine *e, FILE *save);
+error_t cpymo_save_index_get(struct cpymo_engine *e, const cpymo_save_index **out);
 
 #endif
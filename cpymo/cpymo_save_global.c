@@ -8,166 +8,519 @@
 #include <math.h>
 #include <stdlib.h>
 #include <assert.h>
+#include "../stb/stb_ds.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-error_t cpymo_save_global_load(cpymo_engine *e)
+#define CPYMO_SAVE_GLOBAL_JOURNAL "global.cjnl"
+
+// Journal records, all integers are little endian:
+// generation: type, uint32 generation, only at the beginning
+// var:        type, uint16 name length, name, int32 value
+// flag:       type, uint64 flag
+enum {
+	cpymo_save_global_journal_generation = 1,
+	cpymo_save_global_journal_var = 2,
+	cpymo_save_global_journal_flag = 3
+};
+
+void cpymo_save_global_journal_init(cpymo_save_global_journal *j)
+{
+	j->entries = 0;
+	j->generation = 0;
+	j->stale = false;
+	j->compacting = false;
+	j->compacting_generation = 0;
+	j->since_flush = 0;
+}
+
+static error_t cpymo_save_global_read_all(
+	cpymo_engine *e, const char *name, uint8_t **buf, size_t *size)
 {
-	FILE *file = cpymo_backend_read_save(e->assetloader.gamedir, "global.csav");
+	FILE *file = cpymo_backend_read_save(e->assetloader.gamedir, name);
 	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 
-	#define READ(PTR, UNITSIZE, COUNT) \
-		if (fread(PTR, UNITSIZE, COUNT, file) != COUNT) { \
-			if(buf) free(buf); \
-			fclose(file); \
-			return CPYMO_ERR_BAD_FILE_FORMAT; \
-		}
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (file_size < 0) {
+		fclose(file);
+		return CPYMO_ERR_UNKNOWN;
+	}
 
-	char *buf = NULL;
-	size_t buf_size = 0;
-
-	#define ENSURE_BUF(SIZE) \
-		if (buf_size < SIZE) { \
-			if (buf != NULL) { \
-				char *new_buf = (char *)realloc(buf, SIZE); \
-				if (new_buf) { \
-					buf = new_buf; \
-				} \
-				else { \
-					free(buf); \
-					fclose(file); \
-					return CPYMO_ERR_OUT_OF_MEM; \
-				} \
-			} \
-			else buf = (char *)malloc(SIZE); \
-			if(buf == NULL) { \
-				fclose(file); \
-				return CPYMO_ERR_OUT_OF_MEM; \
-			} \
-			buf_size = SIZE; \
-		}
+	*size = (size_t)file_size;
+	*buf = (uint8_t *)malloc(*size ? *size : 1);
+	if (*buf == NULL) {
+		fclose(file);
+		return CPYMO_ERR_OUT_OF_MEM;
+	}
+
+	const size_t read = fread(*buf, 1, *size, file);
+	fclose(file);
+	if (read != *size) {
+		free(*buf);
+		*buf = NULL;
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+// Returns CPYMO_ERR_BAD_FILE_FORMAT without loading anything
+// if the checksum of the snapshot does not match.
+static error_t cpymo_save_global_load_snapshot(cpymo_engine *e)
+{
+	uint8_t *buf = NULL;
+	size_t size = 0;
+	error_t err = cpymo_save_global_read_all(e, "global.csav", &buf, &size);
+	CPYMO_THROW(err);
+
+	if (!cpymo_save_writer_verify(buf, size)) {
+		free(buf);
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
+	// Snapshots written before the trailer have none.
+	if (size >= CPYMO_SAVE_WRITER_TRAILER_SIZE
+		&& memcmp(buf + size - 4, CPYMO_SAVE_WRITER_MAGIC, 4) == 0)
+		size -= CPYMO_SAVE_WRITER_TRAILER_SIZE;
+
+	const uint8_t *p = buf, *end = buf + size;
+
+	#define READ(DST, SIZE) \
+		if ((size_t)(end - p) < (SIZE)) { \
+			free(buf); \
+			return CPYMO_ERR_BAD_FILE_FORMAT; \
+		} \
+		memcpy(DST, p, SIZE); \
+		p += SIZE;
 
 	// Global Variables
 	while (true) {
 		uint8_t flag = 0;
-		READ(&flag, sizeof(flag), 1);
+		READ(&flag, sizeof(flag));
 
 		if (flag == 0) break;
 
 		if (flag != 1 && flag != 2) {
-			fclose(file);
+			free(buf);
 			return CPYMO_ERR_BAD_FILE_FORMAT;
 		}
 
 		uint16_t var_name_len;
-		READ(&var_name_len, sizeof(var_name_len), 1);
+		READ(&var_name_len, sizeof(var_name_len));
 		var_name_len = end_le16toh(var_name_len);
 
-		ENSURE_BUF(var_name_len);
-		READ(buf, sizeof(char), var_name_len);
+		cpymo_str var_name;
+		var_name.begin = (const char *)p;
+		var_name.len = var_name_len;
+		if ((size_t)(end - p) < var_name_len) {
+			free(buf);
+			return CPYMO_ERR_BAD_FILE_FORMAT;
+		}
+		p += var_name_len;
 
 		uint32_t val_abs;
-		READ(&val_abs, sizeof(val_abs), 1);
+		READ(&val_abs, sizeof(val_abs));
 		val_abs = end_le32toh(val_abs);
 
-		cpymo_str var_name;
-		var_name.begin = buf;
-		var_name.len = var_name_len;
-
-		error_t err = cpymo_vars_set(&e->vars, var_name,
+		err = cpymo_vars_set(&e->vars, var_name,
 			flag == 1 ? (int)val_abs : -(int)val_abs);
 
 		if (err != CPYMO_ERR_SUCC) {
-			if (buf) free(buf);
-			fclose(file);
+			free(buf);
 			return err;
 		}
 	}
 
 	// Hash Flags
 	uint64_t hash_flags_count;
-	READ(&hash_flags_count, sizeof(hash_flags_count), 1);
+	READ(&hash_flags_count, sizeof(hash_flags_count));
 	hash_flags_count = end_le64toh(hash_flags_count);
 
-	for (size_t i = 0; i < hash_flags_count; ++i) {
-		uint64_t flag;
-		READ(&flag, sizeof(flag), 1);
-		flag = end_le64toh(flag);
-		cpymo_hash_flags_add(&e->flags, flag);
+	if (hash_flags_count > (uint64_t)(end - p) / sizeof(cpymo_hash_flag)) {
+		free(buf);
+		return CPYMO_ERR_BAD_FILE_FORMAT;
 	}
 
-	if (buf) free(buf);
-	fclose(file);
+	if (hash_flags_count) {
+		cpymo_hash_flag *flags = (cpymo_hash_flag *)malloc((size_t)hash_flags_count * sizeof(cpymo_hash_flag));
+		if (flags == NULL) {
+			free(buf);
+			return CPYMO_ERR_OUT_OF_MEM;
+		}
 
-	e->flags.dirty = false;
-	e->vars.globals_dirty = false;
+		READ(flags, (size_t)hash_flags_count * sizeof(cpymo_hash_flag));
+		for (size_t i = 0; i < hash_flags_count; ++i)
+			flags[i] = end_le64toh(flags[i]);
 
+		err = cpymo_hash_flags_add_many(&e->flags, flags, (size_t)hash_flags_count);
+		free(flags);
+		if (err != CPYMO_ERR_SUCC) {
+			free(buf);
+			return err;
+		}
+	}
+
+	// Snapshots written before the journal end here.
+	uint32_t generation;
+	if ((size_t)(end - p) >= sizeof(generation)) {
+		memcpy(&generation, p, sizeof(generation));
+		e->global_journal.generation = end_le32toh(generation);
+	}
+
+	free(buf);
 	return CPYMO_ERR_SUCC;
 
 	#undef READ
-	#undef ENSURE_BUF
 }
 
-error_t cpymo_save_global_save(cpymo_engine *e)
+// Returns CPYMO_ERR_BAD_FILE_FORMAT if the last record was cut off
+// or the journal belongs to another snapshot.
+// Without a snapshot to check against, any_generation takes the journal as it is.
+static error_t cpymo_save_global_load_journal(cpymo_engine *e, bool any_generation)
 {
-	if (e->vars.globals_dirty == false && e->flags.dirty == false)
+	e->global_journal.entries = 0;
+
+	uint8_t *buf = NULL;
+	size_t size = 0;
+	error_t err = cpymo_save_global_read_all(e, CPYMO_SAVE_GLOBAL_JOURNAL, &buf, &size);
+	CPYMO_THROW(err);
+
+	if (size == 0) {
+		free(buf);
 		return CPYMO_ERR_SUCC;
+	}
 
-	e->vars.globals_dirty = false;
-	e->flags.dirty = false;
+	size_t p = 0;
 
-	FILE *file = cpymo_backend_write_save(e->assetloader.gamedir, "global.csav");
-	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+	uint32_t generation = 0;
+	if (size >= 5 && buf[0] == cpymo_save_global_journal_generation) {
+		memcpy(&generation, buf + 1, sizeof(generation));
+		generation = end_le32toh(generation);
+		p = 5;
+	}
 
-	#define WRITE(PTR, UNITSIZE, COUNT) \
-		if (fwrite(PTR, UNITSIZE, COUNT, file) != COUNT) { \
-			fclose(file); \
-			return CPYMO_ERR_BAD_FILE_FORMAT; \
+	if (any_generation) e->global_journal.generation = generation;
+	else if (generation != e->global_journal.generation) {
+		free(buf);
+		return CPYMO_ERR_BAD_FILE_FORMAT;
+	}
+
+	while (p < size && err == CPYMO_ERR_SUCC) {
+		const size_t left = size - p;
+
+		if (buf[p] == cpymo_save_global_journal_var && left >= 3) {
+			uint16_t name_len;
+			memcpy(&name_len, buf + p + 1, sizeof(name_len));
+			name_len = end_le16toh(name_len);
+
+			if (left < 3 + (size_t)name_len + 4) {
+				err = CPYMO_ERR_BAD_FILE_FORMAT;
+				break;
+			}
+
+			uint32_t val;
+			memcpy(&val, buf + p + 3 + name_len, sizeof(val));
+			val = end_le32toh(val);
+
+			cpymo_str name;
+			name.begin = (const char *)buf + p + 3;
+			name.len = name_len;
+
+			err = cpymo_vars_set(&e->vars, name, (cpymo_val)val);
+			p += 3 + (size_t)name_len + 4;
+		}
+		else if (buf[p] == cpymo_save_global_journal_flag && left >= 9) {
+			uint64_t flag;
+			memcpy(&flag, buf + p + 1, sizeof(flag));
+			err = cpymo_hash_flags_add(&e->flags, end_le64toh(flag));
+			p += 9;
+		}
+		else err = CPYMO_ERR_BAD_FILE_FORMAT;
+
+		if (err == CPYMO_ERR_SUCC) e->global_journal.entries++;
+	}
+
+	free(buf);
+	return err;
+}
+
+error_t cpymo_save_global_load(cpymo_engine *e)
+{
+	error_t err = cpymo_save_global_load_snapshot(e);
+
+	// A broken snapshot is replaced by what the journal still has.
+	const bool snapshot_broken = err == CPYMO_ERR_BAD_FILE_FORMAT;
+	if (snapshot_broken) {
+		printf("[Error] global.csav is corrupted, loading the journal only.\n");
+		err = CPYMO_ERR_SUCC;
+	}
+	else if (err != CPYMO_ERR_SUCC && err != CPYMO_ERR_CAN_NOT_OPEN_FILE) return err;
+
+	error_t journal_err = cpymo_save_global_load_journal(e, snapshot_broken);
+
+	cpymo_vars_clear_unsaved_globals(&e->vars);
+	cpymo_hash_flags_clear_unsaved(&e->flags);
+
+	// Nothing can be appended to this journal, compact it on the next save.
+	if (snapshot_broken || journal_err == CPYMO_ERR_BAD_FILE_FORMAT) {
+		e->global_journal.stale = true;
+		journal_err = CPYMO_ERR_SUCC;
+	}
+
+	return err == CPYMO_ERR_SUCC ? err : journal_err;
+}
+
+static error_t cpymo_save_global_append_journal(cpymo_engine *e)
+{
+	const cpymo_var_slot *vars = e->vars.unsaved_globals;
+	const cpymo_hash_flag *flags = e->flags.unsaved;
+	const size_t var_count = arrlenu(vars), flag_count = arrlenu(flags);
+
+	// Records are built in one buffer and appended with one fwrite.
+	size_t size = flag_count * 9;
+	for (size_t i = 0; i < var_count; ++i)
+		size += 3 + strlen(cpymo_vars_slot_name(&e->vars, vars[i])) + 4;
+
+	uint8_t *buf = (uint8_t *)malloc(size);
+	if (buf == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	uint8_t *p = buf;
+	for (size_t i = 0; i < var_count; ++i) {
+		const char *name = cpymo_vars_slot_name(&e->vars, vars[i]);
+		uint16_t name_len = (uint16_t)strlen(name);
+		uint16_t name_len_le16 = end_htole16(name_len);
+		uint32_t val = end_htole32((uint32_t)cpymo_vars_get_slot(&e->vars, vars[i]));
+
+		*p++ = cpymo_save_global_journal_var;
+		memcpy(p, &name_len_le16, sizeof(name_len_le16)); p += sizeof(name_len_le16);
+		memcpy(p, name, name_len); p += name_len;
+		memcpy(p, &val, sizeof(val)); p += sizeof(val);
+	}
+
+	for (size_t i = 0; i < flag_count; ++i) {
+		uint64_t flag = end_htole64(flags[i]);
+		*p++ = cpymo_save_global_journal_flag;
+		memcpy(p, &flag, sizeof(flag)); p += sizeof(flag);
+	}
+
+	assert((size_t)(p - buf) == size);
+
+	FILE *file = cpymo_backend_append_save(e->assetloader.gamedir, CPYMO_SAVE_GLOBAL_JOURNAL);
+	if (file == NULL) {
+		free(buf);
+		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+	}
+
+	bool written = fwrite(buf, 1, size, file) == size;
+	written = fclose(file) == 0 && written;
+	free(buf);
+
+	if (!written) return CPYMO_ERR_UNKNOWN;
+
+	e->global_journal.entries += var_count + flag_count;
+	cpymo_vars_clear_unsaved_globals(&e->vars);
+	cpymo_hash_flags_clear_unsaved(&e->flags);
+
+#ifdef __EMSCRIPTEN__
+	EM_ASM(FS.syncfs(false, function(err) {}););
+#endif
+
+	return CPYMO_ERR_SUCC;
+}
+
+static bool cpymo_save_global_journal_usable(const cpymo_engine *e)
+{
+	// The journal can not record deleted flags.
+	return !e->global_journal.stale && !e->flags.unsaved_deletion;
+}
+
+static void cpymo_save_global_start_journal(cpymo_engine *e)
+{
+	uint32_t generation_le32 = end_htole32(e->global_journal.generation);
+
+	// Until this is written, the old journal is ignored for its generation.
+	FILE *file = cpymo_backend_write_save(e->assetloader.gamedir, CPYMO_SAVE_GLOBAL_JOURNAL);
+	bool journal_started = false;
+	if (file) {
+		uint8_t header[5] = { cpymo_save_global_journal_generation };
+		memcpy(header + 1, &generation_le32, sizeof(generation_le32));
+		journal_started = fwrite(header, sizeof(header), 1, file) == 1;
+		journal_started = fclose(file) == 0 && journal_started;
+	}
+
+	e->global_journal.entries = 0;
+	e->global_journal.stale = !journal_started;
+
+#ifdef __EMSCRIPTEN__
+	EM_ASM(FS.syncfs(false, function(err) {}););
+#endif
+}
+
+// Returns true while the snapshot is still being written.
+static bool cpymo_save_global_compacting(cpymo_engine *e, bool wait)
+{
+	cpymo_save_global_journal *j = &e->global_journal;
+	if (!j->compacting) return false;
+
+	if (wait) cpymo_save_writer_wait(&e->save_writer);
+
+	error_t err;
+	if (!cpymo_save_writer_poll(&e->save_writer, &j->compacting_ticket, &err))
+		return true;
+
+	j->compacting = false;
+
+	// The old snapshot and journal are still in place,
+	// but they miss what went into the new snapshot.
+	if (err != CPYMO_ERR_SUCC) {
+		printf("[Warning] Can not write global savedata: %s\n", cpymo_error_message(err));
+		j->stale = true;
+		return false;
+	}
+
+	j->generation = j->compacting_generation;
+	cpymo_save_global_start_journal(e);
+	return false;
+}
+
+error_t cpymo_save_global_save(cpymo_engine *e)
+{
+	e->global_journal.since_flush = 0;
+
+	// Changes made meanwhile go to the journal of the new snapshot.
+	if (cpymo_save_global_compacting(e, false)) return CPYMO_ERR_SUCC;
+
+	const size_t unsaved = arrlenu(e->vars.unsaved_globals) + arrlenu(e->flags.unsaved);
+	if (cpymo_save_global_journal_usable(e)
+		&& e->global_journal.entries + unsaved <= CPYMO_SAVE_GLOBAL_JOURNAL_MAX_ENTRIES) {
+		if (unsaved == 0) return CPYMO_ERR_SUCC;
+		if (cpymo_save_global_append_journal(e) == CPYMO_ERR_SUCC)
+			return CPYMO_ERR_SUCC;
+	}
+
+	return cpymo_save_global_compact(e);
+}
+
+error_t cpymo_save_global_flush(cpymo_engine *e)
+{
+	cpymo_save_global_compacting(e, true);
+
+	error_t err = cpymo_save_global_save(e);
+	CPYMO_THROW(err);
+
+	if (!e->global_journal.compacting) return CPYMO_ERR_SUCC;
+
+	cpymo_save_writer_wait(&e->save_writer);
+	cpymo_save_writer_poll(&e->save_writer, &e->global_journal.compacting_ticket, &err);
+	cpymo_save_global_compacting(e, true);
+	return err;
+}
+
+void cpymo_save_global_update(cpymo_engine *e, float delta_time)
+{
+	if (e->assetloader.gamedir == NULL) return;
+
+	e->global_journal.since_flush += delta_time;
+	if (e->global_journal.since_flush < CPYMO_SAVE_GLOBAL_JOURNAL_INTERVAL) return;
+	e->global_journal.since_flush = 0;
+
+	// Snapshots are only written when the game saves or exits,
+	// until then the journal may grow past CPYMO_SAVE_GLOBAL_JOURNAL_MAX_ENTRIES.
+	if (cpymo_save_global_compacting(e, false)) return;
+	if (!cpymo_save_global_journal_usable(e)) return;
+	if (arrlenu(e->vars.unsaved_globals) + arrlenu(e->flags.unsaved) == 0) return;
+
+	// Failures are reported when the game saves or exits.
+	cpymo_save_global_append_journal(e);
+}
+
+error_t cpymo_save_global_compact(cpymo_engine *e)
+{
+	assert(!e->global_journal.compacting);
+
+	const size_t global_vars = cpymo_vars_count(&e->vars, true);
+	const size_t hash_flags_count = cpymo_hash_flags_count(&e->flags);
+
+	// Snapshot: global variables, end flag, hash flags count,
+	// hash flags, generation, then the save writer trailer.
+	size_t size = 1 + sizeof(uint64_t) + hash_flags_count * sizeof(cpymo_hash_flag) + sizeof(uint32_t);
+	for (size_t i = 0; i < global_vars; ++i) {
+		cpymo_val val;
+		size += 1 + 2 + strlen(cpymo_vars_get_by_index(&e->vars, true, i, &val)) + 4;
+	}
+
+	uint8_t *buf = (uint8_t *)malloc(size + CPYMO_SAVE_WRITER_TRAILER_SIZE);
+	if (buf == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	cpymo_hash_flag *hash_flags = NULL;
+	if (hash_flags_count) {
+		hash_flags = (cpymo_hash_flag *)malloc(hash_flags_count * sizeof(cpymo_hash_flag));
+		if (hash_flags == NULL) {
+			free(buf);
+			return CPYMO_ERR_OUT_OF_MEM;
 		}
 
+		cpymo_hash_flags_copy_to(&e->flags, hash_flags);
+		for (size_t i = 0; i < hash_flags_count; ++i)
+			hash_flags[i] = end_htole64(hash_flags[i]);
+	}
+
+	uint8_t *p = buf;
+
 	// Global Variables
-	size_t global_vars = cpymo_vars_count(&e->vars.globals);
 	for (size_t i = 0; i < global_vars; ++i) {
 		cpymo_val val;
 		const char *var_name = 
-			cpymo_vars_get_by_index(e->vars.globals, i, &val);
+			cpymo_vars_get_by_index(&e->vars, true, i, &val);
 		uint16_t var_name_len = (uint16_t)strlen(var_name);
 		uint16_t var_name_len_le16 = end_htole16(var_name_len);
-
-		uint8_t negative = val >= 0 ? 1 : 2;
-		WRITE(&negative, sizeof(negative), 1);
-
-		WRITE(&var_name_len_le16, sizeof(var_name_len_le16), 1);
-		WRITE(var_name, sizeof(var_name[0]), var_name_len);
-
 		uint32_t val_abs = end_htole32((uint32_t)abs(val));
-		WRITE(&val_abs, sizeof(val_abs), 1);
+
+		*p++ = val >= 0 ? 1 : 2;
+		memcpy(p, &var_name_len_le16, sizeof(var_name_len_le16)); p += sizeof(var_name_len_le16);
+		memcpy(p, var_name, var_name_len); p += var_name_len;
+		memcpy(p, &val_abs, sizeof(val_abs)); p += sizeof(val_abs);
 	}
 
-	uint8_t end_flag = 0;
-	WRITE(&end_flag, sizeof(end_flag), 1);
+	*p++ = 0;
 
 	// Hash Flags
-	size_t hash_flags_count = cpymo_hash_flags_count(&e->flags);
 	uint64_t hash_flags_count_le64 = end_htole64((uint64_t)hash_flags_count);
-	WRITE(&hash_flags_count_le64, sizeof(hash_flags_count_le64), 1);
+	memcpy(p, &hash_flags_count_le64, sizeof(hash_flags_count_le64));
+	p += sizeof(hash_flags_count_le64);
 
-	for (size_t i = 0; i < hash_flags_count; ++i) {
-		uint64_t flag = end_htole64(cpymo_hash_flags_get(&e->flags, i));
-		WRITE(&flag, sizeof(flag), 1);
+	if (hash_flags_count) {
+		memcpy(p, hash_flags, hash_flags_count * sizeof(cpymo_hash_flag));
+		p += hash_flags_count * sizeof(cpymo_hash_flag);
+		free(hash_flags);
 	}
 
-	fclose(file);
+	const uint32_t generation = e->global_journal.generation + 1;
+	uint32_t generation_le32 = end_htole32(generation);
+	memcpy(p, &generation_le32, sizeof(generation_le32));
+	p += sizeof(generation_le32);
 
-#ifdef __EMSCRIPTEN__
-	EM_ASM(FS.syncfs(false, function(err) {}););
-#endif
+	assert((size_t)(p - buf) == size);
 
-	return CPYMO_ERR_SUCC;
+	// The snapshot replaces global.csav only once it is completely written,
+	// the generation moves on after that.
+	error_t err = cpymo_save_writer_write_tracked(
+		&e->save_writer, "global.csav", buf, size, &e->global_journal.compacting_ticket);
+	CPYMO_THROW(err);
+
+	e->global_journal.compacting = true;
+	e->global_journal.compacting_generation = generation;
+	cpymo_vars_clear_unsaved_globals(&e->vars);
+	cpymo_hash_flags_clear_unsaved(&e->flags);
 
-	#undef WRITE
+	// Without the writer thread, it is already written.
+	cpymo_save_global_compacting(e, false);
+
+	return CPYMO_ERR_SUCC;
 }
 
 error_t cpymo_save_config_save(const cpymo_engine *e)
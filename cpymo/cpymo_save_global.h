@@ -2,12 +2,67 @@
 #define INCLUDE_CPYMO_SAVE_GLOBAL
 
 #include "cpymo_error.h"
+#include "cpymo_save_writer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 struct cpymo_engine;
 
+// global.csav is a full snapshot of global variables and hash flags,
+// global.cjnl journals what changed after it.
+// Changes are appended to the journal at most every
+// CPYMO_SAVE_GLOBAL_JOURNAL_INTERVAL seconds and when the game saves.
+// When the game saves or exits with more than
+// CPYMO_SAVE_GLOBAL_JOURNAL_MAX_ENTRIES entries in the journal,
+// or with deleted flags, a new snapshot is written by the save writer
+// and the journal starts over once it has replaced the old one.
+
+#ifndef CPYMO_SAVE_GLOBAL_JOURNAL_INTERVAL
+#define CPYMO_SAVE_GLOBAL_JOURNAL_INTERVAL 1.0f
+#endif
+
+#ifndef CPYMO_SAVE_GLOBAL_JOURNAL_MAX_ENTRIES
+#define CPYMO_SAVE_GLOBAL_JOURNAL_MAX_ENTRIES 4096
+#endif
+
+typedef struct {
+	size_t entries;
+
+	// A journal only applies to the snapshot with the same generation,
+	// so a journal left behind by an interrupted compaction is ignored.
+	uint32_t generation;
+
+	// The journal on disk does not belong to the snapshot,
+	// so only a new snapshot can save changes.
+	bool stale;
+
+	// A snapshot of compacting_generation is being written.
+	bool compacting;
+	uint32_t compacting_generation;
+	cpymo_save_writer_ticket compacting_ticket;
+
+	float since_flush;
+} cpymo_save_global_journal;
+
+void cpymo_save_global_journal_init(cpymo_save_global_journal *);
+
+// If the checksum of global.csav does not match,
+// only the journal is loaded and the next save writes a new snapshot.
 error_t cpymo_save_global_load(struct cpymo_engine *);
+
+// Appends unsaved changes to the journal, or compacts it.
 error_t cpymo_save_global_save(struct cpymo_engine *);
 
+// Like cpymo_save_global_save, but waits until everything is written.
+error_t cpymo_save_global_flush(struct cpymo_engine *);
+
+// Queues a snapshot on the save writer,
+// the journal starts over once it is written.
+error_t cpymo_save_global_compact(struct cpymo_engine *);
+
+void cpymo_save_global_update(struct cpymo_engine *, float delta_time);
+
 error_t cpymo_save_config_save(const struct cpymo_engine *);
 error_t cpymo_save_config_load(struct cpymo_engine *);
 
@@ -9,10 +9,6 @@
 #include <string.h>
 #include <stdlib.h>
 
-#ifndef CPYMO_MAX_SAVES
-#define CPYMO_MAX_SAVES 31
-#endif
-
 typedef struct {
 	cpymo_backend_text text;
 #ifdef ENABLE_TEXT_EXTRACT
@@ -181,22 +177,17 @@ error_t cpymo_save_ui_enter(cpymo_engine *e, bool is_load_ui)
 	const float fontsize = cpymo_gameconfig_font_size(&e->gameconfig);
 	size_t characters = (size_t)((float)e->gameconfig.imagesize_w / fontsize * 1.3f);
 
+	const cpymo_save_index *index = NULL;
+	err = cpymo_save_index_get(e, &index);
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_ui_exit(e);
+		return err;
+	}
+
 	char text_buf[1024];
 	for (size_t i = is_load_ui ? 0 : first_slot; i < CPYMO_MAX_SAVES; ++i) {
-		FILE *save = cpymo_save_open_read(e, (unsigned short)i);
-		cpymo_save_title title;
-		title.say_name = NULL;
-		title.say_text = NULL;
-		title.title = NULL;
-
-		if (save) {
-			error_t err = cpymo_save_load_title(&title, save);
-			fclose(save);
-			if (err != CPYMO_ERR_SUCC) ui->items[i].is_empty_save = true;
-		}
-		else {
-			ui->items[i].is_empty_save = true;
-		}
+		const cpymo_save_title title = index->slots[i].title;
+		ui->items[i].is_empty_save = !index->slots[i].present;
 
 		if (!ui->items[i].is_empty_save) {
 			assert(title.say_name != NULL);
@@ -206,9 +197,6 @@ error_t cpymo_save_ui_enter(cpymo_engine *e, bool is_load_ui)
 			char *tmp_str = (char *)malloc(strlen(title.say_name) + strlen(title.say_text) + 16);
 			if (tmp_str == NULL) {
 				cpymo_ui_exit(e);
-				free(title.say_name);
-				free(title.say_text);
-				free(title.title);
 				return CPYMO_ERR_OUT_OF_MEM;
 			}
 
@@ -247,9 +235,6 @@ error_t cpymo_save_ui_enter(cpymo_engine *e, bool is_load_ui)
 
 			if (err != CPYMO_ERR_SUCC) {
 				free(tmp_str);
-				free(title.say_name);
-				free(title.title);
-				free(title.say_text);
 				return err;
 			}
 
@@ -258,10 +243,6 @@ error_t cpymo_save_ui_enter(cpymo_engine *e, bool is_load_ui)
 
 			free(tmp_str);
 
-			free(title.say_name);
-			free(title.title);
-			free(title.say_text);
-
 			cpymo_utils_replace_str_newline_n(text_buf);
 		}
 		else {
@@ -307,11 +288,7 @@ static error_t cpymo_save_ui_load_savedata_yesnobox_confirm(
 	cpymo_engine *e, void *save_id_x, bool confirm)
 {
 	if (!confirm) return CPYMO_ERR_SUCC;
-	FILE *file = cpymo_save_open_read(e, (unsigned short)(uintptr_t)save_id_x);
-	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
-	error_t err = cpymo_save_load_savedata(e, file);
-	fclose(file);
-	return err;
+	return cpymo_save_load(e, (unsigned short)(uintptr_t)save_id_x);
 }
 
 error_t cpymo_save_ui_load_savedata_yesnobox(cpymo_engine * e, unsigned short save_id)
@@ -0,0 +1,303 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_save_writer.h"
+#include "cpymo_package.h"
+#include "../cpymo-backends/include/cpymo_backend_save.h"
+#include "../endianness.h/endianness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#if defined(_WIN32)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#define CPYMO_SAVE_WRITER_MAX_NAME 32
+
+typedef struct cpymo_save_writer_job {
+	char name[CPYMO_SAVE_WRITER_MAX_NAME];
+	uint8_t *data;
+	size_t size;
+	cpymo_save_writer_ticket *ticket;
+	struct cpymo_save_writer_job *next;
+} cpymo_save_writer_job;
+
+// Makes sure the data is on the disk before the tmp file replaces the save,
+// otherwise a power loss can leave the renamed save empty.
+static bool cpymo_save_writer_sync(FILE *file)
+{
+	if (fflush(file) != 0) return false;
+
+#if defined(_WIN32)
+	return _commit(_fileno(file)) == 0;
+#elif defined(__unix__) || defined(__APPLE__)
+	return fsync(fileno(file)) == 0;
+#else
+	return true;
+#endif
+}
+
+static error_t cpymo_save_writer_write_file(
+	const char *gamedir, const char *name, uint8_t *data, size_t size)
+{
+	uint32_t crc = end_htole32(cpymo_package_crc32(0, data, size));
+	memcpy(data + size, &crc, sizeof(crc));
+	memcpy(data + size + sizeof(crc), CPYMO_SAVE_WRITER_MAGIC, 4);
+	size += CPYMO_SAVE_WRITER_TRAILER_SIZE;
+
+	char tmp_name[CPYMO_SAVE_WRITER_MAX_NAME + 4];
+	sprintf(tmp_name, "%s.tmp", name);
+
+	FILE *file = cpymo_backend_write_save(gamedir, tmp_name);
+	if (file == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
+
+	bool written = fwrite(data, size, 1, file) == 1;
+	written = written && cpymo_save_writer_sync(file);
+	written = fclose(file) == 0 && written;
+	if (!written) return CPYMO_ERR_UNKNOWN;
+
+	return cpymo_backend_move_save(gamedir, tmp_name, name);
+}
+
+bool cpymo_save_writer_verify(const uint8_t *data, size_t size)
+{
+	if (size < CPYMO_SAVE_WRITER_TRAILER_SIZE) return true;
+
+	const uint8_t *trailer = data + size - CPYMO_SAVE_WRITER_TRAILER_SIZE;
+	if (memcmp(trailer + 4, CPYMO_SAVE_WRITER_MAGIC, 4) != 0) return true;
+
+	uint32_t crc;
+	memcpy(&crc, trailer, sizeof(crc));
+	return end_le32toh(crc) == 
+		cpymo_package_crc32(0, data, size - CPYMO_SAVE_WRITER_TRAILER_SIZE);
+}
+
+#ifdef ENABLE_ASYNC_SAVE
+
+static void *cpymo_save_writer_worker(void *userdata)
+{
+	cpymo_save_writer *w = (cpymo_save_writer *)userdata;
+
+	pthread_mutex_lock(&w->lock);
+	while (true) {
+		while (!w->quit && w->queue_head == NULL)
+			pthread_cond_wait(&w->job_queued, &w->lock);
+
+		if (w->queue_head == NULL) break;
+
+		cpymo_save_writer_job *job = w->queue_head;
+		w->queue_head = job->next;
+		if (w->queue_head == NULL) w->queue_tail = NULL;
+		w->writing = true;
+
+		pthread_mutex_unlock(&w->lock);
+
+		error_t err = cpymo_save_writer_write_file(w->gamedir, job->name, job->data, job->size);
+		cpymo_save_writer_ticket *ticket = job->ticket;
+		free(job->data);
+		free(job);
+
+		pthread_mutex_lock(&w->lock);
+		w->writing = false;
+		if (ticket) {
+			ticket->done = true;
+			ticket->err = err;
+		}
+		else if (err != CPYMO_ERR_SUCC) w->last_error = err;
+		if (w->queue_head == NULL) pthread_cond_broadcast(&w->idle);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+void cpymo_save_writer_init(cpymo_save_writer *w, const char *gamedir)
+{
+	w->gamedir = gamedir;
+	w->worker_started = false;
+	w->queue_head = NULL;
+	w->queue_tail = NULL;
+	w->writing = false;
+	w->quit = false;
+	w->last_error = CPYMO_ERR_SUCC;
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->job_queued, NULL);
+	pthread_cond_init(&w->idle, NULL);
+}
+
+void cpymo_save_writer_free(cpymo_save_writer *w)
+{
+	// The worker writes what is queued before it quits.
+	if (w->worker_started) {
+		pthread_mutex_lock(&w->lock);
+		w->quit = true;
+		pthread_cond_broadcast(&w->job_queued);
+		pthread_mutex_unlock(&w->lock);
+
+		pthread_join(w->worker, NULL);
+		w->worker_started = false;
+	}
+
+	pthread_cond_destroy(&w->idle);
+	pthread_cond_destroy(&w->job_queued);
+	pthread_mutex_destroy(&w->lock);
+}
+
+static error_t cpymo_save_writer_queue(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size,
+	cpymo_save_writer_ticket *ticket)
+{
+	if (strlen(name) >= CPYMO_SAVE_WRITER_MAX_NAME) {
+		free(data);
+		return CPYMO_ERR_INVALID_ARG;
+	}
+
+	if (!w->worker_started) {
+		w->worker_started = 
+			pthread_create(&w->worker, NULL, &cpymo_save_writer_worker, w) == 0;
+	}
+
+	if (!w->worker_started) {
+		error_t err = cpymo_save_writer_write_file(w->gamedir, name, data, size);
+		free(data);
+
+		if (ticket == NULL) return err;
+		ticket->done = true;
+		ticket->err = err;
+		return CPYMO_ERR_SUCC;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	error_t err = w->last_error;
+	w->last_error = CPYMO_ERR_SUCC;
+
+	cpymo_save_writer_job *job = w->queue_head;
+	while (job && strcmp(job->name, name) != 0) job = job->next;
+
+	if (ticket) {
+		ticket->done = false;
+		ticket->err = CPYMO_ERR_SUCC;
+	}
+
+	if (job) {
+		// The replaced data is never written, its ticket is done as superseded.
+		if (job->ticket && job->ticket != ticket) {
+			job->ticket->done = true;
+			job->ticket->err = CPYMO_ERR_SUCC;
+		}
+
+		free(job->data);
+		job->data = data;
+		job->size = size;
+		job->ticket = ticket;
+	}
+	else {
+		job = (cpymo_save_writer_job *)malloc(sizeof(cpymo_save_writer_job));
+		if (job == NULL) {
+			pthread_mutex_unlock(&w->lock);
+			free(data);
+			return CPYMO_ERR_OUT_OF_MEM;
+		}
+
+		strcpy(job->name, name);
+		job->data = data;
+		job->size = size;
+		job->ticket = ticket;
+		job->next = NULL;
+
+		if (w->queue_tail) w->queue_tail->next = job;
+		else w->queue_head = job;
+		w->queue_tail = job;
+		pthread_cond_signal(&w->job_queued);
+	}
+
+	pthread_mutex_unlock(&w->lock);
+	return err;
+}
+
+error_t cpymo_save_writer_write(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size)
+{
+	return cpymo_save_writer_queue(w, name, data, size, NULL);
+}
+
+error_t cpymo_save_writer_write_tracked(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size,
+	cpymo_save_writer_ticket *ticket)
+{
+	return cpymo_save_writer_queue(w, name, data, size, ticket);
+}
+
+bool cpymo_save_writer_poll(
+	cpymo_save_writer *w, const cpymo_save_writer_ticket *ticket, error_t *err)
+{
+	if (!w->worker_started) {
+		*err = ticket->err;
+		return ticket->done;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	const bool done = ticket->done;
+	*err = ticket->err;
+	pthread_mutex_unlock(&w->lock);
+
+	return done;
+}
+
+void cpymo_save_writer_wait(cpymo_save_writer *w)
+{
+	if (!w->worker_started) return;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->queue_head || w->writing)
+		pthread_cond_wait(&w->idle, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+}
+
+#else
+
+void cpymo_save_writer_init(cpymo_save_writer *w, const char *gamedir)
+{
+	w->gamedir = gamedir;
+}
+
+void cpymo_save_writer_free(cpymo_save_writer *w) {}
+
+error_t cpymo_save_writer_write(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size)
+{
+	error_t err = cpymo_save_writer_write_file(w->gamedir, name, data, size);
+	free(data);
+
+#ifdef __EMSCRIPTEN__
+	EM_ASM(FS.syncfs(false, function(err) {}););
+#endif
+
+	return err;
+}
+
+error_t cpymo_save_writer_write_tracked(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size,
+	cpymo_save_writer_ticket *ticket)
+{
+	ticket->err = cpymo_save_writer_write(w, name, data, size);
+	ticket->done = true;
+	return CPYMO_ERR_SUCC;
+}
+
+bool cpymo_save_writer_poll(
+	cpymo_save_writer *w, const cpymo_save_writer_ticket *ticket, error_t *err)
+{
+	*err = ticket->err;
+	return ticket->done;
+}
+
+void cpymo_save_writer_wait(cpymo_save_writer *w) {}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef INCLUDE_CPYMO_SAVE_WRITER
+#define INCLUDE_CPYMO_SAVE_WRITER
+
+#include "cpymo_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Writes a serialized save file in one piece.
+// The data is written to <name>.tmp followed by a checksum trailer,
+// then renamed over <name>, so a crash leaves either the old or the new file.
+//
+// With ENABLE_ASYNC_SAVE, files are written on a worker thread
+// and the engine only serializes the save into memory.
+// Otherwise, or if the thread can not be started, files are written synchronously.
+
+#if defined(ENABLE_ASYNC_SAVE) && defined(__EMSCRIPTEN__)
+#undef ENABLE_ASYNC_SAVE
+#endif
+
+// Trailer: uint32 crc32 of everything before it, then this magic.
+// Saves written before the trailer end with a zero uint16,
+// so the magic tells them apart.
+#define CPYMO_SAVE_WRITER_MAGIC "CSAV"
+#define CPYMO_SAVE_WRITER_TRAILER_SIZE 8
+
+#ifdef ENABLE_ASYNC_SAVE
+#include <pthread.h>
+#endif
+
+struct cpymo_save_writer_job;
+
+// Tells when one queued file has been written.
+typedef struct {
+	bool done;
+	error_t err;
+} cpymo_save_writer_ticket;
+
+typedef struct {
+	const char *gamedir;
+
+#ifdef ENABLE_ASYNC_SAVE
+	bool worker_started;
+
+	// Guarded by lock.
+	struct cpymo_save_writer_job *queue_head, *queue_tail;
+	bool writing, quit;
+	error_t last_error;
+
+	pthread_mutex_t lock;
+	pthread_cond_t job_queued, idle;
+	pthread_t worker;
+#endif
+} cpymo_save_writer;
+
+void cpymo_save_writer_init(cpymo_save_writer *w, const char *gamedir);
+
+// Waits for queued files to be written.
+void cpymo_save_writer_free(cpymo_save_writer *w);
+
+// Takes a malloc'd buffer with size bytes of data
+// and CPYMO_SAVE_WRITER_TRAILER_SIZE bytes left after it for the trailer.
+// A file queued again before it was written is only written once,
+// the ticket of the replaced data is then done with CPYMO_ERR_SUCC.
+// Errors of asynchronous writes are reported by the next call.
+error_t cpymo_save_writer_write(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size);
+
+// Like cpymo_save_writer_write, but the result of this file
+// is reported through the ticket instead of the next call.
+// The ticket must stay alive until it is done.
+error_t cpymo_save_writer_write_tracked(
+	cpymo_save_writer *w, const char *name, uint8_t *data, size_t size,
+	cpymo_save_writer_ticket *ticket);
+
+// Returns true once the file of the ticket has been written, and its result in *err.
+bool cpymo_save_writer_poll(
+	cpymo_save_writer *w, const cpymo_save_writer_ticket *ticket, error_t *err);
+
+void cpymo_save_writer_wait(cpymo_save_writer *w);
+
+// Returns false if the file ends with a trailer that does not match.
+bool cpymo_save_writer_verify(const uint8_t *data, size_t size);
+
+#endif
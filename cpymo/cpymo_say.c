@@ -76,6 +76,22 @@ void cpymo_say_free(cpymo_say *say)
 	if (say->current_text) free(say->current_text);
 }
 
+void cpymo_say_reset_text(cpymo_engine *e)
+{
+	cpymo_say *say = &e->say;
+	DISABLE_TEXTBOX(say);
+	RESET_NAME(say);
+
+	if (say->current_name) free(say->current_name);
+	if (say->current_text) free(say->current_text);
+	say->current_name = NULL;
+	say->current_text = NULL;
+
+	say->active = false;
+	say->hide_window = false;
+	say->current_say_is_already_read = true;
+}
+
 void cpymo_say_draw(const struct cpymo_engine *e)
 {
 	if (e->say.active && !e->input.hide_window && !e->say.hide_window) {
@@ -37,6 +37,9 @@ typedef struct {
 void cpymo_say_init(cpymo_say *);
 void cpymo_say_free(cpymo_say *);
 
+// Clears the text and name, keeps the msgbox and namebox images.
+void cpymo_say_reset_text(struct cpymo_engine *e);
+
 void cpymo_say_draw(const struct cpymo_engine *);
 
 error_t cpymo_say_load_msgbox_and_namebox_image(
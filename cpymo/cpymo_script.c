@@ -1,67 +1,465 @@
 #include "cpymo_prelude.h"
 #include "cpymo_script.h"
+#include "cpymo_parser.h"
+#include "cpymo_vars.h"
+#include "cpymo_utils.h"
 #include <string.h>
 #include <stdlib.h>
+#include "../stb/stb_ds.h"
 
-error_t cpymo_script_load(
-    cpymo_script **out, 
-    cpymo_str script_name, 
-    const cpymo_assetloader *l)
+static const char *cpymo_script_op_names[] = {
+	"", "",
+#define CPYMO_SCRIPT_OP(NAME) #NAME,
+	CPYMO_SCRIPT_COMMANDS(CPYMO_SCRIPT_OP)
+#undef CPYMO_SCRIPT_OP
+};
+
+static uint8_t cpymo_script_find_op(cpymo_str command)
+{
+	if (command.len == 0) return cpymo_script_op_none;
+
+	for (size_t i = cpymo_script_op_unknown + 1; i < cpymo_script_op_count; ++i)
+		if (cpymo_str_equals_str(command, cpymo_script_op_names[i]))
+			return (uint8_t)i;
+
+	return cpymo_script_op_unknown;
+}
+
+typedef struct {
+	cpymo_script *script;
+	size_t line_cap, arg_count, arg_cap, condition_count, condition_cap;
+} cpymo_script_compiler;
+
+static cpymo_script_arg cpymo_script_make_arg(cpymo_script *s, cpymo_str cell)
+{
+	cpymo_script_arg arg;
+	arg.begin = cell.begin ? (uint32_t)(cell.begin - s->script_content) : 0;
+	arg.len = (uint32_t)cell.len;
+	arg.ival = cpymo_str_atoi(cell);
+	arg.color = cpymo_str_as_color(cell);
+	arg.var = s->var_count++;
+	return arg;
+}
+
+static error_t cpymo_script_compiler_push_arg(
+	cpymo_script_compiler *c, cpymo_script_line *line, cpymo_str cell)
+{
+	if (c->arg_count >= c->arg_cap) {
+		size_t cap = c->arg_cap ? c->arg_cap * 2 : 1024;
+		cpymo_script_arg *args = (cpymo_script_arg *)realloc(
+			c->script->args, cap * sizeof(cpymo_script_arg));
+		if (args == NULL) return CPYMO_ERR_OUT_OF_MEM;
+		c->script->args = args;
+		c->arg_cap = cap;
+	}
+
+	c->script->args[c->arg_count++] = cpymo_script_make_arg(c->script, cell);
+	line->argc++;
+	return CPYMO_ERR_SUCC;
+}
+
+static void cpymo_script_decode_condition(
+	cpymo_script_condition *out, cpymo_script *s, cpymo_str condition)
+{
+	out->begin = (uint32_t)(condition.begin - s->script_content);
+	out->len = (uint32_t)condition.len;
+	out->cmp = cpymo_script_cmp_bad;
+	out->left = s->empty_arg;
+	out->right = s->empty_arg;
+	out->left_is_constant = true;
+	out->right_is_constant = true;
+
+	cpymo_str left;
+	left.begin = condition.begin;
+	left.len = 0;
+
+	while (left.len < condition.len) {
+		char ch = left.begin[left.len];
+		if (ch == '>' || ch == '<' || ch == '=' || ch == '!') 
+			break;
+		left.len++;
+	}
+
+	if (left.len >= condition.len) return;
+
+	cpymo_str op;
+	op.begin = left.begin + left.len;
+	op.len = 1;
+
+	if (op.begin[0] == '!') {
+		op.len++;
+		if (op.len + left.len >= condition.len) return;
+		if (op.begin[1] != '=') return;
+	}
+
+	if ((op.begin[0] == '>' || op.begin[0] == '<')) {
+		if (op.len + 1 + left.len < condition.len) {
+			if (op.begin[1] == '=')
+				op.len++;
+		}
+	}
+
+	if ((op.begin[0] == '<')) {
+		if (op.len + 1 + left.len < condition.len) {
+			if (op.begin[1] == '>')
+				op.len++;
+		}
+	}
+
+	cpymo_str right;
+	right.begin = op.begin + op.len;
+	right.len = condition.len - op.len - left.len;
+
+	cpymo_str_trim(&left);
+	cpymo_str_trim(&right);
+
+	if (left.len == 0 || right.len == 0) return;
+
+	out->left = cpymo_script_make_arg(s, left);
+	out->right = cpymo_script_make_arg(s, right);
+	out->left_is_constant = cpymo_vars_is_constant(left);
+	out->right_is_constant = cpymo_vars_is_constant(right);
+
+	if (cpymo_str_equals_str(op, "="))
+		out->cmp = cpymo_script_cmp_eq;
+	else if (cpymo_str_equals_str(op, "!=") || cpymo_str_equals_str(op, "<>"))
+		out->cmp = cpymo_script_cmp_ne;
+	else if (cpymo_str_equals_str(op, ">"))
+		out->cmp = cpymo_script_cmp_gt;
+	else if (cpymo_str_equals_str(op, ">="))
+		out->cmp = cpymo_script_cmp_ge;
+	else if (cpymo_str_equals_str(op, "<"))
+		out->cmp = cpymo_script_cmp_lt;
+	else if (cpymo_str_equals_str(op, "<="))
+		out->cmp = cpymo_script_cmp_le;
+}
+
+static error_t cpymo_script_compiler_push_condition(
+	cpymo_script_compiler *c, cpymo_script_line *line, cpymo_str condition)
 {
-    cpymo_script *script = 
-        (cpymo_script *)malloc(sizeof(cpymo_script) + script_name.len + 1);
-    if (script == NULL) return CPYMO_ERR_OUT_OF_MEM;
+	if (c->condition_count >= c->condition_cap) {
+		size_t cap = c->condition_cap ? c->condition_cap * 2 : 64;
+		cpymo_script_condition *conditions = (cpymo_script_condition *)realloc(
+			c->script->conditions, cap * sizeof(cpymo_script_condition));
+		if (conditions == NULL) return CPYMO_ERR_OUT_OF_MEM;
+		c->script->conditions = conditions;
+		c->condition_cap = cap;
+	}
+
+	cpymo_script_decode_condition(
+		&c->script->conditions[c->condition_count++], c->script, condition);
+	line->conditions++;
+	return CPYMO_ERR_SUCC;
+}
+
+static error_t cpymo_script_compile_line(
+	cpymo_script_compiler *c, cpymo_script_line *line, cpymo_parser *parser)
+{
+	error_t err;
+	line->offset = (uint32_t)parser->cur_pos;
+	line->first_arg = (uint32_t)c->arg_count;
+	line->argc = 0;
+	line->conditions = 0;
+	line->first_condition = (uint32_t)c->condition_count;
+
+	cpymo_str command = cpymo_parser_curline_pop_command(parser);
+	line->op = cpymo_script_find_op(command);
+
+	// Same steps as the interpreter took to run the sub command of #if.
+	while (line->op == cpymo_script_op_if && line->conditions < UINT8_MAX) {
+		cpymo_str condition = cpymo_parser_curline_pop_commacell(parser);
+		cpymo_str_trim(&condition);
+		if (condition.len == 0) return CPYMO_ERR_SUCC;
 
-    cpymo_str_copy(script->script_name, script_name.len + 1, script_name);
+		err = cpymo_script_compiler_push_condition(c, line, condition);
+		CPYMO_THROW(err);
 
-    script->script_content = NULL;
-    error_t err = cpymo_assetloader_load_script(
-        &script->script_content, 
-        &script->script_content_len, 
-        script->script_name, 
-        l);
+		while (!parser->is_line_end) {
+			char ch = cpymo_parser_curline_peek(parser);
+			if (ch == ' ' || ch == '\t')
+				cpymo_parser_curline_readchar(parser);
+			else break;
+		}
 
-    if (err != CPYMO_ERR_SUCC) {
-        free(script);
-        return err;
-    }
+		command = cpymo_parser_curline_readuntil_or(parser, ' ', '\t');
+		cpymo_str_trim(&command);
+		line->op = cpymo_script_find_op(command);
+	}
 
-    *out = script;
-    return CPYMO_ERR_SUCC;
+	if (line->op == cpymo_script_op_none) return CPYMO_ERR_SUCC;
+
+	if (line->op == cpymo_script_op_unknown) {
+		err = cpymo_script_compiler_push_arg(c, line, command);
+		CPYMO_THROW(err);
+	}
+
+	while (!parser->is_line_end && line->argc < UINT16_MAX) {
+		cpymo_str cell = cpymo_parser_curline_pop_commacell(parser);
+		err = cpymo_script_compiler_push_arg(c, line, cell);
+		CPYMO_THROW(err);
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+typedef struct {
+	uint64_t key;
+	uint32_t value;
+} cpymo_script_label_table_entry;
+
+static uint64_t cpymo_script_label_hash(cpymo_str name)
+{
+	uint64_t hash;
+	cpymo_str_hash_init(&hash);
+	cpymo_str_hash_append(&hash, name);
+	return hash;
+}
+
+static const cpymo_script_arg *cpymo_script_label_name(
+	const cpymo_script *s, const cpymo_script_line *line)
+{
+	if (line->op != cpymo_script_op_label || line->conditions || line->argc == 0)
+		return NULL;
+
+	const cpymo_script_arg *name = cpymo_script_get_arg(s, line, 0);
+	return name->len ? name : NULL;
+}
+
+static int cpymo_script_label_compare(const void *a, const void *b)
+{
+	const cpymo_script_label *x = (const cpymo_script_label *)a;
+	const cpymo_script_label *y = (const cpymo_script_label *)b;
+
+	if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+	if (x->line != y->line) return x->line < y->line ? -1 : 1;
+	return 0;
+}
+
+static error_t cpymo_script_build_label_table(cpymo_script *s)
+{
+	for (size_t i = 0; i < s->line_count; ++i)
+		if (cpymo_script_label_name(s, &s->lines[i]))
+			s->label_count++;
+
+	if (s->label_count == 0) return CPYMO_ERR_SUCC;
+
+	s->labels = (cpymo_script_label *)malloc(sizeof(cpymo_script_label) * s->label_count);
+	if (s->labels == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	size_t count = 0;
+	for (size_t i = 0; i < s->line_count; ++i) {
+		const cpymo_script_arg *name = cpymo_script_label_name(s, &s->lines[i]);
+		if (name) {
+			s->labels[count].hash = cpymo_script_label_hash(cpymo_script_arg_str(s, name));
+			s->labels[count].line = (uint32_t)i;
+			count++;
+		}
+	}
+
+	qsort(s->labels, s->label_count, sizeof(cpymo_script_label), &cpymo_script_label_compare);
+
+	cpymo_script_label_table_entry *table = NULL;
+	for (size_t i = 0; i < s->label_count; ++i)
+		if (i == 0 || s->labels[i].hash != s->labels[i - 1].hash)
+			hmput(table, s->labels[i].hash, (uint32_t)i);
+	s->label_table = (void *)table;
+
+	return CPYMO_ERR_SUCC;
+}
+
+bool cpymo_script_find_label(
+	const cpymo_script *s, cpymo_str name, size_t from_line, size_t *line)
+{
+	// No #label in this script, the shared script must not get a table here.
+	if (s->label_table == NULL) return false;
+
+	const uint64_t hash = cpymo_script_label_hash(name);
+
+	cpymo_script_label_table_entry *table = 
+		(cpymo_script_label_table_entry *)s->label_table;
+	cpymo_script_label_table_entry *entry = hmgetp_null(table, hash);
+	if (entry == NULL) return false;
+
+	bool found = false;
+	for (size_t i = entry->value; i < s->label_count && s->labels[i].hash == hash; ++i) {
+		const cpymo_script_line *l = &s->lines[s->labels[i].line];
+		cpymo_str label = cpymo_script_arg_str(s, cpymo_script_get_arg(s, l, 0));
+		if (!cpymo_str_equals(label, name)) continue;
+
+		if (!found || s->labels[i].line >= from_line) {
+			*line = s->labels[i].line;
+			found = true;
+			if (*line >= from_line) break;
+		}
+	}
+
+	return found;
+}
+
+static error_t cpymo_script_compile(cpymo_script *s)
+{
+	cpymo_script_compiler c;
+	c.script = s;
+	c.line_cap = 0;
+	c.arg_count = 0;
+	c.arg_cap = 0;
+	c.condition_count = 0;
+	c.condition_cap = 0;
+
+	s->lines = NULL;
+	s->args = NULL;
+	s->conditions = NULL;
+	s->line_count = 0;
+	s->labels = NULL;
+	s->label_count = 0;
+	s->label_table = NULL;
+	s->var_count = 0;
+	s->empty_arg = cpymo_script_make_arg(s, cpymo_str_pure(""));
+
+	cpymo_parser parser;
+	cpymo_parser_init(&parser, s->script_content, s->script_content_len);
+	size_t line_begin = parser.cur_pos;
+
+	do {
+		if (s->line_count >= c.line_cap) {
+			size_t cap = c.line_cap ? c.line_cap * 2 : 256;
+			cpymo_script_line *lines = (cpymo_script_line *)realloc(
+				s->lines, cap * sizeof(cpymo_script_line));
+			if (lines == NULL) return CPYMO_ERR_OUT_OF_MEM;
+			s->lines = lines;
+			c.line_cap = cap;
+		}
+
+		parser.cur_pos = line_begin;
+		parser.cur_line = s->line_count;
+		parser.is_line_end = false;
+
+		error_t err = cpymo_script_compile_line(
+			&c, &s->lines[s->line_count++], &parser);
+		CPYMO_THROW(err);
+
+		// Lines are split here, not by the parser, so a record never
+		// starts in the middle of a line whatever the line contains.
+		const char *line_end = (const char *)memchr(
+			s->script_content + line_begin, '\n', 
+			s->script_content_len - line_begin);
+		if (line_end == NULL) break;
+		line_begin = (size_t)(line_end - s->script_content) + 1;
+	} while (line_begin < s->script_content_len);
+
+	return cpymo_script_build_label_table(s);
+}
+
+// Loads the content of the script from l or f, whichever is set.
+static error_t cpymo_script_load_from(
+	cpymo_script **out, 
+	cpymo_str script_name, 
+	const cpymo_assetloader *l,
+	const cpymo_vfs_file *f)
+{
+	cpymo_script *script = 
+		(cpymo_script *)malloc(sizeof(cpymo_script) + script_name.len + 1);
+	if (script == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	cpymo_str_copy(script->script_name, script_name.len + 1, script_name);
+
+	script->script_content = NULL;
+	error_t err;
+	if (l) {
+		err = cpymo_assetloader_load_script(
+			&script->script_content, 
+			&script->script_content_len, 
+			script->script_name, 
+			l);
+	}
+	else {
+		err = cpymo_assetloader_load_vfs_file(
+			&script->script_content, &script->script_content_len, f);
+		if (err == CPYMO_ERR_SUCC)
+			cpymo_utils_replace_cr(script->script_content, script->script_content_len);
+		else
+			err = CPYMO_ERR_SCRIPT_FILE_NOT_FOUND;
+	}
+
+	if (err != CPYMO_ERR_SUCC) {
+		free(script);
+		return err;
+	}
+
+	err = cpymo_script_compile(script);
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_script_free(script);
+		return err;
+	}
+
+	*out = script;
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_script_load(
+	cpymo_script **out, 
+	cpymo_str script_name, 
+	const cpymo_assetloader *l)
+{
+	return cpymo_script_load_from(out, script_name, l, NULL);
+}
+
+error_t cpymo_script_load_vfs(
+	cpymo_script **out,
+	cpymo_str script_name,
+	const cpymo_vfs_file *f)
+{
+	return cpymo_script_load_from(out, script_name, NULL, f);
 }
 
 error_t cpymo_script_create_bootloader(cpymo_script **out, char *startscript)
 {
-    const char *script_format =
+	const char *script_format =
 		"#textbox message,name\n"
-        "#wait 50\n"
+		"#wait 50\n"
 		"#bg logo1\n"
-        "#wait 300\n"
+		"#wait 300\n"
 		"#bg logo2\n"
-        "#wait 300\n"
+		"#wait 300\n"
 		"#change %s";
 
-    cpymo_script *script = (cpymo_script *)malloc(sizeof(cpymo_script) + 1);
-    if (script == NULL) return CPYMO_ERR_OUT_OF_MEM;
+	cpymo_script *script = (cpymo_script *)malloc(sizeof(cpymo_script) + 1);
+	if (script == NULL) return CPYMO_ERR_OUT_OF_MEM;
 
-    script->script_name[0] = '\0';
+	script->script_name[0] = '\0';
 
-	/* sprintf adds the terminating NUL after substituting startscript. */
-	script->script_content = (char *)malloc(strlen(script_format) + strlen(startscript) + 1);
-    if (script->script_content == NULL) {
-        free(script);
-        return CPYMO_ERR_OUT_OF_MEM;
-    }
+	/* sprintf adds the terminating NUL after substituting startscript. */
+	script->script_content = (char *)malloc(strlen(script_format) + strlen(startscript) + 1);
+	if (script->script_content == NULL) {
+		free(script);
+		return CPYMO_ERR_OUT_OF_MEM;
+	}
 
 	sprintf(script->script_content, script_format, startscript);
-    script->script_content_len = strlen(script->script_content);
-    *out = script;
-    return CPYMO_ERR_SUCC;
+	script->script_content_len = strlen(script->script_content);
+
+	error_t err = cpymo_script_compile(script);
+	if (err != CPYMO_ERR_SUCC) {
+		cpymo_script_free(script);
+		return err;
+	}
+
+	*out = script;
+	return CPYMO_ERR_SUCC;
 }
 
 void cpymo_script_free(cpymo_script *to_free)
 {
-    free(to_free->script_content);
-    free(to_free);
+	if (to_free->lines) free(to_free->lines);
+	if (to_free->args) free(to_free->args);
+	if (to_free->conditions) free(to_free->conditions);
+	if (to_free->labels) free(to_free->labels);
+	if (to_free->label_table) {
+		cpymo_script_label_table_entry *table = 
+			(cpymo_script_label_table_entry *)to_free->label_table;
+		hmfree(table);
+	}
+	free(to_free->script_content);
+	free(to_free);
 }
 
@@ -4,21 +4,140 @@
 #include "cpymo_error.h"
 #include "cpymo_str.h"
 #include "cpymo_assetloader.h"
+#include <stdint.h>
+
+// Scripts are compiled once when they are loaded,
+// every line becomes a record with its command and its arguments
+// already split, trimmed and parsed, so the interpreter never tokenizes text.
+
+#define CPYMO_SCRIPT_COMMANDS(X) \
+	X(say) X(text) X(text_off) X(waitkey) X(title) X(title_dsp) \
+	X(chara) X(chara_cls) X(chara_pos) X(bg) X(flash) X(quake) \
+	X(fade_out) X(fade_in) X(movie) X(textbox) \
+	X(chara_quake) X(chara_down) X(chara_up) X(chara_anime) \
+	X(scroll) X(chara_y) X(chara_scroll) X(anime_on) X(anime_off) \
+	X(set) X(add) X(sub) X(label) X(goto) X(change) X(if) X(call) X(ret) \
+	X(sel) X(select_text) X(select_var) X(select_img) X(select_imgs) \
+	X(wait) X(wait_se) X(rand) \
+	X(bgm) X(bgm_stop) X(se) X(se_stop) X(vo) \
+	X(load) X(album) X(music) X(date) X(config)
+
+enum cpymo_script_op {
+	cpymo_script_op_none,       // empty line or not a command
+	cpymo_script_op_unknown,    // first argument is the command name
+#define CPYMO_SCRIPT_OP(NAME) cpymo_script_op_##NAME,
+	CPYMO_SCRIPT_COMMANDS(CPYMO_SCRIPT_OP)
+#undef CPYMO_SCRIPT_OP
+	cpymo_script_op_count
+};
+
+typedef struct {
+	uint32_t begin, len;    // trimmed cell in script_content
+	int32_t ival;           // cpymo_str_atoi
+	cpymo_color color;      // cpymo_str_as_color
+
+	// Index of this cell in the variable slots of an interpreter,
+	// see cpymo_interpreter.var_slots.
+	uint32_t var;
+} cpymo_script_arg;
+
+typedef struct {
+	uint32_t offset;        // where this line begins in script_content
+	uint32_t first_arg;
+	uint16_t argc;
+
+	uint8_t op;
+
+	// "#if a=1,goto x" is compiled as goto with 1 condition.
+	uint8_t conditions;
+	uint32_t first_condition;
+} cpymo_script_line;
+
+enum cpymo_script_cmp {
+	cpymo_script_cmp_bad,       // reported when the condition is tested
+	cpymo_script_cmp_eq,
+	cpymo_script_cmp_ne,
+	cpymo_script_cmp_gt,
+	cpymo_script_cmp_ge,
+	cpymo_script_cmp_lt,
+	cpymo_script_cmp_le,
+};
+
+// An #if condition "left op right".
+typedef struct {
+	uint32_t begin, len;        // the whole condition in script_content
+	cpymo_script_arg left, right;
+	uint8_t cmp;
+	bool left_is_constant, right_is_constant;
+} cpymo_script_condition;
+
+typedef struct {
+	uint64_t hash;
+	uint32_t line;
+} cpymo_script_label;
 
 typedef struct {
-    char *script_content;
-    size_t script_content_len;
-    char script_name[];
+	char *script_content;
+	size_t script_content_len;
+
+	cpymo_script_line *lines;
+	cpymo_script_arg *args;
+	cpymo_script_condition *conditions;
+	size_t line_count;
+	cpymo_script_arg empty_arg;
+
+	// Every cell has a different cpymo_script_arg.var below var_count.
+	uint32_t var_count;
+
+	// #label lines ordered by name hash, then by line,
+	// label_table maps a name hash to its first label.
+	cpymo_script_label *labels;
+	size_t label_count;
+	void *label_table;
+
+	char script_name[];
 } cpymo_script;
 
 error_t cpymo_script_load(
-    cpymo_script **out, 
-    cpymo_str script_name, 
-    const cpymo_assetloader *l);
+	cpymo_script **out, 
+	cpymo_str script_name, 
+	const cpymo_assetloader *l);
+
+// Only reads f, so it can run on a worker thread.
+error_t cpymo_script_load_vfs(
+	cpymo_script **out,
+	cpymo_str script_name,
+	const cpymo_vfs_file *f);
 
 error_t cpymo_script_create_bootloader(
-    cpymo_script **out, char *startscript);
-    
+	cpymo_script **out, char *startscript);
+	
 void cpymo_script_free(cpymo_script *to_free);
 
+// Finds the first #label with this name at or after from_line,
+// or the first one in the script if there is none after it.
+bool cpymo_script_find_label(
+	const cpymo_script *s, cpymo_str name, size_t from_line, size_t *line);
+
+static inline const cpymo_script_arg *cpymo_script_get_arg(
+	const cpymo_script *s, const cpymo_script_line *line, size_t i)
+{
+	return i < line->argc ? &s->args[line->first_arg + i] : &s->empty_arg;
+}
+
+static inline const cpymo_script_condition *cpymo_script_get_condition(
+	const cpymo_script *s, const cpymo_script_line *line, size_t i)
+{
+	return &s->conditions[line->first_condition + i];
+}
+
+static inline cpymo_str cpymo_script_arg_str(
+	const cpymo_script *s, const cpymo_script_arg *arg)
+{
+	cpymo_str str;
+	str.begin = s->script_content + arg->begin;
+	str.len = arg->len;
+	return str;
+}
+
 #endif
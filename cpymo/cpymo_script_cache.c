@@ -0,0 +1,126 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_script_cache.h"
+#include "cpymo_async_loader.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "../stb/stb_ds.h"
+
+typedef struct cpymo_script_cache_entry {
+	cpymo_script *script;
+	uint32_t refs, last_used;
+} cpymo_script_cache_entry;
+
+static void cpymo_script_cache_evict(cpymo_script_cache *c, size_t max_unused)
+{
+	while (true) {
+		size_t unused = 0, oldest = 0;
+		for (size_t i = 0; i < arrlenu(c->entries); ++i) {
+			if (c->entries[i].refs) continue;
+			if (unused == 0 || c->entries[i].last_used < c->entries[oldest].last_used)
+				oldest = i;
+			unused++;
+		}
+
+		if (unused <= max_unused) break;
+
+		cpymo_script_free(c->entries[oldest].script);
+		arrdel(c->entries, oldest);
+	}
+}
+
+void cpymo_script_cache_init(cpymo_script_cache *c)
+{
+	c->entries = NULL;
+	c->tick = 0;
+	c->hits = 0;
+	c->misses = 0;
+}
+
+void cpymo_script_cache_free(cpymo_script_cache *c)
+{
+	for (size_t i = 0; i < arrlenu(c->entries); ++i) {
+		assert(c->entries[i].refs == 0);
+		cpymo_script_free(c->entries[i].script);
+	}
+
+	arrfree(c->entries);
+	c->entries = NULL;
+}
+
+void cpymo_script_cache_clear(cpymo_script_cache *c)
+{
+	cpymo_script_cache_evict(c, 0);
+}
+
+const cpymo_script *cpymo_script_cache_find(const cpymo_script_cache *c, cpymo_str script_name)
+{
+	for (size_t i = 0; i < arrlenu(c->entries); ++i)
+		if (cpymo_str_equals_str(script_name, c->entries[i].script->script_name))
+			return c->entries[i].script;
+
+	return NULL;
+}
+
+error_t cpymo_script_cache_acquire(
+	cpymo_script_cache *c,
+	cpymo_script **out,
+	cpymo_str script_name,
+	const cpymo_assetloader *l)
+{
+	for (size_t i = 0; i < arrlenu(c->entries); ++i) {
+		cpymo_script_cache_entry *e = &c->entries[i];
+		if (cpymo_str_equals_str(script_name, e->script->script_name)) {
+			e->refs++;
+			e->last_used = ++c->tick;
+			c->hits++;
+			*out = e->script;
+			return CPYMO_ERR_SUCC;
+		}
+	}
+
+	c->misses++;
+
+	cpymo_script *script = NULL;
+	error_t err;
+	if (l->async_loader == NULL
+		|| !cpymo_async_loader_take_script(l->async_loader, script_name, &script, &err))
+		err = cpymo_script_load(&script, script_name, l);
+	CPYMO_THROW(err);
+
+	cpymo_script_cache_entry e;
+	e.script = script;
+	e.refs = 1;
+	e.last_used = ++c->tick;
+	arrput(c->entries, e);
+
+	cpymo_script_cache_evict(c, CPYMO_SCRIPT_CACHE_SIZE);
+
+	*out = script;
+	return CPYMO_ERR_SUCC;
+}
+
+void cpymo_script_cache_release(cpymo_script_cache *c, cpymo_script *script)
+{
+	for (size_t i = 0; i < arrlenu(c->entries); ++i) {
+		cpymo_script_cache_entry *e = &c->entries[i];
+		if (e->script == script) {
+			assert(e->refs > 0);
+			e->refs--;
+			e->last_used = ++c->tick;
+			break;
+		}
+	}
+
+	cpymo_script_cache_evict(c, CPYMO_SCRIPT_CACHE_SIZE);
+}
+
+void cpymo_script_cache_print_stats(const cpymo_script_cache *c)
+{
+	uint32_t total = c->hits + c->misses;
+	if (total == 0) return;
+
+	printf("[Info] Script cache: %u hits, %u misses, %u%% hit rate.\n",
+		(unsigned)c->hits, (unsigned)c->misses, 
+		(unsigned)((uint64_t)c->hits * 100 / total));
+}
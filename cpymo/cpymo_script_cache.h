@@ -0,0 +1,48 @@
+#ifndef INCLUDE_CPYMO_SCRIPT_CACHE
+#define INCLUDE_CPYMO_SCRIPT_CACHE
+
+#include "cpymo_script.h"
+
+// Keeps loaded and compiled scripts by name, so #change, #call and #ret
+// back to a recently used script do not read and compile it again.
+// Scripts are refcounted, a script is kept while an interpreter uses it,
+// and at most CPYMO_SCRIPT_CACHE_SIZE unused scripts are kept after that,
+// the least recently used ones are dropped first.
+// Compiled scripts cache variable slots of the engine's cpymo_vars,
+// so a cache belongs to one engine.
+
+#ifndef CPYMO_SCRIPT_CACHE_SIZE
+#define CPYMO_SCRIPT_CACHE_SIZE 16
+#endif
+
+struct cpymo_script_cache_entry;
+
+typedef struct cpymo_script_cache {
+	struct cpymo_script_cache_entry *entries;
+	uint32_t tick;
+	uint32_t hits, misses;
+} cpymo_script_cache;
+
+void cpymo_script_cache_init(cpymo_script_cache *c);
+void cpymo_script_cache_free(cpymo_script_cache *c);
+
+// Drops all unused scripts, used when the system is low on memory.
+void cpymo_script_cache_clear(cpymo_script_cache *c);
+
+// Returns the cached script without acquiring it,
+// only valid until the cache is used again.
+const cpymo_script *cpymo_script_cache_find(const cpymo_script_cache *c, cpymo_str script_name);
+
+// Every acquired script must be released with cpymo_script_cache_release.
+// A script prefetched by the async loader is taken from it instead of loaded.
+error_t cpymo_script_cache_acquire(
+	cpymo_script_cache *c,
+	cpymo_script **out,
+	cpymo_str script_name,
+	const cpymo_assetloader *l);
+
+void cpymo_script_cache_release(cpymo_script_cache *c, cpymo_script *script);
+
+void cpymo_script_cache_print_stats(const cpymo_script_cache *c);
+
+#endif
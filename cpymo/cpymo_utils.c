@@ -5,6 +5,30 @@
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
+
+int cpymo_utils_fseek64(FILE *f, int64_t offset, int whence)
+{
+#if defined(_WIN32)
+	return _fseeki64(f, offset, whence);
+#elif defined(__unix__) || defined(__APPLE__)
+	return fseeko(f, (off_t)offset, whence);
+#else
+	if (offset > LONG_MAX || offset < LONG_MIN) return -1;
+	return fseek(f, (long)offset, whence);
+#endif
+}
+
+int64_t cpymo_utils_ftell64(FILE *f)
+{
+#if defined(_WIN32)
+	return _ftelli64(f);
+#elif defined(__unix__) || defined(__APPLE__)
+	return (int64_t)ftello(f);
+#else
+	return ftell(f);
+#endif
+}
 
 error_t cpymo_utils_loadfile(const char *path, char **outbuf, size_t *len)
 {
@@ -14,12 +38,12 @@ error_t cpymo_utils_loadfile(const char *path, char **outbuf, size_t *len)
 	FILE *f = fopen(path, "rb");
 	if (f == NULL) return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 
-	if (fseek(f, 0, SEEK_END) != 0) {
+	if (cpymo_utils_fseek64(f, 0, SEEK_END) != 0) {
 		fclose(f);
 		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 	}
-	long file_len = ftell(f);
-	if (file_len < 0 || fseek(f, 0, SEEK_SET) != 0) {
+	int64_t file_len = cpymo_utils_ftell64(f);
+	if (file_len < 0 || (uint64_t)file_len > SIZE_MAX || cpymo_utils_fseek64(f, 0, SEEK_SET) != 0) {
 		fclose(f);
 		return CPYMO_ERR_CAN_NOT_OPEN_FILE;
 	}
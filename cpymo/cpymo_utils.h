@@ -4,9 +4,15 @@
 #include "cpymo_error.h"
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 error_t cpymo_utils_loadfile(const char *path, char **outbuf, size_t *len);
 
+// fseek and ftell with 64 bit offsets, long is only 32 bit on Windows.
+int cpymo_utils_fseek64(FILE *f, int64_t offset, int whence);
+int64_t cpymo_utils_ftell64(FILE *f);
+
 #ifndef CPYMO_TOOL
 struct cpymo_engine;
 void *cpymo_utils_malloc_trim_memory(struct cpymo_engine *e, size_t size);
@@ -6,122 +6,200 @@
 #include "../stb/stb_ds.h"
 
 struct cpymo_var {
-    char *key;
-    cpymo_val value;
+	char *name;
+	cpymo_var_slot next_same_hash;
+	bool defined, unsaved;
 };
 
-void cpymo_vars_init(cpymo_vars *out)
-{
-    struct cpymo_var *p = NULL;
-    sh_new_arena(p);
-    out->locals = (void *)p;
+typedef struct {
+	uint64_t key;
+	cpymo_var_slot value;
+} cpymo_vars_slot_table_entry;
 
-    p = NULL;
-    sh_new_arena(p);
-    out->globals = (void *)p;
+#define SLOT(VARS, SLOT) (&(VARS)->slots[(SLOT) - 1])
 
-    out->globals_dirty = false;
+void cpymo_vars_init(cpymo_vars *out)
+{
+	out->slot_table = NULL;
+	out->slots = NULL;
+	out->values = NULL;
+	out->locals = NULL;
+	out->globals = NULL;
+	out->unsaved_globals = NULL;
 }
 
 void cpymo_vars_free(cpymo_vars *to_free)
-{    
-    struct cpymo_var *p = (struct cpymo_var *)to_free->globals;
-    if (p) shfree(p);
-
-    p = (struct cpymo_var *)to_free->locals;
-    if (p) shfree(p);
+{
+	for (size_t i = 0; i < arrlenu(to_free->slots); ++i)
+		free(to_free->slots[i].name);
+	arrfree(to_free->slots);
+	arrfree(to_free->values);
+	arrfree(to_free->locals);
+	arrfree(to_free->globals);
+	arrfree(to_free->unsaved_globals);
+
+	cpymo_vars_slot_table_entry *table = 
+		(cpymo_vars_slot_table_entry *)to_free->slot_table;
+	hmfree(table);
+	to_free->slot_table = NULL;
 }
 
 static inline bool cpymo_vars_is_global(const char *name)
 { return name[0] == 'S'; }
 
-static cpymo_val *cpymo_vars_access_cstr(
-    cpymo_vars *vars, const char *name)
+static uint64_t cpymo_vars_hash(cpymo_str name)
 {
-    bool is_global = cpymo_vars_is_global(name);
-    struct cpymo_var **var_slot = 
-        (struct cpymo_var **)(is_global ? &vars->globals : &vars->locals);
+	uint64_t hash;
+	cpymo_str_hash_init(&hash);
+	cpymo_str_hash_append(&hash, name);
+	return hash;
+}
 
-    struct cpymo_var *hash_table = *var_slot;
-    
-    struct cpymo_var *r = shgetp_null(hash_table, name);
-    *var_slot = hash_table;
+static cpymo_var_slot cpymo_vars_find_hashed(
+	const cpymo_vars *vars, cpymo_str name, uint64_t hash)
+{
+	// Nothing is interned yet, vars may be const so the table is not created here.
+	if (vars->slot_table == NULL) return CPYMO_VAR_SLOT_NONE;
+
+	cpymo_vars_slot_table_entry *table = 
+		(cpymo_vars_slot_table_entry *)vars->slot_table;
+	cpymo_vars_slot_table_entry *e = hmgetp_null(table, hash);
+	if (e == NULL) return CPYMO_VAR_SLOT_NONE;
+
+	cpymo_var_slot slot = e->value;
+	while (slot != CPYMO_VAR_SLOT_NONE) {
+		if (cpymo_str_equals_str(name, SLOT(vars, slot)->name))
+			return slot;
+		slot = SLOT(vars, slot)->next_same_hash;
+	}
 
-    return r ? &r->value : NULL;
+	return CPYMO_VAR_SLOT_NONE;
 }
 
-const cpymo_val *cpymo_vars_access(cpymo_vars *vars, cpymo_str name)
+cpymo_var_slot cpymo_vars_find(const cpymo_vars *vars, cpymo_str name)
+{
+	return cpymo_vars_find_hashed(vars, name, cpymo_vars_hash(name));
+}
+
+cpymo_var_slot cpymo_vars_intern(cpymo_vars *vars, cpymo_str name)
 {
-    char *cstr = cpymo_str_copy_malloc(name);
-    if (cstr == NULL) return NULL;
+	if (name.len == 0) return CPYMO_VAR_SLOT_NONE;
+
+	const uint64_t hash = cpymo_vars_hash(name);
+	cpymo_var_slot slot = cpymo_vars_find_hashed(vars, name, hash);
+	if (slot != CPYMO_VAR_SLOT_NONE) return slot;
+
+	struct cpymo_var var;
+	var.name = cpymo_str_copy_malloc(name);
+	if (var.name == NULL) return CPYMO_VAR_SLOT_NONE;
+	var.defined = false;
+	var.unsaved = false;
+
+	cpymo_vars_slot_table_entry *table = 
+		(cpymo_vars_slot_table_entry *)vars->slot_table;
+	cpymo_vars_slot_table_entry *e = 
+		table ? hmgetp_null(table, hash) : NULL;
+	var.next_same_hash = e ? e->value : CPYMO_VAR_SLOT_NONE;
+
+	arrput(vars->slots, var);
+	arrput(vars->values, 0);
+	slot = (cpymo_var_slot)arrlenu(vars->slots);
+
+	hmput(table, hash, slot);
+	vars->slot_table = (void *)table;
 
-    cpymo_val *r = cpymo_vars_access_cstr(vars, cstr);
-    free(cstr);
-    return r;
+	return slot;
 }
 
-void cpymo_vars_clear_locals(cpymo_vars *vars)
+const char *cpymo_vars_slot_name(const cpymo_vars *vars, cpymo_var_slot slot)
 {
-    struct cpymo_var *v = (struct cpymo_var *)vars->locals;
-    shfree(v);
+	return SLOT(vars, slot)->name;
+}
 
-    v = NULL;
-    sh_new_arena(v);
-    vars->locals = (void *)v;
+const cpymo_val *cpymo_vars_access_slot(const cpymo_vars *vars, cpymo_var_slot slot)
+{
+	if (slot == CPYMO_VAR_SLOT_NONE || !SLOT(vars, slot)->defined) return NULL;
+	return &vars->values[slot - 1];
 }
 
-static error_t cpymo_vars_set_cstr(
-    cpymo_vars *vars, const char *name, cpymo_val v)
+cpymo_val cpymo_vars_get_slot(const cpymo_vars *vars, cpymo_var_slot slot)
 {
-    bool is_global = cpymo_vars_is_global(name);
-    struct cpymo_var **var_slot = 
-        (struct cpymo_var **)
-        (is_global ? &vars->globals : &vars->locals);
+	const cpymo_val *p = cpymo_vars_access_slot(vars, slot);
+	return p ? *p : 0;
+}
 
-    struct cpymo_var *hash_table = *var_slot;
-    shput(hash_table, name, v);
-    *var_slot = hash_table;
+error_t cpymo_vars_set_slot(cpymo_vars *vars, cpymo_var_slot slot, cpymo_val v)
+{
+	if (slot == CPYMO_VAR_SLOT_NONE) return CPYMO_ERR_INVALID_ARG;
 
-    if (is_global) 
-        vars->globals_dirty = true;
+	struct cpymo_var *var = SLOT(vars, slot);
+	bool is_global = cpymo_vars_is_global(var->name);
+	bool changed = !var->defined || vars->values[slot - 1] != v;
 
-    return CPYMO_ERR_SUCC;
+	if (!var->defined) {
+		if (is_global) arrput(vars->globals, slot);
+		else arrput(vars->locals, slot);
+		var->defined = true;
+	}
+
+	vars->values[slot - 1] = v;
+
+	if (is_global && changed && !var->unsaved) {
+		arrput(vars->unsaved_globals, slot);
+		var->unsaved = true;
+	}
+
+	return CPYMO_ERR_SUCC;
 }
 
-error_t cpymo_vars_set(cpymo_vars *vars, cpymo_str name, cpymo_val v)
+error_t cpymo_vars_add_slot(cpymo_vars *vars, cpymo_var_slot slot, cpymo_val v)
 {
-    char *name_cstr = cpymo_str_copy_malloc(name);
-    if (name_cstr == NULL) return CPYMO_ERR_OUT_OF_MEM;
-
-    error_t err = cpymo_vars_set_cstr(vars, name_cstr, v);
-    free(name_cstr);
+	return cpymo_vars_set_slot(vars, slot, cpymo_vars_get_slot(vars, slot) + v);
+}
 
-    return err;
+const cpymo_val *cpymo_vars_access(cpymo_vars *vars, cpymo_str name)
+{
+	return cpymo_vars_access_slot(vars, cpymo_vars_find(vars, name));
 }
 
-cpymo_val cpymo_vars_get(cpymo_vars *vars, cpymo_str name)
+void cpymo_vars_clear_locals(cpymo_vars *vars)
 {
-    const cpymo_val *p = cpymo_vars_access(vars, name);
-    return p ? *p : 0;
+	for (size_t i = 0; i < arrlenu(vars->locals); ++i)
+		SLOT(vars, vars->locals[i])->defined = false;
+
+	arrfree(vars->locals);
 }
 
-error_t cpymo_vars_add(cpymo_vars *vars, cpymo_str name, cpymo_val v)
+void cpymo_vars_clear_unsaved_globals(cpymo_vars *vars)
 {
-    error_t err = CPYMO_ERR_SUCC;
-    char *name_cstr = cpymo_str_copy_malloc(name);
-    if (name_cstr == NULL) return CPYMO_ERR_OUT_OF_MEM;
+	for (size_t i = 0; i < arrlenu(vars->unsaved_globals); ++i)
+		SLOT(vars, vars->unsaved_globals[i])->unsaved = false;
 
-    cpymo_val *p = cpymo_vars_access_cstr(vars, name_cstr);
+	if (vars->unsaved_globals) arrsetlen(vars->unsaved_globals, 0);
+}
 
-    if (p) *p += v;
-    else err = cpymo_vars_set_cstr(vars, name_cstr, v);
+error_t cpymo_vars_set(cpymo_vars *vars, cpymo_str name, cpymo_val v)
+{
+	cpymo_var_slot slot = cpymo_vars_intern(vars, name);
+	if (slot == CPYMO_VAR_SLOT_NONE) 
+		return name.len ? CPYMO_ERR_OUT_OF_MEM : CPYMO_ERR_INVALID_ARG;
 
-    if (cpymo_vars_is_global(name_cstr))
-        vars->globals_dirty = true;
+	return cpymo_vars_set_slot(vars, slot, v);
+}
 
-    free(name_cstr);
+cpymo_val cpymo_vars_get(cpymo_vars *vars, cpymo_str name)
+{
+	const cpymo_val *p = cpymo_vars_access(vars, name);
+	return p ? *p : 0;
+}
+
+error_t cpymo_vars_add(cpymo_vars *vars, cpymo_str name, cpymo_val v)
+{
+	cpymo_var_slot slot = cpymo_vars_intern(vars, name);
+	if (slot == CPYMO_VAR_SLOT_NONE) 
+		return name.len ? CPYMO_ERR_OUT_OF_MEM : CPYMO_ERR_INVALID_ARG;
 
-    return err;
+	return cpymo_vars_add_slot(vars, slot, v);
 }
 
 bool cpymo_vars_is_constant(cpymo_str expr)
@@ -141,18 +219,15 @@ cpymo_val cpymo_vars_eval(cpymo_vars * vars, cpymo_str expr)
 	else return cpymo_vars_get(vars, expr);
 }
 
-size_t cpymo_vars_count(void **var_field)
+size_t cpymo_vars_count(const cpymo_vars *vars, bool globals)
 {
-    struct cpymo_var **vars = (struct cpymo_var **)var_field;
-    struct cpymo_var *hash_table = *vars;
-    size_t sz = shlenu(hash_table);
-    *vars = hash_table;
-    return sz;
+	return arrlenu(globals ? vars->globals : vars->locals);
 }
 
-const char *cpymo_vars_get_by_index(void *var_field, size_t index, cpymo_val *v)
+const char *cpymo_vars_get_by_index(
+	const cpymo_vars *vars, bool globals, size_t index, cpymo_val *v)
 {
-    const struct cpymo_var *var = index + (struct cpymo_var *)var_field;
-    *v = var->value;
-    return var->key;
+	cpymo_var_slot slot = (globals ? vars->globals : vars->locals)[index];
+	*v = vars->values[slot - 1];
+	return SLOT(vars, slot)->name;
 }
@@ -6,17 +6,43 @@
 
 typedef int32_t cpymo_val;
 
+// Variable names are interned to slots that stay valid until cpymo_vars_free,
+// clearing a variable does not release its slot.
+typedef uint32_t cpymo_var_slot;
+#define CPYMO_VAR_SLOT_NONE 0
+
 typedef struct {
-	void *locals, *globals;
-	bool globals_dirty;
+	void *slot_table;
+	struct cpymo_var *slots;
+	cpymo_val *values;
+
+	// Slots that have a value, in the order they were first set.
+	cpymo_var_slot *locals, *globals;
+
+	// Globals changed since cpymo_vars_clear_unsaved_globals.
+	cpymo_var_slot *unsaved_globals;
 } cpymo_vars;
 
 void cpymo_vars_init(cpymo_vars *out);
 void cpymo_vars_free(cpymo_vars *to_free);
 
+// Returns CPYMO_VAR_SLOT_NONE if name is empty or out of memory.
+cpymo_var_slot cpymo_vars_intern(cpymo_vars *vars, cpymo_str name);
+
+// Returns CPYMO_VAR_SLOT_NONE if name was never interned.
+cpymo_var_slot cpymo_vars_find(const cpymo_vars *vars, cpymo_str name);
+
+const char *cpymo_vars_slot_name(const cpymo_vars *vars, cpymo_var_slot slot);
+
+const cpymo_val *cpymo_vars_access_slot(const cpymo_vars *vars, cpymo_var_slot slot);
+cpymo_val cpymo_vars_get_slot(const cpymo_vars *vars, cpymo_var_slot slot);
+error_t cpymo_vars_set_slot(cpymo_vars *vars, cpymo_var_slot slot, cpymo_val v);
+error_t cpymo_vars_add_slot(cpymo_vars *vars, cpymo_var_slot slot, cpymo_val v);
+
 const cpymo_val *cpymo_vars_access(cpymo_vars * vars, cpymo_str name);
 
 void cpymo_vars_clear_locals(cpymo_vars *vars);
+void cpymo_vars_clear_unsaved_globals(cpymo_vars *vars);
 
 cpymo_val cpymo_vars_get(cpymo_vars * vars, cpymo_str name);
 
@@ -28,9 +54,10 @@ bool cpymo_vars_is_constant(cpymo_str expr);
 
 cpymo_val cpymo_vars_eval(cpymo_vars *vars, cpymo_str expr);
 
-size_t cpymo_vars_count(void **p_var_field);
+// Enumerates variables that have a value, for saving.
+size_t cpymo_vars_count(const cpymo_vars *vars, bool globals);
 
 const char *cpymo_vars_get_by_index(
-	void *var_field, size_t index, cpymo_val *value);
+	const cpymo_vars *vars, bool globals, size_t index, cpymo_val *value);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+﻿#include "cpymo_prelude.h"
+#include "cpymo_vfs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "../stb/stb_ds.h"
+
+#ifdef ENABLE_VFS_DIRECTORY_SCAN
+#include <dirent.h>
+#endif
+
+typedef struct {
+	const cpymo_package *package;
+	uint32_t file_index;
+	char *file_name;
+} cpymo_vfs_node;
+
+typedef struct {
+	char *key;
+	cpymo_vfs_node value;
+} cpymo_vfs_entry;
+
+#define CPYMO_VFS_MAX_KEY 256
+
+static bool cpymo_vfs_make_key(
+	char *key, const char *asset_type, cpymo_str name, const char *asset_ext)
+{
+	size_t len = 0;
+
+#define PUT(CH) { \
+		if (len >= CPYMO_VFS_MAX_KEY - 1) return false; \
+		key[len++] = (char)tolower((unsigned char)(CH)); \
+	}
+
+	for (const char *p = asset_type; *p; ++p) PUT(*p);
+	PUT('/');
+	for (size_t i = 0; i < name.len; ++i) PUT(name.begin[i]);
+
+	if (asset_ext) {
+		PUT('.');
+		for (const char *p = asset_ext; *p; ++p) PUT(*p);
+	}
+
+#undef PUT
+
+	key[len] = '\0';
+	return true;
+}
+
+static void cpymo_vfs_put(cpymo_vfs *vfs, const char *key, cpymo_vfs_node node)
+{
+	cpymo_vfs_entry *names = (cpymo_vfs_entry *)vfs->names;
+	shput(names, key, node);
+	vfs->names = (void *)names;
+}
+
+static const cpymo_vfs_node *cpymo_vfs_get(const cpymo_vfs *vfs, const char *key)
+{
+	cpymo_vfs_entry *names = (cpymo_vfs_entry *)vfs->names;
+	cpymo_vfs_entry *entry = shgetp_null(names, key);
+	return entry ? &entry->value : NULL;
+}
+
+void cpymo_vfs_init(cpymo_vfs *vfs, const char *gamedir)
+{
+	cpymo_vfs_entry *names = NULL;
+	sh_new_arena(names);
+	vfs->names = (void *)names;
+	vfs->patches = NULL;
+	vfs->gamedir = gamedir;
+
+#ifdef ENABLE_VFS_DIRECTORY_SCAN
+	vfs->directories_scanned = true;
+#else
+	vfs->directories_scanned = false;
+#endif
+}
+
+void cpymo_vfs_free(cpymo_vfs *vfs)
+{
+	cpymo_vfs_entry *names = (cpymo_vfs_entry *)vfs->names;
+	for (size_t i = 0; i < shlenu(names); ++i)
+		if (names[i].value.file_name) free(names[i].value.file_name);
+	shfree(names);
+	vfs->names = NULL;
+
+	for (size_t i = 0; i < arrlenu(vfs->patches); ++i) {
+		cpymo_package_close(vfs->patches[i]);
+		free(vfs->patches[i]);
+	}
+
+	arrfree(vfs->patches);
+	vfs->patches = NULL;
+}
+
+error_t cpymo_vfs_mount_package(
+	cpymo_vfs *vfs, const char *asset_type, const cpymo_package *package)
+{
+	char key[CPYMO_VFS_MAX_KEY];
+	for (uint32_t i = 0; i < package->file_count; ++i) {
+		if (!cpymo_vfs_make_key(
+			key, asset_type, cpymo_str_pure(package->files[i].file_name), NULL))
+			continue;
+
+		if (cpymo_vfs_get(vfs, key)) continue;
+
+		cpymo_vfs_node node;
+		node.package = package;
+		node.file_index = i;
+		node.file_name = NULL;
+		cpymo_vfs_put(vfs, key, node);
+	}
+
+	return CPYMO_ERR_SUCC;
+}
+
+error_t cpymo_vfs_mount_patch(cpymo_vfs *vfs, const char *asset_type)
+{
+	char path[CPYMO_VFS_MAX_PATH];
+	int len = snprintf(path, sizeof(path), "%s/patch/%s.pak", vfs->gamedir, asset_type);
+	if (len < 0 || (size_t)len >= sizeof(path)) return CPYMO_ERR_OUT_OF_MEM;
+
+	cpymo_package *pkg = (cpymo_package *)malloc(sizeof(cpymo_package));
+	if (pkg == NULL) return CPYMO_ERR_OUT_OF_MEM;
+
+	error_t err = cpymo_package_open(pkg, path);
+	if (err != CPYMO_ERR_SUCC) {
+		free(pkg);
+		return err == CPYMO_ERR_CAN_NOT_OPEN_FILE ? CPYMO_ERR_SUCC : err;
+	}
+
+	arrput(vfs->patches, pkg);
+	return cpymo_vfs_mount_package(vfs, asset_type, pkg);
+}
+
+#ifdef ENABLE_VFS_DIRECTORY_SCAN
+error_t cpymo_vfs_mount_directory(cpymo_vfs *vfs, const char *asset_type)
+{
+	char path[CPYMO_VFS_MAX_PATH];
+	int len = snprintf(path, sizeof(path), "%s/%s", vfs->gamedir, asset_type);
+	if (len < 0 || (size_t)len >= sizeof(path)) return CPYMO_ERR_OUT_OF_MEM;
+
+	DIR *dir = opendir(path);
+	if (dir == NULL) return CPYMO_ERR_SUCC;
+
+	char key[CPYMO_VFS_MAX_KEY];
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		const char *file_name = ent->d_name;
+		if (file_name[0] == '.' || strchr(file_name, '.') == NULL) continue;
+
+		if (!cpymo_vfs_make_key(key, asset_type, cpymo_str_pure(file_name), NULL))
+			continue;
+
+		if (cpymo_vfs_get(vfs, key)) continue;
+
+		cpymo_vfs_node node;
+		node.package = NULL;
+		node.file_index = 0;
+		node.file_name = cpymo_str_copy_malloc(cpymo_str_pure(file_name));
+		if (node.file_name == NULL) {
+			closedir(dir);
+			return CPYMO_ERR_OUT_OF_MEM;
+		}
+
+		cpymo_vfs_put(vfs, key, node);
+	}
+
+	closedir(dir);
+	return CPYMO_ERR_SUCC;
+}
+#else
+error_t cpymo_vfs_mount_directory(cpymo_vfs *vfs, const char *asset_type)
+{
+	return CPYMO_ERR_UNSUPPORTED;
+}
+#endif
+
+error_t cpymo_vfs_find(
+	cpymo_vfs_file *out,
+	const cpymo_vfs *vfs,
+	const char *asset_type,
+	cpymo_str name,
+	const char *asset_ext)
+{
+	out->package = NULL;
+	out->path[0] = '\0';
+
+	char key[CPYMO_VFS_MAX_KEY];
+	if (!cpymo_vfs_make_key(key, asset_type, name, NULL))
+		return CPYMO_ERR_NOT_FOUND;
+
+	const cpymo_vfs_node *node = cpymo_vfs_get(vfs, key);
+	if (node && node->package) {
+		out->package = node->package;
+		out->index = node->package->files[node->file_index];
+		return CPYMO_ERR_SUCC;
+	}
+
+	if (asset_ext == NULL || vfs->gamedir == NULL) return CPYMO_ERR_NOT_FOUND;
+
+	int len;
+	if (vfs->directories_scanned) {
+		if (!cpymo_vfs_make_key(key, asset_type, name, asset_ext))
+			return CPYMO_ERR_NOT_FOUND;
+
+		node = cpymo_vfs_get(vfs, key);
+		if (node == NULL || node->file_name == NULL) return CPYMO_ERR_NOT_FOUND;
+
+		len = snprintf(out->path, sizeof(out->path), "%s/%s/%s",
+			vfs->gamedir, asset_type, node->file_name);
+	}
+	else {
+		len = snprintf(out->path, sizeof(out->path), "%s/%s/%.*s.%s",
+			vfs->gamedir, asset_type, (int)name.len, name.begin, asset_ext);
+	}
+
+	if (len < 0 || (size_t)len >= sizeof(out->path)) return CPYMO_ERR_OUT_OF_MEM;
+	return CPYMO_ERR_SUCC;
+}
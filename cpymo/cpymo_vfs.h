@@ -0,0 +1,57 @@
+#ifndef INCLUDE_CPYMO_VFS
+#define INCLUDE_CPYMO_VFS
+
+#include "cpymo_package.h"
+#include "cpymo_str.h"
+
+// One hashed namespace over patch packages, game packages and asset directories.
+// Keys are "<asset type>/<name>" for package entries
+// and "<asset type>/<name>.<ext>" for files in directories, case folded.
+// When the same name is mounted twice, the first mount wins,
+// so mount patch packages first, then game packages, then directories.
+
+#ifndef CPYMO_VFS_MAX_PATH
+#define CPYMO_VFS_MAX_PATH 1024
+#endif
+
+typedef struct {
+	// Set if the file is inside a package, (package, index) locates it.
+	const cpymo_package *package;
+	cpymo_package_index index;
+
+	// Set if the file is on the filesystem.
+	char path[CPYMO_VFS_MAX_PATH];
+} cpymo_vfs_file;
+
+typedef struct {
+	void *names;
+	cpymo_package **patches;
+	const char *gamedir;
+
+	// If true, every mounted directory is known to the VFS
+	// and a name that is not found does not exist.
+	bool directories_scanned;
+} cpymo_vfs;
+
+void cpymo_vfs_init(cpymo_vfs *vfs, const char *gamedir);
+void cpymo_vfs_free(cpymo_vfs *vfs);
+
+error_t cpymo_vfs_mount_package(
+	cpymo_vfs *vfs, const char *asset_type, const cpymo_package *package);
+
+// Opens <gamedir>/patch/<asset_type>.pak if it exists, owned by vfs.
+error_t cpymo_vfs_mount_patch(cpymo_vfs *vfs, const char *asset_type);
+
+// Scans <gamedir>/<asset_type>/ once, needs ENABLE_VFS_DIRECTORY_SCAN.
+// Without it, returns CPYMO_ERR_UNSUPPORTED and cpymo_vfs_find
+// builds the path for files not found in packages.
+error_t cpymo_vfs_mount_directory(cpymo_vfs *vfs, const char *asset_type);
+
+error_t cpymo_vfs_find(
+	cpymo_vfs_file *out,
+	const cpymo_vfs *vfs,
+	const char *asset_type,
+	cpymo_str name,
+	const char *asset_ext);
+
+#endif